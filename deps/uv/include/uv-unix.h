@@ -286,6 +286,8 @@ typedef struct {
 #define UV_UDP_PRIVATE_FIELDS                                                 \
   uv_alloc_cb alloc_cb;                                                       \
   uv_udp_recv_cb recv_cb;                                                     \
+  unsigned int recv_batch_count;                                              \
+  size_t recv_batch_size;                                                     \
   uv__io_t io_watcher;                                                        \
   void* write_queue[2];                                                       \
   void* write_completed_queue[2];                                             \
@@ -559,7 +559,14 @@ enum uv_udp_flags {
    * (provided they all set the flag) but only the last one to bind will receive
    * any traffic, in effect "stealing" the port from the previous listener.
    */
-  UV_UDP_REUSEADDR = 4
+  UV_UDP_REUSEADDR = 4,
+  /*
+   * Indicates that the message was received as part of a batch, see
+   * uv_udp_set_recv_batch(). The buffer points into the memory returned by
+   * the alloc callback and must not be freed by the recv callback; it is
+   * released with a final recv callback where nread == 0 and addr == NULL.
+   */
+  UV_UDP_MMSG_CHUNK = 8
 };
 
 typedef void (*uv_udp_send_cb)(uv_udp_send_t* req, int status);
@@ -626,6 +633,9 @@ UV_EXTERN int uv_udp_recv_start(uv_udp_t* handle,
                                 uv_alloc_cb alloc_cb,
                                 uv_udp_recv_cb recv_cb);
 UV_EXTERN int uv_udp_recv_stop(uv_udp_t* handle);
+UV_EXTERN int uv_udp_set_recv_batch(uv_udp_t* handle,
+                                    unsigned int count,
+                                    size_t size);
 
 
 /*
@@ -32,6 +32,10 @@
 # define IPV6_ADD_MEMBERSHIP IPV6_JOIN_GROUP
 #endif
 
+#if defined(__linux__)
+# define UV__UDP_MMSG_MAXWIDTH 64
+#endif
+
 #if defined(IPV6_LEAVE_GROUP) && !defined(IPV6_DROP_MEMBERSHIP)
 # define IPV6_DROP_MEMBERSHIP IPV6_LEAVE_GROUP
 #endif
@@ -40,7 +44,13 @@
 static void uv__udp_run_completed(uv_udp_t* handle);
 static void uv__udp_io(uv_loop_t* loop, uv__io_t* w, unsigned int revents);
 static void uv__udp_recvmsg(uv_udp_t* handle);
+#if defined(__linux__)
+static ssize_t uv__udp_recvmmsg(uv_udp_t* handle);
+#endif
 static void uv__udp_sendmsg(uv_udp_t* handle);
+#if defined(__linux__)
+static int uv__udp_sendmmsg(uv_udp_t* handle);
+#endif
 static int uv__udp_maybe_deferred_bind(uv_udp_t* handle,
                                        int domain,
                                        unsigned int flags);
@@ -165,6 +175,13 @@ static void uv__udp_recvmsg(uv_udp_t* handle) {
   h.msg_name = &peer;
 
   do {
+#if defined(__linux__)
+    if (handle->recv_batch_count > 1) {
+      nread = uv__udp_recvmmsg(handle);
+      continue;
+    }
+#endif
+
     handle->alloc_cb((uv_handle_t*) handle, 64 * 1024, &buf);
     if (buf.len == 0) {
       handle->recv_cb(handle, UV_ENOBUFS, &buf, NULL, 0);
@@ -209,12 +226,182 @@ static void uv__udp_recvmsg(uv_udp_t* handle) {
 }
 
 
+#if defined(__linux__)
+static ssize_t uv__udp_recvmmsg(uv_udp_t* handle) {
+  struct sockaddr_storage peers[UV__UDP_MMSG_MAXWIDTH];
+  struct iovec iov[UV__UDP_MMSG_MAXWIDTH];
+  struct uv__mmsghdr msgs[UV__UDP_MMSG_MAXWIDTH];
+  const struct sockaddr* addr;
+  uv_udp_recv_cb recv_cb;
+  uv_buf_t chunk;
+  uv_buf_t buf;
+  size_t chunks;
+  size_t size;
+  size_t k;
+  int flags;
+  int nread;
+
+  size = handle->recv_batch_size;
+  handle->alloc_cb((uv_handle_t*) handle,
+                   handle->recv_batch_count * size,
+                   &buf);
+  if (buf.len == 0) {
+    handle->recv_cb(handle, UV_ENOBUFS, &buf, NULL, 0);
+    return -1;
+  }
+  assert(buf.base != NULL);
+
+  /* The alloc callback is free to hand out less than was asked for. */
+  chunks = buf.len / size;
+  if (chunks > handle->recv_batch_count)
+    chunks = handle->recv_batch_count;
+  if (chunks == 0) {
+    chunks = 1;
+    size = buf.len;
+  }
+
+  for (k = 0; k < chunks; k++) {
+    iov[k].iov_base = buf.base + k * size;
+    iov[k].iov_len = size;
+    memset(&msgs[k].msg_hdr, 0, sizeof(msgs[k].msg_hdr));
+    msgs[k].msg_hdr.msg_iov = iov + k;
+    msgs[k].msg_hdr.msg_iovlen = 1;
+    msgs[k].msg_hdr.msg_name = peers + k;
+    msgs[k].msg_hdr.msg_namelen = sizeof(peers[k]);
+  }
+
+  do {
+    nread = uv__recvmmsg(handle->io_watcher.fd, msgs, chunks, 0, NULL);
+  }
+  while (nread == -1 && errno == EINTR);
+
+  if (nread == -1) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      handle->recv_cb(handle, 0, &buf, NULL, 0);
+    } else if (errno == ENOSYS) {
+      /* Kernel predates recvmmsg(), fall back to one datagram per call. */
+      handle->recv_batch_count = 0;
+      handle->recv_cb(handle, 0, &buf, NULL, 0);
+      return 0;
+    } else {
+      handle->recv_cb(handle, -errno, &buf, NULL, 0);
+    }
+    return -1;
+  }
+
+  /* recv_cb may stop the handle halfway through the batch. Hold on to it so
+   * the buffer can still be released at the end.
+   */
+  recv_cb = handle->recv_cb;
+
+  for (k = 0; k < (size_t) nread && handle->recv_cb != NULL; k++) {
+    flags = UV_UDP_MMSG_CHUNK;
+    if (msgs[k].msg_hdr.msg_flags & MSG_TRUNC)
+      flags |= UV_UDP_PARTIAL;
+
+    if (msgs[k].msg_hdr.msg_namelen == 0)
+      addr = NULL;
+    else
+      addr = (const struct sockaddr*) (peers + k);
+
+    chunk = uv_buf_init(iov[k].iov_base, iov[k].iov_len);
+    handle->recv_cb(handle, msgs[k].msg_len, &chunk, addr, flags);
+  }
+
+  /* One last callback so the batch can be delivered and the buffer freed. */
+  recv_cb(handle, 0, &buf, NULL, 0);
+
+  return nread;
+}
+#endif
+
+
+#if defined(__linux__)
+/* Flushes up to UV__UDP_MMSG_MAXWIDTH queued requests per system call.
+ * Returns UV_ENOSYS if the kernel does not know about sendmmsg(), in which
+ * case nothing has been sent and the caller should fall back to sendmsg().
+ */
+static int uv__udp_sendmmsg(uv_udp_t* handle) {
+  struct uv__mmsghdr h[UV__UDP_MMSG_MAXWIDTH];
+  struct uv__mmsghdr* p;
+  uv_udp_send_t* req;
+  QUEUE* q;
+  int npkts;
+  int pkts;
+  int i;
+
+  while (!QUEUE_EMPTY(&handle->write_queue)) {
+    for (pkts = 0, q = QUEUE_HEAD(&handle->write_queue);
+         pkts < UV__UDP_MMSG_MAXWIDTH && q != &handle->write_queue;
+         pkts++, q = QUEUE_NEXT(q)) {
+      req = QUEUE_DATA(q, uv_udp_send_t, queue);
+      p = h + pkts;
+      memset(p, 0, sizeof(*p));
+      p->msg_hdr.msg_name = &req->addr;
+      p->msg_hdr.msg_namelen = (req->addr.ss_family == AF_INET6 ?
+        sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
+      p->msg_hdr.msg_iov = (struct iovec*) req->bufs;
+      p->msg_hdr.msg_iovlen = req->nbufs;
+    }
+
+    do {
+      npkts = uv__sendmmsg(handle->io_watcher.fd, h, pkts, 0);
+    } while (npkts == -1 && errno == EINTR);
+
+    if (npkts == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+      if (errno == ENOSYS)
+        return -ENOSYS;
+
+      /* The error belongs to the first datagram in the batch; the others
+       * have not been tried yet and go out with the next call.
+       */
+      q = QUEUE_HEAD(&handle->write_queue);
+      req = QUEUE_DATA(q, uv_udp_send_t, queue);
+      req->status = -errno;
+      QUEUE_REMOVE(&req->queue);
+      QUEUE_INSERT_TAIL(&handle->write_completed_queue, &req->queue);
+      uv__io_feed(handle->loop, &handle->io_watcher);
+      continue;
+    }
+
+    for (i = 0; i < npkts; i++) {
+      q = QUEUE_HEAD(&handle->write_queue);
+      req = QUEUE_DATA(q, uv_udp_send_t, queue);
+      req->status = h[i].msg_len;
+
+      /* See uv__udp_sendmsg() as to why partial writes aren't a concern. */
+      QUEUE_REMOVE(&req->queue);
+      QUEUE_INSERT_TAIL(&handle->write_completed_queue, &req->queue);
+    }
+    uv__io_feed(handle->loop, &handle->io_watcher);
+  }
+
+  return 0;
+}
+#endif
+
+
 static void uv__udp_sendmsg(uv_udp_t* handle) {
   uv_udp_send_t* req;
   QUEUE* q;
   struct msghdr h;
   ssize_t size;
 
+#if defined(__linux__)
+  static int no_sendmmsg;
+
+  /* A lone datagram gains nothing from sendmmsg(). */
+  if (no_sendmmsg == 0 &&
+      !QUEUE_EMPTY(&handle->write_queue) &&
+      QUEUE_NEXT(QUEUE_HEAD(&handle->write_queue)) != &handle->write_queue) {
+    if (uv__udp_sendmmsg(handle) == 0)
+      return;
+    no_sendmmsg = 1;
+  }
+#endif
+
   while (!QUEUE_EMPTY(&handle->write_queue)) {
     q = QUEUE_HEAD(&handle->write_queue);
     assert(q != NULL);
@@ -555,6 +742,8 @@ int uv_udp_init(uv_loop_t* loop, uv_udp_t* handle) {
   uv__handle_init(loop, (uv_handle_t*)handle, UV_UDP);
   handle->alloc_cb = NULL;
   handle->recv_cb = NULL;
+  handle->recv_batch_count = 0;
+  handle->recv_batch_size = 0;
   handle->send_queue_size = 0;
   handle->send_queue_count = 0;
   uv__io_init(&handle->io_watcher, uv__udp_io, -1);
@@ -826,6 +1015,20 @@ int uv__udp_recv_start(uv_udp_t* handle,
 }
 
 
+int uv_udp_set_recv_batch(uv_udp_t* handle, unsigned int count, size_t size) {
+#if defined(__linux__)
+  if (count > UV__UDP_MMSG_MAXWIDTH || (count > 1 && size == 0))
+    return -EINVAL;
+
+  handle->recv_batch_count = count > 1 ? count : 0;
+  handle->recv_batch_size = size;
+  return 0;
+#else
+  return -ENOSYS;
+#endif
+}
+
+
 int uv__udp_recv_stop(uv_udp_t* handle) {
   uv__io_stop(handle->loop, &handle->io_watcher, UV__POLLIN);
 
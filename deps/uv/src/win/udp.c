@@ -751,6 +751,11 @@ int uv_udp_set_broadcast(uv_udp_t* handle, int value) {
 }
 
 
+int uv_udp_set_recv_batch(uv_udp_t* handle, unsigned int count, size_t size) {
+  return UV_ENOSYS;
+}
+
+
 int uv_udp_open(uv_udp_t* handle, uv_os_sock_t sock) {
   WSAPROTOCOL_INFOW protocol_info;
   int opt_len;
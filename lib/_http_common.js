@@ -29,8 +29,9 @@ var IncomingMessage = incoming.IncomingMessage;
 var readStart = incoming.readStart;
 var readStop = incoming.readStop;
 
-var isNumber = require('util').isNumber;
-var debug = require('util').debuglog('http');
+var util = require('util');
+var isNumber = util.isNumber;
+var debug = util.debuglog('http');
 exports.debug = debug;
 
 exports.CRLF = '\r\n';
@@ -42,13 +43,36 @@ var kOnHeaders = HTTPParser.kOnHeaders | 0;
 var kOnHeadersComplete = HTTPParser.kOnHeadersComplete | 0;
 var kOnBody = HTTPParser.kOnBody | 0;
 var kOnMessageComplete = HTTPParser.kOnMessageComplete | 0;
+var kOnBodySpans = HTTPParser.kOnBodySpans | 0;
+var kOnBatch = HTTPParser.kOnBatch | 0;
 
-// Only called in the slow case where slow means
-// that the request headers were either fragmented
-// across multiple TCP packets or too large to be
-// processed in a single run. This method is also
-// called to process trailing HTTP headers.
+// Turns the buffer that a parser in raw headers mode hands out (see
+// parser.setRawHeaders() and CreateRawHeaders() in node_http_parser.cc)
+// into the usual [field, value, field, value, ...] list:
+//
+//   uint32le count         number of field/value pairs
+//   uint32le end[2*count]  end offset of each field and value
+//   char data[]            the fields and values, back to back
+function decodeRawHeaders(buf) {
+  var count = buf.readUInt32LE(0, true);
+  var start = 4 + 8 * count;
+  var headers = new Array(2 * count);
+  for (var i = 0; i < 2 * count; i++) {
+    var end = buf.readUInt32LE(4 + 4 * i, true);
+    headers[i] = buf.toString('binary', start, end);
+    start = end;
+  }
+  return headers;
+}
+exports.decodeRawHeaders = decodeRawHeaders;
+
+// Only called to process trailing HTTP headers. The regular headers
+// always arrive in one piece with parserOnHeadersComplete().
 function parserOnHeaders(headers, url) {
+  // A Buffer in raw headers mode, concat() would add it as one element.
+  if (util.isBuffer(headers))
+    headers = decodeRawHeaders(headers);
+
   // Once we exceeded headers limit - stop collecting them
   if (this.maxHeaderPairs <= 0 ||
       this._headers.length < this.maxHeaderPairs) {
@@ -57,8 +81,9 @@ function parserOnHeaders(headers, url) {
   this._url += url;
 }
 
-// info.headers and info.url are set only if .onHeaders()
-// has not been called for this request.
+// info.headers and info.url are always set now that the binding no
+// longer flushes headers early; parser._headers and parser._url are
+// only a fallback.
 //
 // info.url is not set for response parsers but that's not
 // applicable here since all our parsers are request parsers.
@@ -68,7 +93,9 @@ function parserOnHeadersComplete(info) {
   var headers = info.headers;
   var url = info.url;
 
-  if (!headers) {
+  if (util.isBuffer(headers)) {
+    headers = decodeRawHeaders(headers);
+  } else if (!headers) {
     headers = parser._headers;
     parser._headers = [];
   }
@@ -118,8 +145,15 @@ function parserOnHeadersComplete(info) {
 
 // XXX This is a mess.
 // TODO: http.Parser should be a Writable emits request/response events.
-function parserOnBody(b, start, len) {
-  var parser = this;
+//
+// Called once per parser.execute() with all the body data it found, as
+// [offset, length] pairs into b.
+function parserOnBodySpans(b, spans) {
+  for (var i = 0; i < spans.length; i += 2)
+    pushBody(this, b, spans[i], spans[i + 1]);
+}
+
+function pushBody(parser, b, start, len) {
   var stream = parser.incoming;
 
   // if the stream has already been removed, then drop it.
@@ -137,6 +171,37 @@ function parserOnBody(b, start, len) {
   }
 }
 
+// Called once per parser.execute() of a request parser with everything
+// that happened during it, as a flat list of callback indices followed by
+// their arguments. Pipelined requests thus cost a single call into JS.
+function parserOnBatch(b, events) {
+  var parser = this;
+  var i = 0;
+
+  while (i < events.length) {
+    switch (events[i]) {
+      case kOnHeadersComplete:
+        parserOnHeadersComplete.call(parser, events[i + 1]);
+        i += 2;
+        break;
+      case kOnBody:
+        pushBody(parser, b, events[i + 1], events[i + 2]);
+        i += 3;
+        break;
+      case kOnHeaders:
+        parserOnHeaders.call(parser, events[i + 1], events[i + 2]);
+        i += 3;
+        break;
+      case kOnMessageComplete:
+        parserOnMessageComplete.call(parser);
+        i += 1;
+        break;
+      default:
+        throw new Error('Unknown parser event ' + events[i]);
+    }
+  }
+}
+
 function parserOnMessageComplete() {
   var parser = this;
   var stream = parser.incoming;
@@ -166,24 +231,95 @@ function parserOnMessageComplete() {
 }
 
 
-var parsers = new FreeList('parsers', 1000, function() {
+function createParser() {
   var parser = new HTTPParser(HTTPParser.REQUEST);
 
   parser._headers = [];
   parser._url = '';
 
-  // Only called in the slow case where slow means
-  // that the request headers were either fragmented
-  // across multiple TCP packets or too large to be
-  // processed in a single run. This method is also
-  // called to process trailing HTTP headers.
+  // Only called to process trailing HTTP headers.
   parser[kOnHeaders] = parserOnHeaders;
   parser[kOnHeadersComplete] = parserOnHeadersComplete;
-  parser[kOnBody] = parserOnBody;
+  parser[kOnBodySpans] = parserOnBodySpans;
   parser[kOnMessageComplete] = parserOnMessageComplete;
+  parser[kOnBatch] = parserOnBatch;
 
   return parser;
-});
+}
+
+
+// Bounds for the number of idle parsers kept around. Within them the pool
+// holds on to as many parsers as were allocated in the last second, so it
+// grows with the connection rate and shrinks again when things quiet down.
+// The floor is what the fixed pool used to hold.
+var kParserPoolMin = 1000;
+var kParserPoolMax = 4096;
+var kParserPoolWindow = 1000;
+
+function ParserPool() {
+  FreeList.call(this, 'parsers', kParserPoolMin, createParser);
+  this.created = 0;
+  this.reused = 0;
+  this.closed = 0;
+  this._windowStart = Date.now();
+  this._windowAllocs = 0;
+}
+util.inherits(ParserPool, FreeList);
+
+
+ParserPool.prototype.alloc = function() {
+  this._resize();
+  this._windowAllocs++;
+  // Most recently freed first, it is the most likely to still be in the
+  // CPU cache.
+  if (this.list.length) {
+    this.reused++;
+    return this.list.pop();
+  }
+  this.created++;
+  return this.constructor();
+};
+
+
+ParserPool.prototype.free = function(parser) {
+  if (FreeList.prototype.free.call(this, parser))
+    return true;
+  this.closed++;
+  return false;
+};
+
+
+ParserPool.prototype._resize = function() {
+  var now = Date.now();
+  var elapsed = now - this._windowStart;
+  if (elapsed < kParserPoolWindow)
+    return;
+
+  // An idle stretch longer than a window means the rate has dropped to zero.
+  var rate = elapsed < 2 * kParserPoolWindow ? this._windowAllocs : 0;
+  this.max = Math.min(Math.max(rate, kParserPoolMin), kParserPoolMax);
+  this._windowStart = now;
+  this._windowAllocs = 0;
+
+  while (this.list.length > this.max) {
+    this.list.pop().close();
+    this.closed++;
+  }
+};
+
+
+ParserPool.prototype.stats = function() {
+  return {
+    pooled: this.list.length,
+    max: this.max,
+    created: this.created,
+    reused: this.reused,
+    closed: this.closed
+  };
+};
+
+
+var parsers = new ParserPool();
 exports.parsers = parsers;
 
 
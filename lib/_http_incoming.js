@@ -100,7 +100,7 @@ IncomingMessage.prototype.read = function(n) {
 
 
 IncomingMessage.prototype._read = function(n) {
-  // We actually do almost nothing here, because the parserOnBody
+  // We actually do almost nothing here, because the parserOnBodySpans
   // function fills up our internal buffer directly.  However, we
   // do need to unpause the underlying socket so that it flows.
   if (this.socket.readable)
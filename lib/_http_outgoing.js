@@ -37,6 +37,7 @@ var connectionExpression = /Connection/i;
 var transferEncodingExpression = /Transfer-Encoding/i;
 var closeExpression = /close/i;
 var contentLengthExpression = /Content-Length/i;
+var contentEncodingExpression = /Content-Encoding/i;
 var dateExpression = /Date/i;
 var expectExpression = /Expect/i;
 
@@ -81,6 +82,7 @@ function OutgoingMessage() {
 
   this._hasBody = true;
   this._trailer = '';
+  this._gzip = null;  // Native compressor options, see ServerResponse#gzip().
 
   this.finished = false;
   this._hangupClose = false;
@@ -129,9 +131,15 @@ OutgoingMessage.prototype._send = function(data, encoding, callback) {
   // the same packet. Future versions of Node are going to take care of
   // this at a lower level and in a more general way.
   if (!this._headerSent) {
-    if (util.isString(data) &&
-        encoding !== 'hex' &&
-        encoding !== 'base64') {
+    if (this._gzip && this._hasBody) {
+      // The headers go out in the clear, the body through the compressor.
+      this._headerSent = true;
+      this._gzip.chunked = this.chunkedEncoding;
+      this._writeRaw(this._header, 'binary', null);
+      this._writeRaw(gzipSwitch(this._gzip), null, null);
+    } else if (util.isString(data) &&
+               encoding !== 'hex' &&
+               encoding !== 'base64') {
       data = this._header + data;
     } else {
       this.output.unshift(this._header);
@@ -150,7 +158,7 @@ OutgoingMessage.prototype._writeRaw = function(data, encoding, callback) {
     encoding = null;
   }
 
-  if (data.length === 0) {
+  if (data.length === 0 && util.isUndefined(data._gzip)) {
     if (util.isFunction(callback))
       process.nextTick(callback);
     return true;
@@ -238,6 +246,9 @@ OutgoingMessage.prototype._storeHeader = function(firstLine, headers) {
     state.messageHeader += 'Date: ' + utcDate() + CRLF;
   }
 
+  if (this._gzip)
+    state.messageHeader += 'Content-Encoding: gzip' + CRLF;
+
   // Force the connection to close when the response is a 204 No Content or
   // a 304 Not Modified and the user has set a "Transfer-Encoding: chunked"
   // header.
@@ -299,6 +310,13 @@ OutgoingMessage.prototype._storeHeader = function(firstLine, headers) {
 };
 
 function storeHeader(self, state, field, value) {
+  // Those would describe the body before compression.
+  if (self._gzip &&
+      (contentLengthExpression.test(field) ||
+       contentEncodingExpression.test(field))) {
+    return;
+  }
+
   // Protect against response splitting. The if statement is there to
   // minimize the performance impact in the common case.
   if (/[\r\n]/.test(value))
@@ -441,7 +459,7 @@ OutgoingMessage.prototype.write = function(chunk, encoding, callback) {
   if (chunk.length === 0) return true;
 
   var len, ret;
-  if (this.chunkedEncoding) {
+  if (this.chunkedEncoding && !this._gzip) {
     if (util.isString(chunk) &&
         encoding !== 'hex' &&
         encoding !== 'base64' &&
@@ -501,6 +519,15 @@ OutgoingMessage.prototype.addTrailers = function(headers) {
 var crlf_buf = new Buffer('\r\n');
 
 
+// An empty chunk that turns the socket's compressor on (with |options|) or
+// off (null) when the socket gets to it, see net.Socket#_writeGzip().
+function gzipSwitch(options) {
+  var chunk = new Buffer(0);
+  chunk._gzip = options;
+  return chunk;
+}
+
+
 OutgoingMessage.prototype.end = function(data, encoding, callback) {
   if (util.isFunction(data)) {
     callback = data;
@@ -546,6 +573,9 @@ OutgoingMessage.prototype.end = function(data, encoding, callback) {
     ret = this.write(data, encoding);
   }
 
+  if (this._hasBody && this._gzip)
+    this._send(gzipSwitch(null), null, null);
+
   if (this._hasBody && this.chunkedEncoding) {
     ret = this._send('0\r\n' + this._trailer + '\r\n', 'binary', finish);
   } else {
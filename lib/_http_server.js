@@ -106,6 +106,7 @@ function ServerResponse(req) {
   if (req.method === 'HEAD') this._hasBody = false;
 
   this.sendDate = true;
+  this._gzipSocket = req.socket;  // Not assigned yet if pipelined.
 
   if (req.httpVersionMajor < 1 || req.httpVersionMinor < 1) {
     this.useChunkedEncodingByDefault = chunkExpression.test(req.headers.te);
@@ -170,6 +171,21 @@ ServerResponse.prototype.writeContinue = function(cb) {
   this._sent100 = true;
 };
 
+// Compresses the body with gzip on its way to the socket, in native code,
+// rather than through a zlib.Gzip stream. Returns false, and leaves the
+// response alone, if the connection can't do that, e.g. with HTTPS.
+ServerResponse.prototype.gzip = function(options) {
+  if (this._header)
+    throw new Error('Can\'t enable compression after headers are sent.');
+
+  var socket = this._gzipSocket;
+  if (!socket || !socket._canGzip || !socket._canGzip())
+    return false;
+
+  this._gzip = require('zlib')._gzipStreamOptions(options);
+  return true;
+};
+
 ServerResponse.prototype._implicitHeader = function() {
   this.writeHead(this.statusCode);
 };
@@ -26,7 +26,10 @@
 
 var assert = require('assert');
 var crypto = require('crypto');
+var fs = require('fs');
 var net = require('net');
+var os = require('os');
+var path = require('path');
 var tls = require('tls');
 var util = require('util');
 var listenerCount = require('events').listenerCount;
@@ -244,6 +247,10 @@ function TLSSocket(socket, options) {
     this._connecting = socket._connecting;
   }
 
+  // Writes made during a tick are encrypted together, so that small ones
+  // share a TLS record.
+  this._autoCork = true;
+
   this._tlsOptions = options;
   this._secureEstablished = false;
   this._securePending = false;
@@ -322,6 +329,9 @@ TLSSocket.prototype._init = function(socket) {
          listenerCount(this.server, 'OCSPRequest') > 0)) {
       this.ssl.enableSessionCallbacks();
     }
+
+    if (options.asyncHandshake)
+      this.ssl.enableAsyncHandshake();
   } else {
     this.ssl.onhandshakestart = function() {};
     this.ssl.onhandshakedone = this._finishInit.bind(this);
@@ -418,6 +428,10 @@ TLSSocket.prototype.setMaxSendFragment = function setMaxSendFragment(size) {
   return this.ssl.setMaxSendFragment(size) == 1;
 };
 
+TLSSocket.prototype.getRecordStats = function getRecordStats() {
+  return this.ssl ? this.ssl.getRecordStats() : null;
+};
+
 TLSSocket.prototype.getTLSTicket = function getTLSTicket() {
   return this.ssl.getTLSTicket();
 };
@@ -561,6 +575,9 @@ TLSSocket.prototype.getCipher = function(err) {
 // - cert: string.
 // - ca: string or array of strings.
 // - sessionTimeout: integer.
+// - sessionCacheSize: integer, number of sessions in the shared cache.
+// - sessionCacheFile: string, where the shared cache lives.
+// - asyncHandshake: boolean, run handshake crypto on the thread pool.
 //
 // emit 'secureConnection'
 //   function (tlsSocket) { }
@@ -628,6 +645,31 @@ function Server(/* [options], listener */) {
     sharedCreds.context.setTicketKeys(self.ticketKeys);
   }
 
+  if (self.sessionCacheSize) {
+    if (self.sessionCacheFile) {
+      this._sessionCacheFile = self.sessionCacheFile;
+    } else {
+      this._sessionCacheFile = path.join(os.tmpdir(),
+          'node-tls-sessions-' + process.pid + '-' +
+          crypto.pseudoRandomBytes(8).toString('hex'));
+      this._ownSessionCacheFile = true;
+    }
+    var err = sharedCreds.context.setSessionCache(this._sessionCacheFile,
+                                                  self.sessionCacheSize);
+    if (err)
+      throw util._errnoException(err, 'open', this._sessionCacheFile);
+    if (this._ownSessionCacheFile) {
+      // The file goes when the server is closed, or at exit if it never is.
+      // In a cluster the master may take it over, see _setServerData().
+      var removeOnExit = removeSessionCacheFile.bind(null, this);
+      process.on('exit', removeOnExit);
+      this.once('close', function() {
+        process.removeListener('exit', removeOnExit);
+        removeOnExit();
+      });
+    }
+  }
+
   // constructor call
   net.Server.call(this, function(raw_socket) {
     var socket = new TLSSocket(raw_socket, {
@@ -638,7 +680,8 @@ function Server(/* [options], listener */) {
       rejectUnauthorized: self.rejectUnauthorized,
       handshakeTimeout: timeout,
       NPNProtocols: self.NPNProtocols,
-      SNICallback: options.SNICallback || SNICallback
+      SNICallback: options.SNICallback || SNICallback,
+      asyncHandshake: self.asyncHandshake
     });
 
     socket.on('secure', function() {
@@ -689,15 +732,82 @@ exports.createServer = function(options, listener) {
 };
 
 
+exports.getAsyncHandshakeStats = function() {
+  return tls_wrap.getHandshakeStats();
+};
+
+
+function removeSessionCacheFile(server) {
+  if (!server._ownSessionCacheFile)
+    return;
+  server._ownSessionCacheFile = false;
+  try {
+    fs.unlinkSync(server._sessionCacheFile);
+  } catch (e) {
+    // Already gone, nothing to do.
+  }
+}
+
+
 Server.prototype._getServerData = function() {
   return {
-    ticketKeys: this._sharedCreds.context.getTicketKeys().toString('hex')
+    ticketKeys: this._sharedCreds.context.getTicketKeys().toString('hex'),
+    sessionCache: this._sessionCacheFile,
+    sessionCacheTemp: !!this._ownSessionCacheFile
   };
 };
 
 
 Server.prototype._setServerData = function(data) {
   this._sharedCreds.context.setTicketKeys(new Buffer(data.ticketKeys, 'hex'));
+
+  // The master shares our temporary cache with the other workers, it's up to
+  // the master to remove it now.
+  if (this._ownSessionCacheFile &&
+      data.sessionCache === this._sessionCacheFile) {
+    this._ownSessionCacheFile = false;
+  }
+
+  // Switch over to the cache of the first worker. Keep our own if that fails,
+  // a private cache is still better than no cache at all.
+  if (this._sessionCacheFile &&
+      data.sessionCache &&
+      data.sessionCache !== this._sessionCacheFile) {
+    var err = this._sharedCreds.context.setSessionCache(data.sessionCache,
+                                                        this.sessionCacheSize);
+    if (!err) {
+      removeSessionCacheFile(this);
+      this._sessionCacheFile = data.sessionCache;
+    }
+  }
+};
+
+
+Server.prototype.getTicketKeys = function() {
+  return this._sharedCreds.context.getTicketKeys();
+};
+
+
+// Replaces the session ticket keys in one go. The first key encrypts new
+// tickets, the others only decrypt the tickets issued before they were
+// rotated out.
+Server.prototype.setTicketKeys = function(keys) {
+  if (!util.isBuffer(keys) || keys.length === 0 || keys.length % 48 !== 0)
+    throw new TypeError('keys must be a Buffer of one or more 48-byte keys');
+  this._sharedCreds.context.setTicketKeys(keys);
+};
+
+
+Server.prototype.getTicketKeyStats = function() {
+  var stats = this._sharedCreds.context.getTicketKeyStats();
+  return util.isUndefined(stats) ? null : stats;
+};
+
+
+Server.prototype.getSessionCacheStats = function() {
+  if (!this._sessionCacheFile)
+    return null;
+  return this._sharedCreds.context.getSessionCacheStats();
 };
 
 
@@ -727,6 +837,11 @@ Server.prototype.setOptions = function(options) {
   if (options.dhparam) this.dhparam = options.dhparam;
   if (options.sessionTimeout) this.sessionTimeout = options.sessionTimeout;
   if (options.ticketKeys) this.ticketKeys = options.ticketKeys;
+  if (options.sessionCacheSize)
+    this.sessionCacheSize = options.sessionCacheSize;
+  if (options.sessionCacheFile)
+    this.sessionCacheFile = options.sessionCacheFile;
+  if (options.asyncHandshake) this.asyncHandshake = options.asyncHandshake;
 
   var secureOptions = common._getSecureOptions(options.secureProtocol,
                                                options.secureOptions);
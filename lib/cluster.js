@@ -25,6 +25,7 @@ var EventEmitter = require('events').EventEmitter;
 var assert = require('assert');
 var dgram = require('dgram');
 var fork = require('child_process').fork;
+var fs = require('fs');
 var net = require('net');
 var util = require('util');
 var SCHED_NONE = 1;
@@ -239,6 +240,35 @@ function masterInit() {
   // itself so we might end up with an O(n*m) operation. Ergo, FIXME.
   var handles = {};
 
+  // A TLS server's temporary session cache file comes along with the server
+  // data of the first worker that listens. The other workers switch over to
+  // it so it has to stay around for as long as the handle does, rather than
+  // for as long as the worker that created it.
+  var sessionCacheFiles = {};
+  var removeSessionCacheFilesOnExit = false;
+
+  function removeHandle(key) {
+    var data = handles[key].data;
+    delete handles[key];
+    if (data && data.sessionCacheTemp)
+      removeSessionCacheFile(data.sessionCache);
+  }
+
+  function removeSessionCacheFile(path) {
+    if (!(path in sessionCacheFiles))
+      return;
+    delete sessionCacheFiles[path];
+    try {
+      fs.unlinkSync(path);
+    } catch (e) {
+      // Already gone, nothing to do.
+    }
+  }
+
+  function removeSessionCacheFiles() {
+    Object.keys(sessionCacheFiles).forEach(removeSessionCacheFile);
+  }
+
   var initialized = false;
   cluster.setupMaster = function(options) {
     var settings = {
@@ -355,7 +385,7 @@ function masterInit() {
 
       for (var key in handles) {
         var handle = handles[key];
-        if (handle.remove(worker)) delete handles[key];
+        if (handle.remove(worker)) removeHandle(key);
       }
     }
 
@@ -476,7 +506,16 @@ function masterInit() {
                                               message.backlog,
                                               message.fd);
     }
-    if (!handle.data) handle.data = message.data;
+    if (!handle.data) {
+      handle.data = message.data;
+      if (handle.data && handle.data.sessionCacheTemp) {
+        if (!removeSessionCacheFilesOnExit) {
+          removeSessionCacheFilesOnExit = true;
+          process.on('exit', removeSessionCacheFiles);
+        }
+        sessionCacheFiles[handle.data.sessionCache] = true;
+      }
+    }
 
     // Set custom server data
     handle.add(worker, function(errno, reply, handle) {
@@ -486,7 +525,7 @@ function masterInit() {
         ack: message.seq,
         data: handles[key].data
       }, reply);
-      if (errno) delete handles[key];  // Gives other workers a chance to retry.
+      if (errno) removeHandle(key);  // Gives other workers a chance to retry.
       send(worker, reply, handle);
     });
   }
@@ -507,7 +546,7 @@ function masterInit() {
   function close(worker, message) {
     var key = message.key;
     var handle = handles[key];
-    if (handle.remove(worker)) delete handles[key];
+    if (handle.remove(worker)) removeHandle(key);
   }
 
   function send(worker, message, handle, cb) {
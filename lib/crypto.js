@@ -129,6 +129,11 @@ Hash.prototype.digest = function(outputEncoding) {
 };
 
 
+Hash.prototype.digestInto = function(output, offset) {
+  return this._handle.digestInto(output, offset || 0);
+};
+
+
 exports.createHmac = exports.Hmac = Hmac;
 
 function Hmac(hmac, key, options) {
@@ -143,10 +148,90 @@ util.inherits(Hmac, LazyTransform);
 
 Hmac.prototype.update = Hash.prototype.update;
 Hmac.prototype.digest = Hash.prototype.digest;
+Hmac.prototype.digestInto = Hash.prototype.digestInto;
 Hmac.prototype._flush = Hash.prototype._flush;
 Hmac.prototype._transform = Hash.prototype._transform;
 
 
+// One-shot versions of createHash(algorithm).update(data).digest(encoding)
+// and the Hmac equivalent, without the object overhead.
+function hashInputEncoding() {
+  var encoding = exports.DEFAULT_ENCODING;
+  return encoding === 'buffer' ? 'binary' : encoding;
+}
+
+
+exports.hash = function(algorithm, data, outputEncoding) {
+  return binding.hash(algorithm,
+                      data,
+                      hashInputEncoding(),
+                      outputEncoding || exports.DEFAULT_ENCODING);
+};
+
+
+exports.hmac = function(algorithm, key, data, outputEncoding) {
+  return binding.hmac(algorithm,
+                      toBuf(key),
+                      data,
+                      hashInputEncoding(),
+                      outputEncoding || exports.DEFAULT_ENCODING);
+};
+
+
+// Hashes a Buffer or a range of a file on the thread pool, with one or more
+// algorithms in a single pass over the data.
+exports.digest = function(algorithms, source, options, callback) {
+  if (util.isFunction(options)) {
+    callback = options;
+    options = {};
+  }
+  options = options || {};
+
+  var single = util.isString(algorithms);
+  if (single)
+    algorithms = [algorithms];
+  if (!util.isArray(algorithms))
+    throw new TypeError('algorithms must be a string or an array');
+  if (!util.isFunction(callback))
+    throw new TypeError('callback must be a function');
+
+  var start = options.start || 0;
+  var length = -1;
+  if (util.isNumber(options.length))
+    length = options.length;
+  else if (util.isBuffer(source))
+    length = source.length - start;
+
+  var encoding = options.encoding || exports.DEFAULT_ENCODING;
+  var progress = options.progress;
+  var onprogress = null;
+  if (util.isFunction(progress)) {
+    onprogress = function(stats) {
+      progress(addThroughput(stats));
+    };
+  }
+
+  function ondone(err, digests, stats) {
+    if (err)
+      return callback(err);
+    if (encoding !== 'buffer') {
+      digests = digests.map(function(digest) {
+        return digest.toString(encoding);
+      });
+    }
+    callback(null, single ? digests[0] : digests, addThroughput(stats));
+  }
+
+  binding.digest(algorithms, source, start, length, onprogress, ondone);
+};
+
+
+function addThroughput(stats) {
+  stats.throughput = stats.time > 0 ? stats.bytes / stats.time * 1000 : 0;
+  return stats;
+}
+
+
 function getDecoder(decoder, encoding) {
   if (encoding === 'utf-8') encoding = 'utf8';  // Normalize encoding.
   decoder = decoder || new StringDecoder(encoding);
@@ -212,6 +297,24 @@ Cipher.prototype.final = function(outputEncoding) {
 };
 
 
+Cipher.prototype.updateInto = function(data, output, offset, callback) {
+  if (util.isFunction(offset)) {
+    callback = offset;
+    offset = 0;
+  }
+  offset = offset || 0;
+  if (util.isFunction(callback))
+    this._handle.updateInto(data, output, offset, callback);
+  else
+    return this._handle.updateInto(data, output, offset);
+};
+
+
+Cipher.prototype.finalInto = function(output, offset) {
+  return this._handle.finalInto(output, offset || 0);
+};
+
+
 Cipher.prototype.setAutoPadding = function(ap) {
   this._handle.setAutoPadding(ap);
   return this;
@@ -236,6 +339,8 @@ Cipheriv.prototype._transform = Cipher.prototype._transform;
 Cipheriv.prototype._flush = Cipher.prototype._flush;
 Cipheriv.prototype.update = Cipher.prototype.update;
 Cipheriv.prototype.final = Cipher.prototype.final;
+Cipheriv.prototype.updateInto = Cipher.prototype.updateInto;
+Cipheriv.prototype.finalInto = Cipher.prototype.finalInto;
 Cipheriv.prototype.setAutoPadding = Cipher.prototype.setAutoPadding;
 
 Cipheriv.prototype.getAuthTag = function() {
@@ -270,6 +375,8 @@ Decipher.prototype._transform = Cipher.prototype._transform;
 Decipher.prototype._flush = Cipher.prototype._flush;
 Decipher.prototype.update = Cipher.prototype.update;
 Decipher.prototype.final = Cipher.prototype.final;
+Decipher.prototype.updateInto = Cipher.prototype.updateInto;
+Decipher.prototype.finalInto = Cipher.prototype.finalInto;
 Decipher.prototype.finaltol = Cipher.prototype.final;
 Decipher.prototype.setAutoPadding = Cipher.prototype.setAutoPadding;
 
@@ -293,6 +400,8 @@ Decipheriv.prototype._transform = Cipher.prototype._transform;
 Decipheriv.prototype._flush = Cipher.prototype._flush;
 Decipheriv.prototype.update = Cipher.prototype.update;
 Decipheriv.prototype.final = Cipher.prototype.final;
+Decipheriv.prototype.updateInto = Cipher.prototype.updateInto;
+Decipheriv.prototype.finalInto = Cipher.prototype.finalInto;
 Decipheriv.prototype.finaltol = Cipher.prototype.final;
 Decipheriv.prototype.setAutoPadding = Cipher.prototype.setAutoPadding;
 Decipheriv.prototype.getAuthTag = Cipheriv.prototype.getAuthTag;
@@ -320,22 +429,73 @@ Sign.prototype._write = function(chunk, encoding, callback) {
 
 Sign.prototype.update = Hash.prototype.update;
 
-Sign.prototype.sign = function(options, encoding) {
+Sign.prototype.sign = function(options, encoding, callback) {
   if (!options)
     throw new Error('No key provided to sign');
 
+  if (util.isFunction(encoding)) {
+    callback = encoding;
+    encoding = undefined;
+  }
+
   var key = options.key || options;
   var passphrase = options.passphrase || null;
+  encoding = encoding || exports.DEFAULT_ENCODING;
+
+  if (util.isFunction(callback)) {
+    this._handle.sign(toBuf(key), null, passphrase, function(err, sigs) {
+      if (err)
+        return callback(err);
+      callback(null, encodeOutput(sigs[0], encoding));
+    });
+    return;
+  }
+
   var ret = this._handle.sign(toBuf(key), null, passphrase);
+  return encodeOutput(ret, encoding);
+};
 
+
+exports.signBatch = function(algorithm, options, payloads, encoding,
+                             callback) {
+  if (!options)
+    throw new Error('No key provided to sign');
+  if (!util.isArray(payloads))
+    throw new TypeError('payloads must be an array');
+
+  if (util.isFunction(encoding)) {
+    callback = encoding;
+    encoding = undefined;
+  }
+  if (!util.isFunction(callback))
+    throw new TypeError('callback must be a function');
+
+  var key = options.key || options;
+  var passphrase = options.passphrase || null;
   encoding = encoding || exports.DEFAULT_ENCODING;
-  if (encoding && encoding !== 'buffer')
-    ret = ret.toString(encoding);
 
-  return ret;
+  payloads = payloads.map(function(payload) {
+    return toBuf(payload);
+  });
+
+  binding.signBatch(algorithm, toBuf(key), passphrase, payloads,
+                    function(err, sigs) {
+                      if (err)
+                        return callback(err);
+                      callback(null, sigs.map(function(sig) {
+                        return encodeOutput(sig, encoding);
+                      }));
+                    });
 };
 
 
+function encodeOutput(buf, encoding) {
+  if (encoding && encoding !== 'buffer')
+    return buf.toString(encoding);
+  return buf;
+}
+
+
 
 exports.createVerify = exports.Verify = Verify;
 function Verify(algorithm, options) {
@@ -353,8 +513,18 @@ util.inherits(Verify, stream.Writable);
 Verify.prototype._write = Sign.prototype._write;
 Verify.prototype.update = Sign.prototype.update;
 
-Verify.prototype.verify = function(object, signature, sigEncoding) {
+Verify.prototype.verify = function(object, signature, sigEncoding,
+                                   callback) {
+  if (util.isFunction(sigEncoding)) {
+    callback = sigEncoding;
+    sigEncoding = undefined;
+  }
   sigEncoding = sigEncoding || exports.DEFAULT_ENCODING;
+  if (util.isFunction(callback)) {
+    this._handle.verify(toBuf(object), toBuf(signature, sigEncoding), null,
+                        callback);
+    return;
+  }
   return this._handle.verify(toBuf(object), toBuf(signature, sigEncoding));
 };
 
@@ -446,13 +616,26 @@ DiffieHellmanGroup.prototype.computeSecret =
     DiffieHellman.prototype.computeSecret =
     dhComputeSecret;
 
-function dhComputeSecret(key, inEnc, outEnc) {
+function dhComputeSecret(key, inEnc, outEnc, callback) {
+  if (util.isFunction(inEnc)) {
+    callback = inEnc;
+    inEnc = undefined;
+  } else if (util.isFunction(outEnc)) {
+    callback = outEnc;
+    outEnc = undefined;
+  }
   inEnc = inEnc || exports.DEFAULT_ENCODING;
   outEnc = outEnc || exports.DEFAULT_ENCODING;
+  if (util.isFunction(callback)) {
+    this._handle.computeSecret(toBuf(key, inEnc), function(err, secret) {
+      if (err)
+        return callback(err);
+      callback(null, encodeOutput(secret, outEnc));
+    });
+    return;
+  }
   var ret = this._handle.computeSecret(toBuf(key, inEnc));
-  if (outEnc && outEnc !== 'buffer')
-    ret = ret.toString(outEnc);
-  return ret;
+  return encodeOutput(ret, outEnc);
 }
 
 
@@ -664,6 +847,8 @@ exports.pseudoRandomBytes = pseudoRandomBytes;
 exports.rng = randomBytes;
 exports.prng = pseudoRandomBytes;
 
+exports.getRandomPoolStats = binding.getRandomPoolStats;
+
 
 exports.getCiphers = function() {
   return filterDuplicates(getCiphers.call(null, arguments));
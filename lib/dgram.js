@@ -34,6 +34,11 @@ var BIND_STATE_UNBOUND = 0;
 var BIND_STATE_BINDING = 1;
 var BIND_STATE_BOUND = 2;
 
+// Room that batched receives make for every datagram unless told otherwise.
+// Fits what an Ethernet frame carries; each of up to 64 slots is allocated on
+// every wakeup, so the maximum of 64 KB would add up to megabytes.
+var DEFAULT_MAX_DATAGRAM_SIZE = 2048;
+
 // lazily loaded
 var cluster = null;
 var dns = null;
@@ -70,6 +75,7 @@ function newHandle(type) {
     handle.lookup = lookup6;
     handle.bind = handle.bind6;
     handle.send = handle.send6;
+    handle.sendBatch = handle.sendBatch6;
     return handle;
   }
 
@@ -118,6 +124,14 @@ function Socket(type, listener) {
   // If true - UV_UDP_REUSEADDR flag will be set
   this._reuseAddr = options && options.reuseAddr;
 
+  this._maxDatagramSize = DEFAULT_MAX_DATAGRAM_SIZE;
+  if (options && !util.isUndefined(options.maxDatagramSize)) {
+    var size = options.maxDatagramSize;
+    if (!util.isNumber(size) || size < 1 || size > 65536)
+      throw new RangeError('maxDatagramSize should be > 0 and <= 65536');
+    this._maxDatagramSize = size;
+  }
+
   if (util.isFunction(listener))
     this.on('message', listener);
 }
@@ -147,6 +161,7 @@ function replaceHandle(self, newHandle) {
   newHandle.lookup = self._handle.lookup;
   newHandle.bind = self._handle.bind;
   newHandle.send = self._handle.send;
+  newHandle.sendBatch = self._handle.sendBatch;
   newHandle.owner = self;
 
   // Replace the existing handle by the handle we got from master.
@@ -351,6 +366,112 @@ function afterSend(err) {
 }
 
 
+// Sends every buffer in `buffers` as a datagram of its own. `targets` is
+// either a single { port, address } object that applies to all of them or an
+// array with one such object per buffer.
+Socket.prototype.sendBatch = function(buffers, targets, callback) {
+  var self = this;
+
+  if (!util.isArray(buffers))
+    throw new TypeError('First argument must be an array of buffers.');
+  buffers = buffers.slice();
+
+  if (!util.isArray(targets))
+    targets = buffers.map(function() { return targets; });
+
+  if (targets.length !== buffers.length)
+    throw new RangeError('Expected one target per buffer');
+
+  var ports = new Array(buffers.length);
+  for (var i = 0; i < buffers.length; i++) {
+    if (util.isString(buffers[i]))
+      buffers[i] = new Buffer(buffers[i]);
+    if (!util.isBuffer(buffers[i]))
+      throw new TypeError('Batch entries must be buffers or strings.');
+    if (!util.isObject(targets[i]))
+      throw new TypeError('Targets must be { port, address } objects.');
+    ports[i] = targets[i].port | 0;
+    if (ports[i] <= 0 || ports[i] > 65535)
+      throw new RangeError('Port should be > 0 and < 65536');
+  }
+
+  if (!util.isFunction(callback))
+    callback = undefined;
+
+  self._healthCheck();
+
+  if (buffers.length === 0) {
+    if (callback)
+      process.nextTick(function() { callback(null, 0); });
+    return;
+  }
+
+  if (self._bindState == BIND_STATE_UNBOUND)
+    self.bind({port: 0, exclusive: true}, null);
+
+  if (self._bindState != BIND_STATE_BOUND) {
+    self.once('listening', function() {
+      self.sendBatch(buffers, targets, callback);
+    });
+    return;
+  }
+
+  // Resolve every distinct host name once, then hand the whole batch over.
+  var ips = {};
+  var hosts = [];
+  for (var i = 0; i < targets.length; i++) {
+    var address = targets[i].address;
+    if (!ips.hasOwnProperty(address)) {
+      ips[address] = null;
+      hosts.push(address);
+    }
+  }
+
+  var pending = hosts.length;
+  var failed = false;
+  hosts.forEach(function(host) {
+    self._handle.lookup(host, function(ex, ip) {
+      if (failed)
+        return;
+      if (ex) {
+        failed = true;
+        if (callback) callback(ex, 0);
+        self.emit('error', ex);
+        return;
+      }
+      ips[host] = ip;
+      if (--pending === 0 && self._handle)
+        sendBatchResolved(self, buffers, ports, targets, ips, callback);
+    });
+  });
+};
+
+
+function sendBatchResolved(self, buffers, ports, targets, ips, callback) {
+  var addresses = targets.map(function(target) {
+    return ips[target.address];
+  });
+
+  var req = new SendWrap();
+  req.buffers = buffers;  // Keep references alive.
+  if (callback) {
+    req.callback = callback;
+    req.oncomplete = afterSendBatch;
+  }
+  var err = self._handle.sendBatch(req, buffers, ports, addresses, !!callback);
+  if (err && callback) {
+    process.nextTick(function() {
+      callback(errnoException(err, 'sendBatch'), 0);
+    });
+  }
+}
+
+
+function afterSendBatch(err, sent) {
+  this.callback(err ? errnoException(err, 'sendBatch') : null, sent);
+}
+
+
 Socket.prototype.close = function() {
   this._healthCheck();
   this._stopReceiving();
@@ -395,6 +516,23 @@ Socket.prototype.setTTL = function(arg) {
 };
 
 
+Socket.prototype.setRecvBatchSize = function(count, size) {
+  if (!util.isNumber(count)) {
+    throw new TypeError('Argument must be a number');
+  }
+
+  if (util.isUndefined(size))
+    size = this._maxDatagramSize;
+
+  var err = this._handle.setRecvBatch(count >>> 0, size >>> 0);
+  if (err) {
+    throw errnoException(err, 'setRecvBatchSize');
+  }
+
+  return count;
+};
+
+
 Socket.prototype.setMulticastTTL = function(arg) {
   if (!util.isNumber(arg)) {
     throw new TypeError('Argument must be a number');
@@ -470,11 +608,28 @@ function onMessage(nread, handle, buf, rinfo) {
   if (nread < 0) {
     return self.emit('error', errnoException(nread, 'recvmsg'));
   }
+  if (util.isArray(rinfo)) {
+    return onMessageBatch(self, buf, rinfo);
+  }
   rinfo.size = buf.length; // compatibility
   self.emit('message', buf, rinfo);
 }
 
 
+// Batched receives deliver all datagrams in one buffer together with a flat
+// list of (offset, length, rinfo, truncated) records.
+function onMessageBatch(self, buf, records) {
+  for (var i = 0; i < records.length && self._handle; i += 4) {
+    var offset = records[i];
+    var msg = buf.slice(offset, offset + records[i + 1]);
+    var rinfo = records[i + 2];
+    rinfo.size = msg.length; // compatibility
+    rinfo.truncated = records[i + 3];
+    self.emit('message', msg, rinfo);
+  }
+}
+
+
 Socket.prototype.ref = function() {
   if (this._handle)
     this._handle.ref();
@@ -37,6 +37,7 @@ var WriteWrap = process.binding('stream_wrap').WriteWrap;
 
 
 var Buffer = require('buffer').Buffer;
+var emptyBuffer = new Buffer(0);
 var cluster;
 var errnoException = util._errnoException;
 
@@ -180,6 +181,7 @@ function Socket(options) {
 
   this._pendingData = null;
   this._pendingEncoding = '';
+  this._gzipping = false;
 
   // handle strings directly
   this._writableState.decodeStrings = false;
@@ -358,6 +360,15 @@ Socket.prototype.setNoDelay = function(enable) {
 };
 
 
+// Batches the writes made during a tick into as few system calls as possible.
+// The handle flushes on its own once the tick is over.
+Socket.prototype.setAutoCork = function(enable) {
+  this._autoCork = util.isUndefined(enable) ? true : !!enable;
+  if (!this._autoCork && this._handle && this._handle.uncork)
+    this._handle.uncork();
+};
+
+
 Socket.prototype.setKeepAlive = function(setting, msecs) {
   if (this._handle && this._handle.setKeepAlive)
     this._handle.setKeepAlive(setting, ~~(msecs / 1000));
@@ -482,6 +493,9 @@ Socket.prototype._destroy = function(exception, cb) {
     if (this !== process.stderr)
       debug('close handle');
     var isException = exception ? true : false;
+    // Send out what autocork held back, it would go away with the handle.
+    if (this._handle.uncork)
+      this._handle.uncork();
     this._handle.close(function() {
       debug('emit close');
       self.emit('close', isException);
@@ -659,6 +673,15 @@ Socket.prototype._writeGeneric = function(writev, data, encoding, cb) {
     return false;
   }
 
+  if (!writev && util.isBuffer(data) && data._sendFile)
+    return this._writeFile(data._sendFile, cb);
+
+  if (!writev && util.isBuffer(data) && !util.isUndefined(data._gzip))
+    return this._writeGzip(data._gzip, cb);
+
+  if (this._autoCork && this._handle.cork)
+    this._handle.cork();
+
   var req = new WriteWrap();
   req.oncomplete = afterWrite;
   req.async = false;
@@ -703,14 +726,155 @@ Socket.prototype._writeGeneric = function(writev, data, encoding, cb) {
 
 
 Socket.prototype._writev = function(chunks, cb) {
+  for (var i = 0; i < chunks.length; i++) {
+    var chunk = chunks[i].chunk;
+    if (util.isBuffer(chunk) &&
+        (chunk._sendFile || !util.isUndefined(chunk._gzip))) {
+      return writeInOrder(this, chunks, cb);
+    }
+  }
   this._writeGeneric(true, chunks, '', cb);
 };
 
 
+// A file or a compression switch can't be part of a writev, so a batch that
+// contains one is written out one chunk after the other instead.
+function writeInOrder(self, chunks, cb) {
+  var i = 0;
+  (function next(err) {
+    if (err || i === chunks.length)
+      return cb(err);
+    var entry = chunks[i++];
+    self._writeGeneric(false, entry.chunk, entry.encoding, next);
+  })();
+}
+
+
 Socket.prototype._write = function(data, encoding, cb) {
   this._writeGeneric(false, data, encoding, cb);
 };
 
+// Writes `length` bytes of the file `fd`, starting at `offset`. The file is
+// queued like any other chunk so it stays in order with regular writes.
+Socket.prototype.sendFile = function(fd, offset, length, cb) {
+  if (!util.isNumber(fd) || fd < 0 || fd !== (fd | 0))
+    throw new TypeError('fd must be a file descriptor');
+  if (!util.isNumber(offset) || offset < 0 || !isFinite(offset))
+    throw new TypeError('offset must be a non-negative number');
+  if (!util.isNumber(length) || length < 0 || !isFinite(length))
+    throw new TypeError('length must be a non-negative number');
+
+  var chunk = new Buffer(0);
+  chunk._sendFile = { fd: fd, offset: offset, length: length };
+  return this.write(chunk, cb);
+};
+
+
+Socket.prototype._writeFile = function(file, cb) {
+  var req = new WriteWrap();
+  req.oncomplete = afterWrite;
+  req.cb = cb;
+
+  var err = uv.UV_ENOTSUP;
+  // sendfile() would bypass the compressor.
+  if (this._handle.sendFile && !this._gzipping)
+    err = this._handle.sendFile(req, file.fd, file.offset, file.length);
+
+  if (err === uv.UV_ENOTSUP || err === uv.UV_ENOSYS)
+    return copyFile(this, file, cb);
+
+  if (err)
+    return this._destroy(errnoException(err, 'sendFile'), cb);
+
+  this._bytesDispatched += req.bytes;
+};
+
+
+// Whether _writeGzip() works here: it needs a plain TCP or pipe handle, the
+// compressor sits right under it.
+Socket.prototype._canGzip = function() {
+  var TCP = process.binding('tcp_wrap').TCP;
+  var handle = this._handle;
+  return !!handle && (handle instanceof TCP || handle instanceof Pipe);
+};
+
+
+// Switches native gzip compression of the writes that follow on (|options|
+// from zlib._gzipStreamOptions()) or off (null), in order with the writes
+// around it. Switching it off ends the gzip member with one last write.
+Socket.prototype._writeGzip = function(options, cb) {
+  var handle = this._handle;
+  if (!this._canGzip())
+    return this._destroy(new Error('gzip is not supported on this socket'), cb);
+
+  // Whatever is corked was written before the switch.
+  if (handle.uncork)
+    handle.uncork();
+
+  if (!handle._gzip) {
+    var GzipStream = process.binding('zlib').GzipStream;
+    handle._gzip = new GzipStream(handle);
+  }
+
+  var err;
+  if (options) {
+    err = handle._gzip.start(options.level,
+                             options.memLevel,
+                             options.strategy,
+                             options.flushSize,
+                             options.chunked);
+    if (err)
+      return this._destroy(errnoException(err, 'gzip'), cb);
+    this._gzipping = true;
+    return cb();
+  }
+
+  err = handle._gzip.finish();
+  if (err)
+    return this._destroy(errnoException(err, 'gzip'), cb);
+  this._gzipping = false;
+
+  // Not corked, the trailer must not pick up what's written after it.
+  var req = new WriteWrap();
+  req.oncomplete = afterWrite;
+  req.async = false;
+  req.buffer = emptyBuffer;
+  err = handle.writeBuffer(req, emptyBuffer);
+  if (err)
+    return this._destroy(errnoException(err, 'write', req.error), cb);
+
+  this._bytesDispatched += req.bytes;
+
+  if (req.async && handle.writeQueueSize != 0)
+    req.cb = cb;
+  else
+    cb();
+};
+
+// Fallback for handles that can't sendfile(), e.g. pipes or TLS sockets:
+// read the file in chunks and write them out the regular way.
+function copyFile(self, file, cb) {
+  var fs = require('fs');
+  var offset = file.offset;
+  var remaining = file.length;
+
+  (function next(err) {
+    if (err || remaining === 0)
+      return cb(err);
+    var buffer = new Buffer(Math.min(remaining, 64 * 1024));
+    fs.read(file.fd, buffer, 0, buffer.length, offset, function(err, nread) {
+      if (!err && nread === 0)
+        err = errnoException(uv.UV_EOF, 'sendFile');
+      if (err)
+        return self._destroy(err, cb);
+      offset += nread;
+      remaining -= nread;
+      self._writeGeneric(false, buffer.slice(0, nread), 'buffer', next);
+    });
+  })();
+}
+
+
 function createWriteReq(req, handle, data, encoding) {
   switch (encoding) {
     case 'binary':
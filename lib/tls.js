@@ -43,6 +43,8 @@ exports.DEFAULT_ECDH_CURVE = 'prime256v1';
 
 exports.getLegacyCiphers = _crypto.getLegacyCiphers;
 
+exports.getBufferPoolStats = _crypto.getBufferPoolStats;
+
 exports.getCiphers = function() {
   var names = _crypto.getSSLCiphers();
   // Drop all-caps names in favor of their lowercase aliases,
@@ -249,4 +251,5 @@ exports.TLSSocket = require('_tls_wrap').TLSSocket;
 exports.Server = require('_tls_wrap').Server;
 exports.createServer = require('_tls_wrap').createServer;
 exports.connect = require('_tls_wrap').connect;
+exports.getAsyncHandshakeStats = require('_tls_wrap').getAsyncHandshakeStats;
 exports.createSecurePair = require('_tls_legacy').createSecurePair;
@@ -82,6 +82,7 @@ exports.Gunzip = Gunzip;
 exports.DeflateRaw = DeflateRaw;
 exports.InflateRaw = InflateRaw;
 exports.Unzip = Unzip;
+exports.ParallelGzip = ParallelGzip;
 
 exports.createDeflate = function(o) {
   return new Deflate(o);
@@ -111,6 +112,55 @@ exports.createUnzip = function(o) {
   return new Unzip(o);
 };
 
+exports.createParallelGzip = function(o) {
+  return new ParallelGzip(o);
+};
+
+
+// Registers a dictionary that can be passed by id rather than as a Buffer,
+// deflate streams that use it are copied from pre-primed ones.
+exports.registerDictionary = function(dictionary) {
+  if (!util.isBuffer(dictionary))
+    throw new TypeError('Dictionary must be a Buffer');
+  return binding.registerDictionary(dictionary);
+};
+
+// Initialized zlib streams are pooled and reused by every Zlib instance and
+// convenience method in the process.
+exports.getStreamPoolStats = binding.getStreamPoolStats;
+
+exports.setStreamPoolSize = function(size) {
+  if (!util.isNumber(size) || size < 0 || size % 1 !== 0 ||
+      size > 0xffffffff) {
+    throw new TypeError('Pool size must be a non-negative integer');
+  }
+  binding.setStreamPoolSize(size);
+};
+
+
+// Options of http.ServerResponse#gzip(), with the defaults filled in.
+exports._gzipStreamOptions = function(opts) {
+  opts = opts || {};
+  validateOptions(opts);
+
+  var flushSize = 16 * 1024;
+  if (!util.isUndefined(opts.flushSize)) {
+    if (!util.isNumber(opts.flushSize) || !(opts.flushSize >= 0))
+      throw new Error('Invalid flushSize: ' + opts.flushSize);
+    flushSize = Math.min(opts.flushSize, 0xffffffff);
+  }
+
+  return {
+    level: util.isNumber(opts.level) ? opts.level :
+                                       exports.Z_DEFAULT_COMPRESSION,
+    memLevel: opts.memLevel || exports.Z_DEFAULT_MEMLEVEL,
+    strategy: util.isNumber(opts.strategy) ? opts.strategy :
+                                             exports.Z_DEFAULT_STRATEGY,
+    flushSize: flushSize,
+    chunked: false
+  };
+};
+
 
 // Convenience methods.
 // compress/decompress a string or buffer in one step.
@@ -119,11 +169,11 @@ exports.deflate = function(buffer, opts, callback) {
     callback = opts;
     opts = {};
   }
-  return zlibBuffer(new Deflate(opts), buffer, callback);
+  return zlibBuffer(binding.DEFLATE, buffer, opts, callback);
 };
 
 exports.deflateSync = function(buffer, opts) {
-  return zlibBufferSync(new Deflate(opts), buffer);
+  return zlibBufferSync(binding.DEFLATE, buffer, opts);
 };
 
 exports.gzip = function(buffer, opts, callback) {
@@ -131,11 +181,11 @@ exports.gzip = function(buffer, opts, callback) {
     callback = opts;
     opts = {};
   }
-  return zlibBuffer(new Gzip(opts), buffer, callback);
+  return zlibBuffer(binding.GZIP, buffer, opts, callback);
 };
 
 exports.gzipSync = function(buffer, opts) {
-  return zlibBufferSync(new Gzip(opts), buffer);
+  return zlibBufferSync(binding.GZIP, buffer, opts);
 };
 
 exports.deflateRaw = function(buffer, opts, callback) {
@@ -143,11 +193,11 @@ exports.deflateRaw = function(buffer, opts, callback) {
     callback = opts;
     opts = {};
   }
-  return zlibBuffer(new DeflateRaw(opts), buffer, callback);
+  return zlibBuffer(binding.DEFLATERAW, buffer, opts, callback);
 };
 
 exports.deflateRawSync = function(buffer, opts) {
-  return zlibBufferSync(new DeflateRaw(opts), buffer);
+  return zlibBufferSync(binding.DEFLATERAW, buffer, opts);
 };
 
 exports.unzip = function(buffer, opts, callback) {
@@ -155,11 +205,11 @@ exports.unzip = function(buffer, opts, callback) {
     callback = opts;
     opts = {};
   }
-  return zlibBuffer(new Unzip(opts), buffer, callback);
+  return zlibBuffer(binding.UNZIP, buffer, opts, callback);
 };
 
 exports.unzipSync = function(buffer, opts) {
-  return zlibBufferSync(new Unzip(opts), buffer);
+  return zlibBufferSync(binding.UNZIP, buffer, opts);
 };
 
 exports.inflate = function(buffer, opts, callback) {
@@ -167,11 +217,11 @@ exports.inflate = function(buffer, opts, callback) {
     callback = opts;
     opts = {};
   }
-  return zlibBuffer(new Inflate(opts), buffer, callback);
+  return zlibBuffer(binding.INFLATE, buffer, opts, callback);
 };
 
 exports.inflateSync = function(buffer, opts) {
-  return zlibBufferSync(new Inflate(opts), buffer);
+  return zlibBufferSync(binding.INFLATE, buffer, opts);
 };
 
 exports.gunzip = function(buffer, opts, callback) {
@@ -179,11 +229,11 @@ exports.gunzip = function(buffer, opts, callback) {
     callback = opts;
     opts = {};
   }
-  return zlibBuffer(new Gunzip(opts), buffer, callback);
+  return zlibBuffer(binding.GUNZIP, buffer, opts, callback);
 };
 
 exports.gunzipSync = function(buffer, opts) {
-  return zlibBufferSync(new Gunzip(opts), buffer);
+  return zlibBufferSync(binding.GUNZIP, buffer, opts);
 };
 
 exports.inflateRaw = function(buffer, opts, callback) {
@@ -191,55 +241,74 @@ exports.inflateRaw = function(buffer, opts, callback) {
     callback = opts;
     opts = {};
   }
-  return zlibBuffer(new InflateRaw(opts), buffer, callback);
+  return zlibBuffer(binding.INFLATERAW, buffer, opts, callback);
 };
 
 exports.inflateRawSync = function(buffer, opts) {
-  return zlibBufferSync(new InflateRaw(opts), buffer);
+  return zlibBufferSync(binding.INFLATERAW, buffer, opts);
 };
 
-function zlibBuffer(engine, buffer, callback) {
-  var buffers = [];
-  var nread = 0;
-
-  engine.on('error', onError);
-  engine.on('end', onEnd);
+// The convenience methods run the whole buffer through zlib in one go on
+// the native side, rather than a chunk at a time through a Zlib stream.
+function zlibBuffer(mode, buffer, opts, callback) {
+  opts = opts || {};
+  validateOptions(opts);
 
-  engine.end(buffer);
-  flow();
-
-  function flow() {
-    var chunk;
-    while (null !== (chunk = engine.read())) {
-      buffers.push(chunk);
-      nread += chunk.length;
-    }
-    engine.once('readable', flow);
+  if (util.isString(buffer))
+    buffer = new Buffer(buffer);
+  if (!util.isBuffer(buffer)) {
+    process.nextTick(function() {
+      callback(new TypeError('Not a string or buffer'));
+    });
+    return;
   }
 
-  function onError(err) {
-    engine.removeListener('end', onEnd);
-    engine.removeListener('readable', flow);
-    callback(err);
-  }
+  processBuffer(mode, buffer, opts, ondone);
 
-  function onEnd() {
-    var buf = Buffer.concat(buffers, nread);
-    buffers = [];
-    callback(null, buf);
-    engine.close();
+  function ondone(message, errno, result) {
+    if (message !== null)
+      return callback(zlibError(message, errno));
+    callback(null, result);
   }
 }
 
-function zlibBufferSync(engine, buffer) {
+function zlibBufferSync(mode, buffer, opts) {
+  opts = opts || {};
+  validateOptions(opts);
+
   if (util.isString(buffer))
     buffer = new Buffer(buffer);
   if (!util.isBuffer(buffer))
     throw new TypeError('Not a string or buffer');
 
-  var flushFlag = binding.Z_FINISH;
+  var result = processBuffer(mode, buffer, opts);
+  if (!util.isBuffer(result))
+    throw zlibError(result[0], result[1]);
+  return result;
+}
+
+function processBuffer(mode, buffer, opts, ondone) {
+  var level = exports.Z_DEFAULT_COMPRESSION;
+  if (util.isNumber(opts.level)) level = opts.level;
+
+  var strategy = exports.Z_DEFAULT_STRATEGY;
+  if (util.isNumber(opts.strategy)) strategy = opts.strategy;
 
-  return engine._processChunk(buffer, flushFlag);
+  return binding.zlibBuffer(mode,
+                            buffer,
+                            opts.windowBits || exports.Z_DEFAULT_WINDOWBITS,
+                            level,
+                            opts.memLevel || exports.Z_DEFAULT_MEMLEVEL,
+                            strategy,
+                            opts.dictionary,
+                            ondone);
+}
+
+function zlibError(message, errno) {
+  var error = new Error(message);
+  error.errno = errno;
+  error.code = exports.codes[errno];
+  return error;
 }
 
 // generic zlib
@@ -288,17 +357,179 @@ function Unzip(opts) {
 }
 
 
-// the Zlib class they all inherit from
-// This thing manages the queue of requests, and returns
-// true or false if there is anything in the queue when
-// you call the .write() method.
+// parallel gzip - a single gzip member like Gzip produces, but compressed in
+// independent blocks on several threads at once, the way pigz does it.
+// Every block is primed with the input that came before it, so the output
+// is only marginally bigger.
+var kParallelBlockSize = 128 * 1024;
+var kParallelDictionarySize = 32 * 1024;
+
+function ParallelGzip(opts) {
+  if (!(this instanceof ParallelGzip)) return new ParallelGzip(opts);
 
-function Zlib(opts, mode) {
   this._opts = opts = opts || {};
-  this._chunkSize = opts.chunkSize || exports.Z_DEFAULT_CHUNK;
 
   Transform.call(this, opts);
 
+  validateOptions(opts);
+
+  if (opts.blockSize) {
+    if (opts.blockSize < exports.Z_MIN_CHUNK ||
+        opts.blockSize > exports.Z_MAX_CHUNK) {
+      throw new Error('Invalid block size: ' + opts.blockSize);
+    }
+  }
+
+  if (opts.concurrency) {
+    if (opts.concurrency < 1 || opts.concurrency % 1 !== 0) {
+      throw new Error('Invalid concurrency: ' + opts.concurrency);
+    }
+  }
+
+  this._blockSize = opts.blockSize || kParallelBlockSize;
+  this._concurrency = opts.concurrency || 4;
+
+  this._level = exports.Z_DEFAULT_COMPRESSION;
+  if (util.isNumber(opts.level)) this._level = opts.level;
+
+  this._strategy = exports.Z_DEFAULT_STRATEGY;
+  if (util.isNumber(opts.strategy)) this._strategy = opts.strategy;
+
+  this._memLevel = opts.memLevel || exports.Z_DEFAULT_MEMLEVEL;
+
+  // input that doesn't make a whole block yet
+  this._chunks = [];
+  this._chunksLength = 0;
+  // the end of the last block queued, it primes the next one
+  this._dictionary = null;
+  // blocks being compressed, in output order
+  this._blocks = [];
+  this._crc = 0;
+  this._inputLength = 0;
+  // the transform or flush callback, held back while all threads are busy
+  this._waiting = null;
+  this._ending = false;
+  this._lastQueued = false;
+  this._hadError = false;
+
+  this.push(gzipHeader(this._level, this._strategy));
+}
+
+util.inherits(ParallelGzip, Transform);
+
+ParallelGzip.prototype._transform = function(chunk, encoding, callback) {
+  this._chunks.push(chunk);
+  this._chunksLength += chunk.length;
+  this._waiting = callback;
+  this._compress();
+};
+
+ParallelGzip.prototype._flush = function(callback) {
+  this._ending = true;
+  this._waiting = callback;
+  this._compress();
+};
+
+// Queues as many blocks as there are free threads for, then lets the
+// waiting callback go if there's nothing it has to wait for anymore.
+ParallelGzip.prototype._compress = function() {
+  if (this._hadError)
+    return;
+
+  while (this._blocks.length < this._concurrency) {
+    if (this._chunksLength >= this._blockSize) {
+      this._queue(this._takeInput(this._blockSize), false);
+    } else if (this._ending && !this._lastQueued) {
+      this._lastQueued = true;
+      this._queue(this._takeInput(this._chunksLength), true);
+    } else {
+      break;
+    }
+  }
+
+  var callback = this._waiting;
+  if (!callback)
+    return;
+
+  if (this._ending) {
+    if (this._blocks.length > 0)
+      return;
+    var trailer = new Buffer(8);
+    trailer.writeUInt32LE(this._crc, 0);
+    trailer.writeUInt32LE(this._inputLength, 4);
+    this.push(trailer);
+  } else if (this._chunksLength >= this._blockSize) {
+    return;
+  }
+
+  this._waiting = null;
+  callback();
+};
+
+ParallelGzip.prototype._takeInput = function(size) {
+  var input = Buffer.concat(this._chunks, this._chunksLength);
+  var rest = input.slice(size);
+  this._chunks = rest.length > 0 ? [rest] : [];
+  this._chunksLength = rest.length;
+  return input.slice(0, size);
+};
+
+ParallelGzip.prototype._queue = function(input, last) {
+  var self = this;
+  var block = { output: null, crc: 0, length: input.length, done: false };
+  this._blocks.push(block);
+
+  binding.gzipBlock(input,
+                    this._dictionary,
+                    this._level,
+                    this._memLevel,
+                    this._strategy,
+                    last,
+                    ondone);
+
+  var start = Math.max(0, input.length - kParallelDictionarySize);
+  this._dictionary = input.slice(start);
+
+  function ondone(message, errno, output, crc) {
+    if (self._hadError)
+      return;
+    if (message !== null) {
+      self._hadError = true;
+      self.emit('error', zlibError(message, errno));
+      return;
+    }
+    block.output = output;
+    block.crc = crc;
+    block.done = true;
+    self._emitBlocks();
+  }
+};
+
+// Blocks can finish in any order, they're pushed in the order they were
+// queued in.
+ParallelGzip.prototype._emitBlocks = function() {
+  while (this._blocks.length > 0 && this._blocks[0].done) {
+    var block = this._blocks.shift();
+    this._crc = binding.crc32Combine(this._crc, block.crc, block.length);
+    // gzip only keeps the length modulo 2^32.
+    this._inputLength = (this._inputLength + block.length) % 0x100000000;
+    this.push(block.output);
+  }
+  this._compress();
+};
+
+// The 10 byte header that zlib would write, without a file name or time.
+function gzipHeader(level, strategy) {
+  var flags = 0;
+  if (level === 9)
+    flags = 2;
+  else if (strategy >= exports.Z_HUFFMAN_ONLY || (level >= 0 && level < 2))
+    flags = 4;
+  return new Buffer([0x1f, 0x8b, 8, 0, 0, 0, 0, 0, flags, 3]);
+}
+
+// Throws on options that the binding would choke on.
+function validateOptions(opts) {
   if (opts.flush) {
     if (opts.flush !== binding.Z_NO_FLUSH &&
         opts.flush !== binding.Z_PARTIAL_FLUSH &&
@@ -309,7 +540,6 @@ function Zlib(opts, mode) {
       throw new Error('Invalid flush flag: ' + opts.flush);
     }
   }
-  this._flushFlag = opts.flush || binding.Z_NO_FLUSH;
 
   if (opts.chunkSize) {
     if (opts.chunkSize < exports.Z_MIN_CHUNK ||
@@ -350,10 +580,27 @@ function Zlib(opts, mode) {
   }
 
   if (opts.dictionary) {
-    if (!util.isBuffer(opts.dictionary)) {
-      throw new Error('Invalid dictionary: it should be a Buffer instance');
+    if (!util.isBuffer(opts.dictionary) &&
+        !binding.hasDictionary(opts.dictionary)) {
+      throw new Error('Invalid dictionary: it should be a Buffer instance ' +
+                      'or the id of a registered dictionary');
     }
   }
+}
+
+// the Zlib class they all inherit from
+// This thing manages the queue of requests, and returns
+// true or false if there is anything in the queue when
+// you call the .write() method.
+
+function Zlib(opts, mode) {
+  this._opts = opts = opts || {};
+  this._chunkSize = opts.chunkSize || exports.Z_DEFAULT_CHUNK;
+
+  Transform.call(this, opts);
+
+  validateOptions(opts);
+  this._flushFlag = opts.flush || binding.Z_NO_FLUSH;
 
   this._handle = new binding.Zlib(mode);
 
@@ -365,10 +612,7 @@ function Zlib(opts, mode) {
     self._handle = null;
     self._hadError = true;
 
-    var error = new Error(message);
-    error.errno = errno;
-    error.code = exports.codes[errno];
-    self.emit('error', error);
+    self.emit('error', zlibError(message, errno));
   };
 
   var level = exports.Z_DEFAULT_COMPRESSION;
@@ -108,6 +108,7 @@
         'src/node_i18n.cc',
         'src/pipe_wrap.cc',
         'src/signal_wrap.cc',
+        'src/slab_allocator.cc',
         'src/smalloc.cc',
         'src/spawn_sync.cc',
         'src/string_bytes.cc',
@@ -140,6 +141,7 @@
         'src/node_i18n.h',
         'src/pipe_wrap.h',
         'src/queue.h',
+        'src/slab_allocator.h',
         'src/smalloc.h',
         'src/tty_wrap.h',
         'src/tcp_wrap.h',
@@ -191,9 +193,13 @@
             'src/node_crypto.cc',
             'src/node_crypto_bio.cc',
             'src/node_crypto_clienthello.cc',
+            'src/node_crypto_session_cache.cc',
+            'src/node_crypto_ticket_keys.cc',
             'src/node_crypto.h',
             'src/node_crypto_bio.h',
             'src/node_crypto_clienthello.h',
+            'src/node_crypto_session_cache.h',
+            'src/node_crypto_ticket_keys.h',
             'src/tls_wrap.cc',
             'src/tls_wrap.h'
           ],
@@ -23,6 +23,7 @@
 #include "async-wrap-inl.h"
 #include "env.h"
 #include "env-inl.h"
+#include "stream_wrap.h"
 #include "util.h"
 #include "util-inl.h"
 
@@ -168,6 +169,7 @@ Handle<Value> AsyncWrap::MakeCallback(const Handle<Function> cb,
 
   if (tick_info->length() == 0) {
     tick_info->set_index(0);
+    StreamWrap::FlushCorked(env());
     return ret;
   }
 
@@ -176,6 +178,7 @@ Handle<Value> AsyncWrap::MakeCallback(const Handle<Function> cb,
   env()->tick_callback_function()->Call(process, 0, NULL);
 
   tick_info->set_in_tick(false);
+  StreamWrap::FlushCorked(env());
 
   if (try_catch.HasCaught()) {
     tick_info->set_last_threw(true);
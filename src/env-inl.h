@@ -184,6 +184,29 @@ inline void Environment::TickInfo::set_last_threw(bool value) {
   last_threw_ = value;
 }
 
+inline Environment::WritevStats::WritevStats() {
+  for (int i = 0; i < kFieldsCount; ++i)
+    fields_[i] = 0;
+}
+
+inline void Environment::WritevStats::Count(Fields field) {
+  fields_[field] += 1;
+}
+
+inline uint64_t Environment::WritevStats::Get(Fields field) const {
+  return fields_[field];
+}
+
+inline Environment::HandshakeStats::HandshakeStats()
+    : queued(0),
+      completed(0),
+      pending(0),
+      max_pending(0),
+      wait_time(0),
+      run_time(0),
+      max_latency(0) {
+}
+
 inline Environment* Environment::New(v8::Local<v8::Context> context,
                                      uv_loop_t* loop) {
   Environment* env = new Environment(context, loop);
@@ -213,6 +236,7 @@ inline Environment::Environment(v8::Local<v8::Context> context,
       using_asyncwrap_(false),
       printed_error_(false),
       debugger_agent_(this),
+      random_pool_(NULL),
       context_(context->GetIsolate(), context) {
   // We'll be creating new objects so make sure we've entered the context.
   v8::HandleScope handle_scope(isolate());
@@ -222,6 +246,8 @@ inline Environment::Environment(v8::Local<v8::Context> context,
   RB_INIT(&cares_task_list_);
   QUEUE_INIT(&gc_tracker_queue_);
   QUEUE_INIT(&req_wrap_queue_);
+  QUEUE_INIT(&corked_stream_queue_);
+  QUEUE_INIT(&cork_error_stream_queue_);
   QUEUE_INIT(&handle_wrap_queue_);
   QUEUE_INIT(&handle_cleanup_queue_);
   handle_cleanup_waiting_ = 0;
@@ -301,6 +327,27 @@ inline uv_check_t* Environment::idle_check_handle() {
   return &idle_check_handle_;
 }
 
+inline Environment* Environment::from_cork_prepare_handle(
+    uv_prepare_t* handle) {
+  return ContainerOf(&Environment::cork_prepare_handle_, handle);
+}
+
+inline uv_prepare_t* Environment::cork_prepare_handle() {
+  return &cork_prepare_handle_;
+}
+
+inline Environment* Environment::from_cork_check_handle(uv_check_t* handle) {
+  return ContainerOf(&Environment::cork_check_handle_, handle);
+}
+
+inline uv_check_t* Environment::cork_check_handle() {
+  return &cork_check_handle_;
+}
+
+inline uv_idle_t* Environment::cork_idle_handle() {
+  return &cork_idle_handle_;
+}
+
 inline void Environment::RegisterHandleCleanup(uv_handle_t* handle,
                                                HandleCleanupCb cb,
                                                void *arg) {
@@ -23,6 +23,7 @@
 #define SRC_ENV_H_
 
 #include "ares.h"
+#include "slab_allocator.h"
 #include "tree.h"
 #include "util.h"
 #include "uv.h"
@@ -62,11 +63,13 @@ namespace node {
 // for the sake of convenience.
 #define PER_ISOLATE_STRING_PROPERTIES(V)                                      \
   V(address_string, "address")                                                \
+  V(arena_string, "arena")                                                    \
   V(args_string, "args")                                                      \
   V(argv_string, "argv")                                                      \
   V(async, "async")                                                           \
   V(async_queue_string, "_asyncQueue")                                        \
   V(atime_string, "atime")                                                    \
+  V(available_string, "available")                                            \
   V(birthtime_string, "birthtime")                                            \
   V(blksize_string, "blksize")                                                \
   V(blocks_string, "blocks")                                                  \
@@ -75,9 +78,11 @@ namespace node {
   V(bytes_parsed_string, "bytesParsed")                                       \
   V(callback_string, "callback")                                              \
   V(change_string, "change")                                                  \
+  V(chunks_string, "chunks")                                                  \
   V(close_string, "close")                                                    \
   V(code_string, "code")                                                      \
   V(compare_string, "compare")                                                \
+  V(completed_string, "completed")                                            \
   V(ctime_string, "ctime")                                                    \
   V(cwd_string, "cwd")                                                        \
   V(debug_port_string, "debugPort")                                           \
@@ -90,11 +95,13 @@ namespace node {
   V(idle_string, "idle")                                                      \
   V(irq_string, "irq")                                                        \
   V(enter_string, "enter")                                                    \
+  V(entries_string, "entries")                                                \
   V(env_pairs_string, "envPairs")                                             \
   V(env_string, "env")                                                        \
   V(errno_string, "errno")                                                    \
   V(error_string, "error")                                                    \
   V(events_string, "_events")                                                 \
+  V(evictions_string, "evictions")                                            \
   V(exec_argv_string, "execArgv")                                             \
   V(exec_path_string, "execPath")                                             \
   V(exiting_string, "_exiting")                                               \
@@ -104,12 +111,14 @@ namespace node {
   V(exponent_string, "exponent")                                              \
   V(exports_string, "exports")                                                \
   V(ext_key_usage_string, "ext_key_usage")                                    \
+  V(fallbacks_string, "fallbacks")                                            \
   V(family_string, "family")                                                  \
   V(fatal_exception_string, "_fatalException")                                \
   V(fd_string, "fd")                                                          \
   V(file_string, "file")                                                      \
   V(fingerprint_string, "fingerprint")                                        \
   V(flags_string, "flags")                                                    \
+  V(flushes_string, "flushes")                                                \
   V(fsevent_string, "FSEvent")                                                \
   V(gid_string, "gid")                                                        \
   V(handle_string, "handle")                                                  \
@@ -117,9 +126,12 @@ namespace node {
   V(heap_size_limit_string, "heap_size_limit")                                \
   V(heap_total_string, "heapTotal")                                           \
   V(heap_used_string, "heapUsed")                                             \
+  V(heap_string, "heap")                                                      \
+  V(hits_string, "hits")                                                      \
   V(hostmaster_string, "hostmaster")                                          \
   V(ignore_string, "ignore")                                                  \
   V(immediate_callback_string, "_immediateCallback")                          \
+  V(immediate_string, "immediate")                                            \
   V(infoaccess_string, "infoAccess")                                          \
   V(inherit_string, "inherit")                                                \
   V(ino_string, "ino")                                                        \
@@ -128,15 +140,22 @@ namespace node {
   V(ipv4_string, "IPv4")                                                      \
   V(ipv6_lc_string, "ipv6")                                                   \
   V(ipv6_string, "IPv6")                                                      \
+  V(issued_string, "issued")                                                  \
   V(issuer_string, "issuer")                                                  \
   V(issuercert_string, "issuerCertificate")                                   \
+  V(keys_string, "keys")                                                      \
   V(kill_signal_string, "killSignal")                                         \
+  V(live_string, "live")                                                      \
   V(mac_string, "mac")                                                        \
   V(mark_sweep_compact_string, "mark-sweep-compact")                          \
   V(max_buffer_string, "maxBuffer")                                           \
+  V(max_header_pairs_string, "maxHeaderPairs")                                \
+  V(max_latency_string, "maxLatency")                                         \
+  V(max_pending_string, "maxPending")                                         \
   V(message_string, "message")                                                \
   V(method_string, "method")                                                  \
   V(minttl_string, "minttl")                                                  \
+  V(misses_string, "misses")                                                  \
   V(mode_string, "mode")                                                      \
   V(model_string, "model")                                                    \
   V(modulus_string, "modulus")                                                \
@@ -162,6 +181,7 @@ namespace node {
   V(onnewsession_string, "onnewsession")                                      \
   V(onnewsessiondone_string, "onnewsessiondone")                              \
   V(onocspresponse_string, "onocspresponse")                                  \
+  V(onprogress_string, "onprogress")                                          \
   V(onread_string, "onread")                                                  \
   V(onselect_string, "onselect")                                              \
   V(onsignal_string, "onsignal")                                              \
@@ -172,23 +192,32 @@ namespace node {
   V(parse_error_string, "Parse Error")                                        \
   V(path_string, "path")                                                      \
   V(pbkdf2_error_string, "PBKDF2 Error")                                      \
+  V(pending_string, "pending")                                                \
   V(pid_string, "pid")                                                        \
   V(pipe_string, "pipe")                                                      \
+  V(pooled_string, "pooled")                                                  \
   V(port_string, "port")                                                      \
   V(preference_string, "preference")                                          \
   V(priority_string, "priority")                                              \
   V(processed_string, "processed")                                            \
   V(prototype_string, "prototype")                                            \
+  V(queued_string, "queued")                                                  \
   V(raw_string, "raw")                                                        \
   V(rdev_string, "rdev")                                                      \
   V(readable_string, "readable")                                              \
   V(received_shutdown_string, "receivedShutdown")                             \
+  V(record_size_string, "recordSize")                                         \
+  V(records_string, "records")                                                \
+  V(refills_string, "refills")                                                \
   V(refresh_string, "refresh")                                                \
   V(regexp_string, "regexp")                                                  \
   V(rename_string, "rename")                                                  \
   V(replacement_string, "replacement")                                        \
+  V(retained_bytes_string, "retainedBytes")                                   \
+  V(retained_slabs_string, "retainedSlabs")                                   \
   V(retry_string, "retry")                                                    \
   V(rss_string, "rss")                                                        \
+  V(run_time_string, "runTime")                                               \
   V(serial_string, "serial")                                                  \
   V(scavenge_string, "scavenge")                                              \
   V(scopeid_string, "scopeid")                                                \
@@ -200,6 +229,7 @@ namespace node {
   V(should_keep_alive_string, "shouldKeepAlive")                              \
   V(signal_string, "signal")                                                  \
   V(size_string, "size")                                                      \
+  V(sizes_string, "sizes")                                                    \
   V(smalloc_p_string, "_smalloc_p")                                           \
   V(sni_context_err_string, "Invalid SNI context")                            \
   V(sni_context_string, "sni_context")                                        \
@@ -209,12 +239,14 @@ namespace node {
   V(status_message_string, "statusMessage")                                   \
   V(status_string, "status")                                                  \
   V(stdio_string, "stdio")                                                    \
+  V(stores_string, "stores")                                                  \
   V(subject_string, "subject")                                                \
   V(subjectaltname_string, "subjectaltname")                                  \
   V(sys_string, "sys")                                                        \
   V(syscall_string, "syscall")                                                \
   V(tick_callback_string, "_tickCallback")                                    \
   V(tick_domain_cb_string, "_tickDomainCallback")                             \
+  V(time_string, "time")                                                      \
   V(timeout_string, "timeout")                                                \
   V(times_string, "times")                                                    \
   V(timestamp_string, "timestamp")                                            \
@@ -241,6 +273,7 @@ namespace node {
   V(version_major_string, "versionMajor")                                     \
   V(version_minor_string, "versionMinor")                                     \
   V(version_string, "version")                                                \
+  V(wait_time_string, "waitTime")                                             \
   V(weight_string, "weight")                                                  \
   V(windows_verbatim_arguments_string, "windowsVerbatimArguments")            \
   V(wrap_string, "wrap")                                                      \
@@ -259,6 +292,7 @@ namespace node {
   V(domain_array, v8::Array)                                                  \
   V(fs_stats_constructor_function, v8::Function)                              \
   V(gc_info_callback_function, v8::Function)                                  \
+  V(http_header_names_array, v8::Array)                                       \
   V(module_load_list_array, v8::Array)                                        \
   V(pipe_constructor_template, v8::FunctionTemplate)                          \
   V(process_object, v8::Object)                                               \
@@ -273,6 +307,10 @@ namespace node {
 
 class Environment;
 
+namespace crypto {
+class RandomPool;
+}  // namespace crypto
+
 // TODO(bnoordhuis) Rename struct, the ares_ prefix implies it's part
 // of the c-ares API while the _t suffix implies it's a typedef.
 struct ares_task_t {
@@ -356,6 +394,48 @@ class Environment {
     DISALLOW_COPY_AND_ASSIGN(TickInfo);
   };
 
+  // Tracks which of its paths StreamWrap::Writev() ends up taking.
+  class WritevStats {
+   public:
+    enum Fields {
+      kImmediate,  // Written out in full by TryWrite(), no request needed.
+      kQueued,     // Needed a WriteWrap and a uv_write().
+      kArena,      // Strings encoded into the stream's reusable arena.
+      kHeap,       // Strings encoded into a freshly allocated block.
+      kFieldsCount
+    };
+
+    inline void Count(Fields field);
+    inline uint64_t Get(Fields field) const;
+
+   private:
+    friend class Environment;  // So we can call the constructor.
+    inline WritevStats();
+
+    uint64_t fields_[kFieldsCount];
+
+    DISALLOW_COPY_AND_ASSIGN(WritevStats);
+  };
+
+  // Totals over the TLS handshakes that ran on the thread pool, see
+  // TLSCallbacks::QueueHandshake(). Times are in nanoseconds.
+  class HandshakeStats {
+   public:
+    uint64_t queued;
+    uint64_t completed;
+    uint64_t pending;
+    uint64_t max_pending;
+    uint64_t wait_time;
+    uint64_t run_time;
+    uint64_t max_latency;
+
+   private:
+    friend class Environment;  // So we can call the constructor.
+    inline HandshakeStats();
+
+    DISALLOW_COPY_AND_ASSIGN(HandshakeStats);
+  };
+
   typedef void (*HandleCleanupCb)(Environment* env,
                                   uv_handle_t* handle,
                                   void* arg);
@@ -408,6 +488,13 @@ class Environment {
   static inline Environment* from_idle_check_handle(uv_check_t* handle);
   inline uv_check_t* idle_check_handle();
 
+  static inline Environment* from_cork_prepare_handle(uv_prepare_t* handle);
+  inline uv_prepare_t* cork_prepare_handle();
+
+  static inline Environment* from_cork_check_handle(uv_check_t* handle);
+  inline uv_check_t* cork_check_handle();
+  inline uv_idle_t* cork_idle_handle();
+
   // Register clean-up cb to be called on env->Dispose()
   inline void RegisterHandleCleanup(uv_handle_t* handle,
                                     HandleCleanupCb cb,
@@ -470,8 +557,21 @@ class Environment {
     return &debugger_agent_;
   }
 
+  inline SlabAllocator* slab_allocator() { return &slab_allocator_; }
+  inline WritevStats* writev_stats() { return &writev_stats_; }
+  inline HandshakeStats* handshake_stats() { return &handshake_stats_; }
+  // Owned by the crypto binding, NULL until it's loaded.
+  inline crypto::RandomPool* random_pool() const { return random_pool_; }
+  inline void set_random_pool(crypto::RandomPool* pool) {
+    random_pool_ = pool;
+  }
+
   inline QUEUE* handle_wrap_queue() { return &handle_wrap_queue_; }
   inline QUEUE* req_wrap_queue() { return &req_wrap_queue_; }
+  // Streams with corked writes that still need to go out this tick.
+  inline QUEUE* corked_stream_queue() { return &corked_stream_queue_; }
+  // Streams whose corked writes failed and still need to be called back.
+  inline QUEUE* cork_error_stream_queue() { return &cork_error_stream_queue_; }
 
  private:
   static const int kIsolateSlot = NODE_ISOLATE_SLOT;
@@ -494,6 +594,9 @@ class Environment {
   uv_idle_t immediate_idle_handle_;
   uv_prepare_t idle_prepare_handle_;
   uv_check_t idle_check_handle_;
+  uv_prepare_t cork_prepare_handle_;
+  uv_check_t cork_check_handle_;
+  uv_idle_t cork_idle_handle_;
   AsyncHooks async_hooks_;
   DomainFlag domain_flag_;
   TickInfo tick_info_;
@@ -506,9 +609,15 @@ class Environment {
   QUEUE gc_tracker_queue_;
   bool printed_error_;
   debugger::Agent debugger_agent_;
+  SlabAllocator slab_allocator_;
+  WritevStats writev_stats_;
+  HandshakeStats handshake_stats_;
+  crypto::RandomPool* random_pool_;
 
   QUEUE handle_wrap_queue_;
   QUEUE req_wrap_queue_;
+  QUEUE corked_stream_queue_;
+  QUEUE cork_error_stream_queue_;
   QUEUE handle_cleanup_queue_;
   int handle_cleanup_waiting_;
 
@@ -50,6 +50,7 @@
 #include "env-inl.h"
 #include "handle_wrap.h"
 #include "req_wrap.h"
+#include "stream_wrap.h"
 #include "string_bytes.h"
 #include "util.h"
 #include "uv.h"
@@ -1064,6 +1065,7 @@ Handle<Value> MakeCallback(Environment* env,
 
   if (tick_info->length() == 0) {
     tick_info->set_index(0);
+    StreamWrap::FlushCorked(env);
     return ret;
   }
 
@@ -1073,6 +1075,7 @@ Handle<Value> MakeCallback(Environment* env,
   env->tick_callback_function()->Call(process, 0, NULL);
 
   tick_info->set_in_tick(false);
+  StreamWrap::FlushCorked(env);
 
   if (try_catch.HasCaught()) {
     tick_info->set_last_threw(true);
@@ -3668,6 +3671,15 @@ Environment* CreateEnvironment(Isolate* isolate,
   uv_unref(reinterpret_cast<uv_handle_t*>(env->idle_prepare_handle()));
   uv_unref(reinterpret_cast<uv_handle_t*>(env->idle_check_handle()));
 
+  // Flushes corked stream writes before the loop blocks for I/O. Only active
+  // while there is something to flush, and keeps the loop alive until then.
+  uv_prepare_init(env->event_loop(), env->cork_prepare_handle());
+
+  // Reports corked writes that failed to go out. The idle handle keeps the
+  // loop from blocking in the meantime, like it does for setImmediate().
+  uv_check_init(env->event_loop(), env->cork_check_handle());
+  uv_idle_init(env->event_loop(), env->cork_idle_handle());
+
   // Register handle cleanups
   env->RegisterHandleCleanup(
       reinterpret_cast<uv_handle_t*>(env->immediate_check_handle()),
@@ -3685,6 +3697,18 @@ Environment* CreateEnvironment(Isolate* isolate,
       reinterpret_cast<uv_handle_t*>(env->idle_check_handle()),
       HandleCleanup,
       NULL);
+  env->RegisterHandleCleanup(
+      reinterpret_cast<uv_handle_t*>(env->cork_prepare_handle()),
+      HandleCleanup,
+      NULL);
+  env->RegisterHandleCleanup(
+      reinterpret_cast<uv_handle_t*>(env->cork_check_handle()),
+      HandleCleanup,
+      NULL);
+  env->RegisterHandleCleanup(
+      reinterpret_cast<uv_handle_t*>(env->cork_idle_handle()),
+      HandleCleanup,
+      NULL);
 
   if (v8_is_profiling) {
     StartProfilerIdleNotifier(env);
@@ -39,6 +39,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if !defined(_WIN32)
+#include <unistd.h>  // pread
+#endif
+
 #if defined(_MSC_VER)
 #define strcasecmp _stricmp
 #endif
@@ -88,6 +92,7 @@ using v8::EscapableHandleScope;
 using v8::Exception;
 using v8::External;
 using v8::False;
+using v8::Function;
 using v8::FunctionCallbackInfo;
 using v8::FunctionTemplate;
 using v8::Handle;
@@ -95,6 +100,7 @@ using v8::HandleScope;
 using v8::Integer;
 using v8::Isolate;
 using v8::Local;
+using v8::Number;
 using v8::Null;
 using v8::Object;
 using v8::Persistent;
@@ -219,6 +225,43 @@ void ThrowCryptoError(Environment* env,
 }
 
 
+// Only call within a valid HandleScope.
+static Local<Object> NewRequestObject(Environment* env,
+                                      Local<Value> ondone) {
+  Local<Object> obj = Object::New(env->isolate());
+  obj->Set(env->ondone_string(), ondone);
+  // XXX(trevnorris): This will need to go with the rest of domains.
+  if (env->in_domain())
+    obj->Set(env->domain_string(), env->domain_array()->Get(0));
+  return obj;
+}
+
+
+// Returns where to write in the buffer |args[index]|, starting at the offset
+// in |args[index + 1]|, if there's room for |size| bytes there. Throws and
+// returns NULL otherwise.
+static unsigned char* OutputSlice(Environment* env,
+                                  const FunctionCallbackInfo<Value>& args,
+                                  int index,
+                                  size_t size) {
+  if (!Buffer::HasInstance(args[index])) {
+    env->ThrowTypeError("Output must be a buffer");
+    return NULL;
+  }
+  if (!args[index + 1]->IsUint32()) {
+    env->ThrowTypeError("Bad offset");
+    return NULL;
+  }
+  size_t offset = args[index + 1]->Uint32Value();
+  size_t length = Buffer::Length(args[index]);
+  if (offset > length || length - offset < size) {
+    env->ThrowRangeError("Output buffer too small");
+    return NULL;
+  }
+  return reinterpret_cast<unsigned char*>(Buffer::Data(args[index])) + offset;
+}
+
+
 // Ensure that OpenSSL has enough entropy (at least 256 bits) for its PRNG.
 // The entropy pool starts out empty and needs to fill up before the PRNG
 // can be used securely.  Once the pool is filled, it never dries up again;
@@ -283,10 +326,17 @@ void SecureContext::Initialize(Environment* env, Handle<Object> target) {
                                SecureContext::SetSessionIdContext);
   NODE_SET_PROTOTYPE_METHOD(t, "setSessionTimeout",
                                SecureContext::SetSessionTimeout);
+  NODE_SET_PROTOTYPE_METHOD(t, "setSessionCache",
+                               SecureContext::SetSessionCache);
+  NODE_SET_PROTOTYPE_METHOD(t, "getSessionCacheStats",
+                               SecureContext::GetSessionCacheStats);
   NODE_SET_PROTOTYPE_METHOD(t, "close", SecureContext::Close);
   NODE_SET_PROTOTYPE_METHOD(t, "loadPKCS12", SecureContext::LoadPKCS12);
   NODE_SET_PROTOTYPE_METHOD(t, "getTicketKeys", SecureContext::GetTicketKeys);
   NODE_SET_PROTOTYPE_METHOD(t, "setTicketKeys", SecureContext::SetTicketKeys);
+  NODE_SET_PROTOTYPE_METHOD(t,
+                            "getTicketKeyStats",
+                            SecureContext::GetTicketKeyStats);
   NODE_SET_PROTOTYPE_METHOD(t,
                             "getCertificate",
                             SecureContext::GetCertificate<true>);
@@ -389,6 +439,7 @@ void SecureContext::Init(const FunctionCallbackInfo<Value>& args) {
   }
 
   sc->ctx_ = SSL_CTX_new(method);
+  SSL_CTX_set_app_data(sc->ctx_, sc);
 
   // SSL session cache configuration
   SSL_CTX_set_session_cache_mode(sc->ctx_,
@@ -867,6 +918,62 @@ void SecureContext::SetSessionTimeout(const FunctionCallbackInfo<Value>& args) {
 }
 
 
+// Attaches the context to the shared session cache at args[0], creating one
+// with room for args[1] sessions if needed. Returns 0 or a negative errno,
+// the previous cache (if any) stays in place on error. Fails with UV_EBUSY
+// once the context is in use, handshakes on the thread pool may be inside
+// the current cache.
+void SecureContext::SetSessionCache(const FunctionCallbackInfo<Value>& args) {
+  HandleScope scope(args.GetIsolate());
+
+  SecureContext* sc = Unwrap<SecureContext>(args.Holder());
+
+  if (args.Length() != 2 || !args[0]->IsString() || !args[1]->IsUint32()) {
+    return sc->env()->ThrowTypeError("Bad parameter");
+  }
+
+  if (sc->used_)
+    return args.GetReturnValue().Set(UV_EBUSY);
+
+  node::Utf8Value path(args[0]);
+  int err;
+  SessionCache* cache = SessionCache::Open(*path, args[1]->Uint32Value(), &err);
+  if (cache != NULL) {
+    delete sc->session_cache_;
+    sc->session_cache_ = cache;
+  }
+
+  args.GetReturnValue().Set(err);
+}
+
+
+void SecureContext::GetSessionCacheStats(
+    const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args.GetIsolate());
+  HandleScope scope(env->isolate());
+
+  SecureContext* sc = Unwrap<SecureContext>(args.Holder());
+  if (sc->session_cache_ == NULL)
+    return;
+
+  SessionCache::Stats stats;
+  sc->session_cache_->GetStats(&stats);
+
+  Local<Object> info = Object::New(env->isolate());
+  info->Set(env->entries_string(),
+            Number::New(env->isolate(), static_cast<double>(stats.entries)));
+  info->Set(env->hits_string(),
+            Number::New(env->isolate(), static_cast<double>(stats.hits)));
+  info->Set(env->misses_string(),
+            Number::New(env->isolate(), static_cast<double>(stats.misses)));
+  info->Set(env->stores_string(),
+            Number::New(env->isolate(), static_cast<double>(stats.stores)));
+  info->Set(env->evictions_string(),
+            Number::New(env->isolate(), static_cast<double>(stats.evictions)));
+  args.GetReturnValue().Set(info);
+}
+
+
 void SecureContext::Close(const FunctionCallbackInfo<Value>& args) {
   HandleScope scope(args.GetIsolate());
   SecureContext* sc = Unwrap<SecureContext>(args.Holder());
@@ -947,6 +1054,15 @@ void SecureContext::GetTicketKeys(const FunctionCallbackInfo<Value>& args) {
 
   SecureContext* wrap = Unwrap<SecureContext>(args.Holder());
 
+  if (wrap->ticket_keys_ != NULL) {
+    // The ring only changes on this thread, count() stays valid
+    size_t count = wrap->ticket_keys_->count();
+    Local<Object> buff =
+        Buffer::New(wrap->env(), count * TicketKeyRing::kKeySize);
+    wrap->ticket_keys_->Get(Buffer::Data(buff));
+    return args.GetReturnValue().Set(buff);
+  }
+
   Local<Object> buff = Buffer::New(wrap->env(), 48);
   if (SSL_CTX_get_tlsext_ticket_keys(wrap->ctx_,
                                      Buffer::Data(buff),
@@ -959,6 +1075,9 @@ void SecureContext::GetTicketKeys(const FunctionCallbackInfo<Value>& args) {
 }
 
 
+// Takes one or more 48-byte keys. A single key goes to OpenSSL as before,
+// more than one make up a key ring: the first key encrypts new tickets, the
+// others still decrypt the ones issued before they were rotated out.
 void SecureContext::SetTicketKeys(const FunctionCallbackInfo<Value>& args) {
 #if !defined(OPENSSL_NO_TLSEXT) && defined(SSL_CTX_get_tlsext_ticket_keys)
   HandleScope scope(args.GetIsolate());
@@ -966,21 +1085,90 @@ void SecureContext::SetTicketKeys(const FunctionCallbackInfo<Value>& args) {
 
   if (args.Length() < 1 ||
       !Buffer::HasInstance(args[0]) ||
-      Buffer::Length(args[0]) != 48) {
+      Buffer::Length(args[0]) == 0 ||
+      Buffer::Length(args[0]) % TicketKeyRing::kKeySize != 0) {
     return wrap->env()->ThrowTypeError("Bad argument");
   }
 
-  if (SSL_CTX_set_tlsext_ticket_keys(wrap->ctx_,
-                                     Buffer::Data(args[0]),
-                                     Buffer::Length(args[0])) != 1) {
-    return wrap->env()->ThrowError("Failed to fetch tls ticket keys");
+  // Once there's a ring, keep using it so that rotating down to a single key
+  // doesn't lose the counters.
+  if (Buffer::Length(args[0]) == TicketKeyRing::kKeySize &&
+      wrap->ticket_keys_ == NULL) {
+    if (SSL_CTX_set_tlsext_ticket_keys(wrap->ctx_,
+                                       Buffer::Data(args[0]),
+                                       Buffer::Length(args[0])) != 1) {
+      return wrap->env()->ThrowError("Failed to fetch tls ticket keys");
+    }
+    return args.GetReturnValue().Set(true);
   }
 
+#ifdef SSL_CTX_set_tlsext_ticket_key_cb
+  if (wrap->ticket_keys_ == NULL)
+    wrap->ticket_keys_ = new TicketKeyRing();
+  wrap->ticket_keys_->Set(Buffer::Data(args[0]), Buffer::Length(args[0]));
+  SSL_CTX_set_tlsext_ticket_key_cb(wrap->ctx_, TicketKeyCallback);
+
   args.GetReturnValue().Set(true);
+#else
+  return wrap->env()->ThrowError("Multiple ticket keys are not supported");
+#endif  // SSL_CTX_set_tlsext_ticket_key_cb
 #endif  // !def(OPENSSL_NO_TLSEXT) && def(SSL_CTX_get_tlsext_ticket_keys)
 }
 
 
+void SecureContext::GetTicketKeyStats(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args.GetIsolate());
+  HandleScope scope(env->isolate());
+
+  SecureContext* sc = Unwrap<SecureContext>(args.Holder());
+  if (sc->ticket_keys_ == NULL)
+    return;
+
+  size_t count = sc->ticket_keys_->count();
+  TicketKeyRing::KeyStats* stats = new TicketKeyRing::KeyStats[count];
+  uint64_t misses;
+  count = sc->ticket_keys_->GetStats(stats, count, &misses);
+
+  Local<Array> keys = Array::New(env->isolate(), count);
+  for (size_t i = 0; i < count; i++) {
+    Local<Object> key = Object::New(env->isolate());
+    key->Set(env->name_string(),
+             Buffer::New(env,
+                         reinterpret_cast<const char*>(stats[i].name),
+                         sizeof(stats[i].name)));
+    key->Set(env->issued_string(),
+             Number::New(env->isolate(), static_cast<double>(stats[i].issued)));
+    key->Set(env->hits_string(),
+             Number::New(env->isolate(), static_cast<double>(stats[i].hits)));
+    keys->Set(i, key);
+  }
+  delete[] stats;
+
+  Local<Object> info = Object::New(env->isolate());
+  info->Set(env->keys_string(), keys);
+  info->Set(env->misses_string(),
+            Number::New(env->isolate(), static_cast<double>(misses)));
+  args.GetReturnValue().Set(info);
+}
+
+
+#if !defined(OPENSSL_NO_TLSEXT) && defined(SSL_CTX_set_tlsext_ticket_key_cb)
+// Can run on the thread pool, see TLSCallbacks::QueueHandshake().
+int SecureContext::TicketKeyCallback(SSL* ssl,
+                                     unsigned char* name,
+                                     unsigned char* iv,
+                                     EVP_CIPHER_CTX* ectx,
+                                     HMAC_CTX* hctx,
+                                     int enc) {
+  // OpenSSL takes the callback from the context the connection started with,
+  // not from the one SNI may have switched to.
+  SecureContext* sc =
+      static_cast<SecureContext*>(SSL_CTX_get_app_data(ssl->initial_ctx));
+  return sc->ticket_keys_->Process(name, iv, ectx, hctx, enc);
+}
+#endif  // !def(OPENSSL_NO_TLSEXT) && def(SSL_CTX_set_tlsext_ticket_key_cb)
+
+
 void SecureContext::CtxGetter(Local<String> property,
                               const PropertyCallbackInfo<Value>& info) {
   HandleScope scope(info.GetIsolate());
@@ -1085,6 +1273,14 @@ SSL_SESSION* SSLWrap<Base>::GetSessionCallback(SSL* s,
   SSL_SESSION* sess = w->next_sess_;
   w->next_sess_ = NULL;
 
+  // Nothing from the resumeSession event, try the shared cache.
+  if (sess == NULL) {
+    SecureContext* sc =
+        static_cast<SecureContext*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(s)));
+    if (sc != NULL && sc->session_cache_ != NULL)
+      sess = sc->session_cache_->Lookup(key, len);
+  }
+
   return sess;
 }
 
@@ -1092,13 +1288,23 @@ SSL_SESSION* SSLWrap<Base>::GetSessionCallback(SSL* s,
 template <class Base>
 int SSLWrap<Base>::NewSessionCallback(SSL* s, SSL_SESSION* sess) {
   Base* w = static_cast<Base*>(SSL_get_app_data(s));
-  Environment* env = w->ssl_env();
-  HandleScope handle_scope(env->isolate());
-  Context::Scope context_scope(env->context());
 
+  if (w->is_server()) {
+    SecureContext* sc =
+        static_cast<SecureContext*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(s)));
+    if (sc != NULL && sc->session_cache_ != NULL)
+      sc->session_cache_->Store(sess);
+  }
+
+  // Don't touch V8 before this point, TLSCallbacks may run the handshake
+  // on the thread pool when there are no session callbacks.
   if (!w->session_callbacks_)
     return 0;
 
+  Environment* env = w->ssl_env();
+  HandleScope handle_scope(env->isolate());
+  Context::Scope context_scope(env->context());
+
   // Check if session is small enough to be stored
   int size = i2d_SSL_SESSION(sess, NULL);
   if (size > SecureContext::kMaxSessionSize)
@@ -1322,6 +1528,9 @@ void SSLWrap<Base>::GetPeerCertificate(
   Base* w = Unwrap<Base>(args.Holder());
   Environment* env = w->ssl_env();
 
+  if (w->handshake_queued_)
+    return args.GetReturnValue().SetNull();
+
   ClearErrorOnReturn clear_error_on_return;
   (void) &clear_error_on_return;  // Silence unused variable warning.
 
@@ -1429,6 +1638,9 @@ void SSLWrap<Base>::GetSession(const FunctionCallbackInfo<Value>& args) {
 
   Base* w = Unwrap<Base>(args.Holder());
 
+  if (w->handshake_queued_)
+    return args.GetReturnValue().SetNull();
+
   SSL_SESSION* sess = SSL_get_session(w->ssl_);
   if (sess == NULL)
     return;
@@ -1451,6 +1663,9 @@ void SSLWrap<Base>::SetSession(const FunctionCallbackInfo<Value>& args) {
 
   Base* w = Unwrap<Base>(args.Holder());
 
+  if (w->handshake_queued_)
+    return w->ssl_env()->ThrowError("TLS handshake in progress");
+
   if (args.Length() < 1 ||
       (!args[0]->IsString() && !Buffer::HasInstance(args[0]))) {
     return env->ThrowTypeError("Bad argument");
@@ -1484,6 +1699,9 @@ void SSLWrap<Base>::LoadSession(const FunctionCallbackInfo<Value>& args) {
   Base* w = Unwrap<Base>(args.Holder());
   Environment* env = w->ssl_env();
 
+  if (w->handshake_queued_)
+    return w->ssl_env()->ThrowError("TLS handshake in progress");
+
   if (args.Length() >= 1 && Buffer::HasInstance(args[0])) {
     ssize_t slen = Buffer::Length(args[0]);
     char* sbuf = Buffer::Data(args[0]);
@@ -1514,6 +1732,10 @@ template <class Base>
 void SSLWrap<Base>::IsSessionReused(const FunctionCallbackInfo<Value>& args) {
   HandleScope scope(args.GetIsolate());
   Base* w = Unwrap<Base>(args.Holder());
+
+  if (w->handshake_queued_)
+    return args.GetReturnValue().SetNull();
+
   bool yes = SSL_session_reused(w->ssl_);
   args.GetReturnValue().Set(yes);
 }
@@ -1533,6 +1755,9 @@ void SSLWrap<Base>::Renegotiate(const FunctionCallbackInfo<Value>& args) {
 
   Base* w = Unwrap<Base>(args.Holder());
 
+  if (w->handshake_queued_)
+    return w->ssl_env()->ThrowError("TLS handshake in progress");
+
   ClearErrorOnReturn clear_error_on_return;
   (void) &clear_error_on_return;  // Silence unused variable warning.
 
@@ -1547,6 +1772,9 @@ void SSLWrap<Base>::Shutdown(const FunctionCallbackInfo<Value>& args) {
 
   Base* w = Unwrap<Base>(args.Holder());
 
+  if (w->handshake_queued_)
+    return w->ssl_env()->ThrowError("TLS handshake in progress");
+
   int rv = SSL_shutdown(w->ssl_);
   args.GetReturnValue().Set(rv);
 }
@@ -1559,6 +1787,9 @@ void SSLWrap<Base>::GetTLSTicket(const FunctionCallbackInfo<Value>& args) {
   Base* w = Unwrap<Base>(args.Holder());
   Environment* env = w->ssl_env();
 
+  if (w->handshake_queued_)
+    return args.GetReturnValue().SetNull();
+
   SSL_SESSION* sess = SSL_get_session(w->ssl_);
   if (sess == NULL || sess->tlsext_tick == NULL)
     return;
@@ -1576,6 +1807,10 @@ void SSLWrap<Base>::NewSessionDone(const FunctionCallbackInfo<Value>& args) {
   HandleScope scope(args.GetIsolate());
 
   Base* w = Unwrap<Base>(args.Holder());
+
+  if (w->handshake_queued_)
+    return w->ssl_env()->ThrowError("TLS handshake in progress");
+
   w->new_session_wait_ = false;
   w->NewSessionDoneCb();
 }
@@ -1604,6 +1839,9 @@ void SSLWrap<Base>::RequestOCSP(
 
   Base* w = Unwrap<Base>(args.Holder());
 
+  if (w->handshake_queued_)
+    return w->ssl_env()->ThrowError("TLS handshake in progress");
+
   SSL_set_tlsext_status_type(w->ssl_, TLSEXT_STATUSTYPE_ocsp);
 #endif  // NODE__HAVE_TLSEXT_STATUS_CB
 }
@@ -1618,6 +1856,9 @@ void SSLWrap<Base>::SetMaxSendFragment(
 
   Base* w = Unwrap<Base>(args.Holder());
 
+  if (w->handshake_queued_)
+    return w->ssl_env()->ThrowError("TLS handshake in progress");
+
   int rv = SSL_set_max_send_fragment(w->ssl_, args[0]->Int32Value());
   args.GetReturnValue().Set(rv);
 }
@@ -1628,6 +1869,10 @@ template <class Base>
 void SSLWrap<Base>::IsInitFinished(const FunctionCallbackInfo<Value>& args) {
   HandleScope scope(args.GetIsolate());
   Base* w = Unwrap<Base>(args.Holder());
+
+  if (w->handshake_queued_)
+    return args.GetReturnValue().Set(false);
+
   bool yes = SSL_is_init_finished(w->ssl_);
   args.GetReturnValue().Set(yes);
 }
@@ -1639,6 +1884,9 @@ void SSLWrap<Base>::VerifyError(const FunctionCallbackInfo<Value>& args) {
 
   Base* w = Unwrap<Base>(args.Holder());
 
+  if (w->handshake_queued_)
+    return w->ssl_env()->ThrowError("TLS handshake in progress");
+
   // XXX(bnoordhuis) The UNABLE_TO_GET_ISSUER_CERT error when there is no
   // peer certificate is questionable but it's compatible with what was
   // here before.
@@ -1705,6 +1953,9 @@ void SSLWrap<Base>::GetCurrentCipher(const FunctionCallbackInfo<Value>& args) {
   Base* w = Unwrap<Base>(args.Holder());
   Environment* env = w->ssl_env();
 
+  if (w->handshake_queued_)
+    return args.GetReturnValue().SetNull();
+
   OPENSSL_CONST SSL_CIPHER* c = SSL_get_current_cipher(w->ssl_);
   if (c == NULL)
     return;
@@ -1726,15 +1977,15 @@ int SSLWrap<Base>::AdvertiseNextProtoCallback(SSL* s,
                                               unsigned int* len,
                                               void* arg) {
   Base* w = static_cast<Base*>(SSL_get_app_data(s));
-  Environment* env = w->env();
-  HandleScope handle_scope(env->isolate());
-  Context::Scope context_scope(env->context());
 
   if (w->npn_protos_.IsEmpty()) {
     // No initialization - no NPN protocols
     *data = reinterpret_cast<const unsigned char*>("");
     *len = 0;
   } else {
+    Environment* env = w->env();
+    HandleScope handle_scope(env->isolate());
+    Context::Scope context_scope(env->context());
     Local<Object> obj = PersistentToLocal(env->isolate(), w->npn_protos_);
     *data = reinterpret_cast<const unsigned char*>(Buffer::Data(obj));
     *len = Buffer::Length(obj);
@@ -1806,6 +2057,9 @@ void SSLWrap<Base>::GetNegotiatedProto(
 
   Base* w = Unwrap<Base>(args.Holder());
 
+  if (w->handshake_queued_)
+    return args.GetReturnValue().SetNull();
+
   if (w->is_client()) {
     if (w->selected_npn_proto_.IsEmpty() == false) {
       args.GetReturnValue().Set(w->selected_npn_proto_);
@@ -1845,9 +2099,10 @@ template <class Base>
 int SSLWrap<Base>::TLSExtStatusCallback(SSL* s, void* arg) {
   Base* w = static_cast<Base*>(SSL_get_app_data(s));
   Environment* env = w->env();
-  HandleScope handle_scope(env->isolate());
 
   if (w->is_client()) {
+    HandleScope handle_scope(env->isolate());
+
     // Incoming response
     const unsigned char* resp;
     int len = SSL_get_tlsext_status_ocsp_resp(s, &resp);
@@ -1870,6 +2125,7 @@ int SSLWrap<Base>::TLSExtStatusCallback(SSL* s, void* arg) {
     if (w->ocsp_response_.IsEmpty())
       return SSL_TLSEXT_ERR_NOACK;
 
+    HandleScope handle_scope(env->isolate());
     Local<Object> obj = PersistentToLocal(env->isolate(), w->ocsp_response_);
     char* resp = Buffer::Data(obj);
     size_t len = Buffer::Length(obj);
@@ -2554,7 +2810,9 @@ void CipherBase::Initialize(Environment* env, Handle<Object> target) {
   NODE_SET_PROTOTYPE_METHOD(t, "init", Init);
   NODE_SET_PROTOTYPE_METHOD(t, "initiv", InitIv);
   NODE_SET_PROTOTYPE_METHOD(t, "update", Update);
+  NODE_SET_PROTOTYPE_METHOD(t, "updateInto", UpdateInto);
   NODE_SET_PROTOTYPE_METHOD(t, "final", Final);
+  NODE_SET_PROTOTYPE_METHOD(t, "finalInto", FinalInto);
   NODE_SET_PROTOTYPE_METHOD(t, "setAutoPadding", SetAutoPadding);
   NODE_SET_PROTOTYPE_METHOD(t, "getAuthTag", GetAuthTag);
   NODE_SET_PROTOTYPE_METHOD(t, "setAuthTag", SetAuthTag);
@@ -2712,6 +2970,8 @@ void CipherBase::GetAuthTag(const FunctionCallbackInfo<Value>& args) {
   Environment* env = Environment::GetCurrent(args.GetIsolate());
   HandleScope handle_scope(args.GetIsolate());
   CipherBase* cipher = Unwrap<CipherBase>(args.Holder());
+  if (cipher->CheckBusy())
+    return;
 
   char* out = NULL;
   unsigned int out_len = 0;
@@ -2745,6 +3005,8 @@ void CipherBase::SetAuthTag(const FunctionCallbackInfo<Value>& args) {
     return env->ThrowTypeError("Argument must be a Buffer");
 
   CipherBase* cipher = Unwrap<CipherBase>(args.Holder());
+  if (cipher->CheckBusy())
+    return;
 
   if (!cipher->SetAuthTag(Buffer::Data(buf), Buffer::Length(buf)))
     env->ThrowError("Attempting to set auth tag in unsupported state");
@@ -2773,6 +3035,8 @@ void CipherBase::SetAAD(const FunctionCallbackInfo<Value>& args) {
   ASSERT_IS_BUFFER(args[0]);
 
   CipherBase* cipher = Unwrap<CipherBase>(args.Holder());
+  if (cipher->CheckBusy())
+    return;
 
   if (!cipher->SetAAD(Buffer::Data(args[0]), Buffer::Length(args[0])))
     env->ThrowError("Attempting to set AAD in unsupported state");
@@ -2786,6 +3050,19 @@ bool CipherBase::Update(const char* data,
   if (!initialised_)
     return 0;
 
+  *out_len = len + EVP_CIPHER_CTX_block_size(&ctx_);
+  *out = new unsigned char[*out_len];
+  return UpdateInto(data, len, *out, out_len);
+}
+
+
+bool CipherBase::UpdateInto(const char* data,
+                            int len,
+                            unsigned char* out,
+                            int* out_len) {
+  if (!initialised_)
+    return false;
+
   // on first update:
   if (kind_ == kDecipher && IsAuthenticatedMode() && auth_tag_ != NULL) {
     EVP_CIPHER_CTX_ctrl(&ctx_,
@@ -2796,21 +3073,37 @@ bool CipherBase::Update(const char* data,
     auth_tag_ = NULL;
   }
 
-  *out_len = len + EVP_CIPHER_CTX_block_size(&ctx_);
-  *out = new unsigned char[*out_len];
   return EVP_CipherUpdate(&ctx_,
-                          *out,
+                          out,
                           out_len,
                           reinterpret_cast<const unsigned char*>(data),
                           len);
 }
 
 
+// EVP_CipherUpdate() can write up to a block more than it's given when
+// decrypting with padding, stream modes like CTR and GCM write exactly |len|.
+int CipherBase::MaxUpdateSize(int len) const {
+  int block_size = EVP_CIPHER_CTX_block_size(&ctx_);
+  return block_size > 1 ? len + block_size : len;
+}
+
+
+bool CipherBase::CheckBusy() {
+  if (!busy_)
+    return false;
+  env()->ThrowError("Cipher is busy with an asynchronous updateInto()");
+  return true;
+}
+
+
 void CipherBase::Update(const FunctionCallbackInfo<Value>& args) {
   HandleScope handle_scope(args.GetIsolate());
   Environment* env = Environment::GetCurrent(args.GetIsolate());
 
   CipherBase* cipher = Unwrap<CipherBase>(args.Holder());
+  if (cipher->CheckBusy())
+    return;
 
   ASSERT_IS_STRING_OR_BUFFER(args[0]);
 
@@ -2854,6 +3147,132 @@ void CipherBase::Update(const FunctionCallbackInfo<Value>& args) {
 }
 
 
+// Runs CipherBase::UpdateInto() on the thread pool. The cipher is marked busy
+// until the request is done, object() keeps it and both buffers alive.
+class CipherUpdateRequest : public AsyncWrap {
+ public:
+  CipherUpdateRequest(Environment* env,
+                      Local<Object> object,
+                      CipherBase* cipher,
+                      const char* data,
+                      int len,
+                      unsigned char* out)
+      : AsyncWrap(env, object, AsyncWrap::PROVIDER_CRYPTO),
+        cipher_(cipher),
+        data_(data),
+        len_(len),
+        out_(out),
+        out_len_(0),
+        ok_(false),
+        error_(0) {
+  }
+
+  ~CipherUpdateRequest() {
+    persistent().Reset();
+  }
+
+  void Queue() {
+    cipher_->busy_ = true;
+    uv_queue_work(env()->event_loop(), &work_req_, Work, After);
+  }
+
+ private:
+  static void Work(uv_work_t* work_req);
+  static void After(uv_work_t* work_req, int status);
+
+  uv_work_t work_req_;
+  CipherBase* const cipher_;
+  const char* const data_;
+  const int len_;
+  unsigned char* const out_;
+  int out_len_;
+  bool ok_;
+  unsigned long error_;
+};
+
+
+void CipherUpdateRequest::Work(uv_work_t* work_req) {
+  CipherUpdateRequest* req =
+      ContainerOf(&CipherUpdateRequest::work_req_, work_req);
+  req->ok_ = req->cipher_->UpdateInto(req->data_,
+                                      req->len_,
+                                      req->out_,
+                                      &req->out_len_);
+  if (!req->ok_)
+    req->error_ = ERR_get_error();
+  ERR_clear_error();
+}
+
+
+void CipherUpdateRequest::After(uv_work_t* work_req, int status) {
+  assert(status == 0);
+  CipherUpdateRequest* req =
+      ContainerOf(&CipherUpdateRequest::work_req_, work_req);
+  Environment* env = req->env();
+  HandleScope handle_scope(env->isolate());
+  Context::Scope context_scope(env->context());
+
+  req->cipher_->busy_ = false;
+
+  Local<Value> argv[2];
+  if (req->ok_) {
+    argv[0] = Null(env->isolate());
+    argv[1] = Integer::New(env->isolate(), req->out_len_);
+  } else {
+    char errmsg[128] = "Trying to add data in unsupported state";
+    if (req->error_ != 0)
+      ERR_error_string_n(req->error_, errmsg, sizeof(errmsg));
+    argv[0] = Exception::Error(OneByteString(env->isolate(), errmsg));
+    argv[1] = Undefined(env->isolate());
+  }
+
+  req->MakeCallback(env->ondone_string(), ARRAY_SIZE(argv), argv);
+  delete req;
+}
+
+
+// updateInto(input, output, offset[, ondone])
+// Returns the number of bytes written to output, or passes it to ondone.
+void CipherBase::UpdateInto(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args.GetIsolate());
+  HandleScope scope(env->isolate());
+
+  CipherBase* cipher = Unwrap<CipherBase>(args.Holder());
+  if (cipher->CheckBusy())
+    return;
+
+  ASSERT_IS_BUFFER(args[0]);
+  const char* data = Buffer::Data(args[0]);
+  int len = Buffer::Length(args[0]);
+
+  if (!cipher->initialised_)
+    return env->ThrowError("Trying to add data in unsupported state");
+
+  unsigned char* out =
+      OutputSlice(env, args, 1, cipher->MaxUpdateSize(len));
+  if (out == NULL)
+    return;
+
+  if (args[3]->IsFunction()) {
+    Local<Object> obj = NewRequestObject(env, args[3]);
+    obj->Set(env->handle_string(), args.Holder());
+    obj->Set(env->input_string(), args[0]);
+    obj->Set(env->output_string(), args[1]);
+    CipherUpdateRequest* req =
+        new CipherUpdateRequest(env, obj, cipher, data, len, out);
+    return req->Queue();
+  }
+
+  int out_len = 0;
+  if (!cipher->UpdateInto(data, len, out, &out_len)) {
+    return ThrowCryptoError(env,
+                            ERR_get_error(),
+                            "Trying to add data in unsupported state");
+  }
+  args.GetReturnValue().Set(out_len);
+}
+
+
 bool CipherBase::SetAutoPadding(bool auto_padding) {
   if (!initialised_)
     return false;
@@ -2864,6 +3283,8 @@ bool CipherBase::SetAutoPadding(bool auto_padding) {
 void CipherBase::SetAutoPadding(const FunctionCallbackInfo<Value>& args) {
   HandleScope scope(args.GetIsolate());
   CipherBase* cipher = Unwrap<CipherBase>(args.Holder());
+  if (cipher->CheckBusy())
+    return;
   cipher->SetAutoPadding(args.Length() < 1 || args[0]->BooleanValue());
 }
 
@@ -2873,7 +3294,15 @@ bool CipherBase::Final(unsigned char** out, int *out_len) {
     return false;
 
   *out = new unsigned char[EVP_CIPHER_CTX_block_size(&ctx_)];
-  int r = EVP_CipherFinal_ex(&ctx_, *out, out_len);
+  return FinalInto(*out, out_len);
+}
+
+
+bool CipherBase::FinalInto(unsigned char* out, int* out_len) {
+  if (!initialised_)
+    return false;
+
+  int r = EVP_CipherFinal_ex(&ctx_, out, out_len);
 
   if (r && kind_ == kCipher) {
     delete[] auth_tag_;
@@ -2901,6 +3330,8 @@ void CipherBase::Final(const FunctionCallbackInfo<Value>& args) {
   Environment* env = Environment::GetCurrent(args.GetIsolate());
 
   CipherBase* cipher = Unwrap<CipherBase>(args.Holder());
+  if (cipher->CheckBusy())
+    return;
 
   unsigned char* out_value = NULL;
   int out_len = -1;
@@ -2929,6 +3360,127 @@ void CipherBase::Final(const FunctionCallbackInfo<Value>& args) {
 }
 
 
+// finalInto(output, offset)
+void CipherBase::FinalInto(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args.GetIsolate());
+  HandleScope scope(env->isolate());
+
+  CipherBase* cipher = Unwrap<CipherBase>(args.Holder());
+  if (cipher->CheckBusy())
+    return;
+
+  const char* msg = cipher->IsAuthenticatedMode() ?
+      "Unsupported state or unable to authenticate data" :
+      "Unsupported state";
+  if (!cipher->initialised_)
+    return env->ThrowError(msg);
+
+  // Stream modes have nothing left over to write.
+  int block_size = EVP_CIPHER_CTX_block_size(&cipher->ctx_);
+  unsigned char* out =
+      OutputSlice(env, args, 0, block_size > 1 ? block_size : 0);
+  if (out == NULL)
+    return;
+
+  int out_len = 0;
+  if (!cipher->FinalInto(out, &out_len))
+    return ThrowCryptoError(env, ERR_get_error(), msg);
+  args.GetReturnValue().Set(out_len);
+}
+
+
+// One-shot digests: Hash::OneShot() and Hmac::OneShot() compute a digest in
+// a single call, without a wrapper object. They only run on the main thread,
+// so one context of each kind is enough; reusing it also keeps OpenSSL from
+// reallocating the digest state as long as the algorithm doesn't change.
+static EVP_MD_CTX one_shot_md_ctx;
+static HMAC_CTX one_shot_hmac_ctx;
+
+// EVP_get_digestbyname() takes a global lock and hashes the name, remember
+// the last few lookups instead.
+struct DigestCacheEntry {
+  char name[32];
+  const EVP_MD* md;
+};
+static DigestCacheEntry digest_cache[8];
+static unsigned int digest_cache_next;
+
+
+static const EVP_MD* GetDigestByName(Handle<Value> value) {
+  if (!value->IsString())
+    return NULL;
+
+  Local<String> string = value.As<String>();
+  char name[sizeof(digest_cache[0].name)];
+  if (!string->IsOneByte() ||
+      string->Length() >= static_cast<int>(sizeof(name))) {
+    return EVP_get_digestbyname(*node::Utf8Value(string));
+  }
+  string->WriteOneByte(reinterpret_cast<uint8_t*>(name));
+
+  for (size_t i = 0; i < ARRAY_SIZE(digest_cache); i++) {
+    if (digest_cache[i].md != NULL && strcmp(digest_cache[i].name, name) == 0)
+      return digest_cache[i].md;
+  }
+
+  const EVP_MD* md = EVP_get_digestbyname(name);
+  if (md != NULL) {
+    DigestCacheEntry* entry =
+        &digest_cache[digest_cache_next++ % ARRAY_SIZE(digest_cache)];
+    memcpy(entry->name, name, sizeof(name));
+    entry->md = md;
+  }
+  return md;
+}
+
+
+// The bytes of a string or buffer argument. Buffers are used in place,
+// strings get decoded, into stack memory when they're small enough.
+class OneShotInput {
+ public:
+  OneShotInput(Isolate* isolate, Handle<Value> value, enum encoding encoding)
+      : heap_(NULL),
+        data_(NULL),
+        length_(0),
+        valid_(true) {
+    if (Buffer::HasInstance(value)) {
+      data_ = Buffer::Data(value);
+      length_ = Buffer::Length(value);
+      return;
+    }
+
+    Local<String> string = value.As<String>();
+    if (!StringBytes::IsValidString(isolate, string, encoding)) {
+      valid_ = false;
+      return;
+    }
+    size_t size = StringBytes::StorageSize(isolate, string, encoding);
+    char* storage = stack_;
+    if (size > sizeof(stack_))
+      storage = heap_ = new char[size];
+    length_ = StringBytes::Write(isolate, storage, size, string, encoding);
+    data_ = storage;
+  }
+
+  ~OneShotInput() {
+    delete[] heap_;
+  }
+
+  const char* data() const { return data_; }
+  size_t length() const { return length_; }
+  bool valid() const { return valid_; }
+
+ private:
+  char stack_[1024];
+  char* heap_;
+  const char* data_;
+  size_t length_;
+  bool valid_;
+
+  DISALLOW_COPY_AND_ASSIGN(OneShotInput);
+};
+
+
 void Hmac::Initialize(Environment* env, v8::Handle<v8::Object> target) {
   Local<FunctionTemplate> t = FunctionTemplate::New(env->isolate(), New);
 
@@ -2937,8 +3489,49 @@ void Hmac::Initialize(Environment* env, v8::Handle<v8::Object> target) {
   NODE_SET_PROTOTYPE_METHOD(t, "init", HmacInit);
   NODE_SET_PROTOTYPE_METHOD(t, "update", HmacUpdate);
   NODE_SET_PROTOTYPE_METHOD(t, "digest", HmacDigest);
+  NODE_SET_PROTOTYPE_METHOD(t, "digestInto", HmacDigestInto);
 
   target->Set(FIXED_ONE_BYTE_STRING(env->isolate(), "Hmac"), t->GetFunction());
+  NODE_SET_METHOD(target, "hmac", OneShot);
+}
+
+
+// hmac(algorithm, key, data, inputEncoding, outputEncoding)
+void Hmac::OneShot(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args.GetIsolate());
+  HandleScope scope(env->isolate());
+
+  const EVP_MD* md = GetDigestByName(args[0]);
+  if (md == NULL)
+    return env->ThrowError("Unknown message digest");
+
+  ASSERT_IS_BUFFER(args[1]);
+  ASSERT_IS_STRING_OR_BUFFER(args[2]);
+
+  enum encoding encoding = ParseEncoding(env->isolate(), args[3], BINARY);
+  OneShotInput data(env->isolate(), args[2], encoding);
+  if (!data.valid())
+    return env->ThrowTypeError("Bad input string");
+
+  const char* key = Buffer::Data(args[1]);
+  size_t key_len = Buffer::Length(args[1]);
+  if (key_len == 0)
+    key = "";
+
+  unsigned char md_value[EVP_MAX_MD_SIZE];
+  unsigned int md_len;
+  HMAC_Init_ex(&one_shot_hmac_ctx, key, key_len, md, NULL);
+  HMAC_Update(&one_shot_hmac_ctx,
+              reinterpret_cast<const unsigned char*>(data.data()),
+              data.length());
+  HMAC_Final(&one_shot_hmac_ctx, md_value, &md_len);
+
+  encoding = ParseEncoding(env->isolate(), args[4], BUFFER);
+  args.GetReturnValue().Set(
+      StringBytes::Encode(env->isolate(),
+                          reinterpret_cast<const char*>(md_value),
+                          md_len,
+                          encoding));
 }
 
 
@@ -3034,7 +3627,14 @@ bool Hmac::HmacDigest(unsigned char** md_value, unsigned int* md_len) {
   if (!initialised_)
     return false;
   *md_value = new unsigned char[EVP_MAX_MD_SIZE];
-  HMAC_Final(&ctx_, *md_value, md_len);
+  return HmacDigestInto(*md_value, md_len);
+}
+
+
+bool Hmac::HmacDigestInto(unsigned char* md_value, unsigned int* md_len) {
+  if (!initialised_)
+    return false;
+  HMAC_Final(&ctx_, md_value, md_len);
   HMAC_CTX_cleanup(&ctx_);
   initialised_ = false;
   return true;
@@ -3070,15 +3670,68 @@ void Hmac::HmacDigest(const FunctionCallbackInfo<Value>& args) {
 }
 
 
-void Hash::Initialize(Environment* env, v8::Handle<v8::Object> target) {
-  Local<FunctionTemplate> t = FunctionTemplate::New(env->isolate(), New);
+// digestInto(output, offset)
+void Hmac::HmacDigestInto(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args.GetIsolate());
+  HandleScope scope(env->isolate());
 
-  t->InstanceTemplate()->SetInternalFieldCount(1);
+  Hmac* hmac = Unwrap<Hmac>(args.Holder());
+
+  if (!hmac->initialised_)
+    return env->ThrowError("Not initialized");
+
+  unsigned char* out = OutputSlice(env, args, 0, HMAC_size(&hmac->ctx_));
+  if (out == NULL)
+    return;
+
+  unsigned int md_len = 0;
+  hmac->HmacDigestInto(out, &md_len);
+  args.GetReturnValue().Set(md_len);
+}
 
-  NODE_SET_PROTOTYPE_METHOD(t, "update", HashUpdate);
-  NODE_SET_PROTOTYPE_METHOD(t, "digest", HashDigest);
+
+void Hash::Initialize(Environment* env, v8::Handle<v8::Object> target) {
+  Local<FunctionTemplate> t = FunctionTemplate::New(env->isolate(), New);
+
+  t->InstanceTemplate()->SetInternalFieldCount(1);
+
+  NODE_SET_PROTOTYPE_METHOD(t, "update", HashUpdate);
+  NODE_SET_PROTOTYPE_METHOD(t, "digest", HashDigest);
+  NODE_SET_PROTOTYPE_METHOD(t, "digestInto", HashDigestInto);
 
   target->Set(FIXED_ONE_BYTE_STRING(env->isolate(), "Hash"), t->GetFunction());
+  NODE_SET_METHOD(target, "hash", OneShot);
+}
+
+
+// hash(algorithm, data, inputEncoding, outputEncoding)
+void Hash::OneShot(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args.GetIsolate());
+  HandleScope scope(env->isolate());
+
+  const EVP_MD* md = GetDigestByName(args[0]);
+  if (md == NULL)
+    return env->ThrowError("Digest method not supported");
+
+  ASSERT_IS_STRING_OR_BUFFER(args[1]);
+
+  enum encoding encoding = ParseEncoding(env->isolate(), args[2], BINARY);
+  OneShotInput data(env->isolate(), args[1], encoding);
+  if (!data.valid())
+    return env->ThrowTypeError("Bad input string");
+
+  unsigned char md_value[EVP_MAX_MD_SIZE];
+  unsigned int md_len;
+  EVP_DigestInit_ex(&one_shot_md_ctx, md, NULL);
+  EVP_DigestUpdate(&one_shot_md_ctx, data.data(), data.length());
+  EVP_DigestFinal_ex(&one_shot_md_ctx, md_value, &md_len);
+
+  encoding = ParseEncoding(env->isolate(), args[3], BUFFER);
+  args.GetReturnValue().Set(
+      StringBytes::Encode(env->isolate(),
+                          reinterpret_cast<const char*>(md_value),
+                          md_len,
+                          encoding));
 }
 
 
@@ -3185,37 +3838,62 @@ void Hash::HashDigest(const FunctionCallbackInfo<Value>& args) {
 }
 
 
+// digestInto(output, offset)
+void Hash::HashDigestInto(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args.GetIsolate());
+  HandleScope scope(env->isolate());
+
+  Hash* hash = Unwrap<Hash>(args.Holder());
+
+  if (!hash->initialised_)
+    return env->ThrowError("Not initialized");
+
+  unsigned char* out = OutputSlice(env, args, 0, EVP_MD_size(hash->md_));
+  if (out == NULL)
+    return;
+
+  unsigned int md_len;
+  EVP_DigestFinal_ex(&hash->mdctx_, out, &md_len);
+  EVP_MD_CTX_cleanup(&hash->mdctx_);
+  hash->initialised_ = false;
+  args.GetReturnValue().Set(md_len);
+}
+
+
+static const char* SignErrorMessage(SignBase::Error error) {
+  switch (error) {
+    case SignBase::kSignUnknownDigest:
+      return "Unknown message digest";
+    case SignBase::kSignNotInitialised:
+      return "Not initialised";
+    case SignBase::kSignInit:
+      return "EVP_SignInit_ex failed";
+    case SignBase::kSignUpdate:
+      return "EVP_SignUpdate failed";
+    case SignBase::kSignPrivateKey:
+      return "PEM_read_bio_PrivateKey failed";
+    case SignBase::kSignPublicKey:
+      return "PEM_read_bio_PUBKEY failed";
+    case SignBase::kSignOk:
+      break;
+  }
+  abort();
+}
+
+
 void SignBase::CheckThrow(SignBase::Error error) {
   HandleScope scope(env()->isolate());
 
   switch (error) {
     case kSignUnknownDigest:
-      return env()->ThrowError("Unknown message digest");
-
     case kSignNotInitialised:
-      return env()->ThrowError("Not initialised");
+      return env()->ThrowError(SignErrorMessage(error));
 
     case kSignInit:
     case kSignUpdate:
     case kSignPrivateKey:
     case kSignPublicKey:
-      {
-        unsigned long err = ERR_get_error();
-        if (err)
-          return ThrowCryptoError(env(), err);
-        switch (error) {
-          case kSignInit:
-            return env()->ThrowError("EVP_SignInit_ex failed");
-          case kSignUpdate:
-            return env()->ThrowError("EVP_SignUpdate failed");
-          case kSignPrivateKey:
-            return env()->ThrowError("PEM_read_bio_PrivateKey failed");
-          case kSignPublicKey:
-            return env()->ThrowError("PEM_read_bio_PUBKEY failed");
-          default:
-            abort();
-        }
-      }
+      return ThrowCryptoError(env(), ERR_get_error(), SignErrorMessage(error));
 
     case kSignOk:
       return;
@@ -3223,6 +3901,235 @@ void SignBase::CheckThrow(SignBase::Error error) {
 }
 
 
+SignBase::Error SignBase::Detach(EVP_MD_CTX* ctx) {
+  if (!initialised_)
+    return kSignNotInitialised;
+  if (!EVP_MD_CTX_copy_ex(ctx, &mdctx_))
+    return kSignInit;
+  EVP_MD_CTX_cleanup(&mdctx_);
+  initialised_ = false;
+  return kSignOk;
+}
+
+
+static EVP_PKEY* LoadPrivateKey(const char* key_pem,
+                                int key_pem_len,
+                                const char* passphrase) {
+  BIO* bp = BIO_new_mem_buf(const_cast<char*>(key_pem), key_pem_len);
+  if (bp == NULL)
+    return NULL;
+
+  EVP_PKEY* pkey = PEM_read_bio_PrivateKey(bp,
+                                           NULL,
+                                           CryptoPemCallback,
+                                           const_cast<char*>(passphrase));
+  BIO_free_all(bp);
+  return pkey;
+}
+
+
+static EVP_PKEY* LoadPublicKey(const char* key_pem, int key_pem_len) {
+  BIO* bp = BIO_new_mem_buf(const_cast<char*>(key_pem), key_pem_len);
+  if (bp == NULL)
+    return NULL;
+
+  EVP_PKEY* pkey = NULL;
+
+  // Check if this is a PKCS#8 or RSA public key before trying as X.509.
+  if (strncmp(key_pem, PUBLIC_KEY_PFX, PUBLIC_KEY_PFX_LEN) == 0) {
+    pkey = PEM_read_bio_PUBKEY(bp, NULL, CryptoPemCallback, NULL);
+  } else if (strncmp(key_pem, PUBRSA_KEY_PFX, PUBRSA_KEY_PFX_LEN) == 0) {
+    RSA* rsa = PEM_read_bio_RSAPublicKey(bp, NULL, CryptoPemCallback, NULL);
+    if (rsa) {
+      pkey = EVP_PKEY_new();
+      if (pkey)
+        EVP_PKEY_set1_RSA(pkey, rsa);
+      RSA_free(rsa);
+    }
+  } else {
+    // X.509 fallback
+    X509* x509 = PEM_read_bio_X509(bp, NULL, CryptoPemCallback, NULL);
+    if (x509 != NULL) {
+      pkey = X509_get_pubkey(x509);
+      X509_free(x509);
+    }
+  }
+
+  BIO_free_all(bp);
+  return pkey;
+}
+
+
+// Finishes one or more signatures, or one verification, on the thread pool.
+// The digests are computed on the main thread up front, only parsing the key
+// and the public key operation itself - the expensive part - happen in Work().
+// Batches parse the key once for all of their signatures.
+class SignRequest : public AsyncWrap {
+ public:
+  enum Mode {
+    kSign,
+    kVerify
+  };
+
+  SignRequest(Environment* env,
+              Local<Object> object,
+              Mode mode,
+              const char* key_pem,
+              size_t key_pem_len,
+              const char* passphrase,
+              uint32_t count)
+      : AsyncWrap(env, object, AsyncWrap::PROVIDER_CRYPTO),
+        mode_(mode),
+        key_pem_(new char[key_pem_len]),
+        key_pem_len_(key_pem_len),
+        passphrase_(passphrase != NULL ? strdup(passphrase) : NULL),
+        count_(count),
+        contexts_(new EVP_MD_CTX[count]),
+        signatures_(NULL),
+        signature_lengths_(NULL),
+        signature_size_(0),
+        signature_(NULL),
+        signature_len_(0),
+        error_(SignBase::kSignOk),
+        openssl_error_(0),
+        verified_(false) {
+    memcpy(key_pem_, key_pem, key_pem_len);
+    for (uint32_t i = 0; i < count_; i++)
+      EVP_MD_CTX_init(&contexts_[i]);
+  }
+
+  ~SignRequest() {
+    for (uint32_t i = 0; i < count_; i++)
+      EVP_MD_CTX_cleanup(&contexts_[i]);
+    delete[] contexts_;
+    memset(key_pem_, 0, key_pem_len_);
+    delete[] key_pem_;
+    if (passphrase_ != NULL) {
+      memset(passphrase_, 0, strlen(passphrase_));
+      free(passphrase_);
+    }
+    delete[] signatures_;
+    delete[] signature_lengths_;
+    delete[] signature_;
+    persistent().Reset();
+  }
+
+  EVP_MD_CTX* context(uint32_t index) {
+    return &contexts_[index];
+  }
+
+  // The signature to check in kVerify mode.
+  void set_signature(const char* sig, size_t len) {
+    signature_ = new char[len];
+    signature_len_ = len;
+    memcpy(signature_, sig, len);
+  }
+
+  void Queue() {
+    uv_queue_work(env()->event_loop(), &work_req_, Work, After);
+  }
+
+ private:
+  static void Work(uv_work_t* work_req);
+  static void After(uv_work_t* work_req, int status);
+
+  uv_work_t work_req_;
+  const Mode mode_;
+  char* key_pem_;
+  const size_t key_pem_len_;
+  char* passphrase_;
+  const uint32_t count_;
+  EVP_MD_CTX* contexts_;
+  unsigned char* signatures_;  // count_ slots of signature_size_ bytes.
+  unsigned int* signature_lengths_;
+  unsigned int signature_size_;
+  char* signature_;
+  size_t signature_len_;
+  SignBase::Error error_;
+  unsigned long openssl_error_;
+  bool verified_;
+};
+
+
+void SignRequest::Work(uv_work_t* work_req) {
+  SignRequest* req = ContainerOf(&SignRequest::work_req_, work_req);
+
+  if (req->mode_ == kSign) {
+    EVP_PKEY* pkey =
+        LoadPrivateKey(req->key_pem_, req->key_pem_len_, req->passphrase_);
+    if (pkey == NULL) {
+      req->error_ = SignBase::kSignPrivateKey;
+    } else {
+      req->signature_size_ = EVP_PKEY_size(pkey);
+      req->signatures_ = new unsigned char[req->count_ * req->signature_size_];
+      req->signature_lengths_ = new unsigned int[req->count_];
+      for (uint32_t i = 0; i < req->count_; i++) {
+        if (!EVP_SignFinal(&req->contexts_[i],
+                           req->signatures_ + i * req->signature_size_,
+                           &req->signature_lengths_[i],
+                           pkey)) {
+          req->error_ = SignBase::kSignPrivateKey;
+          break;
+        }
+      }
+      EVP_PKEY_free(pkey);
+    }
+  } else {
+    EVP_PKEY* pkey = LoadPublicKey(req->key_pem_, req->key_pem_len_);
+    if (pkey == NULL) {
+      req->error_ = SignBase::kSignPublicKey;
+    } else {
+      int r = EVP_VerifyFinal(
+          &req->contexts_[0],
+          reinterpret_cast<const unsigned char*>(req->signature_),
+          req->signature_len_,
+          pkey);
+      req->verified_ = r == 1;
+      EVP_PKEY_free(pkey);
+    }
+  }
+
+  // The error queue is per thread, pick the reason up while it's there.
+  if (req->error_ != SignBase::kSignOk)
+    req->openssl_error_ = ERR_get_error();
+  ERR_clear_error();
+}
+
+
+void SignRequest::After(uv_work_t* work_req, int status) {
+  assert(status == 0);
+  SignRequest* req = ContainerOf(&SignRequest::work_req_, work_req);
+  Environment* env = req->env();
+  HandleScope handle_scope(env->isolate());
+  Context::Scope context_scope(env->context());
+
+  Local<Value> argv[2];
+  if (req->error_ != SignBase::kSignOk) {
+    char errmsg[128] = { 0 };
+    if (req->openssl_error_ != 0)
+      ERR_error_string_n(req->openssl_error_, errmsg, sizeof(errmsg));
+    else
+      snprintf(errmsg, sizeof(errmsg), "%s", SignErrorMessage(req->error_));
+    argv[0] = Exception::Error(OneByteString(env->isolate(), errmsg));
+    argv[1] = Undefined(env->isolate());
+  } else if (req->mode_ == kVerify) {
+    argv[0] = Null(env->isolate());
+    argv[1] = Boolean::New(env->isolate(), req->verified_);
+  } else {
+    Local<Array> signatures = Array::New(env->isolate(), req->count_);
+    for (uint32_t i = 0; i < req->count_; i++) {
+      const unsigned char* sig = req->signatures_ + i * req->signature_size_;
+      signatures->Set(i, Buffer::New(env,
+                                     reinterpret_cast<const char*>(sig),
+                                     req->signature_lengths_[i]));
+    }
+    argv[0] = Null(env->isolate());
+    argv[1] = signatures;
+  }
+
+  req->MakeCallback(env->ondone_string(), ARRAY_SIZE(argv), argv);
+  delete req;
+}
 
 
 void Sign::Initialize(Environment* env, v8::Handle<v8::Object> target) {
@@ -3325,18 +4232,9 @@ SignBase::Error Sign::SignFinal(const char* key_pem,
   if (!initialised_)
     return kSignNotInitialised;
 
-  BIO* bp = NULL;
-  EVP_PKEY* pkey = NULL;
   bool fatal = true;
 
-  bp = BIO_new_mem_buf(const_cast<char*>(key_pem), key_pem_len);
-  if (bp == NULL)
-    goto exit;
-
-  pkey = PEM_read_bio_PrivateKey(bp,
-                                 NULL,
-                                 CryptoPemCallback,
-                                 const_cast<char*>(passphrase));
+  EVP_PKEY* pkey = LoadPrivateKey(key_pem, key_pem_len, passphrase);
   if (pkey == NULL)
     goto exit;
 
@@ -3348,8 +4246,6 @@ SignBase::Error Sign::SignFinal(const char* key_pem,
  exit:
   if (pkey != NULL)
     EVP_PKEY_free(pkey);
-  if (bp != NULL)
-    BIO_free_all(bp);
 
   EVP_MD_CTX_cleanup(&mdctx_);
 
@@ -3381,6 +4277,23 @@ void Sign::SignFinal(const FunctionCallbackInfo<Value>& args) {
   size_t buf_len = Buffer::Length(args[0]);
   char* buf = Buffer::Data(args[0]);
 
+  if (args[3]->IsFunction()) {
+    SignRequest* req =
+        new SignRequest(env,
+                        NewRequestObject(env, args[3]),
+                        SignRequest::kSign,
+                        buf,
+                        buf_len,
+                        len >= 3 && !args[2]->IsNull() ? *passphrase : NULL,
+                        1);
+    Error err = sign->Detach(req->context(0));
+    if (err != kSignOk) {
+      delete req;
+      return sign->CheckThrow(err);
+    }
+    return req->Queue();
+  }
+
   md_len = 8192;  // Maximum key size is 8192 bits
   md_value = new unsigned char[md_len];
 
@@ -3512,44 +4425,13 @@ SignBase::Error Verify::VerifyFinal(const char* key_pem,
   ClearErrorOnReturn clear_error_on_return;
   (void) &clear_error_on_return;  // Silence compiler warning.
 
-  EVP_PKEY* pkey = NULL;
-  BIO* bp = NULL;
-  X509* x509 = NULL;
   bool fatal = true;
   int r = 0;
 
-  bp = BIO_new_mem_buf(const_cast<char*>(key_pem), key_pem_len);
-  if (bp == NULL)
+  EVP_PKEY* pkey = LoadPublicKey(key_pem, key_pem_len);
+  if (pkey == NULL)
     goto exit;
 
-  // Check if this is a PKCS#8 or RSA public key before trying as X.509.
-  // Split this out into a separate function once we have more than one
-  // consumer of public keys.
-  if (strncmp(key_pem, PUBLIC_KEY_PFX, PUBLIC_KEY_PFX_LEN) == 0) {
-    pkey = PEM_read_bio_PUBKEY(bp, NULL, CryptoPemCallback, NULL);
-    if (pkey == NULL)
-      goto exit;
-  } else if (strncmp(key_pem, PUBRSA_KEY_PFX, PUBRSA_KEY_PFX_LEN) == 0) {
-    RSA* rsa = PEM_read_bio_RSAPublicKey(bp, NULL, CryptoPemCallback, NULL);
-    if (rsa) {
-      pkey = EVP_PKEY_new();
-      if (pkey)
-        EVP_PKEY_set1_RSA(pkey, rsa);
-      RSA_free(rsa);
-    }
-    if (pkey == NULL)
-      goto exit;
-  } else {
-    // X.509 fallback
-    x509 = PEM_read_bio_X509(bp, NULL, CryptoPemCallback, NULL);
-    if (x509 == NULL)
-      goto exit;
-
-    pkey = X509_get_pubkey(x509);
-    if (pkey == NULL)
-      goto exit;
-  }
-
   fatal = false;
   r = EVP_VerifyFinal(&mdctx_,
                       reinterpret_cast<const unsigned char*>(sig),
@@ -3559,10 +4441,6 @@ SignBase::Error Verify::VerifyFinal(const char* key_pem,
  exit:
   if (pkey != NULL)
     EVP_PKEY_free(pkey);
-  if (bp != NULL)
-    BIO_free_all(bp);
-  if (x509 != NULL)
-    X509_free(x509);
 
   EVP_MD_CTX_cleanup(&mdctx_);
   initialised_ = false;
@@ -3608,6 +4486,25 @@ void Verify::VerifyFinal(const FunctionCallbackInfo<Value>& args) {
     hbuf = Buffer::Data(args[1]);
   }
 
+  if (args[3]->IsFunction()) {
+    SignRequest* req = new SignRequest(env,
+                                       NewRequestObject(env, args[3]),
+                                       SignRequest::kVerify,
+                                       kbuf,
+                                       klen,
+                                       NULL,
+                                       1);
+    req->set_signature(hbuf, hlen);
+    if (args[1]->IsString())
+      delete[] hbuf;
+    Error err = verify->Detach(req->context(0));
+    if (err != kSignOk) {
+      delete req;
+      return verify->CheckThrow(err);
+    }
+    return req->Queue();
+  }
+
   bool verify_result;
   Error err = verify->VerifyFinal(kbuf, klen, hbuf, hlen, &verify_result);
   if (args[1]->IsString())
@@ -3618,6 +4515,56 @@ void Verify::VerifyFinal(const FunctionCallbackInfo<Value>& args) {
 }
 
 
+// signBatch(algorithm, key, passphrase, payloads, ondone)
+// Signs every buffer in payloads with the same key in a single thread pool
+// job, ondone gets an array with the signatures in the same order.
+void SignBatch(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args.GetIsolate());
+  HandleScope scope(env->isolate());
+
+  CHECK(args[0]->IsString());
+  ASSERT_IS_BUFFER(args[1]);
+  CHECK(args[3]->IsArray());
+  CHECK(args[4]->IsFunction());
+
+  const node::Utf8Value algorithm(args[0]);
+  const EVP_MD* md = EVP_get_digestbyname(*algorithm);
+  if (md == NULL)
+    return env->ThrowError("Unknown message digest");
+
+  Local<Array> payloads = args[3].As<Array>();
+  uint32_t count = payloads->Length();
+  for (uint32_t i = 0; i < count; i++) {
+    if (!Buffer::HasInstance(payloads->Get(i)))
+      return env->ThrowTypeError("Payloads must be buffers");
+  }
+
+  const node::Utf8Value passphrase(args[2]);
+  SignRequest* req =
+      new SignRequest(env,
+                      NewRequestObject(env, args[4]),
+                      SignRequest::kSign,
+                      Buffer::Data(args[1]),
+                      Buffer::Length(args[1]),
+                      args[2]->IsString() ? *passphrase : NULL,
+                      count);
+
+  for (uint32_t i = 0; i < count; i++) {
+    Local<Value> payload = payloads->Get(i);
+    EVP_MD_CTX* ctx = req->context(i);
+    if (!EVP_SignInit_ex(ctx, md, NULL) ||
+        !EVP_SignUpdate(ctx, Buffer::Data(payload), Buffer::Length(payload))) {
+      delete req;
+      return ThrowCryptoError(env,
+                              ERR_get_error(),
+                              SignErrorMessage(SignBase::kSignUpdate));
+    }
+  }
+
+  req->Queue();
+}
+
+
 template <PublicKeyCipher::Operation operation,
           PublicKeyCipher::EVP_PKEY_cipher_init_t EVP_PKEY_cipher_init,
           PublicKeyCipher::EVP_PKEY_cipher_t EVP_PKEY_cipher>
@@ -4017,6 +4964,159 @@ void DiffieHellman::GetPrivateKey(const FunctionCallbackInfo<Value>& args) {
 }
 
 
+// Computes the shared secret into |data|, which has room for DH_size(dh)
+// bytes. Returns NULL or the reason it failed. Runs on the thread pool too,
+// so it must not touch V8.
+static const char* ComputeDHSecret(DH* dh, BIGNUM* key, char* data) {
+  int dataSize = DH_size(dh);
+  int size = DH_compute_key(reinterpret_cast<unsigned char*>(data), key, dh);
+
+  if (size == -1) {
+    int checkResult;
+    int checked;
+
+    checked = DH_check_pub_key(dh, key, &checkResult);
+
+    if (!checked) {
+      return "Invalid key";
+    } else if (checkResult) {
+      if (checkResult & DH_CHECK_PUBKEY_TOO_SMALL) {
+        return "Supplied key is too small";
+      } else if (checkResult & DH_CHECK_PUBKEY_TOO_LARGE) {
+        return "Supplied key is too large";
+      } else {
+        return "Invalid key";
+      }
+    } else {
+      return "Invalid key";
+    }
+  }
+
+  assert(size >= 0);
+
+  // DH_size returns number of bytes in a prime number
+  // DH_compute_key returns number of bytes in a remainder of exponent, which
+  // may have less bytes than a prime number. Therefore add 0-padding to the
+  // allocated buffer.
+  if (size != dataSize) {
+    assert(dataSize > size);
+    memmove(data + dataSize - size, data, size);
+    memset(data, 0, dataSize - size);
+  }
+
+  return NULL;
+}
+
+
+// Computes a DH or ECDH shared secret on the thread pool. The request works
+// on its own copy of the key pair so that the DiffieHellman or ECDH object
+// can be used, changed or collected in the meantime.
+class ComputeSecretRequest : public AsyncWrap {
+ public:
+  ComputeSecretRequest(Environment* env,
+                       Local<Object> object,
+                       DH* dh,
+                       BIGNUM* key)
+      : AsyncWrap(env, object, AsyncWrap::PROVIDER_CRYPTO),
+        dh_(dh),
+        key_(key),
+        ec_key_(NULL),
+        point_(NULL),
+        secret_len_(DH_size(dh)),
+        secret_(static_cast<char*>(malloc(secret_len_))),
+        error_(NULL) {
+    CHECK_NE(secret_, NULL);
+  }
+
+  ComputeSecretRequest(Environment* env,
+                       Local<Object> object,
+                       EC_KEY* ec_key,
+                       EC_POINT* point)
+      : AsyncWrap(env, object, AsyncWrap::PROVIDER_CRYPTO),
+        dh_(NULL),
+        key_(NULL),
+        ec_key_(ec_key),
+        point_(point),
+        // NOTE: field_size is in bits
+        secret_len_(
+            (EC_GROUP_get_degree(EC_KEY_get0_group(ec_key)) + 7) / 8),
+        secret_(static_cast<char*>(malloc(secret_len_))),
+        error_(NULL) {
+    CHECK_NE(secret_, NULL);
+  }
+
+  ~ComputeSecretRequest() {
+    if (dh_ != NULL)
+      DH_free(dh_);
+    if (key_ != NULL)
+      BN_free(key_);
+    if (point_ != NULL)
+      EC_POINT_free(point_);
+    if (ec_key_ != NULL)
+      EC_KEY_free(ec_key_);
+    free(secret_);
+    persistent().Reset();
+  }
+
+  void Queue() {
+    uv_queue_work(env()->event_loop(), &work_req_, Work, After);
+  }
+
+ private:
+  static void Work(uv_work_t* work_req);
+  static void After(uv_work_t* work_req, int status);
+
+  uv_work_t work_req_;
+  DH* dh_;
+  BIGNUM* key_;
+  EC_KEY* ec_key_;
+  EC_POINT* point_;
+  size_t secret_len_;
+  char* secret_;  // Handed to the Buffer on success.
+  const char* error_;
+};
+
+
+void ComputeSecretRequest::Work(uv_work_t* work_req) {
+  ComputeSecretRequest* req =
+      ContainerOf(&ComputeSecretRequest::work_req_, work_req);
+
+  if (req->dh_ != NULL) {
+    req->error_ = ComputeDHSecret(req->dh_, req->key_, req->secret_);
+  } else if (!ECDH_compute_key(req->secret_,
+                               req->secret_len_,
+                               req->point_,
+                               req->ec_key_,
+                               NULL)) {
+    req->error_ = "Failed to compute ECDH key";
+  }
+  ERR_clear_error();
+}
+
+
+void ComputeSecretRequest::After(uv_work_t* work_req, int status) {
+  assert(status == 0);
+  ComputeSecretRequest* req =
+      ContainerOf(&ComputeSecretRequest::work_req_, work_req);
+  Environment* env = req->env();
+  HandleScope handle_scope(env->isolate());
+  Context::Scope context_scope(env->context());
+
+  Local<Value> argv[2];
+  if (req->error_ != NULL) {
+    argv[0] = Exception::Error(OneByteString(env->isolate(), req->error_));
+    argv[1] = Undefined(env->isolate());
+  } else {
+    argv[0] = Null(env->isolate());
+    argv[1] = Buffer::Use(env, req->secret_, req->secret_len_);
+    req->secret_ = NULL;
+  }
+
+  req->MakeCallback(env->ondone_string(), ARRAY_SIZE(argv), argv);
+  delete req;
+}
+
+
 void DiffieHellman::ComputeSecret(const FunctionCallbackInfo<Value>& args) {
   Environment* env = Environment::GetCurrent(args.GetIsolate());
   HandleScope scope(env->isolate());
@@ -4041,47 +5141,31 @@ void DiffieHellman::ComputeSecret(const FunctionCallbackInfo<Value>& args) {
         0);
   }
 
-  int dataSize = DH_size(diffieHellman->dh);
-  char* data = new char[dataSize];
-
-  int size = DH_compute_key(reinterpret_cast<unsigned char*>(data),
-                            key,
-                            diffieHellman->dh);
-
-  if (size == -1) {
-    int checkResult;
-    int checked;
-
-    checked = DH_check_pub_key(diffieHellman->dh, key, &checkResult);
-    BN_free(key);
-    delete[] data;
-
-    if (!checked) {
-      return env->ThrowError("Invalid key");
-    } else if (checkResult) {
-      if (checkResult & DH_CHECK_PUBKEY_TOO_SMALL) {
-        return env->ThrowError("Supplied key is too small");
-      } else if (checkResult & DH_CHECK_PUBKEY_TOO_LARGE) {
-        return env->ThrowError("Supplied key is too large");
-      } else {
-        return env->ThrowError("Invalid key");
-      }
-    } else {
-      return env->ThrowError("Invalid key");
+  if (args[1]->IsFunction()) {
+    BIGNUM* priv_key = diffieHellman->dh->priv_key;
+    DH* dh = DHparams_dup(diffieHellman->dh);
+    if (dh != NULL && priv_key != NULL)
+      dh->priv_key = BN_dup(priv_key);
+    if (dh == NULL || (priv_key != NULL && dh->priv_key == NULL)) {
+      if (dh != NULL)
+        DH_free(dh);
+      BN_free(key);
+      return env->ThrowError("Failed to copy the DH key");
     }
+    ComputeSecretRequest* req =
+        new ComputeSecretRequest(env, NewRequestObject(env, args[1]), dh, key);
+    return req->Queue();
   }
 
+  int dataSize = DH_size(diffieHellman->dh);
+  char* data = new char[dataSize];
+
+  const char* error = ComputeDHSecret(diffieHellman->dh, key, data);
   BN_free(key);
-  assert(size >= 0);
 
-  // DH_size returns number of bytes in a prime number
-  // DH_compute_key returns number of bytes in a remainder of exponent, which
-  // may have less bytes than a prime number. Therefore add 0-padding to the
-  // allocated buffer.
-  if (size != dataSize) {
-    assert(dataSize > size);
-    memmove(data + dataSize - size, data, size);
-    memset(data, 0, dataSize - size);
+  if (error != NULL) {
+    delete[] data;
+    return env->ThrowError(error);
   }
 
   args.GetReturnValue().Set(Encode(env->isolate(), data, dataSize, BUFFER));
@@ -4248,6 +5332,17 @@ void ECDH::ComputeSecret(const FunctionCallbackInfo<Value>& args) {
   if (pub == NULL)
     return;
 
+  if (args[1]->IsFunction()) {
+    EC_KEY* key = EC_KEY_dup(ecdh->key_);
+    if (key == NULL) {
+      EC_POINT_free(pub);
+      return env->ThrowError("Failed to copy the ECDH key");
+    }
+    ComputeSecretRequest* req =
+        new ComputeSecretRequest(env, NewRequestObject(env, args[1]), key, pub);
+    return req->Queue();
+  }
+
   // NOTE: field_size is in bits
   int field_size = EC_GROUP_get_degree(ecdh->group_);
   size_t out_len = (field_size + 7) / 8;
@@ -4636,6 +5731,145 @@ void PBKDF2(const FunctionCallbackInfo<Value>& args) {
 }
 
 
+// Pre-generated random bytes that serve small synchronous randomBytes() and
+// pseudoRandomBytes() calls straight from memory. Once less than kLowWater
+// bytes are left, a new batch is generated on the thread pool and replaces
+// the pool when it's done. A request that finds the pool dry - it starts out
+// empty, and a tight loop never gives the refill a chance to land - refills
+// it synchronously instead. The bytes come from RAND_bytes(), so they're
+// good enough for both functions.
+class RandomPool {
+ public:
+  static const size_t kSize = 16 * 1024;
+  static const size_t kLowWater = 4 * 1024;
+  static const size_t kMaxRequest = 256;  // Larger requests bypass the pool.
+
+  struct Stats {
+    uint64_t available;
+    uint64_t hits;
+    uint64_t refills;
+    uint64_t fallbacks;
+  };
+
+  explicit RandomPool(uv_loop_t* loop)
+      : loop_(loop),
+        data_(new unsigned char[kSize]),
+        available_(0),
+        refill_(NULL),
+        hits_(0),
+        refills_(0),
+        fallbacks_(0) {
+  }
+
+  ~RandomPool() {
+    // A refill in flight owns its buffer, it gets leaked rather than freed
+    // under the worker's feet.
+    Clear();
+    delete[] data_;
+  }
+
+  // Copies |size| random bytes to |out|. Returns false if the pool can't
+  // serve the request, the caller should generate the bytes itself then.
+  bool Take(char* out, size_t size) {
+    if (size > kMaxRequest)
+      return false;
+
+    if (size > available_) {
+      fallbacks_++;
+      CheckEntropy();
+      if (RAND_bytes(data_, kSize) != 1) {
+        ERR_clear_error();
+        return false;
+      }
+      available_ = kSize;
+    }
+
+    // Hand out bytes from the end and wipe them, they're used up.
+    available_ -= size;
+    memcpy(out, data_ + available_, size);
+    memset(data_ + available_, 0, size);
+    hits_++;
+
+    if (available_ < kLowWater)
+      Refill();
+    return true;
+  }
+
+  // Drops the bytes on hand, including those of a refill in flight. For
+  // when another engine takes over random number generation.
+  void Clear() {
+    memset(data_, 0, available_);
+    available_ = 0;
+    if (refill_ != NULL) {
+      refill_->pool = NULL;
+      refill_ = NULL;
+    }
+  }
+
+  void GetStats(Stats* stats) const {
+    stats->available = available_;
+    stats->hits = hits_;
+    stats->refills = refills_;
+    stats->fallbacks = fallbacks_;
+  }
+
+ private:
+  struct RefillRequest {
+    uv_work_t work_req;
+    RandomPool* pool;
+    unsigned char data[kSize];
+    bool ok;
+  };
+
+  void Refill() {
+    if (refill_ != NULL)
+      return;
+    refill_ = new RefillRequest;
+    refill_->pool = this;
+    uv_queue_work(loop_, &refill_->work_req, RefillWork, RefillAfter);
+  }
+
+  static void RefillWork(uv_work_t* work_req) {
+    RefillRequest* req = ContainerOf(&RefillRequest::work_req, work_req);
+    CheckEntropy();
+    req->ok = RAND_bytes(req->data, kSize) == 1;
+    ERR_clear_error();
+  }
+
+  static void RefillAfter(uv_work_t* work_req, int status) {
+    RefillRequest* req = ContainerOf(&RefillRequest::work_req, work_req);
+    RandomPool* pool = req->pool;
+    if (pool != NULL) {
+      pool->refill_ = NULL;
+      if (status == 0 && req->ok) {
+        memcpy(pool->data_, req->data, kSize);
+        pool->available_ = kSize;
+        pool->refills_++;
+      }
+    }
+    memset(req->data, 0, kSize);
+    delete req;
+  }
+
+  uv_loop_t* const loop_;
+  unsigned char* const data_;
+  size_t available_;
+  RefillRequest* refill_;
+  uint64_t hits_;
+  uint64_t refills_;
+  uint64_t fallbacks_;
+
+  DISALLOW_COPY_AND_ASSIGN(RandomPool);
+};
+
+
+static void DeleteRandomPool(void* arg) {
+  Environment* env = static_cast<Environment*>(arg);
+  delete env->random_pool();
+  env->set_random_pool(NULL);
+}
+
+
 // Only instantiate within a valid HandleScope.
 class RandomBytesRequest : public AsyncWrap {
  public:
@@ -4770,6 +6004,14 @@ void RandomBytes(const FunctionCallbackInfo<Value>& args) {
     return env->ThrowTypeError("size > Buffer::kMaxLength");
   }
 
+  // Small synchronous requests come straight from the pool, without the
+  // overhead of a request object.
+  if (!args[1]->IsFunction()) {
+    char data[RandomPool::kMaxRequest];
+    if (env->random_pool()->Take(data, size))
+      return args.GetReturnValue().Set(Buffer::New(env, data, size));
+  }
+
   Local<Object> obj = Object::New(env->isolate());
   RandomBytesRequest* req = new RandomBytesRequest(env, obj, size);
 
@@ -4797,6 +6039,233 @@ void RandomBytes(const FunctionCallbackInfo<Value>& args) {
 }
 
 
+// Hashes a buffer or a range of a file on the thread pool. The data is fed
+// to all requested digests in chunks of kChunkSize bytes, one work request
+// per chunk, so that a large input doesn't hold on to a thread pool slot
+// and JS gets to see the progress in between.
+class DigestRequest : public AsyncWrap {
+ public:
+  static const int kMaxDigests = 8;
+  static const size_t kChunkSize = 1024 * 1024;
+
+  DigestRequest(Environment* env,
+                Local<Object> object,
+                const EVP_MD** digests,
+                int count,
+                const char* data,
+                int fd,
+                int64_t offset,
+                int64_t length)
+      : AsyncWrap(env, object, AsyncWrap::PROVIDER_CRYPTO),
+        count_(count),
+        data_(data),
+        fd_(fd),
+        offset_(offset),
+        remaining_(length),
+        chunk_(NULL),
+        error_(0),
+        done_(length == 0),
+        bytes_(0),
+        started_at_(uv_hrtime()) {
+    for (int i = 0; i < count_; i++) {
+      EVP_MD_CTX_init(&ctx_[i]);
+      EVP_DigestInit_ex(&ctx_[i], digests[i], NULL);
+    }
+    if (fd_ != -1)
+      chunk_ = new char[kChunkSize];
+  }
+
+  ~DigestRequest() {
+    for (int i = 0; i < count_; i++)
+      EVP_MD_CTX_cleanup(&ctx_[i]);
+    delete[] chunk_;
+    persistent().Reset();
+  }
+
+  void Queue() {
+    uv_queue_work(env()->event_loop(), &work_req_, Work, After);
+  }
+
+ private:
+  static void Work(uv_work_t* work_req);
+  static void After(uv_work_t* work_req, int status);
+  Local<Object> Stats();
+
+  uv_work_t work_req_;
+  EVP_MD_CTX ctx_[kMaxDigests];
+  const int count_;
+  const char* data_;  // Kept alive by object()
+  const int fd_;
+  int64_t offset_;
+  int64_t remaining_;  // -1 reads a file up to its end.
+  char* chunk_;
+  int error_;
+  bool done_;
+  uint64_t bytes_;
+  const uint64_t started_at_;
+};
+
+
+void DigestRequest::Work(uv_work_t* work_req) {
+  DigestRequest* req = ContainerOf(&DigestRequest::work_req_, work_req);
+  if (req->done_)
+    return;
+
+  size_t size = kChunkSize;
+  if (req->remaining_ >= 0 && static_cast<uint64_t>(req->remaining_) < size)
+    size = req->remaining_;
+
+  const char* data;
+  if (req->fd_ == -1) {
+    data = req->data_ + req->offset_;
+  } else {
+    // Not uv_fs_read(), that registers the request with the loop.
+#if defined(_WIN32)
+    req->error_ = UV_ENOSYS;
+    return;
+#else
+    ssize_t r;
+    do {
+      r = pread(req->fd_, req->chunk_, size, req->offset_);
+    } while (r == -1 && errno == EINTR);
+    if (r == -1) {
+      req->error_ = -errno;
+      return;
+    }
+#endif  // defined(_WIN32)
+    if (r == 0) {
+      req->done_ = true;
+      return;
+    }
+    data = req->chunk_;
+    size = r;
+  }
+
+  for (int i = 0; i < req->count_; i++)
+    EVP_DigestUpdate(&req->ctx_[i], data, size);
+
+  req->offset_ += size;
+  req->bytes_ += size;
+  if (req->remaining_ >= 0) {
+    req->remaining_ -= size;
+    req->done_ = req->remaining_ == 0;
+  }
+}
+
+
+// Only call within a valid HandleScope.
+Local<Object> DigestRequest::Stats() {
+  double elapsed = static_cast<double>(uv_hrtime() - started_at_) / 1e6;
+  Local<Object> stats = Object::New(env()->isolate());
+  stats->Set(env()->bytes_string(),
+             Number::New(env()->isolate(), static_cast<double>(bytes_)));
+  stats->Set(env()->time_string(), Number::New(env()->isolate(), elapsed));
+  return stats;
+}
+
+
+void DigestRequest::After(uv_work_t* work_req, int status) {
+  assert(status == 0);
+  DigestRequest* req = ContainerOf(&DigestRequest::work_req_, work_req);
+  Environment* env = req->env();
+  HandleScope handle_scope(env->isolate());
+  Context::Scope context_scope(env->context());
+
+  if (req->error_ == 0 && !req->done_) {
+    Local<Value> callback = req->object()->Get(env->onprogress_string());
+    if (callback->IsFunction()) {
+      Local<Value> arg = req->Stats();
+      req->MakeCallback(callback.As<Function>(), 1, &arg);
+    }
+    return req->Queue();
+  }
+
+  Local<Value> argv[3];
+  if (req->error_ != 0) {
+    argv[0] = UVException(env->isolate(), req->error_, "read");
+    argv[1] = Undefined(env->isolate());
+  } else {
+    Local<Array> digests = Array::New(env->isolate(), req->count_);
+    for (int i = 0; i < req->count_; i++) {
+      unsigned char md_value[EVP_MAX_MD_SIZE];
+      unsigned int md_len;
+      EVP_DigestFinal_ex(&req->ctx_[i], md_value, &md_len);
+      digests->Set(i, Buffer::New(env,
+                                  reinterpret_cast<const char*>(md_value),
+                                  md_len));
+    }
+    argv[0] = Null(env->isolate());
+    argv[1] = digests;
+  }
+  argv[2] = req->Stats();
+
+  req->MakeCallback(env->ondone_string(), ARRAY_SIZE(argv), argv);
+  delete req;
+}
+
+
+// digest(algorithms, source, offset, length, onprogress, ondone)
+// source is a buffer or a file descriptor, length -1 hashes a file up to
+// its end.
+void Digest(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args.GetIsolate());
+  HandleScope scope(env->isolate());
+
+  CHECK(args[0]->IsArray());
+  CHECK(args[2]->IsNumber());
+  CHECK(args[3]->IsNumber());
+  CHECK(args[5]->IsFunction());
+
+  Local<Array> names = args[0].As<Array>();
+  if (names->Length() == 0 ||
+      names->Length() > static_cast<uint32_t>(DigestRequest::kMaxDigests)) {
+    return env->ThrowTypeError("Bad number of digest algorithms");
+  }
+
+  const EVP_MD* digests[DigestRequest::kMaxDigests];
+  int count = names->Length();
+  for (int i = 0; i < count; i++) {
+    digests[i] = GetDigestByName(names->Get(i));
+    if (digests[i] == NULL)
+      return env->ThrowError("Digest method not supported");
+  }
+
+  int64_t offset = args[2]->IntegerValue();
+  int64_t length = args[3]->IntegerValue();
+
+  const char* data = NULL;
+  int fd = -1;
+  if (Buffer::HasInstance(args[1])) {
+    size_t buffer_length = Buffer::Length(args[1]);
+    if (offset < 0 ||
+        length < 0 ||
+        static_cast<uint64_t>(offset) > buffer_length ||
+        static_cast<uint64_t>(length) > buffer_length - offset) {
+      return env->ThrowRangeError("Out of range");
+    }
+    data = Buffer::Data(args[1]);
+  } else if (args[1]->IsInt32() && args[1]->Int32Value() >= 0) {
+    if (offset < 0 || length < -1)
+      return env->ThrowRangeError("Out of range");
+    fd = args[1]->Int32Value();
+  } else {
+    return env->ThrowTypeError("Not a buffer or file descriptor");
+  }
+
+  Local<Object> obj = Object::New(env->isolate());
+  obj->Set(env->buffer_string(), args[1]);
+  obj->Set(env->onprogress_string(), args[4]);
+  obj->Set(env->ondone_string(), args[5]);
+  // XXX(trevnorris): This will need to go with the rest of domains.
+  if (env->in_domain())
+    obj->Set(env->domain_string(), env->domain_array()->Get(0));
+
+  DigestRequest* req =
+      new DigestRequest(env, obj, digests, count, data, fd, offset, length);
+  req->Queue();
+}
+
+
 void GetSSLCiphers(const FunctionCallbackInfo<Value>& args) {
   Environment* env = Environment::GetCurrent(args.GetIsolate());
   HandleScope scope(env->isolate());
@@ -4891,6 +6360,48 @@ void GetHashes(const FunctionCallbackInfo<Value>& args) {
 }
 
 
+void GetRandomPoolStats(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args.GetIsolate());
+  HandleScope scope(env->isolate());
+
+  RandomPool::Stats stats;
+  env->random_pool()->GetStats(&stats);
+
+  Local<Object> info = Object::New(env->isolate());
+  info->Set(env->size_string(),
+            Number::New(env->isolate(), RandomPool::kSize));
+  info->Set(env->available_string(),
+            Number::New(env->isolate(), static_cast<double>(stats.available)));
+  info->Set(env->hits_string(),
+            Number::New(env->isolate(), static_cast<double>(stats.hits)));
+  info->Set(env->refills_string(),
+            Number::New(env->isolate(), static_cast<double>(stats.refills)));
+  info->Set(env->fallbacks_string(),
+            Number::New(env->isolate(), static_cast<double>(stats.fallbacks)));
+  args.GetReturnValue().Set(info);
+}
+
+
+void GetBufferPoolStats(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args.GetIsolate());
+  HandleScope scope(env->isolate());
+
+  NodeBIO::PoolStats stats;
+  NodeBIO::GetPoolStats(&stats);
+
+  Local<Object> info = Object::New(env->isolate());
+  info->Set(env->live_string(),
+            Number::New(env->isolate(), static_cast<double>(stats.live)));
+  info->Set(env->pooled_string(),
+            Number::New(env->isolate(), static_cast<double>(stats.pooled)));
+  info->Set(env->hits_string(),
+            Number::New(env->isolate(), static_cast<double>(stats.hits)));
+  info->Set(env->misses_string(),
+            Number::New(env->isolate(), static_cast<double>(stats.misses)));
+  args.GetReturnValue().Set(info);
+}
+
+
 void Certificate::Initialize(Environment* env, Handle<Object> target) {
   HandleScope scope(env->isolate());
 
@@ -5089,6 +6600,9 @@ void InitCryptoOnce() {
   CRYPTO_set_locking_callback(crypto_lock_cb);
   CRYPTO_THREADID_set_callback(crypto_threadid_cb);
 
+  EVP_MD_CTX_init(&one_shot_md_ctx);
+  HMAC_CTX_init(&one_shot_hmac_ctx);
+
   // Turn off compression. Saves memory and protects against CRIME attacks.
 #if !defined(OPENSSL_NO_COMP)
 #if OPENSSL_VERSION_NUMBER < 0x00908000L
@@ -5146,6 +6660,9 @@ void SetEngine(const FunctionCallbackInfo<Value>& args) {
   ENGINE_free(engine);
   if (r == 0)
     return ThrowCryptoError(env, ERR_get_error());
+
+  if (flags & ENGINE_METHOD_RAND)
+    env->random_pool()->Clear();
 }
 #endif  // !OPENSSL_NO_ENGINE
 
@@ -5170,15 +6687,24 @@ void InitCrypto(Handle<Object> target,
   Verify::Initialize(env, target);
   Certificate::Initialize(env, target);
 
+  if (env->random_pool() == NULL) {
+    env->set_random_pool(new RandomPool(env->event_loop()));
+    AtExit(DeleteRandomPool, env);
+  }
+
 #ifndef OPENSSL_NO_ENGINE
   NODE_SET_METHOD(target, "setEngine", SetEngine);
 #endif  // !OPENSSL_NO_ENGINE
   NODE_SET_METHOD(target, "PBKDF2", PBKDF2);
   NODE_SET_METHOD(target, "randomBytes", RandomBytes<false>);
   NODE_SET_METHOD(target, "pseudoRandomBytes", RandomBytes<true>);
+  NODE_SET_METHOD(target, "digest", Digest);
+  NODE_SET_METHOD(target, "signBatch", SignBatch);
   NODE_SET_METHOD(target, "getSSLCiphers", GetSSLCiphers);
   NODE_SET_METHOD(target, "getCiphers", GetCiphers);
   NODE_SET_METHOD(target, "getHashes", GetHashes);
+  NODE_SET_METHOD(target, "getBufferPoolStats", GetBufferPoolStats);
+  NODE_SET_METHOD(target, "getRandomPoolStats", GetRandomPoolStats);
   NODE_SET_METHOD(target,
                   "publicEncrypt",
                   PublicKeyCipher::Cipher<PublicKeyCipher::kEncrypt,
@@ -25,6 +25,8 @@
 #include "node.h"
 #include "node_crypto_clienthello.h"  // ClientHelloParser
 #include "node_crypto_clienthello-inl.h"
+#include "node_crypto_session_cache.h"  // SessionCache
+#include "node_crypto_ticket_keys.h"  // TicketKeyRing
 
 #ifdef OPENSSL_NPN_NEGOTIATED
 #include "node_buffer.h"
@@ -119,6 +121,8 @@ class SecureContext : public BaseObject {
  public:
   ~SecureContext() {
     FreeCTXMem();
+    delete ticket_keys_;
+    ticket_keys_ = NULL;
   }
 
   static void Initialize(Environment* env, v8::Handle<v8::Object> target);
@@ -127,6 +131,9 @@ class SecureContext : public BaseObject {
   SSL_CTX* ctx_;
   X509* cert_;
   X509* issuer_;
+  SessionCache* session_cache_;
+  TicketKeyRing* ticket_keys_;
+  bool used_;  // Set once a connection has been created with the context.
 
   static const int kMaxSessionSize = 10 * 1024;
 
@@ -147,22 +154,40 @@ class SecureContext : public BaseObject {
       const v8::FunctionCallbackInfo<v8::Value>& args);
   static void SetSessionTimeout(
       const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void SetSessionCache(
+      const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void GetSessionCacheStats(
+      const v8::FunctionCallbackInfo<v8::Value>& args);
   static void Close(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void LoadPKCS12(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void GetTicketKeys(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void SetTicketKeys(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void GetTicketKeyStats(
+      const v8::FunctionCallbackInfo<v8::Value>& args);
   static void CtxGetter(v8::Local<v8::String> property,
                         const v8::PropertyCallbackInfo<v8::Value>& info);
 
   template <bool primary>
   static void GetCertificate(const v8::FunctionCallbackInfo<v8::Value>& args);
 
+#if !defined(OPENSSL_NO_TLSEXT) && defined(SSL_CTX_set_tlsext_ticket_key_cb)
+  static int TicketKeyCallback(SSL* ssl,
+                               unsigned char* name,
+                               unsigned char* iv,
+                               EVP_CIPHER_CTX* ectx,
+                               HMAC_CTX* hctx,
+                               int enc);
+#endif  // !def(OPENSSL_NO_TLSEXT) && def(SSL_CTX_set_tlsext_ticket_key_cb)
+
   SecureContext(Environment* env, v8::Local<v8::Object> wrap)
       : BaseObject(env, wrap),
         ca_store_(NULL),
         ctx_(NULL),
         cert_(NULL),
-        issuer_(NULL) {
+        issuer_(NULL),
+        session_cache_(NULL),
+        ticket_keys_(NULL),
+        used_(false) {
     MakeWeak<SecureContext>(this);
   }
 
@@ -187,6 +212,8 @@ class SecureContext : public BaseObject {
     } else {
       assert(ca_store_ == NULL);
     }
+    delete session_cache_;
+    session_cache_ = NULL;
   }
 };
 
@@ -205,9 +232,11 @@ class SSLWrap {
         kind_(kind),
         next_sess_(NULL),
         session_callbacks_(false),
-        new_session_wait_(false) {
+        new_session_wait_(false),
+        handshake_queued_(false) {
     ssl_ = SSL_new(sc->ctx_);
     assert(ssl_ != NULL);
+    sc->used_ = true;
   }
 
   ~SSLWrap() {
@@ -298,6 +327,9 @@ class SSLWrap {
   SSL* ssl_;
   bool session_callbacks_;
   bool new_session_wait_;
+  // Set while TLSCallbacks runs a handshake step on the thread pool. The
+  // JS accessors leave ssl_ alone until it's done.
+  bool handshake_queued_;
   ClientHelloParser hello_parser_;
 
 #ifdef NODE__HAVE_TLSEXT_STATUS_CB
@@ -429,8 +461,14 @@ class CipherBase : public BaseObject {
               const char* iv,
               int iv_len);
   bool Update(const char* data, int len, unsigned char** out, int* out_len);
+  // Like Update() but writes to |out|, which has room for MaxUpdateSize(len)
+  // bytes. Doesn't touch V8, updateInto() calls it on the thread pool.
+  bool UpdateInto(const char* data, int len, unsigned char* out, int* out_len);
+  int MaxUpdateSize(int len) const;
   bool Final(unsigned char** out, int *out_len);
+  bool FinalInto(unsigned char* out, int* out_len);
   bool SetAutoPadding(bool auto_padding);
+  bool CheckBusy();
 
   bool IsAuthenticatedMode() const;
   bool GetAuthTag(char** out, unsigned int* out_len) const;
@@ -441,7 +479,9 @@ class CipherBase : public BaseObject {
   static void Init(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void InitIv(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void Update(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void UpdateInto(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void Final(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void FinalInto(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void SetAutoPadding(const v8::FunctionCallbackInfo<v8::Value>& args);
 
   static void GetAuthTag(const v8::FunctionCallbackInfo<v8::Value>& args);
@@ -456,7 +496,8 @@ class CipherBase : public BaseObject {
         initialised_(false),
         kind_(kind),
         auth_tag_(NULL),
-        auth_tag_len_(0) {
+        auth_tag_len_(0),
+        busy_(false) {
     MakeWeak<CipherBase>(this);
   }
 
@@ -467,6 +508,9 @@ class CipherBase : public BaseObject {
   CipherKind kind_;
   char* auth_tag_;
   unsigned int auth_tag_len_;
+  bool busy_;  // An asynchronous updateInto() owns ctx_.
+
+  friend class CipherUpdateRequest;
 };
 
 class Hmac : public BaseObject {
@@ -483,11 +527,14 @@ class Hmac : public BaseObject {
   void HmacInit(const char* hash_type, const char* key, int key_len);
   bool HmacUpdate(const char* data, int len);
   bool HmacDigest(unsigned char** md_value, unsigned int* md_len);
+  bool HmacDigestInto(unsigned char* md_value, unsigned int* md_len);
 
   static void New(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void HmacInit(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void HmacUpdate(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void HmacDigest(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void HmacDigestInto(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void OneShot(const v8::FunctionCallbackInfo<v8::Value>& args);
 
   Hmac(Environment* env, v8::Local<v8::Object> wrap)
       : BaseObject(env, wrap),
@@ -519,6 +566,8 @@ class Hash : public BaseObject {
   static void New(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void HashUpdate(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void HashDigest(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void HashDigestInto(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void OneShot(const v8::FunctionCallbackInfo<v8::Value>& args);
 
   Hash(Environment* env, v8::Local<v8::Object> wrap)
       : BaseObject(env, wrap),
@@ -557,6 +606,11 @@ class SignBase : public BaseObject {
     EVP_MD_CTX_cleanup(&mdctx_);
   }
 
+  // Copies the digest state into |ctx| for finishing elsewhere - on the
+  // thread pool - and leaves this object uninitialised, as sign() and
+  // verify() do.
+  Error Detach(EVP_MD_CTX* ctx);
+
  protected:
   void CheckThrow(Error error);
 
@@ -20,11 +20,39 @@
 // USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "node_crypto_bio.h"
+#include "node_internals.h"  // ARRAY_SIZE
 #include "openssl/bio.h"
+#include "util.h"
+#include "util-inl.h"
+#include "uv.h"
+#include <stdlib.h>
 #include <string.h>
 
 namespace node {
 
+// Pooled buffer sizes: kInitialBufferLength, the initial length that TLS
+// clients ask for, and kThroughputBufferLength. Free buffers are chained
+// through their first bytes.
+static const size_t kPoolSizes[] = { 1024, 4096, 16384 };
+static char* pool_free_lists[ARRAY_SIZE(kPoolSizes)];
+static NodeBIO::PoolStats pool_stats;
+static uv_mutex_t pool_mutex;
+static uv_once_t pool_once = UV_ONCE_INIT;
+
+
+static void InitPool() {
+  CHECK_EQ(0, uv_mutex_init(&pool_mutex));
+}
+
+
+static int PoolIndex(size_t len) {
+  for (size_t i = 0; i < ARRAY_SIZE(kPoolSizes); i++)
+    if (kPoolSizes[i] == len)
+      return i;
+  return -1;
+}
+
+
 const BIO_METHOD NodeBIO::method = {
   BIO_TYPE_MEM,
   "node.js SSL buffer",
@@ -91,6 +119,11 @@ int NodeBIO::Read(BIO* bio, char* out, int len) {
 
 
 char* NodeBIO::Peek(size_t* size) {
+  if (read_head_ == NULL) {
+    *size = 0;
+    return NULL;
+  }
+
   *size = read_head_->write_pos_ - read_head_->read_pos_;
   return read_head_->data_ + read_head_->read_pos_;
 }
@@ -264,8 +297,12 @@ size_t NodeBIO::Read(char* out, size_t size) {
   assert(expected == bytes_read);
   length_ -= bytes_read;
 
-  // Free all empty buffers, but write_head's child
-  FreeEmpty();
+  // Drained: give everything back. Otherwise free all empty buffers, but
+  // write_head's child
+  if (length_ == 0)
+    ReleaseAll();
+  else
+    FreeEmpty();
 
   return bytes_read;
 }
@@ -390,6 +427,10 @@ char* NodeBIO::PeekWritable(size_t* size) {
 
 
 void NodeBIO::Commit(size_t size) {
+  // Nothing was read into the buffer from PeekWritable()
+  if (size == 0 && length_ == 0)
+    return ReleaseAll();
+
   write_head_->write_pos_ += size;
   length_ += size;
   assert(write_head_->write_pos_ <= write_head_->len_);
@@ -414,8 +455,9 @@ void NodeBIO::TryAllocateForWrite(size_t hint) {
   if (w == NULL ||
       (w->write_pos_ == w->len_ &&
        (w->next_ == r || w->next_->write_pos_ != 0))) {
-    size_t len = w == NULL ? initial_ :
-                             kThroughputBufferLength;
+    size_t len = w != NULL ? kThroughputBufferLength :
+                 refill_ != 0 ? refill_ :
+                 initial_;
     if (len < hint)
       len = hint;
     Buffer* next = new Buffer(len);
@@ -447,6 +489,83 @@ void NodeBIO::Reset() {
   }
   write_head_ = read_head_;
   assert(length_ == 0);
+
+  ReleaseAll();
+}
+
+
+void NodeBIO::ReleaseAll() {
+  if (read_head_ == NULL)
+    return;
+  assert(length_ == 0);
+
+  // Start over with buffers as big as the ones that were needed this time
+  size_t largest = 0;
+  Buffer* current = read_head_;
+  do {
+    Buffer* next = current->next_;
+    if (current->len_ > largest)
+      largest = current->len_;
+    delete current;
+    current = next;
+  } while (current != read_head_);
+
+  read_head_ = NULL;
+  write_head_ = NULL;
+  refill_ = largest < kThroughputBufferLength ? largest :
+                                                kThroughputBufferLength;
+}
+
+
+char* NodeBIO::AllocateBuffer(size_t len) {
+  uv_once(&pool_once, InitPool);
+
+  int index = PoolIndex(len);
+  char* data = NULL;
+
+  uv_mutex_lock(&pool_mutex);
+  if (index != -1 && pool_free_lists[index] != NULL) {
+    data = pool_free_lists[index];
+    pool_free_lists[index] = *reinterpret_cast<char**>(data);
+    pool_stats.pooled -= len;
+    pool_stats.hits++;
+  } else {
+    pool_stats.misses++;
+  }
+  pool_stats.live += len;
+  uv_mutex_unlock(&pool_mutex);
+
+  if (data == NULL) {
+    data = static_cast<char*>(malloc(len));
+    CHECK_NE(data, static_cast<char*>(NULL));
+  }
+
+  return data;
+}
+
+
+void NodeBIO::ReleaseBuffer(char* data, size_t len) {
+  int index = PoolIndex(len);
+
+  uv_mutex_lock(&pool_mutex);
+  pool_stats.live -= len;
+  if (index != -1 && pool_stats.pooled + len <= kMaxPooledBytes) {
+    *reinterpret_cast<char**>(data) = pool_free_lists[index];
+    pool_free_lists[index] = data;
+    pool_stats.pooled += len;
+    data = NULL;
+  }
+  uv_mutex_unlock(&pool_mutex);
+
+  free(data);
+}
+
+
+void NodeBIO::GetPoolStats(PoolStats* stats) {
+  uv_once(&pool_once, InitPool);
+  uv_mutex_lock(&pool_mutex);
+  *stats = pool_stats;
+  uv_mutex_unlock(&pool_mutex);
 }
 
 
@@ -24,12 +24,15 @@
 
 #include "openssl/bio.h"
 #include <assert.h>
+#include <stddef.h>  // size_t
+#include <stdint.h>
 
 namespace node {
 
 class NodeBIO {
  public:
   NodeBIO() : initial_(kInitialBufferLength),
+              refill_(0),
               length_(0),
               read_head_(NULL),
               write_head_(NULL) {
@@ -92,6 +95,16 @@ class NodeBIO {
     return static_cast<NodeBIO*>(bio->ptr);
   }
 
+  struct PoolStats {
+    uint64_t live;  // Bytes in buffers that belong to a NodeBIO
+    uint64_t pooled;  // Bytes in free buffers kept for reuse
+    uint64_t hits;
+    uint64_t misses;
+  };
+
+  // Process-wide, covers every NodeBIO on every thread
+  static void GetPoolStats(PoolStats* stats);
+
  private:
   static int New(BIO* bio);
   static int Free(BIO* bio);
@@ -105,19 +118,31 @@ class NodeBIO {
   static const size_t kInitialBufferLength = 1024;
   static const size_t kThroughputBufferLength = 16384;
 
+  // Upper bound on the memory that the buffer pool keeps around
+  static const size_t kMaxPooledBytes = 8 * 1024 * 1024;
+
   static const BIO_METHOD method;
 
+  // Buffers of the pooled sizes come from (and go back to) per-size free
+  // lists that are shared by all NodeBIOs, everything else is malloc'ed.
+  static char* AllocateBuffer(size_t len);
+  static void ReleaseBuffer(char* data, size_t len);
+
+  // Hand all buffers back once everything has been read, so that idle
+  // connections don't hold on to any.
+  void ReleaseAll();
+
   class Buffer {
    public:
     explicit Buffer(size_t len) : read_pos_(0),
                                   write_pos_(0),
                                   len_(len),
                                   next_(NULL) {
-      data_ = new char[len];
+      data_ = AllocateBuffer(len);
     }
 
     ~Buffer() {
-      delete[] data_;
+      ReleaseBuffer(data_, len_);
     }
 
     size_t read_pos_;
@@ -128,6 +153,8 @@ class NodeBIO {
   };
 
   size_t initial_;
+  // Size of the first buffer after ReleaseAll(), zero before the first one
+  size_t refill_;
   size_t length_;
   Buffer* read_head_;
   Buffer* write_head_;
@@ -0,0 +1,361 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "node_crypto_session_cache.h"
+#include "node_crypto.h"  // SecureContext::kMaxSessionSize
+#include "uv.h"
+
+#include <errno.h>
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace node {
+namespace crypto {
+
+static const uint32_t kMagic = 0x6e747363;  // "ntsc"
+static const uint32_t kVersion = 2;
+static const size_t kAlignment = 64;
+
+struct SessionCache::Header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slot_count;
+  uint32_t slot_size;
+  uint64_t clock;  // Bumped on every hit and store, orders slots for LRU.
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t stores;
+  uint64_t evictions;
+};
+
+struct SessionCache::Slot {
+  uint32_t sequence;  // Odd while a writer is busy with the slot.
+  uint32_t writer;  // Pid of that writer. Claimed together with |sequence|.
+  uint32_t id_length;  // Zero when the slot is empty.
+  uint32_t data_length;
+  uint64_t last_used;
+  unsigned char id[SSL_MAX_SSL_SESSION_ID_LENGTH];
+  unsigned char data[1];  // Really SecureContext::kMaxSessionSize bytes.
+};
+
+
+static inline size_t RoundUp(size_t n) {
+  return (n + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+
+size_t SessionCache::HeaderSize() {
+  return RoundUp(sizeof(Header));
+}
+
+
+size_t SessionCache::SlotSize() {
+  return RoundUp(offsetof(Slot, data) + SecureContext::kMaxSessionSize);
+}
+
+
+SessionCache* SessionCache::Open(const char* path,
+                                 uint32_t entries,
+                                 int* err) {
+#if defined(_WIN32)
+  *err = UV_ENOSYS;
+  return NULL;
+#else
+  // Whole sets only.
+  if (entries < kWays)
+    entries = kWays;
+  entries = (entries + kWays - 1) / kWays * kWays;
+
+  // The file holds session master keys. Don't follow a symlink that someone
+  // else planted at |path| and only use a file that is ours alone, see below.
+  int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC | O_NOFOLLOW, 0600);
+  if (fd == -1) {
+    *err = -errno;
+    return NULL;
+  }
+
+  // Keep other processes from seeing a half-initialized header.
+  int r;
+  do {
+    r = flock(fd, LOCK_EX);
+  } while (r == -1 && errno == EINTR);
+
+  size_t size = 0;
+  struct stat s;
+  Header header;
+
+  if (fstat(fd, &s) == -1) {
+    *err = -errno;
+    goto fail;
+  }
+
+  if (!S_ISREG(s.st_mode) ||
+      s.st_uid != geteuid() ||
+      (s.st_mode & 077) != 0) {
+    *err = UV_EPERM;
+    goto fail;
+  }
+
+  if (s.st_size == 0) {
+    memset(&header, 0, sizeof(header));
+    header.magic = kMagic;
+    header.version = kVersion;
+    header.slot_count = entries;
+    header.slot_size = SlotSize();
+    size = HeaderSize() + static_cast<size_t>(entries) * SlotSize();
+    // Grows the file with zeroes, i.e. with empty slots.
+    if (ftruncate(fd, size) == -1 ||
+        pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+      *err = -errno;
+      goto fail;
+    }
+  } else {
+    if (pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+        header.magic != kMagic ||
+        header.version != kVersion ||
+        header.slot_size != SlotSize() ||
+        header.slot_count == 0 ||
+        header.slot_count % kWays != 0) {
+      *err = UV_EINVAL;
+      goto fail;
+    }
+    size = HeaderSize() + static_cast<size_t>(header.slot_count) * SlotSize();
+    if (static_cast<size_t>(s.st_size) != size) {
+      *err = UV_EINVAL;
+      goto fail;
+    }
+  }
+
+  {
+    void* base =
+        mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+      *err = -errno;
+      goto fail;
+    }
+
+    // Unlock explicitly, the mapping keeps the open file alive and with it
+    // the lock.
+    flock(fd, LOCK_UN);
+    close(fd);
+    *err = 0;
+    return new SessionCache(base, size);
+  }
+
+ fail:
+  flock(fd, LOCK_UN);
+  close(fd);
+  return NULL;
+#endif  // defined(_WIN32)
+}
+
+
+SessionCache::SessionCache(void* base, size_t size)
+    : base_(base),
+      size_(size),
+      header_(static_cast<Header*>(base)) {
+}
+
+
+SessionCache::~SessionCache() {
+#if !defined(_WIN32)
+  munmap(base_, size_);
+#endif
+}
+
+
+SessionCache::Slot* SessionCache::slot(uint32_t index) const {
+  char* base = static_cast<char*>(base_) + HeaderSize();
+  return reinterpret_cast<Slot*>(base + index * header_->slot_size);
+}
+
+
+// FNV-1a. Session ids are random already, this just folds them.
+uint32_t SessionCache::SetFor(const unsigned char* id,
+                              unsigned int id_length) const {
+  uint32_t hash = 2166136261u;
+  for (unsigned int i = 0; i < id_length; i++) {
+    hash ^= id[i];
+    hash *= 16777619u;
+  }
+  return hash % (header_->slot_count / kWays);
+}
+
+
+#if defined(_WIN32)
+
+void SessionCache::Store(SSL_SESSION* sess) {
+}
+
+
+SSL_SESSION* SessionCache::Lookup(const unsigned char* id,
+                                  unsigned int id_length) {
+  return NULL;
+}
+
+#else
+
+// Slot::sequence and Slot::writer as one word, for the compare-and-swap.
+union SlotOwner {
+  struct {
+    uint32_t sequence;
+    uint32_t writer;
+  } fields;
+  uint64_t word;
+};
+
+
+static bool IsGone(uint32_t pid) {
+  return pid != 0 && kill(static_cast<pid_t>(pid), 0) == -1 && errno == ESRCH;
+}
+
+
+void SessionCache::Store(SSL_SESSION* sess) {
+  unsigned int id_length = sess->session_id_length;
+  if (id_length == 0 || id_length > SSL_MAX_SSL_SESSION_ID_LENGTH)
+    return;
+
+  int size = i2d_SSL_SESSION(sess, NULL);
+  if (size <= 0 || size > SecureContext::kMaxSessionSize)
+    return;
+
+  // Same session id first, then an empty slot, then the least recently used.
+  uint32_t first = SetFor(sess->session_id, id_length) * kWays;
+  Slot* victim = NULL;
+  for (uint32_t i = first; i < first + kWays; i++) {
+    Slot* s = slot(i);
+    if (s->id_length == id_length &&
+        memcmp(s->id, sess->session_id, id_length) == 0) {
+      victim = s;
+      break;
+    }
+    if (victim == NULL ||
+        (victim->id_length != 0 &&
+         (s->id_length == 0 || s->last_used < victim->last_used))) {
+      victim = s;
+    }
+  }
+
+  // A torn read on 32 bits systems makes the compare-and-swap fail.
+  uint64_t* lock = reinterpret_cast<uint64_t*>(&victim->sequence);
+  SlotOwner owner;
+  owner.word = *static_cast<volatile uint64_t*>(lock);
+  uint32_t sequence = owner.fields.sequence;
+  if (sequence & 1) {
+    // Busy, unless the writer died on the job. Take the slot over then, it
+    // stays odd but moves on so that other writers' claims fail.
+    if (!IsGone(owner.fields.writer))
+      return;
+    sequence += 1;
+  }
+
+  SlotOwner claim;
+  claim.fields.sequence = sequence + 1;
+  claim.fields.writer = static_cast<uint32_t>(getpid());
+  if (!__sync_bool_compare_and_swap(lock, owner.word, claim.word))
+    return;
+
+  bool evicted = victim->id_length != 0 &&
+                 (victim->id_length != id_length ||
+                  memcmp(victim->id, sess->session_id, id_length) != 0);
+
+  unsigned char* data = victim->data;
+  i2d_SSL_SESSION(sess, &data);
+  victim->data_length = size;
+  victim->id_length = id_length;
+  memcpy(victim->id, sess->session_id, id_length);
+  victim->last_used = __sync_add_and_fetch(&header_->clock, 1);
+
+  victim->writer = 0;
+  __sync_synchronize();
+  victim->sequence = sequence + 2;
+
+  __sync_add_and_fetch(&header_->stores, 1);
+  if (evicted)
+    __sync_add_and_fetch(&header_->evictions, 1);
+}
+
+
+SSL_SESSION* SessionCache::Lookup(const unsigned char* id,
+                                  unsigned int id_length) {
+  if (id_length == 0 || id_length > SSL_MAX_SSL_SESSION_ID_LENGTH)
+    return NULL;
+
+  unsigned char data[SecureContext::kMaxSessionSize];
+  uint32_t first = SetFor(id, id_length) * kWays;
+
+  for (uint32_t i = first; i < first + kWays; i++) {
+    Slot* s = slot(i);
+
+    // Retry once if a writer raced with us, after that it's a miss.
+    for (int attempt = 0; attempt < 2; attempt++) {
+      uint32_t sequence = *static_cast<volatile uint32_t*>(&s->sequence);
+      __sync_synchronize();
+      if (sequence & 1)
+        break;
+      if (s->id_length != id_length || memcmp(s->id, id, id_length) != 0)
+        break;
+
+      uint32_t data_length = s->data_length;
+      if (data_length > sizeof(data))
+        break;
+      memcpy(data, s->data, data_length);
+
+      __sync_synchronize();
+      if (*static_cast<volatile uint32_t*>(&s->sequence) != sequence)
+        continue;
+
+      const unsigned char* p = data;
+      SSL_SESSION* sess = d2i_SSL_SESSION(NULL, &p, data_length);
+      if (sess == NULL)
+        break;
+
+      s->last_used = __sync_add_and_fetch(&header_->clock, 1);
+      __sync_add_and_fetch(&header_->hits, 1);
+      return sess;
+    }
+  }
+
+  __sync_add_and_fetch(&header_->misses, 1);
+  return NULL;
+}
+
+#endif  // defined(_WIN32)
+
+
+void SessionCache::GetStats(Stats* stats) const {
+  stats->entries = header_->slot_count;
+  stats->hits = header_->hits;
+  stats->misses = header_->misses;
+  stats->stores = header_->stores;
+  stats->evictions = header_->evictions;
+}
+
+}  // namespace crypto
+}  // namespace node
@@ -0,0 +1,98 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef SRC_NODE_CRYPTO_SESSION_CACHE_H_
+#define SRC_NODE_CRYPTO_SESSION_CACHE_H_
+
+#include "util.h"  // DISALLOW_COPY_AND_ASSIGN
+
+#include <openssl/ssl.h>
+#include <stddef.h>  // size_t
+#include <stdint.h>
+
+namespace node {
+namespace crypto {
+
+// Server-side TLS session cache that lives in a file-backed shared memory
+// segment, so that every process that maps the same file - cluster workers,
+// typically - can resume sessions created by any of the others.
+//
+// The segment is split into sets of kWays slots. A session id hashes to one
+// set and the least recently used slot in it gets replaced. Each slot holds
+// one serialized SSL_SESSION of up to SecureContext::kMaxSessionSize bytes.
+//
+// Lookups don't take locks: every slot carries a sequence number that is odd
+// while a writer is busy with it, readers copy the slot out and retry when
+// the number changed under them. Writers claim a slot by making its sequence
+// number odd with a compare-and-swap and simply skip the store when another
+// writer got there first; it's a cache, not a database. A writer leaves its
+// pid in the slot next to the sequence number, so that a slot whose writer
+// died halfway through can be taken over instead of staying busy for good.
+class SessionCache {
+ public:
+  struct Stats {
+    uint64_t entries;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t evictions;
+  };
+
+  // Maps the cache at |path|, creating it with room for |entries| sessions if
+  // it doesn't exist yet. An existing cache is used as-is, whatever its size.
+  // Fails with UV_EPERM when |path| is not a regular file owned by the
+  // effective user and inaccessible to everyone else.
+  // Returns NULL and sets |*err| to a negative errno on failure.
+  static SessionCache* Open(const char* path, uint32_t entries, int* err);
+  ~SessionCache();
+
+  // Serializes and stores |sess| under its session id.
+  void Store(SSL_SESSION* sess);
+
+  // Returns a new reference to the session stored under |id|, or NULL.
+  SSL_SESSION* Lookup(const unsigned char* id, unsigned int id_length);
+
+  void GetStats(Stats* stats) const;
+
+  static const uint32_t kWays = 4;
+
+ private:
+  struct Header;
+  struct Slot;
+
+  SessionCache(void* base, size_t size);
+
+  static size_t HeaderSize();
+  static size_t SlotSize();
+  Slot* slot(uint32_t index) const;
+  uint32_t SetFor(const unsigned char* id, unsigned int id_length) const;
+
+  void* const base_;
+  const size_t size_;
+  Header* const header_;
+
+  DISALLOW_COPY_AND_ASSIGN(SessionCache);
+};
+
+}  // namespace crypto
+}  // namespace node
+
+#endif  // SRC_NODE_CRYPTO_SESSION_CACHE_H_
@@ -0,0 +1,162 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "node_crypto_ticket_keys.h"
+
+#include <openssl/rand.h>
+#include <string.h>
+
+namespace node {
+namespace crypto {
+
+TicketKeyRing::TicketKeyRing() : keys_(NULL), count_(0), misses_(0) {
+  CHECK_EQ(0, uv_mutex_init(&mutex_));
+}
+
+
+TicketKeyRing::~TicketKeyRing() {
+  delete[] keys_;
+  uv_mutex_destroy(&mutex_);
+}
+
+
+void TicketKeyRing::Set(const char* data, size_t length) {
+  size_t count = length / kKeySize;
+  Key* keys = new Key[count];
+  for (size_t i = 0; i < count; i++) {
+    const char* p = data + i * kKeySize;
+    memcpy(keys[i].name, p, kNameSize);
+    memcpy(keys[i].hmac_secret, p + 16, sizeof(keys[i].hmac_secret));
+    memcpy(keys[i].aes_key, p + 32, sizeof(keys[i].aes_key));
+    keys[i].issued = 0;
+    keys[i].hits = 0;
+  }
+
+  uv_mutex_lock(&mutex_);
+  for (size_t i = 0; i < count; i++) {
+    for (size_t j = 0; j < count_; j++) {
+      if (memcmp(keys[i].name, keys_[j].name, kNameSize) == 0) {
+        keys[i].issued = keys_[j].issued;
+        keys[i].hits = keys_[j].hits;
+        break;
+      }
+    }
+  }
+  Key* old = keys_;
+  keys_ = keys;
+  count_ = count;
+  uv_mutex_unlock(&mutex_);
+
+  delete[] old;
+}
+
+
+void TicketKeyRing::Get(char* data) {
+  uv_mutex_lock(&mutex_);
+  for (size_t i = 0; i < count_; i++) {
+    char* p = data + i * kKeySize;
+    memcpy(p, keys_[i].name, kNameSize);
+    memcpy(p + 16, keys_[i].hmac_secret, sizeof(keys_[i].hmac_secret));
+    memcpy(p + 32, keys_[i].aes_key, sizeof(keys_[i].aes_key));
+  }
+  uv_mutex_unlock(&mutex_);
+}
+
+
+size_t TicketKeyRing::count() {
+  uv_mutex_lock(&mutex_);
+  size_t count = count_;
+  uv_mutex_unlock(&mutex_);
+  return count;
+}
+
+
+size_t TicketKeyRing::GetStats(KeyStats* stats,
+                               size_t count,
+                               uint64_t* misses) {
+  uv_mutex_lock(&mutex_);
+  if (count > count_)
+    count = count_;
+  for (size_t i = 0; i < count; i++) {
+    memcpy(stats[i].name, keys_[i].name, kNameSize);
+    stats[i].issued = keys_[i].issued;
+    stats[i].hits = keys_[i].hits;
+  }
+  *misses = misses_;
+  uv_mutex_unlock(&mutex_);
+  return count;
+}
+
+
+// Return values are those of the OpenSSL ticket key callback: 1 to use the
+// key, 2 to use it and issue a fresh ticket, 0 when the key is unknown and -1
+// on error.
+int TicketKeyRing::Process(unsigned char* name,
+                           unsigned char* iv,
+                           EVP_CIPHER_CTX* ectx,
+                           HMAC_CTX* hctx,
+                           int enc) {
+  if (enc && RAND_bytes(iv, EVP_MAX_IV_LENGTH) <= 0)
+    return -1;
+
+  int ret = 0;
+  uv_mutex_lock(&mutex_);
+
+  if (enc) {
+    if (count_ > 0) {
+      Key* key = &keys_[0];
+      memcpy(name, key->name, kNameSize);
+      EVP_EncryptInit_ex(ectx, EVP_aes_128_cbc(), NULL, key->aes_key, iv);
+      HMAC_Init_ex(hctx,
+                   key->hmac_secret,
+                   sizeof(key->hmac_secret),
+                   EVP_sha256(),
+                   NULL);
+      key->issued++;
+      ret = 1;
+    } else {
+      ret = -1;
+    }
+  } else {
+    for (size_t i = 0; i < count_; i++) {
+      Key* key = &keys_[i];
+      if (memcmp(name, key->name, kNameSize) != 0)
+        continue;
+      HMAC_Init_ex(hctx,
+                   key->hmac_secret,
+                   sizeof(key->hmac_secret),
+                   EVP_sha256(),
+                   NULL);
+      EVP_DecryptInit_ex(ectx, EVP_aes_128_cbc(), NULL, key->aes_key, iv);
+      key->hits++;
+      ret = i == 0 ? 1 : 2;
+      break;
+    }
+    if (ret == 0)
+      misses_++;
+  }
+
+  uv_mutex_unlock(&mutex_);
+  return ret;
+}
+
+}  // namespace crypto
+}  // namespace node
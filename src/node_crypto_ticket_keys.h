@@ -0,0 +1,98 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef SRC_NODE_CRYPTO_TICKET_KEYS_H_
+#define SRC_NODE_CRYPTO_TICKET_KEYS_H_
+
+#include "util.h"  // DISALLOW_COPY_AND_ASSIGN
+#include "uv.h"
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <stddef.h>  // size_t
+#include <stdint.h>
+
+namespace node {
+namespace crypto {
+
+// Session ticket keys of a SecureContext. The first key encrypts new tickets,
+// the others are only used to decrypt tickets that were issued before the
+// last rotation; such tickets get renewed with the first key. Rotating keys
+// this way keeps the tickets that clients hold valid for another round.
+//
+// Handshakes can run on the thread pool (see TLSCallbacks::QueueHandshake),
+// so the keys are guarded by a mutex. Set() replaces all of them at once.
+class TicketKeyRing {
+ public:
+  // 16 bytes key name, 16 bytes HMAC secret, 16 bytes AES key. Same layout
+  // as SSL_CTX_set_tlsext_ticket_keys() uses.
+  static const size_t kKeySize = 48;
+  static const size_t kNameSize = 16;
+
+  struct KeyStats {
+    unsigned char name[kNameSize];
+    uint64_t issued;  // Tickets encrypted with the key.
+    uint64_t hits;  // Tickets decrypted with the key.
+  };
+
+  TicketKeyRing();
+  ~TicketKeyRing();
+
+  // Replaces the keys with the |length| / kKeySize ones in |data|. Counters
+  // of keys that are still in the ring are kept.
+  void Set(const char* data, size_t length);
+
+  // Copies count() * kKeySize bytes of keys into |data|.
+  void Get(char* data);
+  size_t count();
+
+  // Copies the counters of up to |count| keys into |stats|, returns the
+  // number of keys copied. |*misses| counts tickets with an unknown key name.
+  size_t GetStats(KeyStats* stats, size_t count, uint64_t* misses);
+
+  // Implements SSL_CTX_set_tlsext_ticket_key_cb().
+  int Process(unsigned char* name,
+              unsigned char* iv,
+              EVP_CIPHER_CTX* ectx,
+              HMAC_CTX* hctx,
+              int enc);
+
+ private:
+  struct Key {
+    unsigned char name[kNameSize];
+    unsigned char hmac_secret[16];
+    unsigned char aes_key[16];
+    uint64_t issued;
+    uint64_t hits;
+  };
+
+  uv_mutex_t mutex_;
+  Key* keys_;
+  size_t count_;
+  uint64_t misses_;
+
+  DISALLOW_COPY_AND_ASSIGN(TicketKeyRing);
+};
+
+}  // namespace crypto
+}  // namespace node
+
+#endif  // SRC_NODE_CRYPTO_TICKET_KEYS_H_
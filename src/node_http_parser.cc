@@ -31,6 +31,7 @@
 #include "util-inl.h"
 #include "v8.h"
 
+#include <ctype.h>  // tolower()
 #include <stdlib.h>  // free()
 #include <string.h>  // strdup()
 
@@ -73,6 +74,182 @@ const uint32_t kOnHeaders = 0;
 const uint32_t kOnHeadersComplete = 1;
 const uint32_t kOnBody = 2;
 const uint32_t kOnMessageComplete = 3;
+const uint32_t kOnBodySpans = 4;
+const uint32_t kOnBatch = 5;
+
+// Header names that show up in most requests and responses. CreateHeaders()
+// hands out a cached, internalized string for these instead of creating a
+// new one every time. Both the canonical spelling and the all-lowercase one
+// are recognized; anything else falls back to a fresh string.
+#define COMMON_HEADER_NAMES(V)                                                \
+  V(kAccept, "Accept")                                                        \
+  V(kAcceptCharset, "Accept-Charset")                                         \
+  V(kAcceptEncoding, "Accept-Encoding")                                       \
+  V(kAcceptLanguage, "Accept-Language")                                       \
+  V(kAcceptRanges, "Accept-Ranges")                                           \
+  V(kAge, "Age")                                                              \
+  V(kAuthorization, "Authorization")                                          \
+  V(kCacheControl, "Cache-Control")                                           \
+  V(kConnection, "Connection")                                                \
+  V(kContentEncoding, "Content-Encoding")                                     \
+  V(kContentLanguage, "Content-Language")                                     \
+  V(kContentLength, "Content-Length")                                         \
+  V(kContentType, "Content-Type")                                             \
+  V(kCookie, "Cookie")                                                        \
+  V(kDate, "Date")                                                            \
+  V(kETag, "ETag")                                                            \
+  V(kExpect, "Expect")                                                        \
+  V(kExpires, "Expires")                                                      \
+  V(kHost, "Host")                                                            \
+  V(kIfModifiedSince, "If-Modified-Since")                                    \
+  V(kIfNoneMatch, "If-None-Match")                                            \
+  V(kKeepAlive, "Keep-Alive")                                                 \
+  V(kLastModified, "Last-Modified")                                           \
+  V(kLocation, "Location")                                                    \
+  V(kOrigin, "Origin")                                                        \
+  V(kPragma, "Pragma")                                                        \
+  V(kRange, "Range")                                                          \
+  V(kReferer, "Referer")                                                      \
+  V(kServer, "Server")                                                        \
+  V(kSetCookie, "Set-Cookie")                                                 \
+  V(kTransferEncoding, "Transfer-Encoding")                                   \
+  V(kUpgrade, "Upgrade")                                                      \
+  V(kUserAgent, "User-Agent")                                                 \
+  V(kVary, "Vary")                                                            \
+  V(kVia, "Via")                                                              \
+  V(kXForwardedFor, "X-Forwarded-For")                                        \
+  V(kXForwardedProto, "X-Forwarded-Proto")                                    \
+  V(kXRequestedWith, "X-Requested-With")                                      \
+
+enum CommonHeaderNameId {
+#define V(id, name) id,
+  COMMON_HEADER_NAMES(V)
+#undef V
+};
+
+static const char* const common_header_names[] = {
+#define V(id, name) name,
+  COMMON_HEADER_NAMES(V)
+#undef V
+};
+
+#undef COMMON_HEADER_NAMES
+
+// Picks the only common header name that |str| can be, going by its length
+// and first character (and one more character where two names collide).
+// Returns -1 if there is none. The caller still has to compare the strings.
+static int CommonHeaderNameCandidate(const char* str, size_t size) {
+  switch (size) {
+    case 3:
+      switch (tolower(str[0])) {
+        case 'a': return kAge;
+        case 'v': return kVia;
+      }
+      break;
+    case 4:
+      switch (tolower(str[0])) {
+        case 'd': return kDate;
+        case 'e': return kETag;
+        case 'h': return kHost;
+        case 'v': return kVary;
+      }
+      break;
+    case 5:
+      switch (tolower(str[0])) {
+        case 'r': return kRange;
+      }
+      break;
+    case 6:
+      switch (tolower(str[0])) {
+        case 'a': return kAccept;
+        case 'c': return kCookie;
+        case 'e': return kExpect;
+        case 'o': return kOrigin;
+        case 'p': return kPragma;
+        case 's': return kServer;
+      }
+      break;
+    case 7:
+      switch (tolower(str[0])) {
+        case 'e': return kExpires;
+        case 'r': return kReferer;
+        case 'u': return kUpgrade;
+      }
+      break;
+    case 8:
+      switch (tolower(str[0])) {
+        case 'l': return kLocation;
+      }
+      break;
+    case 10:
+      switch (tolower(str[0])) {
+        case 'c': return kConnection;
+        case 'k': return kKeepAlive;
+        case 's': return kSetCookie;
+        case 'u': return kUserAgent;
+      }
+      break;
+    case 12:
+      switch (tolower(str[0])) {
+        case 'c': return kContentType;
+      }
+      break;
+    case 13:
+      switch (tolower(str[0])) {
+        case 'a':
+          return tolower(str[1]) == 'c' ? kAcceptRanges : kAuthorization;
+        case 'c': return kCacheControl;
+        case 'i': return kIfNoneMatch;
+        case 'l': return kLastModified;
+      }
+      break;
+    case 14:
+      switch (tolower(str[0])) {
+        case 'a': return kAcceptCharset;
+        case 'c': return kContentLength;
+      }
+      break;
+    case 15:
+      switch (tolower(str[0])) {
+        case 'a':
+          return tolower(str[7]) == 'e' ? kAcceptEncoding : kAcceptLanguage;
+        case 'x': return kXForwardedFor;
+      }
+      break;
+    case 16:
+      switch (tolower(str[0])) {
+        case 'c':
+          return tolower(str[8]) == 'e' ? kContentEncoding : kContentLanguage;
+        case 'x': return kXRequestedWith;
+      }
+      break;
+    case 17:
+      switch (tolower(str[0])) {
+        case 'i': return kIfModifiedSince;
+        case 't': return kTransferEncoding;
+        case 'x': return kXForwardedProto;
+      }
+      break;
+  }
+  return -1;
+}
+
+// Returns the slot in env->http_header_names_array() for the header name in
+// |str|, or -1 if it's not one of the common ones. Even slots hold the
+// canonical spelling, odd slots the lowercase one.
+static int CommonHeaderNameIndex(const char* str, size_t size) {
+  int i = CommonHeaderNameCandidate(str, size);
+  if (i == -1)
+    return -1;
+  const char* name = common_header_names[i];
+  if (memcmp(name, str, size) == 0)
+    return 2 * i;
+  for (size_t k = 0; k < size; k++) {
+    if (str[k] != tolower(name[k]))
+      return -1;
+  }
+  return 2 * i + 1;
+}
 
 
 #define HTTP_CB(name)                                                         \
@@ -93,14 +270,14 @@ const uint32_t kOnMessageComplete = 3;
 
 // helper class for the Parser
 struct StringPtr {
-  StringPtr() {
+  StringPtr() : heap_(NULL), capacity_(0) {
     on_heap_ = false;
     Reset();
   }
 
 
   ~StringPtr() {
-    Reset();
+    Release();
   }
 
 
@@ -109,41 +286,65 @@ struct StringPtr {
   // to leak references. See issue #2438 and test-http-parser-bad-ref.js.
   void Save() {
     if (!on_heap_ && size_ > 0) {
-      char* s = new char[size_];
-      memcpy(s, str_, size_);
-      str_ = s;
+      Reserve(size_);
+      memcpy(heap_, str_, size_);
+      str_ = heap_;
       on_heap_ = true;
     }
   }
 
 
+  // Forgets the string but keeps the heap storage around for the next one,
+  // a parser sees the same kind of headers over and over again.
   void Reset() {
-    if (on_heap_) {
-      delete[] str_;
-      on_heap_ = false;
-    }
+    if (capacity_ > kMaxRetainedCapacity)
+      Release();
+
+    on_heap_ = false;
+    str_ = NULL;
+    size_ = 0;
+  }
+
 
+  // Frees the heap storage. The string must not be in use.
+  void Release() {
+    delete[] heap_;
+    heap_ = NULL;
+    capacity_ = 0;
+    on_heap_ = false;
     str_ = NULL;
     size_ = 0;
   }
 
 
+  // Hands the string over to |other| and leaves this one empty.
+  void MoveTo(StringPtr* other) {
+    other->Release();
+    other->str_ = str_;
+    other->on_heap_ = on_heap_;
+    other->size_ = size_;
+    other->heap_ = heap_;
+    other->capacity_ = capacity_;
+    heap_ = NULL;
+    capacity_ = 0;
+    Reset();
+  }
+
+
   void Update(const char* str, size_t size) {
-    if (str_ == NULL)
+    if (str_ == NULL) {
       str_ = str;
-    else if (on_heap_ || str_ + size_ != str) {
+    } else if (on_heap_) {
+      Reserve(size_ + size);
+      memcpy(heap_ + size_, str, size);
+      str_ = heap_;
+    } else if (str_ + size_ != str) {
       // Non-consecutive input, make a copy on the heap.
-      // TODO(bnoordhuis) Use slab allocation, O(n) allocs is bad.
-      char* s = new char[size_ + size];
-      memcpy(s, str_, size_);
-      memcpy(s + size_, str, size);
-
-      if (on_heap_)
-        delete[] str_;
-      else
-        on_heap_ = true;
-
-      str_ = s;
+      Reserve(size_ + size);
+      memcpy(heap_, str_, size_);
+      memcpy(heap_ + size_, str, size);
+      str_ = heap_;
+      on_heap_ = true;
     }
     size_ += size;
   }
@@ -157,9 +358,57 @@ struct StringPtr {
   }
 
 
+  // Like ToString() but returns a cached string when this is one of the
+  // common header names.
+  Local<String> ToHeaderName(Environment* env) const {
+    int index = CommonHeaderNameIndex(str_, size_);
+    if (index == -1)
+      return ToString(env);
+
+    Local<Array> names = env->http_header_names_array();
+    Local<Value> name = names->Get(index);
+    if (name->IsString())
+      return name.As<String>();
+
+    Local<String> string =
+        String::NewFromOneByte(env->isolate(),
+                               reinterpret_cast<const uint8_t*>(str_),
+                               String::kInternalizedString,
+                               size_);
+    names->Set(index, string);
+    return string;
+  }
+
+
   const char* str_;
   bool on_heap_;
   size_t size_;
+
+ private:
+  // Storage beyond this is given back when the string is reset so that one
+  // oversized header doesn't pin memory for the lifetime of the parser.
+  static const size_t kMaxRetainedCapacity = 4096;
+
+  // Makes room for |size| bytes on the heap, keeping the current contents
+  // if the string lives there.
+  void Reserve(size_t size) {
+    if (size <= capacity_)
+      return;
+
+    size_t capacity = capacity_ > 0 ? 2 * capacity_ : 64;
+    while (capacity < size)
+      capacity *= 2;
+
+    char* heap = new char[capacity];
+    if (on_heap_)
+      memcpy(heap, heap_, size_);
+    delete[] heap_;
+    heap_ = heap;
+    capacity_ = capacity;
+  }
+
+  char* heap_;
+  size_t capacity_;
 };
 
 
@@ -167,6 +416,12 @@ class Parser : public BaseObject {
  public:
   Parser(Environment* env, Local<Object> wrap, enum http_parser_type type)
       : BaseObject(env, wrap),
+        fields_(new StringPtr[kInitialHeaderCapacity]),
+        values_(new StringPtr[kInitialHeaderCapacity]),
+        header_capacity_(kInitialHeaderCapacity),
+        max_header_pairs_(0),
+        headers_full_(false),
+        raw_headers_(false),
         current_buffer_len_(0),
         current_buffer_data_(NULL) {
     Wrap(object(), this);
@@ -177,11 +432,14 @@ class Parser : public BaseObject {
   ~Parser() {
     ClearWrap(object());
     persistent().Reset();
+    delete[] fields_;
+    delete[] values_;
   }
 
 
   HTTP_CB(on_message_begin) {
     num_fields_ = num_values_ = 0;
+    headers_full_ = false;
     url_.Reset();
     status_message_.Reset();
     return 0;
@@ -201,19 +459,23 @@ class Parser : public BaseObject {
 
 
   HTTP_DATA_CB(on_header_field) {
+    if (headers_full_)
+      return 0;
+
     if (num_fields_ == num_values_) {
       // start of new field name
-      num_fields_++;
-      if (num_fields_ == ARRAY_SIZE(fields_)) {
-        // ran out of space - flush to javascript land
-        Flush();
-        num_fields_ = 1;
-        num_values_ = 0;
+      if (max_header_pairs_ > 0 && 2 * num_fields_ >= max_header_pairs_) {
+        // JS land drops everything past the limit anyway, don't keep it.
+        headers_full_ = true;
+        return 0;
       }
+      num_fields_++;
+      if (num_fields_ > header_capacity_)
+        GrowHeaders();
       fields_[num_fields_ - 1].Reset();
     }
 
-    assert(num_fields_ < static_cast<int>(ARRAY_SIZE(fields_)));
+    assert(num_fields_ <= header_capacity_);
     assert(num_fields_ == num_values_ + 1);
 
     fields_[num_fields_ - 1].Update(at, length);
@@ -223,13 +485,16 @@ class Parser : public BaseObject {
 
 
   HTTP_DATA_CB(on_header_value) {
+    if (headers_full_)
+      return 0;
+
     if (num_values_ != num_fields_) {
       // start of new header value
       num_values_++;
       values_[num_values_ - 1].Reset();
     }
 
-    assert(num_values_ < static_cast<int>(ARRAY_SIZE(values_)));
+    assert(num_values_ <= header_capacity_);
     assert(num_values_ == num_fields_);
 
     values_[num_values_ - 1].Update(at, length);
@@ -240,23 +505,23 @@ class Parser : public BaseObject {
 
   HTTP_CB(on_headers_complete) {
     Local<Object> obj = object();
-    Local<Value> cb = obj->Get(kOnHeadersComplete);
+    Local<Value> cb;
 
-    if (!cb->IsFunction())
-      return 0;
+    if (!batch_) {
+      cb = obj->Get(kOnHeadersComplete);
+      if (!cb->IsFunction())
+        return 0;
+    }
 
     Local<Object> message_info = Object::New(env()->isolate());
 
-    if (have_flushed_) {
-      // Slow case, flush remaining headers.
-      Flush();
-    } else {
-      // Fast case, pass headers and URL to JS land.
-      message_info->Set(env()->headers_string(), CreateHeaders());
-      if (parser_.type == HTTP_REQUEST)
-        message_info->Set(env()->url_string(), url_.ToString(env()));
-    }
+    // The header arrays grow as needed so the headers and URL always go to
+    // JS land in one piece.
+    message_info->Set(env()->headers_string(), CreateHeaders());
+    if (parser_.type == HTTP_REQUEST)
+      message_info->Set(env()->url_string(), url_.ToString(env()));
     num_fields_ = num_values_ = 0;
+    headers_full_ = false;  // Trailers get a limit of their own.
 
     // METHOD
     if (parser_.type == HTTP_REQUEST) {
@@ -287,6 +552,12 @@ class Parser : public BaseObject {
                       parser_.upgrade ? True(env()->isolate())
                                       : False(env()->isolate()));
 
+    if (batch_) {
+      AddToBatch(kOnHeadersComplete);
+      AddToBatch(message_info);
+      return 0;
+    }
+
     Local<Value> argv[1] = { message_info };
     Local<Value> head_response =
         cb.As<Function>()->Call(obj, ARRAY_SIZE(argv), argv);
@@ -301,6 +572,32 @@ class Parser : public BaseObject {
 
 
   HTTP_DATA_CB(on_body) {
+    if (batch_) {
+      AddToBatch(kOnBody);
+      AddToBatch(at - current_buffer_data_);
+      AddToBatch(length);
+      return 0;
+    }
+
+    if (batch_body_) {
+      size_t offset = at - current_buffer_data_;
+      if (num_body_spans_ > 0) {
+        BodySpan* last = &body_spans_[num_body_spans_ - 1];
+        if (last->offset + last->length == offset) {
+          last->length += length;
+          return 0;
+        }
+      }
+      if (num_body_spans_ == static_cast<int>(ARRAY_SIZE(body_spans_)) &&
+          FlushBodySpans()) {
+        return -1;
+      }
+      body_spans_[num_body_spans_].offset = offset;
+      body_spans_[num_body_spans_].length = length;
+      num_body_spans_++;
+      return 0;
+    }
+
     HandleScope scope(env()->isolate());
 
     Local<Object> obj = object();
@@ -329,6 +626,21 @@ class Parser : public BaseObject {
   HTTP_CB(on_message_complete) {
     HandleScope scope(env()->isolate());
 
+    if (batch_) {
+      if (num_fields_) {
+        // Trailing HTTP headers.
+        AddToBatch(kOnHeaders);
+        AddToBatch(CreateHeaders());
+        AddToBatch(url_.ToString(env()));
+        url_.Reset();
+      }
+      AddToBatch(kOnMessageComplete);
+      return 0;
+    }
+
+    if (FlushBodySpans())
+      return -1;
+
     if (num_fields_)
       Flush();  // Flush trailing HTTP headers.
 
@@ -402,10 +714,25 @@ class Parser : public BaseObject {
     parser->current_buffer_len_ = buffer_len;
     parser->current_buffer_data_ = buffer_data;
     parser->got_exception_ = false;
+    parser->max_header_pairs_ =
+        parser->object()->Get(env->max_header_pairs_string())->Int32Value();
+    parser->batch_body_ =
+        parser->object()->Get(kOnBodySpans)->IsFunction();
+    // Only request parsers can batch: a response parser has to tell
+    // http_parser right away whether to expect a body.
+    parser->batch_ = parser->parser_.type == HTTP_REQUEST &&
+                     parser->object()->Get(kOnBatch)->IsFunction();
+    if (parser->batch_)
+      parser->batch_events_ = Array::New(env->isolate());
 
     size_t nparsed =
       http_parser_execute(&parser->parser_, &settings, buffer_data, buffer_len);
 
+    if (!parser->got_exception_)
+      parser->FlushBatch();
+    if (!parser->got_exception_)
+      parser->FlushBodySpans();
+
     parser->Save();
 
     // Unassign the 'buffer_' variable
@@ -414,8 +741,11 @@ class Parser : public BaseObject {
     parser->current_buffer_data_ = NULL;
 
     // If there was an exception in one of the callbacks
-    if (parser->got_exception_)
+    if (parser->got_exception_) {
+      // Spans left over point into this buffer, don't carry them over.
+      parser->num_body_spans_ = 0;
       return;
+    }
 
     Local<Integer> nparsed_obj = Integer::New(env->isolate(), nparsed);
     // If there was a parse error in one of the callbacks
@@ -447,8 +777,10 @@ class Parser : public BaseObject {
 
     int rv = http_parser_execute(&(parser->parser_), &settings, NULL, 0);
 
-    if (parser->got_exception_)
+    if (parser->got_exception_) {
+      parser->num_body_spans_ = 0;
       return;
+    }
 
     if (rv != 0) {
       enum http_errno err = HTTP_PARSER_ERRNO(&parser->parser_);
@@ -476,6 +808,16 @@ class Parser : public BaseObject {
     // Should always be called from the same context.
     assert(env == parser->env());
     parser->Init(type);
+    parser->ReleaseHeaders();
+    parser->raw_headers_ = false;
+  }
+
+
+  // parser.setRawHeaders(enable)
+  static void SetRawHeaders(const FunctionCallbackInfo<Value>& args) {
+    HandleScope handle_scope(args.GetIsolate());
+    Parser* parser = Unwrap<Parser>(args.Holder());
+    parser->raw_headers_ = args[0]->IsTrue();
   }
 
 
@@ -492,13 +834,16 @@ class Parser : public BaseObject {
 
  private:
 
-  Local<Array> CreateHeaders() {
+  Local<Object> CreateHeaders() {
+    if (raw_headers_)
+      return CreateRawHeaders();
+
     // num_values_ is either -1 or the entry # of the last header
     // so num_values_ == 0 means there's a single header
     Local<Array> headers = Array::New(env()->isolate(), 2 * num_values_);
 
     for (int i = 0; i < num_values_; ++i) {
-      headers->Set(2 * i, fields_[i].ToString(env()));
+      headers->Set(2 * i, fields_[i].ToHeaderName(env()));
       headers->Set(2 * i + 1, values_[i].ToString(env()));
     }
 
@@ -506,6 +851,175 @@ class Parser : public BaseObject {
   }
 
 
+  // Packs all header fields and values into a single buffer:
+  //
+  //   uint32le count         number of field/value pairs
+  //   uint32le end[2*count]  end offset of each field and value
+  //   char data[]            the fields and values, back to back
+  //
+  // Offsets are relative to the start of the buffer. The first string starts
+  // where the offset table ends, every other one where the previous ends.
+  Local<Object> CreateRawHeaders() {
+    size_t table_size = 4 * (1 + 2 * num_values_);
+    size_t size = table_size;
+    for (int i = 0; i < num_values_; ++i)
+      size += fields_[i].size_ + values_[i].size_;
+
+    Local<Object> buffer = Buffer::New(env(), size);
+    unsigned char* data =
+        reinterpret_cast<unsigned char*>(Buffer::Data(buffer));
+    unsigned char* table = data;
+    size_t offset = table_size;
+
+    WriteUInt32LE(table, num_values_);
+    table += 4;
+
+    for (int i = 0; i < 2 * num_values_; ++i) {
+      const StringPtr& str = (i % 2 == 0) ? fields_[i / 2] : values_[i / 2];
+      if (str.size_ > 0)
+        memcpy(data + offset, str.str_, str.size_);
+      offset += str.size_;
+      WriteUInt32LE(table, offset);
+      table += 4;
+    }
+
+    assert(offset == size);
+    return buffer;
+  }
+
+
+  static void WriteUInt32LE(unsigned char* p, size_t value) {
+    p[0] = value & 0xff;
+    p[1] = (value >> 8) & 0xff;
+    p[2] = (value >> 16) & 0xff;
+    p[3] = (value >> 24) & 0xff;
+  }
+
+
+  // Doubles the room for header fields and values. The strings move over to
+  // the new arrays without copying the data they point to.
+  void GrowHeaders() {
+    int capacity = 2 * header_capacity_;
+    StringPtr* fields = new StringPtr[capacity];
+    StringPtr* values = new StringPtr[capacity];
+
+    for (int i = 0; i < header_capacity_; i++) {
+      fields_[i].MoveTo(&fields[i]);
+      values_[i].MoveTo(&values[i]);
+    }
+
+    delete[] fields_;
+    delete[] values_;
+    fields_ = fields;
+    values_ = values;
+    header_capacity_ = capacity;
+  }
+
+
+  // Pooled parsers are reinitialized for a new connection. What the last one
+  // needed for its headers is no indication for the next, so the arrays go
+  // back to their initial size and the strings let go of their storage.
+  void ReleaseHeaders() {
+    if (header_capacity_ > kInitialHeaderCapacity) {
+      delete[] fields_;
+      delete[] values_;
+      fields_ = new StringPtr[kInitialHeaderCapacity];
+      values_ = new StringPtr[kInitialHeaderCapacity];
+      header_capacity_ = kInitialHeaderCapacity;
+    } else {
+      for (int i = 0; i < header_capacity_; i++) {
+        fields_[i].Release();
+        values_[i].Release();
+      }
+    }
+    url_.Release();
+    status_message_.Release();
+  }
+
+
+  void AddToBatch(Local<Value> value) {
+    batch_events_->Set(batch_events_->Length(), value);
+  }
+
+
+  void AddToBatch(size_t value) {
+    AddToBatch(Integer::NewFromUnsigned(env()->isolate(), value));
+  }
+
+
+  // Replays everything that happened during this execute() in JS land with
+  // a single onBatch(buffer, events) call. |events| is a flat list of
+  // callback indices, each followed by the arguments for that callback:
+  //
+  //   kOnHeadersComplete, info
+  //   kOnBody, offset, length
+  //   kOnHeaders, headers, url
+  //   kOnMessageComplete
+  void FlushBatch() {
+    if (!batch_)
+      return;
+
+    HandleScope scope(env()->isolate());
+
+    Local<Array> events = batch_events_;
+    batch_events_.Clear();
+    batch_ = false;
+
+    if (events->Length() == 0)
+      return;
+
+    Local<Object> obj = object();
+    Local<Value> cb = obj->Get(kOnBatch);
+
+    if (!cb->IsFunction())
+      return;
+
+    Local<Value> argv[2] = { current_buffer_, events };
+    Local<Value> r = cb.As<Function>()->Call(obj, ARRAY_SIZE(argv), argv);
+
+    if (r.IsEmpty())
+      got_exception_ = true;
+  }
+
+
+  // Hands the body data collected during this execute() to JS land in one
+  // call: onBodySpans(buffer, [offset0, length0, offset1, length1, ...]).
+  // Returns -1 if the callback threw.
+  int FlushBodySpans() {
+    if (num_body_spans_ == 0)
+      return 0;
+
+    HandleScope scope(env()->isolate());
+
+    int count = num_body_spans_;
+    num_body_spans_ = 0;
+
+    Local<Object> obj = object();
+    Local<Value> cb = obj->Get(kOnBodySpans);
+
+    if (!cb->IsFunction())
+      return 0;
+
+    Local<Array> spans = Array::New(env()->isolate(), 2 * count);
+    for (int i = 0; i < count; i++) {
+      spans->Set(2 * i, Integer::NewFromUnsigned(env()->isolate(),
+                                                 body_spans_[i].offset));
+      spans->Set(2 * i + 1, Integer::NewFromUnsigned(env()->isolate(),
+                                                     body_spans_[i].length));
+    }
+
+    Local<Value> argv[2] = { current_buffer_, spans };
+    Local<Value> r = cb.As<Function>()->Call(obj, ARRAY_SIZE(argv), argv);
+
+    if (r.IsEmpty()) {
+      got_exception_ = true;
+      return -1;
+    }
+
+    return 0;
+  }
+
+
   // spill headers and request path to JS land
   void Flush() {
     HandleScope scope(env()->isolate());
@@ -527,7 +1041,6 @@ class Parser : public BaseObject {
       got_exception_ = true;
 
     url_.Reset();
-    have_flushed_ = true;
   }
 
 
@@ -537,19 +1050,37 @@ class Parser : public BaseObject {
     status_message_.Reset();
     num_fields_ = 0;
     num_values_ = 0;
-    have_flushed_ = false;
+    num_body_spans_ = 0;
+    headers_full_ = false;
+    batch_body_ = false;
+    batch_ = false;
     got_exception_ = false;
   }
 
 
+  static const int kInitialHeaderCapacity = 32;
+
+  struct BodySpan {
+    size_t offset;
+    size_t length;
+  };
+
   http_parser parser_;
-  StringPtr fields_[32];  // header fields
-  StringPtr values_[32];  // header values
+  StringPtr* fields_;  // header fields
+  StringPtr* values_;  // header values
+  int header_capacity_;
   StringPtr url_;
   StringPtr status_message_;
   int num_fields_;
   int num_values_;
-  bool have_flushed_;
+  int max_header_pairs_;  // parser.maxHeaderPairs, <= 0 means no limit
+  bool headers_full_;  // ignore header data until the next message
+  bool raw_headers_;
+  BodySpan body_spans_[64];  // body data not yet passed to JS land
+  int num_body_spans_;
+  bool batch_body_;
+  bool batch_;
+  Local<Array> batch_events_;  // only valid while batch_ is set
   bool got_exception_;
   Local<Object> current_buffer_;
   size_t current_buffer_len_;
@@ -592,6 +1123,10 @@ void InitHttpParser(Handle<Object> target,
          Integer::NewFromUnsigned(env->isolate(), kOnBody));
   t->Set(FIXED_ONE_BYTE_STRING(env->isolate(), "kOnMessageComplete"),
          Integer::NewFromUnsigned(env->isolate(), kOnMessageComplete));
+  t->Set(FIXED_ONE_BYTE_STRING(env->isolate(), "kOnBodySpans"),
+         Integer::NewFromUnsigned(env->isolate(), kOnBodySpans));
+  t->Set(FIXED_ONE_BYTE_STRING(env->isolate(), "kOnBatch"),
+         Integer::NewFromUnsigned(env->isolate(), kOnBatch));
 
   Local<Array> methods = Array::New(env->isolate());
 #define V(num, name, string)                                                  \
@@ -606,6 +1141,12 @@ void InitHttpParser(Handle<Object> target,
   NODE_SET_PROTOTYPE_METHOD(t, "reinitialize", Parser::Reinitialize);
   NODE_SET_PROTOTYPE_METHOD(t, "pause", Parser::Pause<true>);
   NODE_SET_PROTOTYPE_METHOD(t, "resume", Parser::Pause<false>);
+  NODE_SET_PROTOTYPE_METHOD(t, "setRawHeaders", Parser::SetRawHeaders);
+
+  if (env->http_header_names_array().IsEmpty()) {
+    env->set_http_header_names_array(
+        Array::New(env->isolate(), 2 * ARRAY_SIZE(common_header_names)));
+  }
 
   target->Set(FIXED_ONE_BYTE_STRING(env->isolate(), "HTTPParser"),
               t->GetFunction());
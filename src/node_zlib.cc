@@ -21,14 +21,20 @@
 
 #include "node.h"
 #include "node_buffer.h"
+#include "node_internals.h"  // snprintf
+#include "node_wrap.h"  // WITH_GENERIC_STREAM
 
 #include "async-wrap.h"
 #include "async-wrap-inl.h"
+#include "base-object.h"
+#include "base-object-inl.h"
 #include "env.h"
 #include "env-inl.h"
+#include "stream_wrap.h"
 #include "util.h"
 #include "util-inl.h"
 
+#include "uv.h"
 #include "v8.h"
 #include "zlib.h"
 
@@ -47,6 +53,7 @@ using v8::Handle;
 using v8::HandleScope;
 using v8::Integer;
 using v8::Local;
+using v8::Null;
 using v8::Number;
 using v8::Object;
 using v8::String;
@@ -67,6 +74,451 @@ enum node_zlib_mode {
 void InitZlib(v8::Handle<v8::Object> target);
 
 
+static bool IsDeflateMode(node_zlib_mode mode) {
+  return mode == DEFLATE || mode == GZIP || mode == DEFLATERAW;
+}
+
+
+// deflateInit2() or inflateInit2() for |mode|. zlib takes the kind of header
+// to write or expect from the range and sign of windowBits.
+static int InitStream(z_stream* strm,
+                      node_zlib_mode mode,
+                      int level,
+                      int windowBits,
+                      int memLevel,
+                      int strategy) {
+  strm->zalloc = Z_NULL;
+  strm->zfree = Z_NULL;
+  strm->opaque = Z_NULL;
+
+  if (mode == GZIP || mode == GUNZIP) {
+    windowBits += 16;
+  }
+
+  if (mode == UNZIP) {
+    windowBits += 32;
+  }
+
+  if (mode == DEFLATERAW || mode == INFLATERAW) {
+    windowBits *= -1;
+  }
+
+  switch (mode) {
+    case DEFLATE:
+    case GZIP:
+    case DEFLATERAW:
+      return deflateInit2(strm,
+                          level,
+                          Z_DEFLATED,
+                          windowBits,
+                          memLevel,
+                          strategy);
+    case INFLATE:
+    case GUNZIP:
+    case INFLATERAW:
+    case UNZIP:
+      return inflateInit2(strm, windowBits);
+    default:
+      assert(0 && "wtf?");
+      return Z_STREAM_ERROR;
+  }
+}
+
+
+// One deflate() or inflate() call. Safe to call from the thread pool.
+static int Step(z_stream* strm,
+                node_zlib_mode mode,
+                int flush,
+                const Bytef* dictionary,
+                size_t dictionary_len) {
+  if (IsDeflateMode(mode))
+    return deflate(strm, flush);
+
+  int err = inflate(strm, flush);
+
+  // If data was encoded with dictionary
+  if (err == Z_NEED_DICT && dictionary != NULL) {
+    // Load it
+    err = inflateSetDictionary(strm, dictionary, dictionary_len);
+    if (err == Z_OK) {
+      // And try to decode again
+      err = inflate(strm, flush);
+    } else if (err == Z_DATA_ERROR) {
+      // Both inflateSetDictionary() and inflate() return Z_DATA_ERROR.
+      // Make it possible for the caller to tell a bad dictionary from bad
+      // input.
+      err = Z_NEED_DICT;
+    }
+  }
+
+  return err;
+}
+
+
+struct SharedDictionary;
+
+
+// Setting up a deflate state means allocating and touching a few hundred kB,
+// which costs more than compressing a small response does. Streams that are
+// done with get reset and kept in a process-wide pool instead, keyed by the
+// parameters they were initialized with, so that the next ZCtx or one-shot
+// job that asks for the same only pays for the reset.
+struct PooledStream {
+  z_stream strm;
+  node_zlib_mode mode;
+  int level;
+  int windowBits;
+  int memLevel;
+  int strategy;
+  SharedDictionary* dictionary;  // Set when primed, those aren't pooled.
+  PooledStream* next;
+};
+
+struct StreamPoolStats {
+  size_t size;
+  size_t available;
+  uint64_t hits;
+  uint64_t misses;
+};
+
+static const size_t kDefaultStreamPoolSize = 16;
+static PooledStream* stream_pool;  // Most recently released first.
+static StreamPoolStats stream_pool_stats = { kDefaultStreamPoolSize, 0, 0, 0 };
+static uv_mutex_t stream_pool_mutex;
+static uv_once_t stream_pool_once = UV_ONCE_INIT;
+
+
+static void InitStreamPool() {
+  CHECK_EQ(0, uv_mutex_init(&stream_pool_mutex));
+}
+
+
+static void EndStream(PooledStream* stream) {
+  if (IsDeflateMode(stream->mode))
+    (void)deflateEnd(&stream->strm);
+  else
+    (void)inflateEnd(&stream->strm);
+  delete stream;
+}
+
+
+static void EndStreams(PooledStream* stream) {
+  while (stream != NULL) {
+    PooledStream* next = stream->next;
+    EndStream(stream);
+    stream = next;
+  }
+}
+
+
+static PooledStream* NewStream(node_zlib_mode mode,
+                               int level,
+                               int windowBits,
+                               int memLevel,
+                               int strategy,
+                               int* err) {
+  PooledStream* stream = new PooledStream;
+  memset(stream, 0, sizeof(*stream));
+  stream->mode = mode;
+  stream->level = level;
+  stream->windowBits = windowBits;
+  stream->memLevel = memLevel;
+  stream->strategy = strategy;
+  *err = InitStream(&stream->strm, mode, level, windowBits, memLevel, strategy);
+  return stream;
+}
+
+
+// Returns a stream that is ready to use, from the pool if there is one with
+// the same parameters. |*err| is InitStream()'s result, the stream has to go
+// back through ReleaseStream() either way. Safe to call from the thread pool.
+static z_stream* AcquireStream(node_zlib_mode mode,
+                               int level,
+                               int windowBits,
+                               int memLevel,
+                               int strategy,
+                               int* err) {
+  uv_once(&stream_pool_once, InitStreamPool);
+
+  // Only windowBits matters to inflate.
+  if (!IsDeflateMode(mode)) {
+    level = 0;
+    memLevel = 0;
+    strategy = 0;
+  }
+
+  uv_mutex_lock(&stream_pool_mutex);
+  PooledStream** p = &stream_pool;
+  while (*p != NULL &&
+         ((*p)->mode != mode ||
+          (*p)->level != level ||
+          (*p)->windowBits != windowBits ||
+          (*p)->memLevel != memLevel ||
+          (*p)->strategy != strategy)) {
+    p = &(*p)->next;
+  }
+  PooledStream* stream = *p;
+  if (stream != NULL) {
+    *p = stream->next;
+    stream_pool_stats.available--;
+    stream_pool_stats.hits++;
+  } else {
+    stream_pool_stats.misses++;
+  }
+  uv_mutex_unlock(&stream_pool_mutex);
+
+  if (stream != NULL) {
+    stream->next = NULL;
+    *err = Z_OK;
+    return &stream->strm;
+  }
+
+  stream = NewStream(mode, level, windowBits, memLevel, strategy, err);
+  return &stream->strm;
+}
+
+
+// deflateParams() that keeps the pool's key in sync with the stream.
+static int SetStreamParams(z_stream* strm, int level, int strategy) {
+  PooledStream* stream = ContainerOf(&PooledStream::strm, strm);
+  int err = deflateParams(strm, level, strategy);
+  if (err == Z_OK || err == Z_BUF_ERROR) {
+    // zlib takes the new parameters even when it couldn't flush.
+    stream->level = level;
+    stream->strategy = strategy;
+  }
+  return err;
+}
+
+
+// Resets |strm| and puts it in the pool, or ends it if the pool is full or
+// the stream can't be reused. Safe to call from the thread pool.
+static void ReleaseStream(z_stream* strm) {
+  PooledStream* stream = ContainerOf(&PooledStream::strm, strm);
+
+  // A reset would undo the priming.
+  if (stream->dictionary != NULL)
+    return EndStream(stream);
+
+  int err;
+  if (IsDeflateMode(stream->mode))
+    err = deflateReset(strm);
+  else
+    err = inflateReset(strm);
+
+  if (err != Z_OK)
+    return EndStream(stream);
+
+  PooledStream* evicted = NULL;
+
+  uv_mutex_lock(&stream_pool_mutex);
+  stream->next = stream_pool;
+  stream_pool = stream;
+  stream_pool_stats.available++;
+  if (stream_pool_stats.available > stream_pool_stats.size) {
+    // Drop the least recently released one.
+    PooledStream** p = &stream_pool;
+    while ((*p)->next != NULL)
+      p = &(*p)->next;
+    evicted = *p;
+    *p = NULL;
+    stream_pool_stats.available--;
+  }
+  uv_mutex_unlock(&stream_pool_mutex);
+
+  EndStreams(evicted);
+}
+
+
+static void ResizeStreamPool(size_t size) {
+  uv_once(&stream_pool_once, InitStreamPool);
+
+  PooledStream* evicted = NULL;
+
+  uv_mutex_lock(&stream_pool_mutex);
+  stream_pool_stats.size = size;
+  PooledStream** p = &stream_pool;
+  for (size_t i = 0; i < size && *p != NULL; i++)
+    p = &(*p)->next;
+  evicted = *p;
+  *p = NULL;
+  if (stream_pool_stats.available > size)
+    stream_pool_stats.available = size;
+  uv_mutex_unlock(&stream_pool_mutex);
+
+  EndStreams(evicted);
+}
+
+
+static void CopyStreamPoolStats(StreamPoolStats* stats) {
+  uv_once(&stream_pool_once, InitStreamPool);
+  uv_mutex_lock(&stream_pool_mutex);
+  *stats = stream_pool_stats;
+  uv_mutex_unlock(&stream_pool_mutex);
+}
+
+
+// Dictionaries registered with registerDictionary(). Deflating with a
+// dictionary starts with running the whole dictionary through the hash
+// chains, that's what deflateSetDictionary() spends its time on. For a
+// registered one that happens once per set of parameters, in a template
+// stream that new streams are copied from with deflateCopy(). Inflate has
+// nothing to prime ahead of time, a zlib stream asks for its dictionary
+// after the header, but it shares the registered bytes rather than taking a
+// copy of its own.
+//
+// Dictionaries stay registered for the life of the process, registering the
+// same bytes twice gives back the same id.
+struct SharedDictionary {
+  Bytef* data;
+  size_t length;
+  uLong adler;
+  PooledStream* templates;
+};
+
+static SharedDictionary** dictionaries;  // Indexed by id - 1.
+static size_t dictionary_count;
+static uv_mutex_t dictionary_mutex;
+static uv_once_t dictionary_once = UV_ONCE_INIT;
+
+
+static void InitDictionaries() {
+  CHECK_EQ(0, uv_mutex_init(&dictionary_mutex));
+}
+
+
+static uint32_t AddDictionary(const char* data, size_t length) {
+  uv_once(&dictionary_once, InitDictionaries);
+
+  const Bytef* bytes = reinterpret_cast<const Bytef*>(data);
+  uLong adler = adler32(adler32(0, Z_NULL, 0), bytes, length);
+
+  uv_mutex_lock(&dictionary_mutex);
+
+  for (size_t i = 0; i < dictionary_count; i++) {
+    SharedDictionary* dictionary = dictionaries[i];
+    if (dictionary->adler == adler &&
+        dictionary->length == length &&
+        memcmp(dictionary->data, bytes, length) == 0) {
+      uv_mutex_unlock(&dictionary_mutex);
+      return i + 1;
+    }
+  }
+
+  SharedDictionary* dictionary = new SharedDictionary;
+  dictionary->data = new Bytef[length];
+  memcpy(dictionary->data, bytes, length);
+  dictionary->length = length;
+  dictionary->adler = adler;
+  dictionary->templates = NULL;
+
+  void* grown = realloc(dictionaries,
+                        (dictionary_count + 1) * sizeof(*dictionaries));
+  CHECK_NE(grown, static_cast<void*>(NULL));
+  dictionaries = static_cast<SharedDictionary**>(grown);
+  dictionaries[dictionary_count++] = dictionary;
+  uint32_t id = dictionary_count;
+
+  uv_mutex_unlock(&dictionary_mutex);
+
+  return id;
+}
+
+
+static SharedDictionary* FindDictionary(uint32_t id) {
+  uv_once(&dictionary_once, InitDictionaries);
+  SharedDictionary* dictionary = NULL;
+  uv_mutex_lock(&dictionary_mutex);
+  if (id >= 1 && id <= dictionary_count)
+    dictionary = dictionaries[id - 1];
+  uv_mutex_unlock(&dictionary_mutex);
+  return dictionary;
+}
+
+
+// Returns a deflate stream that's primed with |dictionary|, a copy of the
+// template for these parameters. |*err| and ReleaseStream() work like they
+// do for AcquireStream(). Safe to call from the thread pool.
+static z_stream* AcquirePrimedStream(SharedDictionary* dictionary,
+                                     node_zlib_mode mode,
+                                     int level,
+                                     int windowBits,
+                                     int memLevel,
+                                     int strategy,
+                                     int* err) {
+  assert(mode == DEFLATE || mode == DEFLATERAW);
+
+  uv_mutex_lock(&dictionary_mutex);
+  PooledStream* primed = dictionary->templates;
+  while (primed != NULL &&
+         (primed->mode != mode ||
+          primed->level != level ||
+          primed->windowBits != windowBits ||
+          primed->memLevel != memLevel ||
+          primed->strategy != strategy)) {
+    primed = primed->next;
+  }
+  if (primed == NULL) {
+    primed = NewStream(mode, level, windowBits, memLevel, strategy, err);
+    if (*err == Z_OK) {
+      *err = deflateSetDictionary(&primed->strm,
+                                  dictionary->data,
+                                  dictionary->length);
+    }
+    if (*err == Z_OK) {
+      primed->dictionary = dictionary;
+      primed->next = dictionary->templates;
+      dictionary->templates = primed;
+    } else {
+      EndStream(primed);
+      primed = NULL;
+    }
+  }
+  uv_mutex_unlock(&dictionary_mutex);
+
+  PooledStream* stream;
+  if (primed != NULL) {
+    // Templates are never written to again, copying from one needs no lock.
+    stream = new PooledStream(*primed);
+    memset(&stream->strm, 0, sizeof(stream->strm));
+    stream->next = NULL;
+    *err = deflateCopy(&stream->strm, &primed->strm);
+  } else {
+    // Fails all over again, but with a stream to report it from.
+    stream = NewStream(mode, level, windowBits, memLevel, strategy, err);
+    stream->dictionary = dictionary;
+    if (*err == Z_OK) {
+      *err = deflateSetDictionary(&stream->strm,
+                                  dictionary->data,
+                                  dictionary->length);
+    }
+  }
+  return &stream->strm;
+}
+
+
+// AcquirePrimedStream() for deflate with a registered dictionary,
+// AcquireStream() for everything else.
+static z_stream* AcquireStreamWith(SharedDictionary* dictionary,
+                                   node_zlib_mode mode,
+                                   int level,
+                                   int windowBits,
+                                   int memLevel,
+                                   int strategy,
+                                   int* err) {
+  if (dictionary != NULL && (mode == DEFLATE || mode == DEFLATERAW)) {
+    return AcquirePrimedStream(dictionary,
+                               mode,
+                               level,
+                               windowBits,
+                               memLevel,
+                               strategy,
+                               err);
+  }
+  return AcquireStream(mode, level, windowBits, memLevel, strategy, err);
+}
+
+
 /**
  * Deflate/Inflate
  */
@@ -84,7 +536,9 @@ class ZCtx : public AsyncWrap {
         level_(0),
         memLevel_(0),
         mode_(mode),
+        shared_dictionary_(NULL),
         strategy_(0),
+        strm_(NULL),
         windowBits_(0),
         write_in_progress_(false),
         pending_close_(false),
@@ -108,20 +562,24 @@ class ZCtx : public AsyncWrap {
     assert(init_done_ && "close before init");
     assert(mode_ <= UNZIP);
 
+    if (strm_ != NULL) {
+      ReleaseStream(strm_);
+      strm_ = NULL;
+    }
+
     if (mode_ == DEFLATE || mode_ == GZIP || mode_ == DEFLATERAW) {
-      (void)deflateEnd(&strm_);
       int64_t change_in_bytes = -static_cast<int64_t>(kDeflateContextSize);
       env()->isolate()->AdjustAmountOfExternalAllocatedMemory(change_in_bytes);
     } else if (mode_ == INFLATE || mode_ == GUNZIP || mode_ == INFLATERAW ||
                mode_ == UNZIP) {
-      (void)inflateEnd(&strm_);
       int64_t change_in_bytes = -static_cast<int64_t>(kInflateContextSize);
       env()->isolate()->AdjustAmountOfExternalAllocatedMemory(change_in_bytes);
     }
     mode_ = NONE;
 
     if (dictionary_ != NULL) {
-      delete[] dictionary_;
+      if (shared_dictionary_ == NULL)
+        delete[] dictionary_;
       dictionary_ = NULL;
     }
   }
@@ -195,10 +653,10 @@ class ZCtx : public AsyncWrap {
     // build up the work request
     uv_work_t* work_req = &(ctx->work_req_);
 
-    ctx->strm_.avail_in = in_len;
-    ctx->strm_.next_in = in;
-    ctx->strm_.avail_out = out_len;
-    ctx->strm_.next_out = out;
+    ctx->strm_->avail_in = in_len;
+    ctx->strm_->next_in = in;
+    ctx->strm_->avail_out = out_len;
+    ctx->strm_->next_out = out;
     ctx->flush_ = flush;
 
     // set this so that later on, I can easily tell how much was written.
@@ -226,9 +684,9 @@ class ZCtx : public AsyncWrap {
     Environment* env = Environment::GetCurrent(args.GetIsolate());
     HandleScope scope(env->isolate());
     Local<Integer> avail_out = Integer::New(env->isolate(),
-                                            ctx->strm_.avail_out);
+                                            ctx->strm_->avail_out);
     Local<Integer> avail_in = Integer::New(env->isolate(),
-                                           ctx->strm_.avail_in);
+                                           ctx->strm_->avail_in);
 
     ctx->write_in_progress_ = false;
 
@@ -251,38 +709,11 @@ class ZCtx : public AsyncWrap {
     // If the avail_out is left at 0, then it means that it ran out
     // of room.  If there was avail_out left over, then it means
     // that all of the input was consumed.
-    switch (ctx->mode_) {
-      case DEFLATE:
-      case GZIP:
-      case DEFLATERAW:
-        ctx->err_ = deflate(&ctx->strm_, ctx->flush_);
-        break;
-      case UNZIP:
-      case INFLATE:
-      case GUNZIP:
-      case INFLATERAW:
-        ctx->err_ = inflate(&ctx->strm_, ctx->flush_);
-
-        // If data was encoded with dictionary
-        if (ctx->err_ == Z_NEED_DICT && ctx->dictionary_ != NULL) {
-          // Load it
-          ctx->err_ = inflateSetDictionary(&ctx->strm_,
-                                           ctx->dictionary_,
-                                           ctx->dictionary_len_);
-          if (ctx->err_ == Z_OK) {
-            // And try to decode again
-            ctx->err_ = inflate(&ctx->strm_, ctx->flush_);
-          } else if (ctx->err_ == Z_DATA_ERROR) {
-            // Both inflateSetDictionary() and inflate() return Z_DATA_ERROR.
-            // Make it possible for After() to tell a bad dictionary from bad
-            // input.
-            ctx->err_ = Z_NEED_DICT;
-          }
-        }
-        break;
-      default:
-        assert(0 && "wtf?");
-    }
+    ctx->err_ = Step(ctx->strm_,
+                     ctx->mode_,
+                     ctx->flush_,
+                     ctx->dictionary_,
+                     ctx->dictionary_len_);
 
     // pass any errors back to the main thread to deal with.
 
@@ -330,9 +761,9 @@ class ZCtx : public AsyncWrap {
       return;
 
     Local<Integer> avail_out = Integer::New(env->isolate(),
-                                            ctx->strm_.avail_out);
+                                            ctx->strm_->avail_out);
     Local<Integer> avail_in = Integer::New(env->isolate(),
-                                           ctx->strm_.avail_in);
+                                           ctx->strm_->avail_in);
 
     ctx->write_in_progress_ = false;
 
@@ -351,8 +782,8 @@ class ZCtx : public AsyncWrap {
     // If you hit this assertion, you forgot to enter the v8::Context first.
     assert(env->context() == env->isolate()->GetCurrentContext());
 
-    if (ctx->strm_.msg != NULL) {
-      message = ctx->strm_.msg;
+    if (ctx->strm_ != NULL && ctx->strm_->msg != NULL) {
+      message = ctx->strm_->msg;
     }
 
     HandleScope scope(env->isolate());
@@ -393,6 +824,7 @@ class ZCtx : public AsyncWrap {
 
     assert((args.Length() == 4 || args.Length() == 5) &&
            "init(windowBits, level, memLevel, strategy, [dictionary])");
+    // dictionary is a Buffer or the id of a registered one.
 
     ZCtx* ctx = Unwrap<ZCtx>(args.Holder());
 
@@ -421,11 +853,18 @@ class ZCtx : public AsyncWrap {
       dictionary = new char[dictionary_len];
 
       memcpy(dictionary, Buffer::Data(dictionary_), dictionary_len);
+    } else if (args.Length() >= 5 && args[4]->IsUint32()) {
+      ctx->shared_dictionary_ = FindDictionary(args[4]->Uint32Value());
+      assert(ctx->shared_dictionary_ != NULL && "unknown dictionary");
+      dictionary = reinterpret_cast<char*>(ctx->shared_dictionary_->data);
+      dictionary_len = ctx->shared_dictionary_->length;
     }
 
     Init(ctx, level, windowBits, memLevel, strategy,
          dictionary, dictionary_len);
-    SetDictionary(ctx);
+    // Streams for a registered dictionary come primed.
+    if (ctx->shared_dictionary_ == NULL)
+      SetDictionary(ctx);
   }
 
   static void Params(const FunctionCallbackInfo<Value>& args) {
@@ -456,49 +895,22 @@ class ZCtx : public AsyncWrap {
     ctx->memLevel_ = memLevel;
     ctx->strategy_ = strategy;
 
-    ctx->strm_.zalloc = Z_NULL;
-    ctx->strm_.zfree = Z_NULL;
-    ctx->strm_.opaque = Z_NULL;
-
     ctx->flush_ = Z_NO_FLUSH;
 
-    ctx->err_ = Z_OK;
-
-    if (ctx->mode_ == GZIP || ctx->mode_ == GUNZIP) {
-      ctx->windowBits_ += 16;
-    }
-
-    if (ctx->mode_ == UNZIP) {
-      ctx->windowBits_ += 32;
-    }
-
-    if (ctx->mode_ == DEFLATERAW || ctx->mode_ == INFLATERAW) {
-      ctx->windowBits_ *= -1;
-    }
-
-    switch (ctx->mode_) {
-      case DEFLATE:
-      case GZIP:
-      case DEFLATERAW:
-        ctx->err_ = deflateInit2(&ctx->strm_,
-                                 ctx->level_,
-                                 Z_DEFLATED,
-                                 ctx->windowBits_,
-                                 ctx->memLevel_,
-                                 ctx->strategy_);
-        ctx->env()->isolate()
-            ->AdjustAmountOfExternalAllocatedMemory(kDeflateContextSize);
-        break;
-      case INFLATE:
-      case GUNZIP:
-      case INFLATERAW:
-      case UNZIP:
-        ctx->err_ = inflateInit2(&ctx->strm_, ctx->windowBits_);
-        ctx->env()->isolate()
-            ->AdjustAmountOfExternalAllocatedMemory(kInflateContextSize);
-        break;
-      default:
-        assert(0 && "wtf?");
+    ctx->strm_ = AcquireStreamWith(ctx->shared_dictionary_,
+                                   ctx->mode_,
+                                   ctx->level_,
+                                   ctx->windowBits_,
+                                   ctx->memLevel_,
+                                   ctx->strategy_,
+                                   &ctx->err_);
+
+    if (IsDeflateMode(ctx->mode_)) {
+      ctx->env()->isolate()
+          ->AdjustAmountOfExternalAllocatedMemory(kDeflateContextSize);
+    } else {
+      ctx->env()->isolate()
+          ->AdjustAmountOfExternalAllocatedMemory(kInflateContextSize);
     }
 
     if (ctx->err_ != Z_OK) {
@@ -522,7 +934,7 @@ class ZCtx : public AsyncWrap {
     switch (ctx->mode_) {
       case DEFLATE:
       case DEFLATERAW:
-        ctx->err_ = deflateSetDictionary(&ctx->strm_,
+        ctx->err_ = deflateSetDictionary(ctx->strm_,
                                          ctx->dictionary_,
                                          ctx->dictionary_len_);
         break;
@@ -541,7 +953,7 @@ class ZCtx : public AsyncWrap {
     switch (ctx->mode_) {
       case DEFLATE:
       case DEFLATERAW:
-        ctx->err_ = deflateParams(&ctx->strm_, level, strategy);
+        ctx->err_ = SetStreamParams(ctx->strm_, level, strategy);
         break;
       default:
         break;
@@ -558,11 +970,11 @@ class ZCtx : public AsyncWrap {
     switch (ctx->mode_) {
       case DEFLATE:
       case DEFLATERAW:
-        ctx->err_ = deflateReset(&ctx->strm_);
+        ctx->err_ = deflateReset(ctx->strm_);
         break;
       case INFLATE:
       case INFLATERAW:
-        ctx->err_ = inflateReset(&ctx->strm_);
+        ctx->err_ = inflateReset(ctx->strm_);
         break;
       default:
         break;
@@ -599,8 +1011,9 @@ class ZCtx : public AsyncWrap {
   int level_;
   int memLevel_;
   node_zlib_mode mode_;
+  SharedDictionary* shared_dictionary_;
   int strategy_;
-  z_stream strm_;
+  z_stream* strm_;
   int windowBits_;
   uv_work_t work_req_;
   bool write_in_progress_;
@@ -609,6 +1022,741 @@ class ZCtx : public AsyncWrap {
 };
 
 
+/**
+ * One-shot compression of a whole buffer, the engine behind zlib.gzip()
+ * and friends. Unlike a ZCtx, which goes back to JS for every chunk of
+ * output, this runs the stream to the end in one go and grows the output
+ * buffer as it goes.
+ */
+class ZBufferJob {
+ public:
+  ZBufferJob(node_zlib_mode mode,
+             int level,
+             int windowBits,
+             int memLevel,
+             int strategy,
+             const char* data,
+             size_t length,
+             Bytef* dictionary,
+             size_t dictionary_len)
+      : mode_(mode),
+        level_(level),
+        windowBits_(windowBits),
+        memLevel_(memLevel),
+        strategy_(strategy),
+        data_(reinterpret_cast<const Bytef*>(data)),
+        length_(length),
+        dictionary_(dictionary),
+        dictionary_len_(dictionary_len),
+        shared_dictionary_(NULL),
+        out_(NULL),
+        out_len_(0),
+        flush_(Z_FINISH),
+        want_crc_(false),
+        crc_(0),
+        err_(Z_OK),
+        message_(NULL) {
+  }
+
+  ~ZBufferJob() {
+    free(out_);
+    if (shared_dictionary_ == NULL)
+      delete[] dictionary_;
+  }
+
+  // Doesn't touch V8, runs on the thread pool for the async version.
+  void Run();
+
+  // The output as a Buffer on success, [message, errno] otherwise.
+  Local<Value> Result(Environment* env);
+
+  Local<Object> ToBuffer(Environment* env);
+
+  // Uses a registered dictionary rather than one of its own.
+  void set_shared_dictionary(SharedDictionary* dictionary) {
+    assert(dictionary_ == NULL);
+    shared_dictionary_ = dictionary;
+    dictionary_ = dictionary->data;
+    dictionary_len_ = dictionary->length;
+  }
+
+  // Compresses with |flush| rather than Z_FINISH, for a block of a stream
+  // that goes on.
+  void set_flush(int flush) { flush_ = flush; }
+
+  // Makes Run() compute the CRC-32 of the input too.
+  void set_want_crc(bool want_crc) { want_crc_ = want_crc; }
+
+  int err() const { return err_; }
+  const char* message() const { return message_; }
+  uLong crc() const { return crc_; }
+
+ private:
+  void Fail(z_stream* strm, int err, const char* message);
+  bool Grow(z_stream* strm, size_t size);
+
+  static const size_t kMinInflateSize = 16 * 1024;
+
+  const node_zlib_mode mode_;
+  const int level_;
+  const int windowBits_;
+  const int memLevel_;
+  const int strategy_;
+  const Bytef* data_;  // Kept alive by the caller
+  const size_t length_;
+  Bytef* dictionary_;
+  size_t dictionary_len_;
+  SharedDictionary* shared_dictionary_;
+  Bytef* out_;
+  size_t out_len_;
+  int flush_;
+  bool want_crc_;
+  uLong crc_;
+  int err_;
+  const char* message_;
+};
+
+
+void ZBufferJob::Fail(z_stream* strm, int err, const char* message) {
+  err_ = err;
+  // zlib's messages are string constants, they outlive the stream.
+  message_ = strm->msg != NULL ? strm->msg : message;
+}
+
+
+// Makes room for |size| bytes of output, counting what's there already.
+bool ZBufferJob::Grow(z_stream* strm, size_t size) {
+  if (size > Buffer::kMaxLength)
+    size = Buffer::kMaxLength;
+  if (size <= out_len_) {
+    Fail(strm, Z_BUF_ERROR, "Output exceeds maximum buffer size");
+    return false;
+  }
+
+  Bytef* out = static_cast<Bytef*>(realloc(out_, size));
+  if (out == NULL) {
+    Fail(strm, Z_MEM_ERROR, "Out of memory");
+    return false;
+  }
+
+  size_t written = out_len_ - strm->avail_out;
+  strm->next_out = out + written;
+  strm->avail_out = size - written;
+  out_ = out;
+  out_len_ = size;
+  return true;
+}
+
+
+void ZBufferJob::Run() {
+  int err;
+  z_stream* strm = AcquireStreamWith(shared_dictionary_,
+                                     mode_,
+                                     level_,
+                                     windowBits_,
+                                     memLevel_,
+                                     strategy_,
+                                     &err);
+  if (err != Z_OK) {
+    Fail(strm, err, "Init error");
+    return ReleaseStream(strm);
+  }
+
+  strm->next_in = const_cast<Bytef*>(data_);
+  strm->avail_in = length_;
+  strm->next_out = NULL;
+  strm->avail_out = 0;
+
+  size_t size;
+  if (IsDeflateMode(mode_)) {
+    // Enough for the whole stream, one allocation is all it takes.
+    size = deflateBound(strm, length_);
+    if (dictionary_ != NULL &&
+        shared_dictionary_ == NULL &&
+        (mode_ == DEFLATE || mode_ == DEFLATERAW)) {
+      err = deflateSetDictionary(strm, dictionary_, dictionary_len_);
+      if (err != Z_OK)
+        Fail(strm, err, "Failed to set dictionary");
+    }
+  } else {
+    size = length_ * 4;
+    if (size < kMinInflateSize)
+      size = kMinInflateSize;
+  }
+
+  if (err_ == Z_OK && Grow(strm, size)) {
+    for (;;) {
+      err = Step(strm, mode_, flush_, dictionary_, dictionary_len_);
+
+      if (err == Z_STREAM_END)
+        break;
+
+      if (err == Z_NEED_DICT) {
+        Fail(strm,
+             err,
+             dictionary_ == NULL ? "Missing dictionary" : "Bad dictionary");
+        break;
+      }
+
+      if (err != Z_OK && err != Z_BUF_ERROR) {
+        Fail(strm, err, "Zlib error");
+        break;
+      }
+
+      // Out of input, not out of room. That's the end of a flushed block,
+      // and like the streams, take what's there from a truncated input
+      // rather than call it an error.
+      if (strm->avail_out != 0)
+        break;
+
+      if (!Grow(strm, out_len_ * 2))
+        break;
+    }
+  }
+
+  size = out_len_ - strm->avail_out;
+
+  ReleaseStream(strm);
+
+  if (want_crc_)
+    crc_ = crc32(crc32(0, Z_NULL, 0), data_, length_);
+
+  if (err_ != Z_OK)
+    return;
+
+  // Give back what deflateBound() or the doubling overshot by.
+  if (size != 0 && size < out_len_) {
+    Bytef* out = static_cast<Bytef*>(realloc(out_, size));
+    if (out != NULL)
+      out_ = out;
+  }
+  out_len_ = size;
+}
+
+
+Local<Object> ZBufferJob::ToBuffer(Environment* env) {
+  if (out_len_ == 0)
+    return Buffer::New(env, 0);
+  Local<Object> buffer =
+      Buffer::Use(env, reinterpret_cast<char*>(out_), out_len_);
+  out_ = NULL;  // Owned by the buffer now.
+  out_len_ = 0;
+  return buffer;
+}
+
+
+Local<Value> ZBufferJob::Result(Environment* env) {
+  if (err_ == Z_OK)
+    return ToBuffer(env);
+  Local<Array> result = Array::New(env->isolate(), 2);
+  result->Set(0, OneByteString(env->isolate(), message_));
+  result->Set(1, Number::New(env->isolate(), err_));
+  return result;
+}
+
+
+class ZBufferRequest : public AsyncWrap {
+ public:
+  ZBufferRequest(Environment* env, Local<Object> object, ZBufferJob* job)
+      : AsyncWrap(env, object, AsyncWrap::PROVIDER_ZLIB),
+        job_(job) {
+  }
+
+  ~ZBufferRequest() {
+    delete job_;
+    persistent().Reset();
+  }
+
+  void Queue() {
+    uv_queue_work(env()->event_loop(), &work_req_, Work, After);
+  }
+
+ private:
+  static void Work(uv_work_t* work_req) {
+    ZBufferRequest* req = ContainerOf(&ZBufferRequest::work_req_, work_req);
+    req->job_->Run();
+  }
+
+  static void After(uv_work_t* work_req, int status) {
+    assert(status == 0);
+    ZBufferRequest* req = ContainerOf(&ZBufferRequest::work_req_, work_req);
+    Environment* env = req->env();
+    HandleScope handle_scope(env->isolate());
+    Context::Scope context_scope(env->context());
+
+    ZBufferJob* job = req->job_;
+    Local<Value> argv[4] = {
+      Null(env->isolate()),
+      Integer::New(env->isolate(), job->err()),
+      Null(env->isolate()),
+      Integer::NewFromUnsigned(env->isolate(),
+                               static_cast<uint32_t>(job->crc()))
+    };
+    if (job->err() == Z_OK)
+      argv[2] = job->ToBuffer(env);
+    else
+      argv[0] = OneByteString(env->isolate(), job->message());
+
+    req->MakeCallback(env->ondone_string(), ARRAY_SIZE(argv), argv);
+    delete req;
+  }
+
+  uv_work_t work_req_;
+  ZBufferJob* job_;
+};
+
+
+// zlibBuffer(mode, input, windowBits, level, memLevel, strategy,
+//            dictionary, [ondone])
+//
+// dictionary is a Buffer, the id of a registered one, or undefined.
+// Without ondone, returns the output Buffer or [message, errno]. With it,
+// runs on the thread pool and calls ondone(message, errno, output).
+static void ZlibBuffer(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args.GetIsolate());
+  HandleScope scope(env->isolate());
+
+  assert(args.Length() >= 7);
+
+  node_zlib_mode mode = static_cast<node_zlib_mode>(args[0]->Int32Value());
+  assert(mode >= DEFLATE && mode <= UNZIP);
+
+  assert(Buffer::HasInstance(args[1]));
+  Local<Object> input = args[1]->ToObject();
+
+  int windowBits = args[2]->Uint32Value();
+  assert((windowBits >= 8 && windowBits <= 15) && "invalid windowBits");
+
+  int level = args[3]->Int32Value();
+  assert((level >= -1 && level <= 9) && "invalid compression level");
+
+  int memLevel = args[4]->Uint32Value();
+  assert((memLevel >= 1 && memLevel <= 9) && "invalid memlevel");
+
+  int strategy = args[5]->Uint32Value();
+  assert((strategy == Z_FILTERED ||
+          strategy == Z_HUFFMAN_ONLY ||
+          strategy == Z_RLE ||
+          strategy == Z_FIXED ||
+          strategy == Z_DEFAULT_STRATEGY) && "invalid strategy");
+
+  // Copied, so that changes to it can't race with the thread pool.
+  Bytef* dictionary = NULL;
+  size_t dictionary_len = 0;
+  if (Buffer::HasInstance(args[6])) {
+    dictionary_len = Buffer::Length(args[6]);
+    dictionary = new Bytef[dictionary_len];
+    memcpy(dictionary, Buffer::Data(args[6]), dictionary_len);
+  }
+
+  ZBufferJob* job = new ZBufferJob(mode,
+                                   level,
+                                   windowBits,
+                                   memLevel,
+                                   strategy,
+                                   Buffer::Data(input),
+                                   Buffer::Length(input),
+                                   dictionary,
+                                   dictionary_len);
+
+  if (args[6]->IsUint32()) {
+    SharedDictionary* shared = FindDictionary(args[6]->Uint32Value());
+    assert(shared != NULL && "unknown dictionary");
+    job->set_shared_dictionary(shared);
+  }
+
+  if (args[7]->IsFunction()) {
+    Local<Object> obj = Object::New(env->isolate());
+    obj->Set(env->ondone_string(), args[7]);
+    obj->Set(env->input_string(), input);
+    // XXX(trevnorris): This will need to go with the rest of domains.
+    if (env->in_domain())
+      obj->Set(env->domain_string(), env->domain_array()->Get(0));
+    ZBufferRequest* req = new ZBufferRequest(env, obj, job);
+    return req->Queue();
+  }
+
+  job->Run();
+  args.GetReturnValue().Set(job->Result(env));
+  delete job;
+}
+
+
+// gzipBlock(input, dictionary, level, memLevel, strategy, last, ondone)
+//
+// Compresses one block of a gzip member that's split up to be compressed on
+// several threads at once, the way pigz does it. The output is raw deflate
+// data that ends on a byte boundary, with a Z_SYNC_FLUSH, so that the blocks
+// can simply be concatenated, or with Z_FINISH for the |last| one. The
+// |dictionary| should be the input that came before, it keeps the blocks
+// from compressing much worse than one stream would. Calls
+// ondone(message, errno, output, crc) with the CRC-32 of the input.
+static void GzipBlock(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args.GetIsolate());
+  HandleScope scope(env->isolate());
+
+  assert(args.Length() == 7);
+  assert(Buffer::HasInstance(args[0]));
+  assert(args[6]->IsFunction());
+  Local<Object> input = args[0]->ToObject();
+
+  Bytef* dictionary = NULL;
+  size_t dictionary_len = 0;
+  if (Buffer::HasInstance(args[1])) {
+    dictionary_len = Buffer::Length(args[1]);
+    dictionary = new Bytef[dictionary_len];
+    memcpy(dictionary, Buffer::Data(args[1]), dictionary_len);
+  }
+
+  int level = args[2]->Int32Value();
+  assert((level >= -1 && level <= 9) && "invalid compression level");
+
+  int memLevel = args[3]->Uint32Value();
+  assert((memLevel >= 1 && memLevel <= 9) && "invalid memlevel");
+
+  int strategy = args[4]->Uint32Value();
+  assert((strategy == Z_FILTERED ||
+          strategy == Z_HUFFMAN_ONLY ||
+          strategy == Z_RLE ||
+          strategy == Z_FIXED ||
+          strategy == Z_DEFAULT_STRATEGY) && "invalid strategy");
+
+  ZBufferJob* job = new ZBufferJob(DEFLATERAW,
+                                   level,
+                                   MAX_WBITS,
+                                   memLevel,
+                                   strategy,
+                                   Buffer::Data(input),
+                                   Buffer::Length(input),
+                                   dictionary,
+                                   dictionary_len);
+  job->set_flush(args[5]->IsTrue() ? Z_FINISH : Z_SYNC_FLUSH);
+  job->set_want_crc(true);
+
+  Local<Object> obj = Object::New(env->isolate());
+  obj->Set(env->ondone_string(), args[6]);
+  obj->Set(env->input_string(), input);
+  // XXX(trevnorris): This will need to go with the rest of domains.
+  if (env->in_domain())
+    obj->Set(env->domain_string(), env->domain_array()->Get(0));
+  ZBufferRequest* req = new ZBufferRequest(env, obj, job);
+  req->Queue();
+}
+
+
+// crc32Combine(crc1, crc2, len2)
+static void Crc32Combine(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args.GetIsolate());
+  HandleScope scope(env->isolate());
+  uLong crc = crc32_combine(args[0]->Uint32Value(),
+                            args[1]->Uint32Value(),
+                            args[2]->IntegerValue());
+  args.GetReturnValue().Set(
+      Integer::NewFromUnsigned(env->isolate(), static_cast<uint32_t>(crc)));
+}
+
+
+// registerDictionary(dictionary)
+static void RegisterDictionary(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args.GetIsolate());
+  HandleScope scope(env->isolate());
+  assert(Buffer::HasInstance(args[0]));
+  uint32_t id = AddDictionary(Buffer::Data(args[0]), Buffer::Length(args[0]));
+  args.GetReturnValue().Set(Integer::NewFromUnsigned(env->isolate(), id));
+}
+
+
+// hasDictionary(id)
+static void HasDictionary(const FunctionCallbackInfo<Value>& args) {
+  bool found = args[0]->IsUint32() &&
+               FindDictionary(args[0]->Uint32Value()) != NULL;
+  args.GetReturnValue().Set(found);
+}
+
+
+static void GetStreamPoolStats(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args.GetIsolate());
+  HandleScope scope(env->isolate());
+
+  StreamPoolStats stats;
+  CopyStreamPoolStats(&stats);
+
+  Local<Object> info = Object::New(env->isolate());
+  info->Set(env->size_string(),
+            Number::New(env->isolate(), static_cast<double>(stats.size)));
+  info->Set(env->available_string(),
+            Number::New(env->isolate(), static_cast<double>(stats.available)));
+  info->Set(env->hits_string(),
+            Number::New(env->isolate(), static_cast<double>(stats.hits)));
+  info->Set(env->misses_string(),
+            Number::New(env->isolate(), static_cast<double>(stats.misses)));
+  args.GetReturnValue().Set(info);
+}
+
+
+static void SetStreamPoolSize(const FunctionCallbackInfo<Value>& args) {
+  assert(args[0]->IsUint32());
+  ResizeStreamPool(args[0]->Uint32Value());
+}
+
+
+// Compresses what gets written to a TCP or pipe handle on its way to
+// uv_write(), so response bodies don't have to go through a JS Transform.
+// JS switches it on with start() once the headers are out and off with
+// finish() followed by an empty write, which carries the gzip trailer. In
+// between, every write is deflated in place and the output, framed as an
+// HTTP chunk if asked to, goes out with the write's own request. A write that
+// zlib swallows whole still completes through libuv, as an empty write, so
+// ordering and cancellation work the same as for any other write.
+class GzipStream : public StreamWrapCallbacks, public BaseObject {
+ public:
+  GzipStream(Environment* env,
+             Local<Object> object,
+             StreamWrapCallbacks* old)
+      : StreamWrapCallbacks(old),
+        BaseObject(env, object),
+        strm_(NULL),
+        chunked_(false),
+        finishing_(false),
+        flush_size_(0),
+        pending_(0),
+        out_(NULL),
+        out_len_(0),
+        out_cap_(0),
+        output_(NULL),
+        output_tail_(NULL) {
+    MakeWeak<GzipStream>(this);
+  }
+
+  ~GzipStream() {
+    End();
+    free(out_);
+    while (output_ != NULL) {
+      Output* output = output_;
+      output_ = output->next;
+      free(output->data);
+      delete output;
+    }
+  }
+
+  // new GzipStream(handle)
+  static void New(const FunctionCallbackInfo<Value>& args) {
+    Environment* env = Environment::GetCurrent(args.GetIsolate());
+    HandleScope scope(env->isolate());
+
+    if (args.Length() < 1 || !args[0]->IsObject()) {
+      return env->ThrowTypeError(
+          "First argument should be a StreamWrap instance");
+    }
+
+    Local<Object> stream = args[0].As<Object>();
+    GzipStream* gzip = NULL;
+    WITH_GENERIC_STREAM(env, stream, {
+      gzip = new GzipStream(env, args.This(), wrap->callbacks());
+      wrap->OverrideCallbacks(gzip, true);
+    });
+
+    if (gzip == NULL) {
+      return env->ThrowTypeError(
+          "First argument should be a StreamWrap instance");
+    }
+  }
+
+  // start(level, memLevel, strategy, flushSize, chunked)
+  static void Start(const FunctionCallbackInfo<Value>& args) {
+    GzipStream* gzip = Unwrap<GzipStream>(args.Holder());
+    assert(args.Length() == 5);
+
+    if (gzip->strm_ != NULL)
+      return args.GetReturnValue().Set(UV_EINVAL);
+
+    int err;
+    z_stream* strm = AcquireStream(GZIP,
+                                   args[0]->Int32Value(),
+                                   15,
+                                   args[1]->Int32Value(),
+                                   args[2]->Int32Value(),
+                                   &err);
+    if (err != Z_OK) {
+      ReleaseStream(strm);
+      return args.GetReturnValue().Set(
+          err == Z_MEM_ERROR ? UV_ENOMEM : UV_EINVAL);
+    }
+
+    gzip->strm_ = strm;
+    gzip->flush_size_ = args[3]->Uint32Value();
+    gzip->chunked_ = args[4]->IsTrue();
+    gzip->finishing_ = false;
+    gzip->pending_ = 0;
+    args.GetReturnValue().Set(0);
+  }
+
+  // Makes the next write the last one of the gzip member.
+  static void Finish(const FunctionCallbackInfo<Value>& args) {
+    GzipStream* gzip = Unwrap<GzipStream>(args.Holder());
+    if (gzip->strm_ == NULL)
+      return args.GetReturnValue().Set(UV_EINVAL);
+    gzip->finishing_ = true;
+    args.GetReturnValue().Set(0);
+  }
+
+  int TryWrite(uv_buf_t** bufs, size_t* count) {
+    // Everything has to go through deflate(), i.e. through DoWrite().
+    if (strm_ != NULL)
+      return 0;
+    return StreamWrapCallbacks::TryWrite(bufs, count);
+  }
+
+  int DoWrite(WriteWrap* w,
+              uv_buf_t* bufs,
+              size_t count,
+              uv_stream_t* send_handle,
+              uv_write_cb cb) {
+    if (strm_ == NULL || send_handle != NULL)
+      return StreamWrapCallbacks::DoWrite(w, bufs, count, send_handle, cb);
+
+    int flush = Z_NO_FLUSH;
+    for (size_t i = 0; i < count; i++)
+      pending_ += bufs[i].len;
+    if (finishing_)
+      flush = Z_FINISH;
+    else if (pending_ >= flush_size_)
+      flush = Z_SYNC_FLUSH;
+
+    int err = Z_OK;
+    for (size_t i = 0; i < count && err == Z_OK; i++)
+      err = Deflate(bufs[i].base, bufs[i].len, Z_NO_FLUSH);
+    if (err == Z_OK && flush != Z_NO_FLUSH) {
+      err = Deflate(NULL, 0, flush);
+      pending_ = 0;
+    }
+
+    if (err != Z_OK || finishing_)
+      End();
+    if (err != Z_OK) {
+      out_len_ = 0;
+      return err == Z_MEM_ERROR ? UV_ENOMEM : UV_EINVAL;
+    }
+
+    if (out_len_ == 0) {
+      uv_buf_t buf = uv_buf_init(NULL, 0);
+      return StreamWrapCallbacks::DoWrite(w, &buf, 1, NULL, cb);
+    }
+
+    // The write owns the output until it completes, see AfterWrite().
+    Output* output = new Output;
+    output->w = w;
+    output->data = out_;
+    output->next = NULL;
+
+    uv_buf_t buf[3];
+    size_t n = 0;
+    if (chunked_) {
+      int len = snprintf(output->head,
+                         sizeof(output->head),
+                         "%lx\r\n",
+                         static_cast<unsigned long>(out_len_));  // NOLINT
+      buf[n++] = uv_buf_init(output->head, len);
+    }
+    buf[n++] = uv_buf_init(out_, out_len_);
+    if (chunked_)
+      buf[n++] = uv_buf_init(const_cast<char*>("\r\n"), 2);
+
+    out_ = NULL;
+    out_len_ = 0;
+    out_cap_ = 0;
+
+    int r = StreamWrapCallbacks::DoWrite(w, buf, n, NULL, cb);
+    if (r != 0) {
+      free(output->data);
+      delete output;
+      return r;
+    }
+
+    if (output_tail_ == NULL)
+      output_ = output;
+    else
+      output_tail_->next = output;
+    output_tail_ = output;
+    return 0;
+  }
+
+  void AfterWrite(WriteWrap* w) {
+    // Writes complete in order, so if |w| has output it's the oldest one.
+    if (output_ != NULL && output_->w == w) {
+      Output* output = output_;
+      output_ = output->next;
+      if (output_ == NULL)
+        output_tail_ = NULL;
+      free(output->data);
+      delete output;
+    }
+    StreamWrapCallbacks::AfterWrite(w);
+  }
+
+  void OnStreamDestroyed() {
+    End();
+  }
+
+ private:
+  struct Output {
+    WriteWrap* w;
+    char* data;
+    char head[20];  // Chunk size line.
+    Output* next;
+  };
+
+  static const size_t kOutputSize = 16 * 1024;
+
+  // Runs |data| through deflate() and appends what comes out to out_.
+  int Deflate(char* data, size_t len, int flush) {
+    strm_->next_in = reinterpret_cast<Bytef*>(data);
+    strm_->avail_in = len;
+    for (;;) {
+      if (out_len_ == out_cap_) {
+        size_t cap = out_cap_ > 0 ? out_cap_ * 2 : kOutputSize;
+        char* out = static_cast<char*>(realloc(out_, cap));
+        if (out == NULL)
+          return Z_MEM_ERROR;
+        out_ = out;
+        out_cap_ = cap;
+      }
+      strm_->next_out = reinterpret_cast<Bytef*>(out_ + out_len_);
+      strm_->avail_out = out_cap_ - out_len_;
+      int err = deflate(strm_, flush);
+      out_len_ = out_cap_ - strm_->avail_out;
+      if (err == Z_STREAM_END)
+        return Z_OK;
+      if (err != Z_OK && err != Z_BUF_ERROR)
+        return err;
+      // Room to spare means all input is in and the flush is complete.
+      if (strm_->avail_out != 0)
+        return Z_OK;
+    }
+  }
+
+  // Gives the stream back to the pool, an idle connection doesn't need it.
+  void End() {
+    if (strm_ != NULL) {
+      ReleaseStream(strm_);
+      strm_ = NULL;
+    }
+    finishing_ = false;
+  }
+
+  z_stream* strm_;  // NULL while writes pass through untouched.
+  bool chunked_;
+  bool finishing_;
+  size_t flush_size_;
+  size_t pending_;  // Bytes deflated since the last flush.
+  char* out_;
+  size_t out_len_;
+  size_t out_cap_;
+  Output* output_;  // Output of writes in flight, oldest first.
+  Output* output_tail_;
+};
+
+
 void InitZlib(Handle<Object> target,
               Handle<Value> unused,
               Handle<Context> context,
@@ -628,6 +1776,23 @@ void InitZlib(Handle<Object> target,
   z->SetClassName(FIXED_ONE_BYTE_STRING(env->isolate(), "Zlib"));
   target->Set(FIXED_ONE_BYTE_STRING(env->isolate(), "Zlib"), z->GetFunction());
 
+  Local<FunctionTemplate> g =
+      FunctionTemplate::New(env->isolate(), GzipStream::New);
+  g->InstanceTemplate()->SetInternalFieldCount(1);
+  NODE_SET_PROTOTYPE_METHOD(g, "start", GzipStream::Start);
+  NODE_SET_PROTOTYPE_METHOD(g, "finish", GzipStream::Finish);
+  g->SetClassName(FIXED_ONE_BYTE_STRING(env->isolate(), "GzipStream"));
+  target->Set(FIXED_ONE_BYTE_STRING(env->isolate(), "GzipStream"),
+              g->GetFunction());
+
+  NODE_SET_METHOD(target, "zlibBuffer", ZlibBuffer);
+  NODE_SET_METHOD(target, "gzipBlock", GzipBlock);
+  NODE_SET_METHOD(target, "crc32Combine", Crc32Combine);
+  NODE_SET_METHOD(target, "registerDictionary", RegisterDictionary);
+  NODE_SET_METHOD(target, "hasDictionary", HasDictionary);
+  NODE_SET_METHOD(target, "getStreamPoolStats", GetStreamPoolStats);
+  NODE_SET_METHOD(target, "setStreamPoolSize", SetStreamPoolSize);
+
   // valid flush values.
   NODE_DEFINE_CONSTANT(target, Z_NO_FLUSH);
   NODE_DEFINE_CONSTANT(target, Z_PARTIAL_FLUSH);
@@ -125,6 +125,9 @@ void PipeWrap::Initialize(Handle<Object> target,
   NODE_SET_PROTOTYPE_METHOD(t,
                             "writeBinaryString",
                             StreamWrap::WriteBinaryString);
+  NODE_SET_PROTOTYPE_METHOD(t, "cork", StreamWrap::Cork);
+  NODE_SET_PROTOTYPE_METHOD(t, "uncork", StreamWrap::Uncork);
+  NODE_SET_PROTOTYPE_METHOD(t, "getCorkStats", StreamWrap::GetCorkStats);
 
   NODE_SET_PROTOTYPE_METHOD(t, "bind", Bind);
   NODE_SET_PROTOTYPE_METHOD(t, "listen", Listen);
@@ -0,0 +1,202 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "slab_allocator.h"
+#include "env.h"
+#include "env-inl.h"
+#include "node_buffer.h"
+#include "node_internals.h"
+#include "util.h"
+#include "util-inl.h"
+
+#include <stdlib.h>  // malloc(), free()
+
+namespace node {
+
+using v8::Local;
+using v8::Object;
+
+
+inline char* SlabAllocator::Slab::data() {
+  return reinterpret_cast<char*>(this) + ROUND_UP(sizeof(*this), kHeaderSize);
+}
+
+
+SlabAllocator::SlabAllocator(size_t slab_size)
+    : slab_size_(slab_size),
+      current_(NULL),
+      spare_(NULL),
+      last_(NULL),
+      hits_(0),
+      misses_(0),
+      retained_slabs_(0),
+      retained_bytes_(0) {
+  QUEUE_INIT(&retained_queue_);
+}
+
+
+SlabAllocator::~SlabAllocator() {
+  // Buffers that still point into a slab may outlive the allocator. Detach
+  // the slabs; whoever drops the last reference frees the memory.
+  while (!QUEUE_EMPTY(&retained_queue_)) {
+    QUEUE* q = QUEUE_HEAD(&retained_queue_);
+    QUEUE_REMOVE(q);
+    Slab* slab = ContainerOf(&Slab::member, q);
+    slab->allocator = NULL;
+  }
+
+  if (current_ != NULL) {
+    Slab* slab = current_;
+    current_ = NULL;
+    slab->allocator = NULL;
+    Unref(slab);
+  }
+
+  free(spare_);
+  spare_ = NULL;
+}
+
+
+SlabAllocator::Slab* SlabAllocator::NewSlab(size_t size) {
+  if (size == slab_size_ && spare_ != NULL) {
+    Slab* slab = spare_;
+    spare_ = NULL;
+    return slab;
+  }
+
+  size_t header = ROUND_UP(sizeof(Slab), kHeaderSize);
+  Slab* slab = static_cast<Slab*>(malloc(header + size));
+  if (slab == NULL)
+    FatalError("node::SlabAllocator::NewSlab(size_t)", "Out Of Memory");
+
+  slab->allocator = this;
+  slab->refs = 0;
+  slab->size = size;
+  slab->offset = 0;
+  QUEUE_INIT(&slab->member);
+  return slab;
+}
+
+
+char* SlabAllocator::Allocate(size_t size) {
+  size_t needed = kHeaderSize + ROUND_UP(size, kHeaderSize);
+  Slab* slab;
+
+  if (needed > slab_size_) {
+    // Too big for a regular slab, give it a slab of its own. It is retired
+    // right away so it goes away with the allocation.
+    misses_++;
+    slab = NewSlab(needed);
+    Retire(slab);
+  } else if (current_ == NULL || current_->size - current_->offset < needed) {
+    misses_++;
+    if (current_ != NULL) {
+      Slab* old = current_;
+      current_ = NULL;
+      Retire(old);
+      Unref(old);  // Drop the allocator's own reference.
+    }
+    slab = current_ = NewSlab(slab_size_);
+    slab->refs++;  // The allocator's own reference.
+  } else {
+    hits_++;
+    slab = current_;
+  }
+
+  char* header = slab->data() + slab->offset;
+  *reinterpret_cast<Slab**>(header) = slab;
+  slab->offset += needed;
+  slab->refs++;
+
+  last_ = header + kHeaderSize;
+  return last_;
+}
+
+
+void SlabAllocator::Shrink(char* ptr, size_t size) {
+  Slab* slab = SlabOf(ptr);
+  if (ptr != last_ || slab != current_)
+    return;
+  slab->offset = (ptr - slab->data()) + ROUND_UP(size, kHeaderSize);
+}
+
+
+void SlabAllocator::Release(char* ptr) {
+  Slab* slab = SlabOf(ptr);
+  if (ptr == last_ && slab == current_) {
+    slab->offset = (ptr - slab->data()) - kHeaderSize;
+    last_ = NULL;
+  }
+  Unref(slab);
+}
+
+
+Local<Object> SlabAllocator::Use(Environment* env, char* ptr, size_t size) {
+  if (ptr == last_)
+    last_ = NULL;
+  return Buffer::New(env, ptr, size, FreeCallback, SlabOf(ptr));
+}
+
+
+SlabAllocator::Slab* SlabAllocator::SlabOf(char* ptr) {
+  return *reinterpret_cast<Slab**>(ptr - kHeaderSize);
+}
+
+
+void SlabAllocator::FreeCallback(char* data, void* hint) {
+  Unref(static_cast<Slab*>(hint));
+}
+
+
+void SlabAllocator::Retire(Slab* slab) {
+  QUEUE_INSERT_TAIL(&retained_queue_, &slab->member);
+  retained_slabs_++;
+  retained_bytes_ += slab->size;
+}
+
+
+void SlabAllocator::Unref(Slab* slab) {
+  CHECK_GT(slab->refs, 0);
+  if (--slab->refs > 0)
+    return;
+
+  SlabAllocator* allocator = slab->allocator;
+  if (allocator == NULL) {
+    free(slab);
+    return;
+  }
+
+  // The current slab is pinned by the allocator so this must be a slab that
+  // was retired earlier.
+  QUEUE_REMOVE(&slab->member);
+  QUEUE_INIT(&slab->member);
+  allocator->retained_slabs_--;
+  allocator->retained_bytes_ -= slab->size;
+
+  if (allocator->spare_ == NULL && slab->size == allocator->slab_size_) {
+    slab->offset = 0;
+    allocator->spare_ = slab;
+  } else {
+    free(slab);
+  }
+}
+
+}  // namespace node
@@ -0,0 +1,111 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef SRC_SLAB_ALLOCATOR_H_
+#define SRC_SLAB_ALLOCATOR_H_
+
+#include "queue.h"
+#include "util.h"
+#include "v8.h"
+
+#include <stddef.h>
+
+namespace node {
+
+// Forward declaration
+class Environment;
+
+// Carves read buffers out of large, reference counted slabs. Every
+// allocation holds a reference to its slab; the allocator holds one more on
+// the slab it is currently carving from. Buffers handed to JS through Use()
+// keep their slab alive until they are garbage collected, at which point the
+// slab is either freed or, if there is no spare yet, kept for reuse.
+//
+// Not thread-safe, there is one instance per Environment.
+class SlabAllocator {
+ public:
+  static const size_t kDefaultSlabSize = 1024 * 1024;
+
+  explicit SlabAllocator(size_t slab_size = kDefaultSlabSize);
+  ~SlabAllocator();
+
+  // Returns storage for `size` bytes. Requests that don't fit in a regular
+  // slab get a dedicated slab of their own.
+  char* Allocate(size_t size);
+
+  // Shrinks the allocation at `ptr` to `size` bytes. The tail is returned to
+  // the slab when `ptr` is the most recent allocation, otherwise this is a
+  // no-op.
+  void Shrink(char* ptr, size_t size);
+
+  // Gives back an allocation that is not going to be handed out to JS.
+  void Release(char* ptr);
+
+  // Creates a Buffer that points into the slab. Takes over the reference
+  // that was acquired by Allocate().
+  v8::Local<v8::Object> Use(Environment* env, char* ptr, size_t size);
+
+  // Allocations that were served from the current slab.
+  inline size_t hits() const { return hits_; }
+  // Allocations that required switching to another slab.
+  inline size_t misses() const { return misses_; }
+  // Slabs that are no longer carved from but still referenced by a Buffer.
+  inline size_t retained_slabs() const { return retained_slabs_; }
+  inline size_t retained_bytes() const { return retained_bytes_; }
+
+ private:
+  struct Slab {
+    SlabAllocator* allocator;
+    unsigned int refs;
+    size_t size;
+    size_t offset;
+    QUEUE member;
+
+    inline char* data();
+  };
+
+  // Every allocation is preceded by a pointer to its slab, padded so that
+  // the returned memory is suitably aligned.
+  static const size_t kHeaderSize = 16;
+
+  static Slab* SlabOf(char* ptr);
+  static void FreeCallback(char* data, void* hint);
+  static void Unref(Slab* slab);
+
+  Slab* NewSlab(size_t size);
+  void Retire(Slab* slab);
+
+  const size_t slab_size_;
+  Slab* current_;
+  Slab* spare_;
+  char* last_;
+  QUEUE retained_queue_;
+  size_t hits_;
+  size_t misses_;
+  size_t retained_slabs_;
+  size_t retained_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(SlabAllocator);
+};
+
+}  // namespace node
+
+#endif  // SRC_SLAB_ALLOCATOR_H_
@@ -36,6 +36,10 @@
 #include <string.h>  // memcpy()
 #include <limits.h>  // INT_MAX
 
+#if !defined(_WIN32)
+#include <unistd.h>  // dup(), close()
+#endif
+
 
 namespace node {
 
@@ -75,6 +79,27 @@ void StreamWrap::Initialize(Handle<Object> target,
   ww->SetClassName(FIXED_ONE_BYTE_STRING(env->isolate(), "WriteWrap"));
   target->Set(FIXED_ONE_BYTE_STRING(env->isolate(), "WriteWrap"),
               ww->GetFunction());
+
+  NODE_SET_METHOD(target, "getSlabAllocatorStats", GetSlabAllocatorStats);
+  NODE_SET_METHOD(target, "getWritevStats", GetWritevStats);
+}
+
+
+void StreamWrap::GetSlabAllocatorStats(
+    const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args.GetIsolate());
+  HandleScope scope(env->isolate());
+  SlabAllocator* allocator = env->slab_allocator();
+  Local<Object> info = Object::New(env->isolate());
+#define V(name)                                                               \
+  info->Set(env->name ## _string(),                                           \
+            Number::New(env->isolate(), allocator->name()))
+  V(hits);
+  V(misses);
+  V(retained_slabs);
+  V(retained_bytes);
+#undef V
+  args.GetReturnValue().Set(info);
 }
 
 
@@ -91,7 +116,42 @@ StreamWrap::StreamWrap(Environment* env,
       stream_(stream),
       default_callbacks_(this),
       callbacks_(&default_callbacks_),
-      callbacks_gc_(false) {
+      callbacks_gc_(false),
+      sendfile_(NULL),
+      writev_arena_(NULL),
+      writev_arena_owner_(NULL),
+      corked_(false),
+      cork_bufs_(NULL),
+      cork_count_(0),
+      cork_capacity_(0),
+      cork_size_(0),
+      cork_error_(0),
+      cork_flushes_(0),
+      cork_chunks_(0) {
+  QUEUE_INIT(&cork_reqs_);
+  QUEUE_INIT(&cork_flight_);
+  QUEUE_INIT(&cork_failed_);
+  QUEUE_INIT(&cork_member_);
+  QUEUE_INIT(&cork_error_member_);
+}
+
+
+void StreamWrap::GetWritevStats(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args.GetIsolate());
+  HandleScope scope(env->isolate());
+  Environment::WritevStats* stats = env->writev_stats();
+  Local<Object> info = Object::New(env->isolate());
+#define V(name, field)                                                        \
+  info->Set(env->name ## _string(),                                           \
+            Number::New(env->isolate(),                                       \
+                        static_cast<double>(                                  \
+                            stats->Get(Environment::WritevStats::field))))
+  V(immediate, kImmediate);
+  V(queued, kQueued);
+  V(arena, kArena);
+  V(heap, kHeap);
+#undef V
+  args.GetReturnValue().Set(info);
 }
 
 
@@ -111,8 +171,10 @@ void StreamWrap::GetFD(Local<String>, const PropertyCallbackInfo<Value>& args) {
 
 void StreamWrap::UpdateWriteQueueSize() {
   HandleScope scope(env()->isolate());
+  // Corked data hasn't reached libuv yet but is just as much waiting to go out.
+  size_t size = stream()->write_queue_size + cork_size_;
   Local<Integer> write_queue_size =
-      Integer::NewFromUnsigned(env()->isolate(), stream()->write_queue_size);
+      Integer::NewFromUnsigned(env()->isolate(), size);
   object()->Set(env()->write_queue_size_string(), write_queue_size);
 }
 
@@ -241,7 +303,7 @@ void StreamWrap::WriteBuffer(const FunctionCallbackInfo<Value>& args) {
   // Try writing immediately without allocation
   uv_buf_t* bufs = &buf;
   size_t count = 1;
-  int err = wrap->callbacks()->TryWrite(&bufs, &count);
+  int err = wrap->is_corked() ? 0 : wrap->callbacks()->TryWrite(&bufs, &count);
   if (err != 0)
     goto done;
   if (count == 0)
@@ -252,11 +314,7 @@ void StreamWrap::WriteBuffer(const FunctionCallbackInfo<Value>& args) {
   storage = new char[sizeof(WriteWrap)];
   req_wrap = new(storage) WriteWrap(env, req_wrap_obj, wrap);
 
-  err = wrap->callbacks()->DoWrite(req_wrap,
-                                   bufs,
-                                   count,
-                                   NULL,
-                                   StreamWrap::AfterWrite);
+  err = wrap->DispatchWrite(req_wrap, bufs, count, NULL);
   req_wrap->Dispatched();
   req_wrap_obj->Set(env->async(), True(env->isolate()));
 
@@ -312,6 +370,7 @@ void StreamWrap::WriteStringImpl(const FunctionCallbackInfo<Value>& args) {
   uv_buf_t buf;
 
   bool try_write = storage_size + 15 <= sizeof(stack_storage) &&
+                   !wrap->is_corked() &&
                    (!wrap->is_named_pipe_ipc() || !args[2]->IsObject());
   if (try_write) {
     data_size = StringBytes::Write(env->isolate(),
@@ -361,11 +420,7 @@ void StreamWrap::WriteStringImpl(const FunctionCallbackInfo<Value>& args) {
   buf = uv_buf_init(data, data_size);
 
   if (!wrap->is_named_pipe_ipc()) {
-    err = wrap->callbacks()->DoWrite(req_wrap,
-                                     &buf,
-                                     1,
-                                     NULL,
-                                     StreamWrap::AfterWrite);
+    err = wrap->DispatchWrite(req_wrap, &buf, 1, NULL);
   } else {
     uv_handle_t* send_handle = NULL;
 
@@ -379,12 +434,10 @@ void StreamWrap::WriteStringImpl(const FunctionCallbackInfo<Value>& args) {
       req_wrap->object()->Set(env->handle_string(), send_handle_obj);
     }
 
-    err = wrap->callbacks()->DoWrite(
-        req_wrap,
-        &buf,
-        1,
-        reinterpret_cast<uv_stream_t*>(send_handle),
-        StreamWrap::AfterWrite);
+    err = wrap->DispatchWrite(req_wrap,
+                              &buf,
+                              1,
+                              reinterpret_cast<uv_stream_t*>(send_handle));
   }
 
   req_wrap->Dispatched();
@@ -408,6 +461,7 @@ void StreamWrap::WriteStringImpl(const FunctionCallbackInfo<Value>& args) {
 void StreamWrap::Writev(const FunctionCallbackInfo<Value>& args) {
   HandleScope handle_scope(args.GetIsolate());
   Environment* env = Environment::GetCurrent(args.GetIsolate());
+  Environment::WritevStats* stats = env->writev_stats();
 
   StreamWrap* wrap = Unwrap<StreamWrap>(args.Holder());
 
@@ -451,13 +505,29 @@ void StreamWrap::Writev(const FunctionCallbackInfo<Value>& args) {
   if (ARRAY_SIZE(bufs_) < count)
     bufs = new uv_buf_t[count];
 
-  storage_size += sizeof(WriteWrap);
-  char* storage = new char[storage_size];
-  WriteWrap* req_wrap =
-      new(storage) WriteWrap(env, req_wrap_obj, wrap);
+  // Small string payloads go into the stream's arena, which is free to reuse
+  // as long as no queued write still points into it. Anything else shares a
+  // single allocation with the WriteWrap that may be needed further down.
+  char* storage = NULL;
+  char* str_base = NULL;
+  bool use_arena = false;
+  if (storage_size == 0) {
+    // Buffers only, nothing to copy.
+  } else if (storage_size <= kWritevArenaSize &&
+             wrap->writev_arena_owner_ == NULL) {
+    if (wrap->writev_arena_ == NULL)
+      wrap->writev_arena_ = new char[kWritevArenaSize];
+    str_base = wrap->writev_arena_;
+    use_arena = true;
+    stats->Count(Environment::WritevStats::kArena);
+  } else {
+    storage = new char[sizeof(WriteWrap) + storage_size];
+    str_base = storage + sizeof(WriteWrap);
+    stats->Count(Environment::WritevStats::kHeap);
+  }
 
   uint32_t bytes = 0;
-  size_t offset = sizeof(WriteWrap);
+  size_t offset = 0;
   for (size_t i = 0; i < count; i++) {
     Handle<Value> chunk = chunks->Get(i * 2);
 
@@ -472,7 +542,7 @@ void StreamWrap::Writev(const FunctionCallbackInfo<Value>& args) {
     // Write string
     offset = ROUND_UP(offset, 16);
     assert(offset < storage_size);
-    char* str_storage = storage + offset;
+    char* str_storage = str_base + offset;
     size_t str_size = storage_size - offset;
 
     Handle<String> string = chunk->ToString();
@@ -489,29 +559,49 @@ void StreamWrap::Writev(const FunctionCallbackInfo<Value>& args) {
     bytes += str_size;
   }
 
-  int err = wrap->callbacks()->DoWrite(req_wrap,
-                                       bufs,
-                                       count,
-                                       NULL,
-                                       StreamWrap::AfterWrite);
+  // Try writing immediately, a request is only needed for what's left over.
+  uv_buf_t* vbufs = bufs;
+  size_t vcount = count;
+  WriteWrap* req_wrap = NULL;
+  int err = 0;
+  if (!wrap->is_corked())
+    err = wrap->callbacks()->TryWrite(&vbufs, &vcount);
+  if (err != 0 || vcount == 0) {
+    if (err == 0)
+      stats->Count(Environment::WritevStats::kImmediate);
+    delete[] storage;
+    goto done;
+  }
+
+  if (storage == NULL)
+    storage = new char[sizeof(WriteWrap)];
+  req_wrap = new(storage) WriteWrap(env, req_wrap_obj, wrap);
+  if (use_arena)
+    wrap->writev_arena_owner_ = req_wrap;
+  stats->Count(Environment::WritevStats::kQueued);
 
-  // Deallocate space
-  if (bufs != bufs_)
-    delete[] bufs;
+  err = wrap->DispatchWrite(req_wrap, vbufs, vcount, NULL);
 
   req_wrap->Dispatched();
-  req_wrap->object()->Set(env->async(), True(env->isolate()));
-  req_wrap->object()->Set(env->bytes_string(),
-                          Number::New(env->isolate(), bytes));
-  const char* msg = wrap->callbacks()->Error();
-  if (msg != NULL)
-    req_wrap_obj->Set(env->error_string(), OneByteString(env->isolate(), msg));
+  req_wrap_obj->Set(env->async(), True(env->isolate()));
 
   if (err) {
+    if (wrap->writev_arena_owner_ == req_wrap)
+      wrap->writev_arena_owner_ = NULL;
     req_wrap->~WriteWrap();
     delete[] storage;
   }
 
+ done:
+  // Deallocate space
+  if (bufs != bufs_)
+    delete[] bufs;
+
+  req_wrap_obj->Set(env->bytes_string(), Number::New(env->isolate(), bytes));
+  const char* msg = wrap->callbacks()->Error();
+  if (msg != NULL)
+    req_wrap_obj->Set(env->error_string(), OneByteString(env->isolate(), msg));
+
   args.GetReturnValue().Set(err);
 }
 
@@ -546,6 +636,327 @@ void StreamWrap::SetBlocking(const FunctionCallbackInfo<Value>& args) {
   args.GetReturnValue().Set(err);
 }
 
+void StreamWrap::SendFile(const FunctionCallbackInfo<Value>& args) {
+  HandleScope handle_scope(args.GetIsolate());
+  Environment* env = Environment::GetCurrent(args.GetIsolate());
+
+  StreamWrap* wrap = Unwrap<StreamWrap>(args.Holder());
+
+  // sendFile(req, fd, offset, length)
+  assert(args[0]->IsObject());
+  assert(args[1]->IsInt32());
+  assert(args[2]->IsNumber());
+  assert(args[3]->IsNumber());
+
+  Local<Object> req_wrap_obj = args[0].As<Object>();
+  const uv_file in_fd = args[1]->Int32Value();
+  const int64_t offset = args[2]->IntegerValue();
+  const int64_t length = args[3]->IntegerValue();
+
+  assert(offset >= 0);
+  assert(length >= 0);
+
+#if defined(_WIN32)
+  args.GetReturnValue().Set(UV_ENOSYS);
+#else
+  // The file contents would bypass whatever the overridden callbacks do to
+  // outgoing data (TLS, for one), so only plain streams qualify.
+  if (wrap->callbacks() != &wrap->default_callbacks_ ||
+      wrap->sendfile_ != NULL) {
+    return args.GetReturnValue().Set(UV_ENOTSUP);
+  }
+
+  // The file goes straight to the socket, so whatever was written before has
+  // to be there first. Corked writes get flushed and the transfer waits for
+  // them, and anything else libuv still has queued, see MaybeStartSendFile().
+  wrap->corked_ = false;
+  wrap->Flush();
+
+  uv_os_fd_t fd;
+  int err = uv_fileno(reinterpret_cast<uv_handle_t*>(wrap->stream()), &fd);
+  if (err)
+    return args.GetReturnValue().Set(err);
+
+  // Work on a duplicate so the transfer can't end up writing to an unrelated
+  // file descriptor when the stream is closed before the thread pool is done.
+  int out_fd = dup(fd);
+  if (out_fd == -1)
+    return args.GetReturnValue().Set(-errno);
+
+  char* storage = new char[sizeof(WriteWrap)];
+  WriteWrap* req_wrap = new(storage) WriteWrap(env, req_wrap_obj, wrap);
+  req_wrap->Dispatched();
+
+  wrap->sendfile_ = new SendFileWrap(wrap,
+                                     req_wrap,
+                                     out_fd,
+                                     in_fd,
+                                     offset,
+                                     static_cast<size_t>(length));
+  wrap->MaybeStartSendFile();
+
+  req_wrap_obj->Set(env->async(), True(env->isolate()));
+  req_wrap_obj->Set(env->bytes_string(),
+                    Number::New(env->isolate(), static_cast<double>(length)));
+  args.GetReturnValue().Set(0);
+#endif
+}
+
+
+void StreamWrap::Cork(const FunctionCallbackInfo<Value>& args) {
+  StreamWrap* wrap = Unwrap<StreamWrap>(args.Holder());
+  wrap->corked_ = true;
+}
+
+
+void StreamWrap::Uncork(const FunctionCallbackInfo<Value>& args) {
+  StreamWrap* wrap = Unwrap<StreamWrap>(args.Holder());
+  wrap->corked_ = false;
+  args.GetReturnValue().Set(wrap->Flush());
+}
+
+
+void StreamWrap::GetCorkStats(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args.GetIsolate());
+  HandleScope scope(env->isolate());
+  StreamWrap* wrap = Unwrap<StreamWrap>(args.Holder());
+  Local<Object> info = Object::New(env->isolate());
+  info->Set(env->flushes_string(),
+            Number::New(env->isolate(),
+                        static_cast<double>(wrap->cork_flushes_)));
+  info->Set(env->chunks_string(),
+            Number::New(env->isolate(),
+                        static_cast<double>(wrap->cork_chunks_)));
+  args.GetReturnValue().Set(info);
+}
+
+
+void StreamWrap::FlushCorked(Environment* env) {
+  QUEUE* list = env->corked_stream_queue();
+  while (!QUEUE_EMPTY(list)) {
+    QUEUE* q = QUEUE_HEAD(list);
+    StreamWrap* wrap = ContainerOf(&StreamWrap::cork_member_, q);
+    wrap->corked_ = false;
+    wrap->Flush();
+  }
+}
+
+
+void StreamWrap::OnCorkPrepare(uv_prepare_t* handle) {
+  Environment* env = Environment::from_cork_prepare_handle(handle);
+  HandleScope handle_scope(env->isolate());
+  Context::Scope context_scope(env->context());
+  FlushCorked(env);
+}
+
+
+int StreamWrap::DispatchWrite(WriteWrap* req_wrap,
+                              uv_buf_t* bufs,
+                              size_t count,
+                              uv_stream_t* send_handle) {
+  if (!is_corked() || send_handle != NULL) {
+    // Passing a handle doesn't mix with batching; flush what came before.
+    Flush();
+    return callbacks()->DoWrite(req_wrap,
+                                bufs,
+                                count,
+                                send_handle,
+                                StreamWrap::AfterWrite);
+  }
+
+  if (cork_count_ + count > cork_capacity_) {
+    size_t capacity = cork_capacity_ > 0 ? cork_capacity_ * 2 : 16;
+    if (capacity < cork_count_ + count)
+      capacity = cork_count_ + count;
+    uv_buf_t* cork_bufs = new uv_buf_t[capacity];
+    if (cork_count_ > 0)
+      memcpy(cork_bufs, cork_bufs_, cork_count_ * sizeof(*cork_bufs));
+    delete[] cork_bufs_;
+    cork_bufs_ = cork_bufs;
+    cork_capacity_ = capacity;
+  }
+  memcpy(cork_bufs_ + cork_count_, bufs, count * sizeof(*bufs));
+  cork_count_ += count;
+  for (size_t i = 0; i < count; i++)
+    cork_size_ += bufs[i].len;
+
+  if (QUEUE_EMPTY(&cork_reqs_)) {
+    QUEUE* list = env()->corked_stream_queue();
+    if (QUEUE_EMPTY(list))
+      uv_prepare_start(env()->cork_prepare_handle(), OnCorkPrepare);
+    QUEUE_INSERT_TAIL(list, &cork_member_);
+  }
+  QUEUE_INSERT_TAIL(&cork_reqs_, &req_wrap->cork_queue_);
+  // Overridden callbacks keep track of writeQueueSize themselves.
+  if (callbacks() == &default_callbacks_)
+    UpdateWriteQueueSize();
+
+  return 0;
+}
+
+
+// Writes out everything that was corked with a single uv_write(). The last
+// request of the batch carries it; AfterCorkedWrite() completes the others.
+int StreamWrap::Flush() {
+  if (QUEUE_EMPTY(&cork_reqs_))
+    return 0;
+
+  QUEUE_REMOVE(&cork_member_);
+  QUEUE_INIT(&cork_member_);
+  if (QUEUE_EMPTY(env()->corked_stream_queue()))
+    uv_prepare_stop(env()->cork_prepare_handle());
+
+  QUEUE* first = QUEUE_HEAD(&cork_reqs_);
+  WriteWrap* carrier =
+      ContainerOf(&WriteWrap::cork_queue_, QUEUE_PREV(&cork_reqs_));
+  while (!QUEUE_EMPTY(&cork_reqs_)) {
+    QUEUE* q = QUEUE_HEAD(&cork_reqs_);
+    QUEUE_REMOVE(q);
+    QUEUE_INSERT_TAIL(&cork_flight_, q);
+  }
+
+  size_t count = cork_count_;
+  cork_count_ = 0;
+  cork_size_ = 0;
+  cork_flushes_ += 1;
+  cork_chunks_ += count;
+
+  int err = callbacks()->DoWrite(carrier,
+                                 cork_bufs_,
+                                 count,
+                                 NULL,
+                                 StreamWrap::AfterCorkedWrite);
+  if (callbacks() == &default_callbacks_)
+    UpdateWriteQueueSize();
+  if (err == 0)
+    return 0;
+
+  // Whoever flushed may be in the middle of a write itself, the callbacks
+  // must not run from in here. The batch leaves the flight list, batches
+  // behind it complete as usual, and OnCorkCheck() reports the error.
+  QUEUE* q = first;
+  for (;;) {
+    QUEUE* next = QUEUE_NEXT(q);
+    QUEUE_REMOVE(q);
+    QUEUE_INSERT_TAIL(&cork_failed_, q);
+    if (q == &carrier->cork_queue_)
+      break;
+    q = next;
+  }
+  cork_error_ = err;
+
+  if (QUEUE_EMPTY(&cork_error_member_)) {
+    QUEUE* list = env()->cork_error_stream_queue();
+    if (QUEUE_EMPTY(list)) {
+      uv_check_start(env()->cork_check_handle(), OnCorkCheck);
+      uv_idle_start(env()->cork_idle_handle(), OnCorkIdle);
+    }
+    QUEUE_INSERT_TAIL(list, &cork_error_member_);
+  }
+
+  return err;
+}
+
+
+void StreamWrap::OnCorkCheck(uv_check_t* handle) {
+  Environment* env = Environment::from_cork_check_handle(handle);
+  QUEUE* list = env->cork_error_stream_queue();
+  while (!QUEUE_EMPTY(list)) {
+    QUEUE* q = QUEUE_HEAD(list);
+    StreamWrap* wrap = ContainerOf(&StreamWrap::cork_error_member_, q);
+    QUEUE_REMOVE(q);
+    QUEUE_INIT(q);
+    while (!QUEUE_EMPTY(&wrap->cork_failed_)) {
+      QUEUE* r = QUEUE_HEAD(&wrap->cork_failed_);
+      WriteWrap* req_wrap = ContainerOf(&WriteWrap::cork_queue_, r);
+      QUEUE_REMOVE(r);
+      AfterWrite(&req_wrap->req_, wrap->cork_error_);
+    }
+  }
+  uv_check_stop(handle);
+  uv_idle_stop(env->cork_idle_handle());
+}
+
+
+void StreamWrap::OnCorkIdle(uv_idle_t* handle) {
+  // Nothing to do, only keeps the loop from blocking before OnCorkCheck().
+}
+
+
+void StreamWrap::AfterCorkedWrite(uv_write_t* req, int status) {
+  WriteWrap* carrier = ContainerOf(&WriteWrap::req_, req);
+  StreamWrap* wrap = carrier->wrap();
+  bool last;
+
+  // Batches complete in the order they were flushed, so everything up to and
+  // including the carrier belongs to this one.
+  do {
+    QUEUE* q = QUEUE_HEAD(&wrap->cork_flight_);
+    WriteWrap* req_wrap = ContainerOf(&WriteWrap::cork_queue_, q);
+    QUEUE_REMOVE(q);
+    last = (req_wrap == carrier);
+    AfterWrite(&req_wrap->req_, status);
+  } while (!last);
+}
+
+
+// Corked writes that never got flushed because the stream went away first.
+void StreamWrap::DiscardCorked() {
+  while (!QUEUE_EMPTY(&cork_reqs_)) {
+    QUEUE* q = QUEUE_HEAD(&cork_reqs_);
+    WriteWrap* req_wrap = ContainerOf(&WriteWrap::cork_queue_, q);
+    QUEUE_REMOVE(q);
+    if (writev_arena_owner_ == req_wrap)
+      writev_arena_owner_ = NULL;
+    req_wrap->~WriteWrap();
+    delete[] reinterpret_cast<char*>(req_wrap);
+  }
+
+  while (!QUEUE_EMPTY(&cork_failed_)) {
+    QUEUE* q = QUEUE_HEAD(&cork_failed_);
+    WriteWrap* req_wrap = ContainerOf(&WriteWrap::cork_queue_, q);
+    QUEUE_REMOVE(q);
+    if (writev_arena_owner_ == req_wrap)
+      writev_arena_owner_ = NULL;
+    req_wrap->~WriteWrap();
+    delete[] reinterpret_cast<char*>(req_wrap);
+  }
+
+  if (!QUEUE_EMPTY(&cork_member_)) {
+    QUEUE_REMOVE(&cork_member_);
+    if (QUEUE_EMPTY(env()->corked_stream_queue()))
+      uv_prepare_stop(env()->cork_prepare_handle());
+  }
+
+  if (!QUEUE_EMPTY(&cork_error_member_)) {
+    QUEUE_REMOVE(&cork_error_member_);
+    if (QUEUE_EMPTY(env()->cork_error_stream_queue())) {
+      uv_check_stop(env()->cork_check_handle());
+      uv_idle_stop(env()->cork_idle_handle());
+    }
+  }
+
+  delete[] cork_bufs_;
+  cork_bufs_ = NULL;
+  cork_size_ = 0;
+}
+
+
+void StreamWrap::MaybeStartSendFile() {
+  if (sendfile_ == NULL || sendfile_->started())
+    return;
+  if (stream()->write_queue_size != 0 ||
+      !QUEUE_EMPTY(&cork_flight_) ||
+      !QUEUE_EMPTY(&cork_failed_)) {
+    return;
+  }
+  // A closing stream cancels the transfer when it goes away.
+  if (uv_is_closing(reinterpret_cast<uv_handle_t*>(stream())))
+    return;
+  sendfile_->Start();
+}
+
+
 void StreamWrap::AfterWrite(uv_write_t* req, int status) {
   WriteWrap* req_wrap = ContainerOf(&WriteWrap::req_, req);
   StreamWrap* wrap = req_wrap->wrap();
@@ -558,6 +969,9 @@ void StreamWrap::AfterWrite(uv_write_t* req, int status) {
   assert(req_wrap->persistent().IsEmpty() == false);
   assert(wrap->persistent().IsEmpty() == false);
 
+  if (wrap->writev_arena_owner_ == req_wrap)
+    wrap->writev_arena_owner_ = NULL;
+
   // Unref handle property
   Local<Object> req_wrap_obj = req_wrap->object();
   req_wrap_obj->Delete(env->handle_string());
@@ -578,6 +992,158 @@ void StreamWrap::AfterWrite(uv_write_t* req, int status) {
 
   req_wrap->~WriteWrap();
   delete[] reinterpret_cast<char*>(req_wrap);
+
+  // A sendFile() may have been waiting for this write.
+  wrap->MaybeStartSendFile();
+}
+
+
+SendFileWrap::SendFileWrap(StreamWrap* wrap,
+                           WriteWrap* req_wrap,
+                           int out_fd,
+                           uv_file in_fd,
+                           int64_t offset,
+                           size_t length)
+    : wrap_(wrap),
+      req_wrap_(req_wrap),
+      out_fd_(out_fd),
+      in_fd_(in_fd),
+      offset_(offset),
+      remaining_(length),
+      started_(false),
+      polling_(false),
+      waiting_(false) {
+  fs_req_.data = this;
+  poll_.data = this;
+}
+
+
+void SendFileWrap::Start() {
+  started_ = true;
+  if (remaining_ == 0)
+    return Finish(0);
+  SendChunk();
+}
+
+
+void SendFileWrap::Detach() {
+  wrap_ = NULL;
+
+  // Still waiting for the writes in front of it, nothing to cancel yet.
+  if (!started_)
+    return Finish(UV_ECANCELED);
+
+  // A socket that's gone won't become writable, don't hold on to it (through
+  // out_fd_) until it does. A chunk on the thread pool is cancelled if it
+  // hasn't started, AfterSendFile() finishes up either way.
+  if (waiting_) {
+    waiting_ = false;
+    uv_poll_stop(&poll_);
+    Finish(UV_ECANCELED);
+  } else {
+    uv_cancel(reinterpret_cast<uv_req_t*>(&fs_req_));
+  }
+}
+
+
+void SendFileWrap::SendChunk() {
+  uv_loop_t* loop = req_wrap_->env()->event_loop();
+  int err = uv_fs_sendfile(loop,
+                           &fs_req_,
+                           out_fd_,
+                           in_fd_,
+                           offset_,
+                           remaining_,
+                           AfterSendFile);
+  if (err)
+    Finish(err);
+}
+
+
+void SendFileWrap::WaitWritable() {
+  int err = 0;
+  if (polling_ == false) {
+    uv_loop_t* loop = req_wrap_->env()->event_loop();
+    err = uv_poll_init(loop, &poll_, out_fd_);
+    if (err == 0)
+      polling_ = true;
+  }
+  if (err == 0)
+    err = uv_poll_start(&poll_, UV_WRITABLE, OnWritable);
+  if (err)
+    Finish(err);
+  else
+    waiting_ = true;
+}
+
+
+void SendFileWrap::AfterSendFile(uv_fs_t* req) {
+  SendFileWrap* sf = static_cast<SendFileWrap*>(req->data);
+  ssize_t result = req->result;
+  uv_fs_req_cleanup(req);
+
+  if (sf->wrap_ == NULL)
+    return sf->Finish(UV_ECANCELED);
+
+  if (result > 0) {
+    if (sf->wrap_->is_tcp()) {
+      NODE_COUNT_NET_BYTES_SENT(result);
+    }
+    sf->offset_ += result;
+    sf->remaining_ -= result;
+    if (sf->remaining_ == 0)
+      return sf->Finish(0);
+    // A short write means the socket's send buffer is full.
+    return sf->WaitWritable();
+  }
+
+  if (result == 0)
+    return sf->Finish(UV_EOF);  // File is shorter than advertised.
+
+  if (result == UV_EAGAIN)
+    return sf->WaitWritable();
+
+  sf->Finish(result);
+}
+
+
+void SendFileWrap::OnWritable(uv_poll_t* handle, int status, int events) {
+  SendFileWrap* sf = static_cast<SendFileWrap*>(handle->data);
+  uv_poll_stop(handle);
+  sf->waiting_ = false;
+
+  if (sf->wrap_ == NULL)
+    return sf->Finish(UV_ECANCELED);
+  if (status < 0)
+    return sf->Finish(status);
+
+  sf->SendChunk();
+}
+
+
+void SendFileWrap::Finish(int status) {
+  if (wrap_ != NULL) {
+    wrap_->sendfile_ = NULL;
+    StreamWrap::AfterWrite(&req_wrap_->req_, status);
+  } else {
+    req_wrap_->~WriteWrap();
+    delete[] reinterpret_cast<char*>(req_wrap_);
+  }
+
+  if (polling_) {
+    uv_close(reinterpret_cast<uv_handle_t*>(&poll_), OnClose);
+  } else {
+    OnClose(reinterpret_cast<uv_handle_t*>(&poll_));
+  }
+}
+
+
+void SendFileWrap::OnClose(uv_handle_t* handle) {
+  SendFileWrap* sf = static_cast<SendFileWrap*>(handle->data);
+#if !defined(_WIN32)
+  close(sf->out_fd_);
+#endif
+  delete sf;
 }
 
 
@@ -590,6 +1156,9 @@ void StreamWrap::Shutdown(const FunctionCallbackInfo<Value>& args) {
   assert(args[0]->IsObject());
   Local<Object> req_wrap_obj = args[0].As<Object>();
 
+  wrap->corked_ = false;
+  wrap->Flush();
+
   ShutdownWrap* req_wrap = new ShutdownWrap(env, req_wrap_obj);
   int err = wrap->callbacks()->DoShutdown(req_wrap, AfterShutdown);
   req_wrap->Dispatched();
@@ -706,14 +1275,9 @@ void StreamWrapCallbacks::AfterWrite(WriteWrap* w) {
 void StreamWrapCallbacks::DoAlloc(uv_handle_t* handle,
                                   size_t suggested_size,
                                   uv_buf_t* buf) {
-  buf->base = static_cast<char*>(malloc(suggested_size));
+  SlabAllocator* allocator = wrap()->env()->slab_allocator();
+  buf->base = allocator->Allocate(suggested_size);
   buf->len = suggested_size;
-
-  if (buf->base == NULL && suggested_size > 0) {
-    FatalError(
-        "node::StreamWrapCallbacks::DoAlloc(uv_handle_t*, size_t, uv_buf_t*)",
-        "Out Of Memory");
-  }
 }
 
 
@@ -731,22 +1295,24 @@ void StreamWrapCallbacks::DoRead(uv_stream_t* handle,
     Undefined(env->isolate())
   };
 
+  SlabAllocator* allocator = env->slab_allocator();
+
   if (nread < 0)  {
     if (buf->base != NULL)
-      free(buf->base);
+      allocator->Release(buf->base);
     wrap()->MakeCallback(env->onread_string(), ARRAY_SIZE(argv), argv);
     return;
   }
 
   if (nread == 0) {
     if (buf->base != NULL)
-      free(buf->base);
+      allocator->Release(buf->base);
     return;
   }
 
-  char* base = static_cast<char*>(realloc(buf->base, nread));
   assert(static_cast<size_t>(nread) <= buf->len);
-  argv[1] = Buffer::Use(env, base, nread);
+  allocator->Shrink(buf->base, nread);
+  argv[1] = allocator->Use(env, buf->base, nread);
 
   Local<Object> pending_obj;
   if (pending == UV_TCP) {
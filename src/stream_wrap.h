@@ -71,6 +71,10 @@ class WriteWrap: public ReqWrap<uv_write_t> {
     CHECK(args.IsConstructCall());
   }
 
+  // Links the write into its stream's cork lists while it is corked or part
+  // of a flushed batch.
+  QUEUE cork_queue_;
+
  private:
   // People should not be using the non-placement new and delete operator on a
   // WriteWrap. Ensure this never happens.
@@ -80,6 +84,47 @@ class WriteWrap: public ReqWrap<uv_write_t> {
   StreamWrap* const wrap_;
 };
 
+// Streams a range of a file to a socket with sendfile(). The copy happens on
+// the thread pool; when the socket's send buffer fills up, it waits on a
+// poll handle for the socket to become writable again. Completion is reported
+// through the WriteWrap that JS passed in, the same way as for any other write.
+class SendFileWrap {
+ public:
+  SendFileWrap(StreamWrap* wrap,
+               WriteWrap* req_wrap,
+               int out_fd,
+               uv_file in_fd,
+               int64_t offset,
+               size_t length);
+
+  void Start();
+  inline bool started() const { return started_; }
+  // Called when the stream goes away while the transfer is still running.
+  // Cancels it, the request completes without calling back into JS.
+  void Detach();
+
+ private:
+  void SendChunk();
+  void WaitWritable();
+  void Finish(int status);
+
+  static void AfterSendFile(uv_fs_t* req);
+  static void OnWritable(uv_poll_t* handle, int status, int events);
+  static void OnClose(uv_handle_t* handle);
+
+  StreamWrap* wrap_;
+  WriteWrap* const req_wrap_;
+  const int out_fd_;
+  const uv_file in_fd_;
+  int64_t offset_;
+  size_t remaining_;
+  bool started_;
+  bool polling_;
+  bool waiting_;  // For the socket to become writable again.
+  uv_fs_t fs_req_;
+  uv_poll_t poll_;
+};
+
 // Overridable callbacks' types
 class StreamWrapCallbacks {
  public:
@@ -111,6 +156,12 @@ class StreamWrapCallbacks {
                       uv_handle_type pending);
   virtual int DoShutdown(ShutdownWrap* req_wrap, uv_shutdown_cb cb);
 
+  // Called from ~StreamWrap() on callbacks that outlive their stream, i.e.
+  // the ones installed with OverrideCallbacks(callbacks, true). wrap() is
+  // not valid anymore after that.
+  virtual void OnStreamDestroyed() {
+  }
+
  protected:
   inline StreamWrap* wrap() const {
     return wrap_;
@@ -127,6 +178,9 @@ class StreamWrap : public HandleWrap {
                          v8::Handle<v8::Context> context);
 
   void OverrideCallbacks(StreamWrapCallbacks* callbacks, bool gc) {
+    // Corked data was written before the new callbacks took over and must go
+    // out ahead of anything they write.
+    Flush();
     StreamWrapCallbacks* old = callbacks_;
     callbacks_ = callbacks;
     callbacks_gc_ = gc;
@@ -151,6 +205,17 @@ class StreamWrap : public HandleWrap {
       const v8::FunctionCallbackInfo<v8::Value>& args);
 
   static void SetBlocking(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void SendFile(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void Cork(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void Uncork(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void GetCorkStats(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+  // Flushes every stream that was corked during the current tick.
+  static void FlushCorked(Environment* env);
+
+  static void GetSlabAllocatorStats(
+      const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void GetWritevStats(const v8::FunctionCallbackInfo<v8::Value>& args);
 
   inline StreamWrapCallbacks* callbacks() const {
     return callbacks_;
@@ -185,13 +250,35 @@ class StreamWrap : public HandleWrap {
   ~StreamWrap() {
     if (!callbacks_gc_ && callbacks_ != &default_callbacks_) {
       delete callbacks_;
+    } else if (callbacks_gc_) {
+      callbacks_->OnStreamDestroyed();
     }
     callbacks_ = NULL;
+    if (sendfile_ != NULL)
+      sendfile_->Detach();
+    delete[] writev_arena_;
+    DiscardCorked();
   }
 
   void StateChange() { }
   void UpdateWriteQueueSize();
 
+  // Hands |bufs| to the callbacks or, while the stream is corked, holds on to
+  // them until the next flush.
+  int DispatchWrite(WriteWrap* req_wrap,
+                    uv_buf_t* bufs,
+                    size_t count,
+                    uv_stream_t* send_handle);
+  int Flush();
+  void DiscardCorked();
+  // Starts a sendFile() that waits for the writes in front of it, once they
+  // are all out.
+  void MaybeStartSendFile();
+
+  inline bool is_corked() const {
+    return corked_;
+  }
+
  private:
   // Callbacks for libuv
   static void AfterWrite(uv_write_t* req, int status);
@@ -199,6 +286,10 @@ class StreamWrap : public HandleWrap {
                       size_t suggested_size,
                       uv_buf_t* buf);
   static void AfterShutdown(uv_shutdown_t* req, int status);
+  static void AfterCorkedWrite(uv_write_t* req, int status);
+  static void OnCorkPrepare(uv_prepare_t* handle);
+  static void OnCorkCheck(uv_check_t* handle);
+  static void OnCorkIdle(uv_idle_t* handle);
 
   static void OnRead(uv_stream_t* handle,
                      ssize_t nread,
@@ -215,7 +306,29 @@ class StreamWrap : public HandleWrap {
   StreamWrapCallbacks default_callbacks_;
   StreamWrapCallbacks* callbacks_;  // Overridable callbacks
   bool callbacks_gc_;
-
+  SendFileWrap* sendfile_;  // Pending or in-flight sendFile(), if any.
+
+  // Scratch space for the string chunks of small writev() calls. Owned by
+  // the write that still references it, if any.
+  static const size_t kWritevArenaSize = 8 * 1024;
+  char* writev_arena_;
+  WriteWrap* writev_arena_owner_;
+
+  bool corked_;
+  uv_buf_t* cork_bufs_;
+  size_t cork_count_;
+  size_t cork_capacity_;
+  size_t cork_size_;   // Bytes in cork_bufs_, counted into writeQueueSize.
+  QUEUE cork_reqs_;    // Corked writes waiting for the next flush.
+  QUEUE cork_flight_;  // Flushed writes waiting for their batch to finish.
+  QUEUE cork_failed_;  // Flushed writes whose batch failed to go out.
+  QUEUE cork_member_;  // Links into env()->corked_stream_queue().
+  QUEUE cork_error_member_;  // Links into env()->cork_error_stream_queue().
+  int cork_error_;
+  uint64_t cork_flushes_;
+  uint64_t cork_chunks_;
+
+  friend class SendFileWrap;
   friend class StreamWrapCallbacks;
 };
 
@@ -132,6 +132,10 @@ void TCPWrap::Initialize(Handle<Object> target,
                             "writeBinaryString",
                             StreamWrap::WriteBinaryString);
   NODE_SET_PROTOTYPE_METHOD(t, "writev", StreamWrap::Writev);
+  NODE_SET_PROTOTYPE_METHOD(t, "cork", StreamWrap::Cork);
+  NODE_SET_PROTOTYPE_METHOD(t, "uncork", StreamWrap::Uncork);
+  NODE_SET_PROTOTYPE_METHOD(t, "getCorkStats", StreamWrap::GetCorkStats);
+  NODE_SET_PROTOTYPE_METHOD(t, "sendFile", StreamWrap::SendFile);
 
   NODE_SET_PROTOTYPE_METHOD(t, "open", Open);
   NODE_SET_PROTOTYPE_METHOD(t, "bind", Bind);
@@ -33,6 +33,8 @@
 #include "util.h"
 #include "util-inl.h"
 
+#include <string.h>  // memcpy, memset
+
 namespace node {
 
 using crypto::SSLWrap;
@@ -49,6 +51,8 @@ using v8::HandleScope;
 using v8::Integer;
 using v8::Local;
 using v8::Null;
+using v8::Number;
+using v8::Array;
 using v8::Object;
 using v8::String;
 using v8::Value;
@@ -77,10 +81,29 @@ TLSCallbacks::TLSCallbacks(Environment* env,
       shutdown_(false),
       error_(NULL),
       cycle_depth_(0),
-      eof_(false) {
+      eof_(false),
+      async_handshake_(false),
+      stream_destroyed_(false),
+      handshake_in_(NULL),
+      handshake_nread_(0),
+      handshake_ret_(0),
+      handshake_info_(0),
+      handshake_queued_at_(0),
+      handshake_started_at_(0),
+      handshake_done_at_(0),
+      handshake_error_count_(0),
+      handshake_sni_context_(NULL),
+      handshake_shutdown_(NULL),
+      handshake_shutdown_cb_(NULL),
+      dynamic_records_(true),
+      record_size_(kMaxRecordSize),
+      record_boost_bytes_(0),
+      record_written_at_(0) {
   node::Wrap(object(), this);
   MakeWeak(this);
 
+  memset(&record_stats_, 0, sizeof(record_stats_));
+
   // Initialize queue for clearIn writes
   QUEUE_INIT(&write_item_queue_);
   QUEUE_INIT(&pending_write_items_);
@@ -98,6 +121,8 @@ TLSCallbacks::~TLSCallbacks() {
   enc_out_ = NULL;
   delete clear_in_;
   clear_in_ = NULL;
+  delete handshake_in_;
+  handshake_in_ = NULL;
 
   sc_ = NULL;
   sc_handle_.Reset();
@@ -290,23 +315,34 @@ void TLSCallbacks::SSLInfoCallback(const SSL* ssl_, int where, int ret) {
   // a non-const SSL* in OpenSSL <= 0.9.7e.
   SSL* ssl = const_cast<SSL*>(ssl_);
   TLSCallbacks* c = static_cast<TLSCallbacks*>(SSL_get_app_data(ssl));
-  Environment* env = c->env();
-  HandleScope handle_scope(env->isolate());
-  Context::Scope context_scope(env->context());
-  Local<Object> object = c->object();
+
+  // Off the loop thread, AfterHandshakeWork() replays it.
+  if (c->handshake_queued_) {
+    c->handshake_info_ |= where;
+    return;
+  }
+
+  c->OnHandshakeInfo(where);
+}
+
+
+void TLSCallbacks::OnHandshakeInfo(int where) {
+  HandleScope handle_scope(env()->isolate());
+  Context::Scope context_scope(env()->context());
+  Local<Object> object = this->object();
 
   if (where & SSL_CB_HANDSHAKE_START) {
-    Local<Value> callback = object->Get(env->onhandshakestart_string());
+    Local<Value> callback = object->Get(env()->onhandshakestart_string());
     if (callback->IsFunction()) {
-      c->MakeCallback(callback.As<Function>(), 0, NULL);
+      MakeCallback(callback.As<Function>(), 0, NULL);
     }
   }
 
   if (where & SSL_CB_HANDSHAKE_DONE) {
-    c->established_ = true;
-    Local<Value> callback = object->Get(env->onhandshakedone_string());
+    established_ = true;
+    Local<Value> callback = object->Get(env()->onhandshakedone_string());
     if (callback->IsFunction()) {
-      c->MakeCallback(callback.As<Function>(), 0, NULL);
+      MakeCallback(callback.As<Function>(), 0, NULL);
     }
   }
 }
@@ -317,6 +353,10 @@ void TLSCallbacks::EncOut() {
   if (!hello_parser_.IsEnded())
     return;
 
+  // The handshake owns enc_out_ until AfterHandshakeWork()
+  if (handshake_queued_)
+    return;
+
   // Write in progress
   if (write_size_ != 0)
     return;
@@ -451,6 +491,13 @@ void TLSCallbacks::ClearOut() {
   if (eof_)
     return;
 
+  // The handshake owns the SSL object until AfterHandshakeWork()
+  if (handshake_queued_)
+    return;
+
+  if (CanQueueHandshake())
+    return QueueHandshake();
+
   HandleScope handle_scope(env()->isolate());
   Context::Scope context_scope(env()->context());
 
@@ -501,15 +548,24 @@ bool TLSCallbacks::ClearIn() {
   if (!hello_parser_.IsEnded())
     return false;
 
+  // SSL_write() would run the handshake right here, leave it to ClearOut()
+  if (handshake_queued_ || CanQueueHandshake())
+    return false;
+
   int written = 0;
   while (clear_in_->Length() > 0) {
-    size_t avail = 0;
-    char* data = clear_in_->Peek(&avail);
-    written = SSL_write(ssl_, data, avail);
-    assert(written == -1 || written == static_cast<int>(avail));
-    if (written == -1)
+    char* data[kSimultaneousBufferCount];
+    size_t size[ARRAY_SIZE(data)];
+    size_t count = ARRAY_SIZE(data);
+    size_t avail = clear_in_->PeekMultiple(data, size, &count);
+
+    uv_buf_t bufs[ARRAY_SIZE(data)];
+    for (size_t i = 0; i < count; i++)
+      bufs[i] = uv_buf_init(data[i], size[i]);
+    size_t n = WriteRecords(bufs, count, &written);
+    clear_in_->Read(NULL, n);
+    if (n != avail)
       break;
-    clear_in_->Read(NULL, avail);
   }
 
   // All written
@@ -555,15 +611,21 @@ int TLSCallbacks::DoWrite(WriteWrap* w,
                           uv_write_cb cb) {
   assert(send_handle == NULL);
 
-  bool empty = true;
+  // The handshake owns the SSL object, encrypt once it's done
+  if (handshake_queued_) {
+    WriteItem* wi = new WriteItem(w, cb);
+    QUEUE_INSERT_TAIL(&write_item_queue_, &wi->member_);
+    for (size_t i = 0; i < count; i++)
+      clear_in_->Write(bufs[i].base, bufs[i].len);
+    return 0;
+  }
 
   // Empty writes should not go through encryption process
   size_t i;
+  size_t total = 0;
   for (i = 0; i < count; i++)
-    if (bufs[i].len > 0) {
-      empty = false;
-      break;
-    }
+    total += bufs[i].len;
+  bool empty = total == 0;
   if (empty) {
     ClearOut();
     // However if there any data that should be written to socket,
@@ -590,25 +652,30 @@ int TLSCallbacks::DoWrite(WriteWrap* w,
     return 0;
   }
 
-  int written = 0;
-  for (i = 0; i < count; i++) {
-    written = SSL_write(ssl_, bufs[i].base, bufs[i].len);
-    assert(written == -1 || written == static_cast<int>(bufs[i].len));
-    if (written == -1)
-      break;
-  }
+  int ret;
+  size_t written = WriteRecords(bufs, count, &ret);
 
-  if (i != count) {
+  if (written != total) {
     int err;
     HandleScope handle_scope(env()->isolate());
     Context::Scope context_scope(env()->context());
-    Local<Value> arg = GetSSLError(written, &err, &error_);
-    if (!arg.IsEmpty())
+    Local<Value> arg = GetSSLError(ret, &err, &error_);
+    if (!arg.IsEmpty()) {
+      // The caller reports the error, don't complete the write twice
+      QUEUE_REMOVE(&wi->member_);
+      delete wi;
       return UV_EPROTO;
+    }
 
     // No errors, queue rest
-    for (; i < count; i++)
-      clear_in_->Write(bufs[i].base, bufs[i].len);
+    for (i = 0; i < count; i++) {
+      if (written >= bufs[i].len) {
+        written -= bufs[i].len;
+        continue;
+      }
+      clear_in_->Write(bufs[i].base + written, bufs[i].len - written);
+      written = 0;
+    }
   }
 
   // Try writing data immediately
@@ -618,6 +685,117 @@ int TLSCallbacks::DoWrite(WriteWrap* w,
 }
 
 
+// Size of the next record. Decides between small and full-sized records for
+// dynamic record sizing, see kSmallRecordSize.
+size_t TLSCallbacks::RecordSize() {
+#ifdef SSL_set_max_send_fragment
+  if (!dynamic_records_)
+    return record_size_;
+
+  uint64_t now = uv_now(env()->event_loop());
+  if (now - record_written_at_ >= static_cast<uint64_t>(kRecordIdleTimeout))
+    record_boost_bytes_ = 0;
+  record_written_at_ = now;
+
+  size_t size = kSmallRecordSize;
+  if (record_boost_bytes_ >= static_cast<uint64_t>(kRecordBoostBytes))
+    size = kMaxRecordSize;
+  if (size != record_size_) {
+    SSL_set_max_send_fragment(ssl_, size);
+    record_size_ = size;
+  }
+#endif  // SSL_set_max_send_fragment
+  return record_size_;
+}
+
+
+// Encrypts |bufs| into as few records as possible: small pieces are copied
+// together so they share a record instead of each getting its own header and
+// MAC, large ones are passed to SSL_write() directly in record-sized
+// multiples. Returns the number of bytes written, |*ret| is the return value
+// of the last SSL_write().
+size_t TLSCallbacks::WriteRecords(const uv_buf_t* bufs,
+                                  size_t count,
+                                  int* ret) {
+  char stage[kMaxRecordSize];
+  size_t staged = 0;
+  size_t written = 0;
+  size_t record_size = kMaxRecordSize;
+
+  *ret = 0;
+  record_stats_.chunks += count;
+  for (size_t i = 0; i < count; i++) {
+    const char* data = bufs[i].base;
+    size_t length = bufs[i].len;
+    while (length > 0) {
+      if (staged == 0)
+        record_size = RecordSize();
+
+      size_t n;
+      if (staged == 0 && length >= record_size) {
+        // Small records are written one by one so that the switch to full
+        // ones happens as soon as the connection has warmed up.
+        n = record_size;
+        if (record_size == static_cast<size_t>(kMaxRecordSize))
+          n = length - length % record_size;
+        if (!WriteRecord(data, n, ret))
+          return written;
+        written += n;
+      } else {
+        n = record_size - staged;
+        if (n > length)
+          n = length;
+        memcpy(stage + staged, data, n);
+        staged += n;
+        if (staged == record_size) {
+          if (!WriteRecord(stage, staged, ret))
+            return written;
+          written += staged;
+          staged = 0;
+        }
+      }
+      data += n;
+      length -= n;
+    }
+  }
+
+  if (staged > 0 && WriteRecord(stage, staged, ret))
+    written += staged;
+
+  return written;
+}
+
+
+bool TLSCallbacks::WriteRecord(const char* data, size_t length, int* ret) {
+  *ret = SSL_write(ssl_, data, length);
+  assert(*ret == -1 || *ret == static_cast<int>(length));
+  if (*ret == -1)
+    return false;
+
+  // SSL_write() cuts |data| into records of record_size_ bytes
+  size_t full = length / record_size_;
+  size_t rest = length % record_size_;
+  record_stats_.records += full + (rest != 0);
+  record_stats_.bytes += length;
+  record_boost_bytes_ += length;
+
+  for (int i = 0; i < kRecordSizeBuckets; i++) {
+    if (record_size_ <= static_cast<size_t>(512 << i)) {
+      record_stats_.sizes[i] += full;
+      break;
+    }
+  }
+  for (int i = 0; i < kRecordSizeBuckets && rest != 0; i++) {
+    if (rest <= static_cast<size_t>(512 << i)) {
+      record_stats_.sizes[i]++;
+      break;
+    }
+  }
+
+  return true;
+}
+
+
 void TLSCallbacks::AfterWrite(WriteWrap* w) {
   // Intentionally empty
 }
@@ -626,8 +804,10 @@ void TLSCallbacks::AfterWrite(WriteWrap* w) {
 void TLSCallbacks::DoAlloc(uv_handle_t* handle,
                            size_t suggested_size,
                            uv_buf_t* buf) {
+  // enc_in_ belongs to the handshake while it runs on the thread pool
+  NodeBIO* bio = handshake_queued_ ? handshake_in_ : NodeBIO::FromBIO(enc_in_);
   size_t size = 0;
-  buf->base = NodeBIO::FromBIO(enc_in_)->PeekWritable(&size);
+  buf->base = bio->PeekWritable(&size);
   buf->len = size;
 }
 
@@ -637,7 +817,12 @@ void TLSCallbacks::DoRead(uv_stream_t* handle,
                           const uv_buf_t* buf,
                           uv_handle_type pending) {
   if (nread < 0)  {
-    // Error should be emitted only after all data was read
+    // Error should be emitted only after all data was read, including the
+    // data that is still parked for an asynchronous handshake step
+    if (handshake_queued_) {
+      handshake_nread_ = nread;
+      return;
+    }
     ClearOut();
 
     // Ignore EOF if received close_notify
@@ -657,6 +842,12 @@ void TLSCallbacks::DoRead(uv_stream_t* handle,
   // Only client connections can receive data
   assert(ssl_ != NULL);
 
+  // Picked up by AfterHandshakeWork()
+  if (handshake_queued_) {
+    handshake_in_->Commit(nread);
+    return;
+  }
+
   // Commit read data
   NodeBIO* enc_in = NodeBIO::FromBIO(enc_in_);
   enc_in->Commit(nread);
@@ -675,6 +866,16 @@ void TLSCallbacks::DoRead(uv_stream_t* handle,
 
 
 int TLSCallbacks::DoShutdown(ShutdownWrap* req_wrap, uv_shutdown_cb cb) {
+  // No close_notify in the middle of an asynchronous handshake step, and the
+  // socket can't be shut down before the step's output has been written.
+  // AfterHandshakeWork() picks it up from here.
+  if (handshake_queued_) {
+    assert(handshake_shutdown_ == NULL);
+    handshake_shutdown_ = req_wrap;
+    handshake_shutdown_cb_ = cb;
+    return 0;
+  }
+
   if (SSL_shutdown(ssl_) == 0)
     SSL_shutdown(ssl_);
   shutdown_ = true;
@@ -683,6 +884,198 @@ int TLSCallbacks::DoShutdown(ShutdownWrap* req_wrap, uv_shutdown_cb cb) {
 }
 
 
+void TLSCallbacks::OnStreamDestroyed() {
+  stream_destroyed_ = true;
+}
+
+
+bool TLSCallbacks::CanQueueHandshake() {
+  if (!async_handshake_ || !is_server() || established_ || stream_destroyed_)
+    return false;
+
+  // Nothing to do yet, or a write still references enc_out_
+  if (BIO_pending(enc_in_) == 0 || write_size_ != 0)
+    return false;
+
+  // These call into JS in the middle of the handshake
+  if (session_callbacks_)
+    return false;
+#ifdef OPENSSL_NPN_NEGOTIATED
+  if (!npn_protos_.IsEmpty())
+    return false;
+#endif  // OPENSSL_NPN_NEGOTIATED
+#ifdef NODE__HAVE_TLSEXT_STATUS_CB
+  if (!ocsp_response_.IsEmpty())
+    return false;
+#endif  // NODE__HAVE_TLSEXT_STATUS_CB
+
+#ifdef SSL_CTRL_SET_TLSEXT_SERVERNAME_CB
+  // Leave bad SNI contexts to SelectSNIContextCallback() to report
+  HandleScope scope(env()->isolate());
+  Local<Value> ctx = object()->Get(env()->sni_context_string());
+  if (ctx->IsObject() &&
+      !env()->secure_context_constructor_template()->HasInstance(ctx)) {
+    return false;
+  }
+#endif  // SSL_CTRL_SET_TLSEXT_SERVERNAME_CB
+
+  return true;
+}
+
+
+// OpenSSL 1.0.1 can't suspend the handshake halfway through a private key
+// operation, so the whole step that contains it - everything SSL_accept()
+// does with the data that is in enc_in_ right now - runs on the thread pool.
+// Callbacks that would call into JS from there are either replayed when the
+// step is done (the info callback), resolved up front (SNI) or make
+// CanQueueHandshake() fall back to the synchronous path.
+void TLSCallbacks::QueueHandshake() {
+  HandleScope scope(env()->isolate());
+
+  handshake_sni_context_ = NULL;
+#ifdef SSL_CTRL_SET_TLSEXT_SERVERNAME_CB
+  Local<Value> ctx = object()->Get(env()->sni_context_string());
+  if (ctx->IsObject()) {
+    sni_context_.Reset(env()->isolate(), ctx);
+    handshake_sni_context_ = Unwrap<SecureContext>(ctx.As<Object>());
+    // Other connections may be using the context, set it up here rather
+    // than on the thread pool.
+    InitNPN(handshake_sni_context_);
+  }
+#endif  // SSL_CTRL_SET_TLSEXT_SERVERNAME_CB
+
+  if (handshake_in_ == NULL)
+    handshake_in_ = new NodeBIO();
+
+  handshake_queued_ = true;
+  handshake_info_ = 0;
+  handshake_error_count_ = 0;
+  handshake_queued_at_ = uv_hrtime();
+
+  // Stay alive until AfterHandshakeWork()
+  ClearWeak();
+
+  Environment::HandshakeStats* stats = env()->handshake_stats();
+  stats->queued++;
+  if (++stats->pending > stats->max_pending)
+    stats->max_pending = stats->pending;
+
+  int r = uv_queue_work(env()->event_loop(),
+                        &handshake_req_,
+                        HandshakeWork,
+                        AfterHandshakeWork);
+  CHECK_EQ(r, 0);
+}
+
+
+void TLSCallbacks::HandshakeWork(uv_work_t* req) {
+  TLSCallbacks* c = ContainerOf(&TLSCallbacks::handshake_req_, req);
+
+  c->handshake_started_at_ = uv_hrtime();
+  c->handshake_ret_ = SSL_do_handshake(c->ssl_);
+
+  // The error queue is per thread, take it over to the loop thread.
+  const char* file;
+  int line;
+  unsigned long code;
+  while ((code = ERR_get_error_line(&file, &line)) != 0) {
+    if (c->handshake_error_count_ == kMaxHandshakeErrors)
+      continue;
+    HandshakeError* e = &c->handshake_errors_[c->handshake_error_count_++];
+    e->code = code;
+    e->file = file;
+    e->line = line;
+  }
+
+  c->handshake_done_at_ = uv_hrtime();
+}
+
+
+void TLSCallbacks::AfterHandshakeWork(uv_work_t* req, int status) {
+  TLSCallbacks* c = ContainerOf(&TLSCallbacks::handshake_req_, req);
+  CHECK_EQ(status, 0);
+
+  uint64_t latency = uv_hrtime() - c->handshake_queued_at_;
+  Environment::HandshakeStats* stats = c->env()->handshake_stats();
+  stats->pending--;
+  stats->completed++;
+  stats->wait_time += c->handshake_started_at_ - c->handshake_queued_at_;
+  stats->run_time += c->handshake_done_at_ - c->handshake_started_at_;
+  if (latency > stats->max_latency)
+    stats->max_latency = latency;
+
+  c->handshake_queued_ = false;
+  c->MakeWeak(c);
+
+  ShutdownWrap* shutdown = c->handshake_shutdown_;
+  c->handshake_shutdown_ = NULL;
+
+  // Socket went away in the meantime, nothing left to talk to
+  if (c->stream_destroyed_) {
+    delete shutdown;
+    return;
+  }
+
+  // Hand over what arrived in the meantime
+  NodeBIO* enc_in = NodeBIO::FromBIO(c->enc_in_);
+  while (c->handshake_in_->Length() > 0) {
+    size_t avail = 0;
+    char* data = c->handshake_in_->Peek(&avail);
+    enc_in->Write(data, avail);
+    c->handshake_in_->Read(NULL, avail);
+  }
+
+  for (int i = 0; i < c->handshake_error_count_; i++) {
+    HandshakeError* e = &c->handshake_errors_[i];
+    ERR_put_error(ERR_GET_LIB(e->code),
+                  ERR_GET_FUNC(e->code),
+                  ERR_GET_REASON(e->code),
+                  e->file,
+                  e->line);
+  }
+
+  Environment* env = c->env();
+  HandleScope handle_scope(env->isolate());
+  Context::Scope context_scope(env->context());
+
+  if (c->handshake_info_ != 0)
+    c->OnHandshakeInfo(c->handshake_info_);
+
+  Local<Value> arg;
+  if (c->handshake_ret_ <= 0) {
+    int err;
+    arg = c->GetSSLError(c->handshake_ret_, &err, NULL);
+  }
+
+  if (arg.IsEmpty()) {
+    c->Cycle();
+  } else {
+    // Flush the alert, same as ClearOut()
+    if (BIO_pending(c->enc_out_) != 0)
+      c->EncOut();
+
+    c->MakeCallback(env->onerror_string(), 1, &arg);
+  }
+
+  // EOF or read error that came in while the step was running
+  if (c->handshake_nread_ != 0) {
+    ssize_t nread = c->handshake_nread_;
+    c->handshake_nread_ = 0;
+    c->DoRead(c->wrap()->stream(), nread, NULL, UV_UNKNOWN_HANDLE);
+  }
+
+  // The step's output is on its way, the shutdown goes out after it
+  if (shutdown != NULL) {
+    int err = c->DoShutdown(shutdown, c->handshake_shutdown_cb_);
+    if (err != 0) {
+      // JS land was told the shutdown is underway, complete it with the error
+      shutdown->req_.handle = c->wrap()->stream();
+      c->handshake_shutdown_cb_(&shutdown->req_, err);
+    }
+  }
+}
+
+
 void TLSCallbacks::SetVerifyMode(const FunctionCallbackInfo<Value>& args) {
   Environment* env = Environment::GetCurrent(args.GetIsolate());
   HandleScope scope(env->isolate());
@@ -739,6 +1132,87 @@ void TLSCallbacks::EnableHelloParser(const FunctionCallbackInfo<Value>& args) {
 }
 
 
+void TLSCallbacks::EnableAsyncHandshake(
+    const FunctionCallbackInfo<Value>& args) {
+  HandleScope scope(args.GetIsolate());
+
+  TLSCallbacks* wrap = Unwrap<TLSCallbacks>(args.Holder());
+  wrap->async_handshake_ = true;
+}
+
+
+void TLSCallbacks::GetRecordStats(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args.GetIsolate());
+  HandleScope scope(env->isolate());
+
+  TLSCallbacks* wrap = Unwrap<TLSCallbacks>(args.Holder());
+  const RecordStats& s = wrap->record_stats_;
+
+  Local<Array> sizes = Array::New(env->isolate(), kRecordSizeBuckets);
+  for (int i = 0; i < kRecordSizeBuckets; i++)
+    sizes->Set(i, Number::New(env->isolate(),
+                              static_cast<double>(s.sizes[i])));
+
+  Local<Object> info = Object::New(env->isolate());
+  info->Set(env->records_string(),
+            Number::New(env->isolate(), static_cast<double>(s.records)));
+  info->Set(env->bytes_string(),
+            Number::New(env->isolate(), static_cast<double>(s.bytes)));
+  info->Set(env->chunks_string(),
+            Number::New(env->isolate(), static_cast<double>(s.chunks)));
+  info->Set(env->record_size_string(),
+            Integer::NewFromUnsigned(env->isolate(), wrap->record_size_));
+  info->Set(env->sizes_string(), sizes);
+  args.GetReturnValue().Set(info);
+}
+
+
+#ifdef SSL_set_max_send_fragment
+// Shadows SSLWrap::SetMaxSendFragment(): a size picked by the user turns off
+// dynamic record sizing.
+void TLSCallbacks::SetMaxSendFragment(
+    const FunctionCallbackInfo<Value>& args) {
+  HandleScope scope(args.GetIsolate());
+  CHECK(args.Length() >= 1 && args[0]->IsNumber());
+
+  TLSCallbacks* wrap = Unwrap<TLSCallbacks>(args.Holder());
+
+  int size = args[0]->Int32Value();
+  int rv = SSL_set_max_send_fragment(wrap->ssl_, size);
+  if (rv == 1) {
+    wrap->dynamic_records_ = false;
+    wrap->record_size_ = size;
+  }
+  args.GetReturnValue().Set(rv);
+}
+#endif  // SSL_set_max_send_fragment
+
+
+void TLSCallbacks::GetHandshakeStats(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args.GetIsolate());
+  HandleScope scope(env->isolate());
+
+  const Environment::HandshakeStats& s = *env->handshake_stats();
+  Local<Object> info = Object::New(env->isolate());
+  info->Set(env->queued_string(),
+            Number::New(env->isolate(), static_cast<double>(s.queued)));
+  info->Set(env->completed_string(),
+            Number::New(env->isolate(), static_cast<double>(s.completed)));
+  info->Set(env->pending_string(),
+            Number::New(env->isolate(), static_cast<double>(s.pending)));
+  info->Set(env->max_pending_string(),
+            Number::New(env->isolate(), static_cast<double>(s.max_pending)));
+  // Times in milliseconds
+  info->Set(env->wait_time_string(),
+            Number::New(env->isolate(), s.wait_time / 1e6));
+  info->Set(env->run_time_string(),
+            Number::New(env->isolate(), s.run_time / 1e6));
+  info->Set(env->max_latency_string(),
+            Number::New(env->isolate(), s.max_latency / 1e6));
+  args.GetReturnValue().Set(info);
+}
+
+
 void TLSCallbacks::OnClientHelloParseEnd(void* arg) {
   TLSCallbacks* c = static_cast<TLSCallbacks*>(arg);
   c->Cycle();
@@ -786,13 +1260,23 @@ void TLSCallbacks::SetServername(const FunctionCallbackInfo<Value>& args) {
 
 int TLSCallbacks::SelectSNIContextCallback(SSL* s, int* ad, void* arg) {
   TLSCallbacks* p = static_cast<TLSCallbacks*>(SSL_get_app_data(s));
-  Environment* env = p->env();
 
   const char* servername = SSL_get_servername(s, TLSEXT_NAMETYPE_host_name);
 
   if (servername == NULL)
     return SSL_TLSEXT_ERR_OK;
 
+  // Off the loop thread. QueueHandshake() has looked up and set up the
+  // context already, touch neither V8 nor the shared SSL_CTX from here.
+  if (p->handshake_queued_) {
+    SecureContext* sc = p->handshake_sni_context_;
+    if (sc == NULL)
+      return SSL_TLSEXT_ERR_NOACK;
+    SSL_set_SSL_CTX(s, sc->ctx_);
+    return SSL_TLSEXT_ERR_OK;
+  }
+
+  Environment* env = p->env();
   HandleScope scope(env->isolate());
   // Call the SNI callback and use its return value as context
   Local<Object> object = p->object();
@@ -827,6 +1311,7 @@ void TLSCallbacks::Initialize(Handle<Object> target,
   Environment* env = Environment::GetCurrent(context);
 
   NODE_SET_METHOD(target, "wrap", TLSCallbacks::Wrap);
+  NODE_SET_METHOD(target, "getHandshakeStats", TLSCallbacks::GetHandshakeStats);
 
   Local<FunctionTemplate> t = FunctionTemplate::New(env->isolate());
   t->InstanceTemplate()->SetInternalFieldCount(1);
@@ -841,9 +1326,18 @@ void TLSCallbacks::Initialize(Handle<Object> target,
   NODE_SET_PROTOTYPE_METHOD(t,
                             "enableHelloParser",
                             EnableHelloParser);
+  NODE_SET_PROTOTYPE_METHOD(t,
+                            "enableAsyncHandshake",
+                            EnableAsyncHandshake);
+
+  NODE_SET_PROTOTYPE_METHOD(t, "getRecordStats", GetRecordStats);
 
   SSLWrap<TLSCallbacks>::AddMethods(env, t);
 
+#ifdef SSL_set_max_send_fragment
+  NODE_SET_PROTOTYPE_METHOD(t, "setMaxSendFragment", SetMaxSendFragment);
+#endif  // SSL_set_max_send_fragment
+
 #ifdef SSL_CTRL_SET_TLSEXT_SERVERNAME_CB
   NODE_SET_PROTOTYPE_METHOD(t, "getServername", GetServername);
   NODE_SET_PROTOTYPE_METHOD(t, "setServername", SetServername);
@@ -68,6 +68,7 @@ class TLSCallbacks : public crypto::SSLWrap<TLSCallbacks>,
               const uv_buf_t* buf,
               uv_handle_type pending);
   int DoShutdown(ShutdownWrap* req_wrap, uv_shutdown_cb cb);
+  void OnStreamDestroyed();
 
   void NewSessionDoneCb();
 
@@ -83,6 +84,21 @@ class TLSCallbacks : public crypto::SSLWrap<TLSCallbacks>,
   // Maximum number of buffers passed to uv_write()
   static const int kSimultaneousBufferCount = 10;
 
+  // OpenSSL errors carried over from an asynchronous handshake step
+  static const int kMaxHandshakeErrors = 8;
+
+  // Dynamic record sizing: a fresh or idle connection gets records that fit
+  // into a single TCP segment, so the peer can decrypt the first bytes
+  // without waiting for more packets. Once kRecordBoostBytes went out without
+  // a pause of kRecordIdleTimeout ms, records grow to the maximum size.
+  static const int kSmallRecordSize = 1400;
+  static const int kMaxRecordSize = 16384;
+  static const int kRecordBoostBytes = 1024 * 1024;
+  static const int kRecordIdleTimeout = 1000;
+
+  // Record size histogram, bucket i counts records of up to (512 << i) bytes
+  static const int kRecordSizeBuckets = 6;
+
   // Write callback queue's item
   class WriteItem {
    public:
@@ -104,14 +120,26 @@ class TLSCallbacks : public crypto::SSLWrap<TLSCallbacks>,
                StreamWrapCallbacks* old);
 
   static void SSLInfoCallback(const SSL* ssl_, int where, int ret);
+  void OnHandshakeInfo(int where);
   void InitSSL();
   void EncOut();
   static void EncOutCb(uv_write_t* req, int status);
   bool ClearIn();
   void ClearOut();
+  size_t RecordSize();
+  size_t WriteRecords(const uv_buf_t* bufs, size_t count, int* ret);
+  bool WriteRecord(const char* data, size_t length, int* ret);
   void MakePending();
   bool InvokeQueued(int status);
 
+  // Asynchronous handshake: the handshake steps that do the private key
+  // operations run on the thread pool while the SSL object is left alone
+  // on the loop thread. Incoming data is parked in handshake_in_ meanwhile.
+  bool CanQueueHandshake();
+  void QueueHandshake();
+  static void HandshakeWork(uv_work_t* req);
+  static void AfterHandshakeWork(uv_work_t* req, int status);
+
   inline void Cycle() {
     // Prevent recursion
     if (++cycle_depth_ > 1)
@@ -138,6 +166,15 @@ class TLSCallbacks : public crypto::SSLWrap<TLSCallbacks>,
       const v8::FunctionCallbackInfo<v8::Value>& args);
   static void EnableHelloParser(
       const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void EnableAsyncHandshake(
+      const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void GetHandshakeStats(
+      const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void GetRecordStats(const v8::FunctionCallbackInfo<v8::Value>& args);
+#ifdef SSL_set_max_send_fragment
+  static void SetMaxSendFragment(
+      const v8::FunctionCallbackInfo<v8::Value>& args);
+#endif  // SSL_set_max_send_fragment
 
 #ifdef SSL_CTRL_SET_TLSEXT_SERVERNAME_CB
   static void GetServername(const v8::FunctionCallbackInfo<v8::Value>& args);
@@ -165,6 +202,43 @@ class TLSCallbacks : public crypto::SSLWrap<TLSCallbacks>,
   // after the `UV_EOF` on socket.
   bool eof_;
 
+  // See QueueHandshake()
+  struct HandshakeError {
+    unsigned long code;
+    const char* file;
+    int line;
+  };
+
+  bool async_handshake_;
+  bool stream_destroyed_;
+  uv_work_t handshake_req_;
+  NodeBIO* handshake_in_;
+  ssize_t handshake_nread_;
+  int handshake_ret_;
+  int handshake_info_;
+  uint64_t handshake_queued_at_;
+  uint64_t handshake_started_at_;
+  uint64_t handshake_done_at_;
+  HandshakeError handshake_errors_[kMaxHandshakeErrors];
+  int handshake_error_count_;
+  crypto::SecureContext* handshake_sni_context_;
+  ShutdownWrap* handshake_shutdown_;  // Waits for AfterHandshakeWork()
+  uv_shutdown_cb handshake_shutdown_cb_;
+
+  // See WriteRecords()
+  struct RecordStats {
+    uint64_t records;
+    uint64_t bytes;
+    uint64_t chunks;
+    uint64_t sizes[kRecordSizeBuckets];
+  };
+
+  bool dynamic_records_;
+  size_t record_size_;
+  uint64_t record_boost_bytes_;
+  uint64_t record_written_at_;
+  RecordStats record_stats_;
+
 #ifdef SSL_CTRL_SET_TLSEXT_SERVERNAME_CB
   v8::Persistent<v8::Value> sni_context_;
 #endif  // SSL_CTRL_SET_TLSEXT_SERVERNAME_CB
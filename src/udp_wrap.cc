@@ -29,10 +29,13 @@
 #include "util-inl.h"
 
 #include <stdlib.h>
+#include <string.h>  // memcpy(), memmove()
 
 
 namespace node {
 
+using v8::Array;
+using v8::Boolean;
 using v8::Context;
 using v8::EscapableHandleScope;
 using v8::External;
@@ -75,6 +78,118 @@ inline bool SendWrap::have_callback() const {
 }
 
 
+// Carries the requests for every datagram of a sendBatch() call and reports
+// back to JS once, after the last one has completed.
+class SendBatchWrap : public ReqWrap<uv_udp_send_t> {
+ public:
+  SendBatchWrap(Environment* env,
+                Local<Object> req_wrap_obj,
+                size_t count,
+                bool have_callback);
+  ~SendBatchWrap();
+
+  inline uv_udp_send_t* req(size_t index);
+  inline void Queued(size_t index);
+  inline void Failed(int err);
+  // Returns true when that was the last outstanding datagram.
+  inline bool Done(int status);
+  inline size_t pending() const;
+  inline size_t sent() const;
+  inline int error() const;
+  inline bool have_callback() const;
+
+ private:
+  uv_udp_send_t* reqs_;
+  size_t pending_;
+  size_t sent_;
+  int error_;
+  const bool have_callback_;
+};
+
+
+SendBatchWrap::SendBatchWrap(Environment* env,
+                             Local<Object> req_wrap_obj,
+                             size_t count,
+                             bool have_callback)
+    : ReqWrap<uv_udp_send_t>(env, req_wrap_obj, AsyncWrap::PROVIDER_UDPWRAP),
+      reqs_(new uv_udp_send_t[count]),
+      pending_(0),
+      sent_(0),
+      error_(0),
+      have_callback_(have_callback) {
+  Wrap(req_wrap_obj, this);
+}
+
+
+SendBatchWrap::~SendBatchWrap() {
+  delete[] reqs_;
+}
+
+
+inline uv_udp_send_t* SendBatchWrap::req(size_t index) {
+  return reqs_ + index;
+}
+
+
+inline void SendBatchWrap::Queued(size_t index) {
+  reqs_[index].data = this;
+  pending_ += 1;
+}
+
+
+inline void SendBatchWrap::Failed(int err) {
+  if (error_ == 0)
+    error_ = err;
+}
+
+
+inline bool SendBatchWrap::Done(int status) {
+  if (status < 0)
+    Failed(status);
+  else
+    sent_ += 1;
+  assert(pending_ > 0);
+  pending_ -= 1;
+  return pending_ == 0;
+}
+
+
+inline size_t SendBatchWrap::pending() const {
+  return pending_;
+}
+
+
+inline size_t SendBatchWrap::sent() const {
+  return sent_;
+}
+
+
+inline int SendBatchWrap::error() const {
+  return error_;
+}
+
+
+inline bool SendBatchWrap::have_callback() const {
+  return have_callback_;
+}
+
+
+static int ToSockAddr(int family,
+                      const char* address,
+                      unsigned short port,
+                      sockaddr_storage* addr) {
+  switch (family) {
+  case AF_INET:
+    return uv_ip4_addr(address, port, reinterpret_cast<sockaddr_in*>(addr));
+  case AF_INET6:
+    return uv_ip6_addr(address, port, reinterpret_cast<sockaddr_in6*>(addr));
+  default:
+    assert(0 && "unexpected address family");
+    abort();
+  }
+}
+
+
 static void NewSendWrap(const FunctionCallbackInfo<Value>& args) {
   assert(args.IsConstructCall());
 }
@@ -84,13 +199,16 @@ UDPWrap::UDPWrap(Environment* env, Handle<Object> object, AsyncWrap* parent)
     : HandleWrap(env,
                  object,
                  reinterpret_cast<uv_handle_t*>(&handle_),
-                 AsyncWrap::PROVIDER_UDPWRAP) {
+                 AsyncWrap::PROVIDER_UDPWRAP),
+      recv_batch_(NULL),
+      recv_batch_count_(0) {
   int r = uv_udp_init(env->event_loop(), &handle_);
   assert(r == 0);  // can't fail anyway
 }
 
 
 UDPWrap::~UDPWrap() {
+  delete[] recv_batch_;
 }
 
 
@@ -116,6 +234,8 @@ void UDPWrap::Initialize(Handle<Object> target,
   NODE_SET_PROTOTYPE_METHOD(t, "send", Send);
   NODE_SET_PROTOTYPE_METHOD(t, "bind6", Bind6);
   NODE_SET_PROTOTYPE_METHOD(t, "send6", Send6);
+  NODE_SET_PROTOTYPE_METHOD(t, "sendBatch", SendBatch);
+  NODE_SET_PROTOTYPE_METHOD(t, "sendBatch6", SendBatch6);
   NODE_SET_PROTOTYPE_METHOD(t, "close", Close);
   NODE_SET_PROTOTYPE_METHOD(t, "recvStart", RecvStart);
   NODE_SET_PROTOTYPE_METHOD(t, "recvStop", RecvStop);
@@ -126,6 +246,7 @@ void UDPWrap::Initialize(Handle<Object> target,
   NODE_SET_PROTOTYPE_METHOD(t, "setMulticastLoopback", SetMulticastLoopback);
   NODE_SET_PROTOTYPE_METHOD(t, "setBroadcast", SetBroadcast);
   NODE_SET_PROTOTYPE_METHOD(t, "setTTL", SetTTL);
+  NODE_SET_PROTOTYPE_METHOD(t, "setRecvBatch", SetRecvBatch);
 
   NODE_SET_PROTOTYPE_METHOD(t, "ref", HandleWrap::Ref);
   NODE_SET_PROTOTYPE_METHOD(t, "unref", HandleWrap::Unref);
@@ -181,20 +302,8 @@ void UDPWrap::DoBind(const FunctionCallbackInfo<Value>& args, int family) {
   node::Utf8Value address(args[0]);
   const int port = args[1]->Uint32Value();
   const int flags = args[2]->Uint32Value();
-  char addr[sizeof(sockaddr_in6)];
-  int err;
-
-  switch (family) {
-  case AF_INET:
-    err = uv_ip4_addr(*address, port, reinterpret_cast<sockaddr_in*>(&addr));
-    break;
-  case AF_INET6:
-    err = uv_ip6_addr(*address, port, reinterpret_cast<sockaddr_in6*>(&addr));
-    break;
-  default:
-    assert(0 && "unexpected address family");
-    abort();
-  }
+  sockaddr_storage addr;
+  int err = ToSockAddr(family, *address, port, &addr);
 
   if (err == 0) {
     err = uv_udp_bind(&wrap->handle_,
@@ -234,6 +343,24 @@ X(SetMulticastLoopback, uv_udp_set_multicast_loop)
 #undef X
 
 
+void UDPWrap::SetRecvBatch(const FunctionCallbackInfo<Value>& args) {
+  HandleScope scope(args.GetIsolate());
+  UDPWrap* wrap = Unwrap<UDPWrap>(args.Holder());
+
+  // setRecvBatch(count, size)
+  assert(args[0]->IsUint32());
+  assert(args[1]->IsUint32());
+  const unsigned int count = args[0]->Uint32Value();
+  const size_t size = args[1]->Uint32Value();
+
+  int err = uv_udp_set_recv_batch(&wrap->handle_, count, size);
+  if (err == 0 && count > 1 && wrap->recv_batch_ == NULL)
+    wrap->recv_batch_ = new RecvBatchEntry[kMaxRecvBatch];
+
+  args.GetReturnValue().Set(err);
+}
+
+
 void UDPWrap::SetMembership(const FunctionCallbackInfo<Value>& args,
                             uv_membership membership) {
   Environment* env = Environment::GetCurrent(args.GetIsolate());
@@ -339,6 +466,83 @@ void UDPWrap::Send6(const FunctionCallbackInfo<Value>& args) {
 }
 
 
+void UDPWrap::DoSendBatch(const FunctionCallbackInfo<Value>& args,
+                          int family) {
+  HandleScope handle_scope(args.GetIsolate());
+  Environment* env = Environment::GetCurrent(args.GetIsolate());
+
+  UDPWrap* wrap = Unwrap<UDPWrap>(args.Holder());
+
+  // sendBatch(req, buffers, ports, addresses, have_callback)
+  assert(args[0]->IsObject());
+  assert(args[1]->IsArray());
+  assert(args[2]->IsArray());
+  assert(args[3]->IsArray());
+  assert(args[4]->IsBoolean());
+
+  Local<Object> req_wrap_obj = args[0].As<Object>();
+  Local<Array> buffers = args[1].As<Array>();
+  Local<Array> ports = args[2].As<Array>();
+  Local<Array> addresses = args[3].As<Array>();
+  const bool have_callback = args[4]->IsTrue();
+  const uint32_t count = buffers->Length();
+
+  assert(count > 0);
+  assert(ports->Length() == count);
+  assert(addresses->Length() == count);
+
+  SendBatchWrap* req_wrap =
+      new SendBatchWrap(env, req_wrap_obj, count, have_callback);
+
+  // Only the first datagram is written out right away, the rest are queued
+  // and flushed together with sendmmsg() where the platform supports it.
+  for (uint32_t i = 0; i < count; i++) {
+    Local<Object> buffer_obj = buffers->Get(i).As<Object>();
+    assert(Buffer::HasInstance(buffer_obj));
+    const unsigned short port = ports->Get(i)->Uint32Value();
+    node::Utf8Value address(addresses->Get(i));
+
+    uv_buf_t buf = uv_buf_init(Buffer::Data(buffer_obj),
+                               Buffer::Length(buffer_obj));
+    sockaddr_storage addr;
+    int err = ToSockAddr(family, *address, port, &addr);
+
+    if (err == 0) {
+      err = uv_udp_send(req_wrap->req(i),
+                        &wrap->handle_,
+                        &buf,
+                        1,
+                        reinterpret_cast<const sockaddr*>(&addr),
+                        OnSendBatch);
+    }
+
+    if (err == 0)
+      req_wrap->Queued(i);
+    else
+      req_wrap->Failed(err);
+  }
+
+  req_wrap->Dispatched();
+  if (req_wrap->pending() == 0) {
+    args.GetReturnValue().Set(req_wrap->error());
+    delete req_wrap;
+    return;
+  }
+
+  args.GetReturnValue().Set(0);
+}
+
+
+void UDPWrap::SendBatch(const FunctionCallbackInfo<Value>& args) {
+  DoSendBatch(args, AF_INET);
+}
+
+
+void UDPWrap::SendBatch6(const FunctionCallbackInfo<Value>& args) {
+  DoSendBatch(args, AF_INET6);
+}
+
+
 void UDPWrap::RecvStart(const FunctionCallbackInfo<Value>& args) {
   Environment* env = Environment::GetCurrent(args.GetIsolate());
   HandleScope scope(env->isolate());
@@ -400,6 +604,26 @@ void UDPWrap::OnSend(uv_udp_send_t* req, int status) {
 }
 
 
+void UDPWrap::OnSendBatch(uv_udp_send_t* req, int status) {
+  SendBatchWrap* req_wrap = static_cast<SendBatchWrap*>(req->data);
+  if (!req_wrap->Done(status))
+    return;
+
+  if (req_wrap->have_callback()) {
+    Environment* env = req_wrap->env();
+    HandleScope handle_scope(env->isolate());
+    Context::Scope context_scope(env->context());
+    Local<Value> argv[] = {
+      Integer::New(env->isolate(), req_wrap->error()),
+      Integer::NewFromUnsigned(env->isolate(),
+                              static_cast<uint32_t>(req_wrap->sent()))
+    };
+    req_wrap->MakeCallback(env->oncomplete_string(), ARRAY_SIZE(argv), argv);
+  }
+  delete req_wrap;
+}
+
+
 void UDPWrap::OnAlloc(uv_handle_t* handle,
                       size_t suggested_size,
                       uv_buf_t* buf) {
@@ -418,13 +642,34 @@ void UDPWrap::OnRecv(uv_udp_t* handle,
                      const uv_buf_t* buf,
                      const struct sockaddr* addr,
                      unsigned int flags) {
+  UDPWrap* wrap = static_cast<UDPWrap*>(handle->data);
+
+  // Datagrams that are part of a batch point into one buffer. Collect them
+  // and hand the whole batch to JS once libuv passes the buffer back.
+  if (flags & UV_UDP_MMSG_CHUNK) {
+    assert(wrap->recv_batch_count_ < kMaxRecvBatch);
+    RecvBatchEntry* entry = &wrap->recv_batch_[wrap->recv_batch_count_++];
+    entry->data = buf->base;
+    entry->length = nread;
+    entry->truncated = (flags & UV_UDP_PARTIAL) != 0;
+    memset(&entry->address, 0, sizeof(entry->address));
+    if (addr != NULL) {
+      memcpy(&entry->address,
+             addr,
+             addr->sa_family == AF_INET6 ? sizeof(sockaddr_in6) :
+                                           sizeof(sockaddr_in));
+    }
+    return;
+  }
+
   if (nread == 0 && addr == NULL) {
+    if (wrap->recv_batch_count_ > 0)
+      return wrap->OnRecvBatch(buf);
     if (buf->base != NULL)
       free(buf->base);
     return;
   }
 
-  UDPWrap* wrap = static_cast<UDPWrap*>(handle->data);
   Environment* env = wrap->env();
 
   HandleScope handle_scope(env->isolate());
@@ -452,6 +697,53 @@ void UDPWrap::OnRecv(uv_udp_t* handle,
 }
 
 
+void UDPWrap::OnRecvBatch(const uv_buf_t* buf) {
+  Environment* env = this->env();
+
+  HandleScope handle_scope(env->isolate());
+  Context::Scope context_scope(env->context());
+
+  const unsigned int count = recv_batch_count_;
+  recv_batch_count_ = 0;
+
+  // Every datagram sits at the start of its own slot. Pack them together so
+  // JS gets a single buffer and a flat list of
+  // (offset, length, address, truncated).
+  Local<Array> records = Array::New(env->isolate(), count * 4);
+  size_t offset = 0;
+  for (unsigned int i = 0; i < count; i++) {
+    const RecvBatchEntry* entry = &recv_batch_[i];
+    const sockaddr* addr = reinterpret_cast<const sockaddr*>(&entry->address);
+    memmove(buf->base + offset, entry->data, entry->length);
+    records->Set(i * 4 + 0, Integer::NewFromUnsigned(env->isolate(), offset));
+    records->Set(i * 4 + 1,
+                 Integer::NewFromUnsigned(env->isolate(), entry->length));
+    records->Set(i * 4 + 2, AddressToJS(env, addr));
+    records->Set(i * 4 + 3, Boolean::New(env->isolate(), entry->truncated));
+    offset += entry->length;
+  }
+
+  // realloc() to zero bytes may free the block and return NULL, so a batch
+  // of empty datagrams gets an empty buffer of its own.
+  Local<Object> data;
+  if (offset == 0) {
+    free(buf->base);
+    data = Buffer::New(env, static_cast<size_t>(0));
+  } else {
+    char* base = static_cast<char*>(realloc(buf->base, offset));
+    data = Buffer::Use(env, base, offset);
+  }
+
+  Local<Value> argv[] = {
+    Integer::NewFromUnsigned(env->isolate(), count),
+    object(),
+    data,
+    records
+  };
+  MakeCallback(env->onmessage_string(), ARRAY_SIZE(argv), argv);
+}
+
+
 Local<Object> UDPWrap::Instantiate(Environment* env, AsyncWrap* parent) {
   // If this assert fires then Initialize hasn't been called yet.
   assert(env->udp_constructor_function().IsEmpty() == false);
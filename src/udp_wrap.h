@@ -43,6 +43,8 @@ class UDPWrap: public HandleWrap {
   static void Send(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void Bind6(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void Send6(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void SendBatch(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void SendBatch6(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void RecvStart(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void RecvStop(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void GetSockName(const v8::FunctionCallbackInfo<v8::Value>& args);
@@ -53,6 +55,7 @@ class UDPWrap: public HandleWrap {
       const v8::FunctionCallbackInfo<v8::Value>& args);
   static void SetBroadcast(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void SetTTL(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void SetRecvBatch(const v8::FunctionCallbackInfo<v8::Value>& args);
 
   static v8::Local<v8::Object> Instantiate(Environment* env, AsyncWrap* parent);
   uv_udp_t* UVHandle();
@@ -65,6 +68,8 @@ class UDPWrap: public HandleWrap {
                      int family);
   static void DoSend(const v8::FunctionCallbackInfo<v8::Value>& args,
                      int family);
+  static void DoSendBatch(const v8::FunctionCallbackInfo<v8::Value>& args,
+                          int family);
   static void SetMembership(const v8::FunctionCallbackInfo<v8::Value>& args,
                             uv_membership membership);
 
@@ -72,13 +77,27 @@ class UDPWrap: public HandleWrap {
                       size_t suggested_size,
                       uv_buf_t* buf);
   static void OnSend(uv_udp_send_t* req, int status);
+  static void OnSendBatch(uv_udp_send_t* req, int status);
   static void OnRecv(uv_udp_t* handle,
                      ssize_t nread,
                      const uv_buf_t* buf,
                      const struct sockaddr* addr,
                      unsigned int flags);
+  void OnRecvBatch(const uv_buf_t* buf);
+
+  // Matches the upper bound that libuv puts on uv_udp_set_recv_batch().
+  static const unsigned int kMaxRecvBatch = 64;
+
+  struct RecvBatchEntry {
+    char* data;
+    size_t length;
+    bool truncated;  // Didn't fit its slot, see UV_UDP_PARTIAL.
+    struct sockaddr_storage address;
+  };
 
   uv_udp_t handle_;
+  RecvBatchEntry* recv_batch_;
+  unsigned int recv_batch_count_;
 };
 
 }  // namespace node
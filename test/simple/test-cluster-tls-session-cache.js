@@ -0,0 +1,77 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+if (!process.versions.openssl) {
+  console.error('Skipping because node compiled without OpenSSL.');
+  process.exit(0);
+}
+if (process.platform === 'win32') {
+  console.error('Skipping because the shared session cache needs mmap().');
+  process.exit(0);
+}
+
+var common = require('../common');
+var assert = require('assert');
+var cluster = require('cluster');
+var fs = require('fs');
+var tls = require('tls');
+
+// The temporary session cache of the first worker is shared by all of them.
+// It has to survive that worker and go away with the last one.
+if (cluster.isMaster) {
+  var first = cluster.fork();
+  first.once('message', common.mustCall(function(cacheFile) {
+    assert(fs.existsSync(cacheFile));
+
+    var second = cluster.fork();
+    second.once('message', common.mustCall(function(file) {
+      assert.equal(file, cacheFile);
+
+      first.on('exit', common.mustCall(function() {
+        assert(fs.existsSync(cacheFile));
+        second.send('close');
+      }));
+      first.send('exit');
+    }));
+
+    second.on('disconnect', common.mustCall(function() {
+      assert(!fs.existsSync(cacheFile));
+    }));
+  }));
+} else {
+  var server = tls.createServer({
+    key: fs.readFileSync(common.fixturesDir + '/keys/agent1-key.pem'),
+    cert: fs.readFileSync(common.fixturesDir + '/keys/agent1-cert.pem'),
+    sessionCacheSize: 16
+  });
+
+  server.listen(common.PORT, function() {
+    process.send(server._sessionCacheFile);
+  });
+
+  process.on('message', function(message) {
+    if (message === 'exit')
+      process.exit(0);
+    server.close(function() {
+      process.disconnect();
+    });
+  });
+}
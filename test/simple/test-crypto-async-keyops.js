@@ -0,0 +1,152 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+var common = require('../common');
+var assert = require('assert');
+var fs = require('fs');
+
+try {
+  var crypto = require('crypto');
+} catch (e) {
+  console.log('Not compiled with OPENSSL support.');
+  process.exit();
+}
+
+crypto.DEFAULT_ENCODING = 'buffer';
+
+var keyPem = fs.readFileSync(common.fixturesDir + '/test_key.pem', 'ascii');
+var certPem = fs.readFileSync(common.fixturesDir + '/test_cert.pem', 'ascii');
+var rsaKeyPem = fs.readFileSync(
+    common.fixturesDir + '/test_rsa_privkey_encrypted.pem', 'ascii');
+var rsaPubPem = fs.readFileSync(common.fixturesDir + '/test_rsa_pubkey.pem',
+                                'ascii');
+
+var pending = 0;
+function expect(fn) {
+  pending++;
+  return function() {
+    pending--;
+    return fn.apply(this, arguments);
+  };
+}
+
+process.on('exit', function() {
+  assert.equal(pending, 0);
+});
+
+// sign() and verify() with a callback produce what the sync versions do
+var syncSig = crypto.createSign('RSA-SHA256').update('payload')
+                    .sign(keyPem, 'hex');
+crypto.createSign('RSA-SHA256').update('payload')
+      .sign(keyPem, 'hex', expect(function(err, sig) {
+  assert.ifError(err);
+  assert.equal(sig, syncSig);
+
+  crypto.createVerify('RSA-SHA256').update('payload')
+        .verify(certPem, sig, 'hex', expect(function(err, ok) {
+    assert.ifError(err);
+    assert.strictEqual(ok, true);
+  }));
+
+  crypto.createVerify('RSA-SHA256').update('tampered')
+        .verify(certPem, sig, 'hex', expect(function(err, ok) {
+    assert.ifError(err);
+    assert.strictEqual(ok, false);
+  }));
+}));
+
+// The object is finished once the job is queued
+var signer = crypto.createSign('RSA-SHA256').update('payload');
+signer.sign(keyPem, expect(function(err, sig) {
+  assert.ifError(err);
+  assert(Buffer.isBuffer(sig));
+}));
+assert.throws(function() {
+  signer.sign(keyPem);
+}, /Not initialised/);
+
+// Key errors are passed to the callback
+crypto.createSign('RSA-SHA256').update('payload')
+      .sign('not a key', expect(function(err, sig) {
+  assert(err instanceof Error);
+  assert.equal(sig, undefined);
+}));
+crypto.createSign('RSA-SHA256').update('payload')
+      .sign({ key: rsaKeyPem, passphrase: 'wrong' }, expect(function(err) {
+  assert(err instanceof Error);
+}));
+
+// Batches sign every payload with the same key
+var payloads = ['a', 'bb', new Buffer('ccc'), ''];
+crypto.signBatch('RSA-SHA1', { key: rsaKeyPem, passphrase: 'password' },
+                 payloads, 'base64', expect(function(err, sigs) {
+  assert.ifError(err);
+  assert.equal(sigs.length, payloads.length);
+  sigs.forEach(function(sig, i) {
+    assert.equal(sig, crypto.createSign('RSA-SHA1').update(payloads[i])
+        .sign({ key: rsaKeyPem, passphrase: 'password' }, 'base64'));
+    assert(crypto.createVerify('RSA-SHA1').update(payloads[i])
+        .verify(rsaPubPem, sig, 'base64'));
+  });
+}));
+
+crypto.signBatch('RSA-SHA1', keyPem, [], expect(function(err, sigs) {
+  assert.ifError(err);
+  assert.deepEqual(sigs, []);
+}));
+
+assert.throws(function() {
+  crypto.signBatch('no-such-digest', keyPem, ['a'], function() {});
+}, /Unknown message digest/);
+
+// DH and ECDH secrets match the synchronous result
+var dh1 = crypto.createDiffieHellman(256);
+var dh2 = crypto.createDiffieHellman(dh1.getPrime(), dh1.getGenerator());
+dh1.generateKeys();
+dh2.generateKeys();
+var dhSecret = dh1.computeSecret(dh2.getPublicKey(), null, 'hex');
+dh1.computeSecret(dh2.getPublicKey('hex'), 'hex', 'hex',
+                  expect(function(err, secret) {
+  assert.ifError(err);
+  assert.equal(secret, dhSecret);
+}));
+dh2.computeSecret(dh1.getPublicKey(), expect(function(err, secret) {
+  assert.ifError(err);
+  assert.equal(secret.toString('hex'), dhSecret);
+}));
+// The job has its own copy of the key pair
+dh1.generateKeys();
+
+dh1.computeSecret(new Buffer([0]), expect(function(err) {
+  assert(err instanceof Error);
+  assert(/Supplied key is too small/.test(err.message));
+}));
+
+var ecdh1 = crypto.createECDH('prime256v1');
+var ecdh2 = crypto.createECDH('prime256v1');
+ecdh1.generateKeys();
+ecdh2.generateKeys();
+var ecdhSecret = ecdh1.computeSecret(ecdh2.getPublicKey(), null, 'hex');
+ecdh2.computeSecret(ecdh1.getPublicKey(), null, 'hex',
+                    expect(function(err, secret) {
+  assert.ifError(err);
+  assert.equal(secret, ecdhSecret);
+}));
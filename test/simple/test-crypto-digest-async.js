@@ -0,0 +1,119 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+var common = require('../common');
+var assert = require('assert');
+var fs = require('fs');
+var path = require('path');
+
+try {
+  var crypto = require('crypto');
+} catch (e) {
+  console.log('Not compiled with OPENSSL support.');
+  process.exit();
+}
+
+// A few chunks' worth, not a multiple of the chunk size
+var data = crypto.pseudoRandomBytes(3 * 1024 * 1024 + 12345);
+var algorithms = ['md5', 'sha1', 'sha256'];
+
+function expected(alg, buf) {
+  return crypto.createHash(alg).update(buf).digest('hex');
+}
+
+var done = 0;
+
+// Buffer, several algorithms in one pass
+var progress = [];
+crypto.digest(algorithms, data, {
+  encoding: 'hex',
+  progress: function(stats) {
+    progress.push(stats.bytes);
+    assert.equal(typeof stats.throughput, 'number');
+  }
+}, function(err, digests, stats) {
+  assert.ifError(err);
+  assert.deepEqual(digests, algorithms.map(function(alg) {
+    return expected(alg, data);
+  }));
+  assert.equal(stats.bytes, data.length);
+  assert(stats.time >= 0);
+  assert.deepEqual(progress, [1, 2, 3].map(function(n) {
+    return n * 1024 * 1024;
+  }));
+  done++;
+});
+
+// Buffer range, single algorithm gives a single Buffer
+crypto.digest('sha1', data, { start: 10, length: 100 }, function(err, digest) {
+  assert.ifError(err);
+  assert(Buffer.isBuffer(digest));
+  assert.equal(digest.toString('hex'), expected('sha1', data.slice(10, 110)));
+  done++;
+});
+
+crypto.digest('sha256', new Buffer(0), function(err, digest) {
+  assert.ifError(err);
+  assert.equal(digest.toString('hex'), expected('sha256', ''));
+  done++;
+});
+
+// File, whole and a range
+var file = path.join(common.tmpDir, 'digest-async.bin');
+try { fs.unlinkSync(file); } catch (e) {}
+fs.writeFileSync(file, data);
+var fd = fs.openSync(file, 'r');
+
+crypto.digest(algorithms, fd, { encoding: 'hex' }, function(err, digests) {
+  assert.ifError(err);
+  assert.equal(digests[2], expected('sha256', data));
+
+  var range = { start: 1024 * 1024 - 1, length: 1024 * 1024 + 2 };
+  crypto.digest('md5', fd, range, function(err, digest) {
+    assert.ifError(err);
+    assert.equal(digest.toString('hex'),
+                 expected('md5', data.slice(range.start,
+                                            range.start + range.length)));
+    fs.closeSync(fd);
+
+    crypto.digest('md5', fd, function(err) {
+      assert.equal(err.code, 'EBADF');
+      done++;
+    });
+  });
+});
+
+assert.throws(function() {
+  crypto.digest('nope', data, function() {});
+}, /Digest method not supported/);
+
+assert.throws(function() {
+  crypto.digest('sha1', data, { start: 1, length: data.length }, function() {});
+}, RangeError);
+
+assert.throws(function() {
+  crypto.digest('sha1', 'string', function() {});
+}, TypeError);
+
+process.on('exit', function() {
+  assert.equal(done, 4);
+  try { fs.unlinkSync(file); } catch (e) {}
+});
@@ -0,0 +1,70 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+var common = require('../common');
+var assert = require('assert');
+
+try {
+  var crypto = require('crypto');
+} catch (e) {
+  console.log('Not compiled with OPENSSL support.');
+  process.exit();
+}
+
+var inputs = [
+  '',
+  'aoeu',
+  'éè',
+  new Buffer('deadbeef', 'hex'),
+  new Array(2000).join('x')  // Doesn't fit the stack buffer
+];
+
+['md5', 'sha1', 'sha256', 'sha512', 'RSA-SHA1'].forEach(function(alg) {
+  inputs.forEach(function(data) {
+    // Alternate algorithms so the shared context has to switch
+    var expected = crypto.createHash(alg).update(data).digest('hex');
+    assert.equal(crypto.hash(alg, data, 'hex'), expected);
+    assert.equal(crypto.hash('md5', data).length, 16);
+    assert.deepEqual(crypto.hash(alg, data),
+                     crypto.createHash(alg).update(data).digest());
+
+    ['', 'key', new Buffer('secret')].forEach(function(key) {
+      expected = crypto.createHmac(alg, key).update(data).digest('base64');
+      assert.equal(crypto.hmac(alg, key, data, 'base64'), expected);
+    });
+  });
+});
+
+// Known answer
+assert.equal(crypto.hash('sha1', 'aoeu', 'hex'),
+             '15987e60950cf22655b9323bc1e281f9c4aff47e');
+
+assert.throws(function() {
+  crypto.hash('nope', 'data');
+}, /Digest method not supported/);
+
+assert.throws(function() {
+  crypto.hmac('nope', 'key', 'data');
+}, /Unknown message digest/);
+
+assert.throws(function() {
+  crypto.hash('sha1', 42);
+}, TypeError);
@@ -0,0 +1,78 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+var common = require('../common');
+var assert = require('assert');
+
+try {
+  var crypto = require('crypto');
+} catch (e) {
+  console.log('Not compiled with OPENSSL support.');
+  process.exit();
+}
+
+crypto.DEFAULT_ENCODING = 'buffer';
+
+var stats = crypto.getRandomPoolStats();
+assert.equal(stats.available, 0);
+assert.equal(stats.hits, 0);
+assert(stats.size > 0);
+
+// The pool starts out empty, the first small request fills it synchronously.
+assert.equal(crypto.randomBytes(16).length, 16);
+stats = crypto.getRandomPoolStats();
+assert.equal(stats.fallbacks, 1);
+assert.equal(stats.hits, 1);
+assert.equal(stats.available, stats.size - 16);
+
+// Large requests bypass the pool altogether.
+assert.equal(crypto.randomBytes(4096).length, 4096);
+assert.equal(crypto.getRandomPoolStats().available, stats.size - 16);
+
+// Small requests of both kinds are served from the pool, and the bytes
+// handed out are gone from it.
+var seen = {};
+for (var i = 0; i < 64; i++) {
+  var id = crypto.randomBytes(16).toString('hex');
+  assert(!seen[id]);
+  seen[id] = true;
+  assert.equal(crypto.pseudoRandomBytes(32).length, 32);
+}
+assert.equal(crypto.randomBytes(0).length, 0);
+
+stats = crypto.getRandomPoolStats();
+assert.equal(stats.hits, 130);
+assert.equal(stats.fallbacks, 1);
+assert.equal(stats.available, stats.size - 16 - 64 * (16 + 32));
+
+// Draining it past the low-water mark refills it on the thread pool.
+while (crypto.getRandomPoolStats().available >= 256)
+  crypto.randomBytes(256);
+assert.equal(crypto.getRandomPoolStats().refills, 0);
+
+setImmediate(function wait() {
+  var stats = crypto.getRandomPoolStats();
+  if (stats.refills === 0)
+    return setImmediate(wait);
+  assert.equal(stats.refills, 1);
+  assert.equal(stats.fallbacks, 1);
+  assert.equal(stats.available, stats.size);
+});
@@ -0,0 +1,151 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+var common = require('../common');
+var assert = require('assert');
+
+try {
+  var crypto = require('crypto');
+} catch (e) {
+  console.log('Not compiled with OPENSSL support.');
+  process.exit();
+}
+
+crypto.DEFAULT_ENCODING = 'buffer';
+
+var key = new Buffer('0123456789abcdef0123456789abcdef');
+var iv = new Buffer('0123456789ab');
+var cbcIv = new Buffer('0123456789abcdef');
+var plaintext = crypto.pseudoRandomBytes(64 * 1024 + 7);
+
+function encryptWithUpdate(alg, iv, data) {
+  var cipher = crypto.createCipheriv(alg, key, iv);
+  return Buffer.concat([cipher.update(data), cipher.final()]);
+}
+
+// Synchronous updateInto() writes the same bytes update() returns, at the
+// given offset.
+(function() {
+  var expected = encryptWithUpdate('aes-256-cbc', cbcIv, plaintext);
+  var cipher = crypto.createCipheriv('aes-256-cbc', key, cbcIv);
+  var out = new Buffer(8 + plaintext.length + 32);
+  var n = cipher.updateInto(plaintext.slice(0, 1000), out, 8);
+  n += cipher.updateInto(plaintext.slice(1000), out, 8 + n);
+  n += cipher.finalInto(out, 8 + n);
+  assert.equal(n, expected.length);
+  assert.deepEqual(out.slice(8, 8 + n), expected);
+
+  // And back, in place.
+  var decipher = crypto.createDecipheriv('aes-256-cbc', key, cbcIv);
+  var buf = new Buffer(expected.length + 16);
+  expected.copy(buf);
+  var m = decipher.updateInto(buf.slice(0, expected.length), buf, 0);
+  m += decipher.finalInto(buf, m);
+  assert.equal(m, plaintext.length);
+  assert.deepEqual(buf.slice(0, m), plaintext);
+})();
+
+// The output has to have room for what the cipher may write.
+(function() {
+  var cipher = crypto.createCipheriv('aes-256-cbc', key, cbcIv);
+  assert.throws(function() {
+    cipher.updateInto(new Buffer(32), new Buffer(32));
+  }, RangeError);
+  assert.throws(function() {
+    cipher.updateInto(new Buffer(16), new Buffer(64), 40);
+  }, RangeError);
+  assert.throws(function() {
+    cipher.updateInto(new Buffer(16), 'not a buffer');
+  }, TypeError);
+  // Stream modes write exactly as much as they're given.
+  var gcm = crypto.createCipheriv('aes-256-gcm', key, iv);
+  assert.equal(gcm.updateInto(new Buffer(32), new Buffer(32)), 32);
+})();
+
+// Hash and Hmac digests.
+(function() {
+  var out = new Buffer(4 + 32);
+  out.fill(0);
+  var hash = crypto.createHash('sha256').update(plaintext);
+  assert.equal(hash.digestInto(out, 4), 32);
+  assert.deepEqual(out.slice(4),
+                   crypto.createHash('sha256').update(plaintext).digest());
+  assert.throws(function() {
+    hash.digestInto(out, 4);
+  }, /Not initialized/);
+
+  var hmac = crypto.createHmac('sha1', key).update(plaintext);
+  assert.throws(function() {
+    hmac.digestInto(new Buffer(19));
+  }, RangeError);
+  var mac = new Buffer(20);
+  assert.equal(hmac.digestInto(mac), 20);
+  assert.deepEqual(mac,
+                   crypto.createHmac('sha1', key).update(plaintext).digest());
+})();
+
+// Asynchronous updateInto() with AES-GCM, chunk by chunk.
+(function() {
+  var expected = encryptWithUpdate('aes-256-gcm', iv, plaintext);
+  var cipher = crypto.createCipheriv('aes-256-gcm', key, iv);
+  var out = new Buffer(plaintext.length);
+  var chunkSize = 16 * 1024;
+  var offset = 0;
+  var done = false;
+
+  (function next() {
+    if (offset === plaintext.length) {
+      assert.equal(cipher.finalInto(out, offset), 0);
+      assert.deepEqual(out, expected);
+      var tag = cipher.getAuthTag();
+
+      var decipher = crypto.createDecipheriv('aes-256-gcm', key, iv);
+      decipher.setAuthTag(tag);
+      var back = new Buffer(out.length);
+      decipher.updateInto(out, back, function(err, n) {
+        assert.ifError(err);
+        assert.equal(n, out.length);
+        assert.equal(decipher.finalInto(back, n), 0);
+        assert.deepEqual(back, plaintext);
+        done = true;
+      });
+      return;
+    }
+    var chunk = plaintext.slice(offset, offset + chunkSize);
+    cipher.updateInto(chunk, out, offset, function(err, n) {
+      assert.ifError(err);
+      assert.equal(n, chunk.length);
+      offset += n;
+      next();
+    });
+    // The cipher belongs to the thread pool until the callback runs.
+    assert.throws(function() {
+      cipher.update(chunk);
+    }, /busy/);
+    assert.throws(function() {
+      cipher.finalInto(out, offset);
+    }, /busy/);
+  })();
+
+  process.on('exit', function() {
+    assert(done);
+  });
+})();
@@ -0,0 +1,79 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// Batched receives make room for maxDatagramSize bytes per datagram. Longer
+// datagrams are cut short and flagged, empty ones still come through.
+
+var common = require('../common');
+var assert = require('assert');
+var dgram = require('dgram');
+
+if (process.platform !== 'linux') {
+  console.log('1..0 # Skipped: recvmmsg() is only available on Linux');
+  return;
+}
+
+assert.throws(function() {
+  dgram.createSocket({ type: 'udp4', maxDatagramSize: 0 });
+}, RangeError);
+assert.throws(function() {
+  dgram.createSocket({ type: 'udp4', maxDatagramSize: 65537 });
+}, RangeError);
+
+var SIZE = 16;
+var EMPTY = 8;
+var messages = [];
+
+var server = dgram.createSocket({ type: 'udp4', maxDatagramSize: SIZE });
+server.setRecvBatchSize(16);
+
+server.on('message', function(msg, rinfo) {
+  messages.push([msg.toString(), rinfo.size, rinfo.truncated]);
+  if (messages.length === EMPTY + 2) {
+    server.close();
+    client.close();
+  }
+});
+
+var client = dgram.createSocket('udp4');
+
+server.bind(common.PORT, '127.0.0.1', function() {
+  var empty = new Buffer(0);
+  for (var i = 0; i < EMPTY; i++)
+    client.send(empty, 0, 0, common.PORT, '127.0.0.1');
+
+  // After the empty ones have gone through by themselves.
+  setTimeout(function() {
+    var short = new Buffer('short');
+    var long = new Buffer(new Array(SIZE * 2 + 1).join('x'));
+    client.send(short, 0, short.length, common.PORT, '127.0.0.1');
+    client.send(long, 0, long.length, common.PORT, '127.0.0.1');
+  }, 50);
+});
+
+process.on('exit', function() {
+  var expected = [];
+  for (var i = 0; i < EMPTY; i++)
+    expected.push(['', 0, false]);
+  expected.push(['short', 5, false]);
+  expected.push([new Array(SIZE + 1).join('x'), SIZE, true]);
+  assert.deepEqual(messages, expected);
+});
@@ -0,0 +1,82 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+var common = require('../common');
+var assert = require('assert');
+var dgram = require('dgram');
+
+var N = 100;
+var received = [];
+var batches = 0;
+
+var server = dgram.createSocket('udp4');
+
+if (process.platform !== 'linux') {
+  assert.throws(function() {
+    server.setRecvBatchSize(16);
+  }, /ENOSYS/);
+  console.log('1..0 # Skipped: recvmmsg() is only available on Linux');
+  return;
+}
+
+assert.throws(function() {
+  server.setRecvBatchSize(65);
+}, /EINVAL/);
+assert.equal(server.setRecvBatchSize(16, 512), 16);
+
+server.on('message', function(msg, rinfo) {
+  assert.equal(rinfo.address, '127.0.0.1');
+  assert.equal(rinfo.size, msg.length);
+  received.push(msg.toString());
+  if (received.length === N) {
+    server.close();
+    client.close();
+  }
+});
+
+var client = dgram.createSocket('udp4');
+
+server.bind(common.PORT, '127.0.0.1', function() {
+  var onmessage = server._handle.onmessage;
+  server._handle.onmessage = function(nread, handle, buf, records) {
+    assert.ok(Array.isArray(records));
+    assert.equal(records.length, nread * 4);
+    batches++;
+    return onmessage.apply(this, arguments);
+  };
+
+  // Queue up the datagrams in one go so that they pile up in the socket's
+  // receive buffer and are drained in batches.
+  for (var i = 0; i < N; i++) {
+    var buf = new Buffer('message ' + i);
+    client.send(buf, 0, buf.length, common.PORT, '127.0.0.1');
+  }
+});
+
+process.on('exit', function() {
+  assert.equal(received.length, N);
+  assert.ok(batches > 0 && batches <= N);
+  received.sort(function(a, b) {
+    return a.split(' ')[1] - b.split(' ')[1];
+  });
+  for (var i = 0; i < N; i++)
+    assert.equal(received[i], 'message ' + i);
+});
@@ -0,0 +1,74 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+var common = require('../common');
+var assert = require('assert');
+var dgram = require('dgram');
+
+var N = 150;
+var received = {};
+var receivedCount = 0;
+var batchCallbacks = 0;
+
+var server = dgram.createSocket('udp4');
+var client = dgram.createSocket('udp4');
+
+server.on('message', function(msg, rinfo) {
+  assert.equal(rinfo.address, '127.0.0.1');
+  received[msg.toString()] = true;
+  if (++receivedCount === N) {
+    server.close();
+    client.close();
+  }
+});
+
+server.bind(common.PORT, '127.0.0.1', function() {
+  var buffers = [];
+  for (var i = 0; i < N; i++)
+    buffers.push('datagram ' + i);
+
+  // One oversized datagram in the middle of the batch must not take the
+  // rest of the batch down with it.
+  buffers.splice(N >> 1, 0, new Buffer(70000));
+
+  client.sendBatch(buffers, { port: common.PORT, address: '127.0.0.1' },
+                   function(err, sent) {
+    batchCallbacks++;
+    assert.ok(err);
+    assert.equal(err.code, 'EMSGSIZE');
+    assert.equal(sent, N);
+  });
+});
+
+assert.throws(function() {
+  client.sendBatch('not an array', { port: common.PORT });
+}, TypeError);
+
+assert.throws(function() {
+  client.sendBatch(['a', 'b'], [{ port: common.PORT }]);
+}, RangeError);
+
+process.on('exit', function() {
+  assert.equal(batchCallbacks, 1);
+  assert.equal(receivedCount, N);
+  for (var i = 0; i < N; i++)
+    assert.ok(received['datagram ' + i]);
+});
@@ -0,0 +1,149 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// response.gzip() compresses the body under the socket. Check that several
+// compressed responses share a keep-alive connection, that trailers and
+// HTTP/1.0 responses still work, and that flushSize: 0 streams.
+
+var common = require('../common');
+var assert = require('assert');
+var http = require('http');
+var net = require('net');
+var zlib = require('zlib');
+
+var body = new Array(2000).join('compress me please ');
+var responses = 0;
+var streamed = false;
+
+var server = http.createServer(function(req, res) {
+  assert.throws(function() {
+    res.gzip({ flushSize: -1 });
+  }, /Invalid flushSize/);
+
+  assert(res.gzip({ flushSize: req.url === '/stream' ? 0 : undefined }));
+  res.setHeader('Content-Length', body.length);
+
+  if (req.url === '/empty')
+    return res.end();
+
+  if (req.url === '/stream') {
+    res.write('first');
+    // The client answers once it could decompress the first write.
+    req.socket.once('_first', function() {
+      res.end('second');
+    });
+    return;
+  }
+
+  res.write(body.slice(0, 1000));
+  res.addTrailers({ 'X-Trailer': 'yes' });
+  setTimeout(function() {
+    res.end(body.slice(1000));
+    assert.throws(function() {
+      res.gzip();
+    }, /after headers are sent/);
+  }, 10);
+});
+
+function get(path, agent, cb) {
+  http.get({ port: common.PORT, path: path, agent: agent }, function(res) {
+    assert.equal(res.headers['content-encoding'], 'gzip');
+    assert.equal(res.headers['content-length'], undefined);
+    var chunks = [];
+    res.on('data', function(chunk) {
+      chunks.push(chunk);
+    });
+    res.on('end', function() {
+      cb(res, zlib.gunzipSync(Buffer.concat(chunks)).toString());
+    });
+  });
+}
+
+server.listen(common.PORT, function() {
+  var agent = new http.Agent({ maxSockets: 1 });
+
+  get('/a', agent, function(res, text) {
+    assert.equal(text, body);
+    assert.equal(res.trailers['x-trailer'], 'yes');
+    responses++;
+  });
+
+  get('/empty', agent, function(res, text) {
+    assert.equal(text, '');
+    responses++;
+  });
+
+  get('/b', agent, function(res, text) {
+    assert.equal(text, body);
+    responses++;
+    http10();
+  });
+});
+
+function http10() {
+  var c = net.connect(common.PORT);
+  c.write('GET /stream HTTP/1.0\r\n\r\n');
+
+  var received = new Buffer(0);
+  c.on('data', function(data) {
+    received = Buffer.concat([received, data]);
+    var end = received.toString('binary').indexOf('\r\n\r\n');
+    if (streamed || end === -1)
+      return;
+    var head = received.slice(0, end).toString();
+    assert(/Content-Encoding: gzip/.test(head));
+    assert(!/Transfer-Encoding/.test(head));
+    // Only the first write is out, there's no gzip trailer yet.
+    var inflate = zlib.createGunzip();
+    inflate.on('data', function(data) {
+      if (streamed)
+        return;
+      assert.equal(data.toString(), 'first');
+      streamed = true;
+      serverSocketOf(c).emit('_first');
+    });
+    inflate.write(received.slice(end + 4));
+  });
+  c.on('end', function() {
+    var end = received.toString('binary').indexOf('\r\n\r\n');
+    var text = zlib.gunzipSync(received.slice(end + 4)).toString();
+    assert.equal(text, 'firstsecond');
+    responses++;
+    server.close();
+  });
+}
+
+var sockets = [];
+server.on('connection', function(socket) {
+  sockets.push(socket);
+});
+
+function serverSocketOf(client) {
+  var port = client.address().port;
+  return sockets.filter(function(socket) {
+    return socket.remotePort === port;
+  })[0];
+}
+
+process.on('exit', function() {
+  assert.equal(responses, 4);
+  assert(streamed);
+});
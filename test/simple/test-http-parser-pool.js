@@ -0,0 +1,89 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+var common = require('../common');
+var assert = require('assert');
+var http = require('http');
+var parsers = require('_http_common').parsers;
+
+var stats = parsers.stats();
+assert.equal(stats.pooled, 0);
+assert.equal(stats.created, 0);
+
+// The pool follows the allocation rate of the last second, but holds at
+// least as many parsers as the fixed pool used to.
+var MIN = 1000;
+var RATE = MIN + 50;
+var allocated = [];
+for (var i = 0; i < RATE; i++)
+  allocated.push(parsers.alloc());
+
+assert.equal(parsers.stats().created, RATE);
+parsers._windowStart -= 1000;
+allocated.push(parsers.alloc());
+assert.equal(parsers.stats().max, RATE);
+
+allocated.forEach(function(parser) {
+  parsers.free(parser) || parser.close();
+});
+stats = parsers.stats();
+assert.equal(stats.pooled, RATE);
+assert.equal(stats.closed, 1);
+
+// Reuse hands out the most recently freed parser.
+var last = allocated[allocated.length - 2];
+assert.strictEqual(parsers.alloc(), last);
+assert.equal(parsers.stats().reused, 1);
+parsers.free(last);
+
+// After a quiet stretch it shrinks back to the minimum.
+parsers._windowStart -= 5000;
+parsers.free(parsers.alloc());
+stats = parsers.stats();
+assert.equal(stats.max, MIN);
+assert.equal(stats.pooled, MIN);
+assert.equal(stats.closed, 1 + RATE - MIN);
+
+// Keep-alive requests reuse pooled parsers.
+var server = http.createServer(function(req, res) {
+  res.end('ok');
+});
+
+server.listen(common.PORT, function() {
+  var agent = new http.Agent({ maxSockets: 1 });
+  var pending = 10;
+  var before = parsers.stats();
+
+  for (var i = 0; i < 10; i++) {
+    http.get({ port: common.PORT, agent: agent }, function(res) {
+      res.resume();
+      res.on('end', function() {
+        if (--pending > 0)
+          return;
+        var after = parsers.stats();
+        assert.equal(after.created, before.created);
+        assert.ok(after.reused > before.reused);
+        agent.destroy();
+        server.close();
+      });
+    });
+  }
+});
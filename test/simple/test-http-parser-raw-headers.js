@@ -0,0 +1,84 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// An http server whose parser hands out raw header buffers still ends up
+// with the same headers and trailers, also past the old 32 field limit.
+
+var common = require('../common');
+var assert = require('assert');
+var http = require('http');
+var net = require('net');
+
+var FIELDS = 40;
+
+var server = http.createServer(function(req, res) {
+  assert.equal(Object.keys(req.headers).length, FIELDS + 3);
+  for (var i = 0; i < FIELDS; i++)
+    assert.equal(req.headers['x-field-' + i], 'value ' + i);
+  assert.equal(req.rawHeaders[0], 'X-Field-0');
+
+  var body = '';
+  req.setEncoding('utf8');
+  req.on('data', function(data) {
+    body += data;
+  });
+  req.on('end', function() {
+    assert.equal(body, 'ping');
+    assert.deepEqual(req.trailers, { vary: '*', 'x-trailer': 'yes' });
+    assert.deepEqual(req.rawTrailers, ['Vary', '*', 'X-Trailer', 'yes']);
+    res.end('ok');
+  });
+});
+
+server.on('connection', function(socket) {
+  socket.parser.setRawHeaders(true);
+});
+
+server.listen(common.PORT, function() {
+  var fields = '';
+  for (var i = 0; i < FIELDS; i++)
+    fields += 'X-Field-' + i + ': value ' + i + '\r\n';
+
+  var client = net.connect(common.PORT, function() {
+    client.end('POST / HTTP/1.1\r\n' +
+               fields +
+               'Host: example.com\r\n' +
+               'Transfer-Encoding: chunked\r\n' +
+               'Connection: close\r\n' +
+               '\r\n' +
+               '4\r\nping\r\n' +
+               '0\r\n' +
+               'Vary: *\r\n' +
+               'X-Trailer: yes\r\n' +
+               '\r\n');
+  });
+
+  var response = '';
+  client.setEncoding('utf8');
+  client.on('data', function(data) {
+    response += data;
+  });
+  client.on('end', function() {
+    assert(/^HTTP\/1\.1 200 OK/.test(response));
+    assert(/\r\nok\r\n/.test(response));
+    server.close();
+  });
+});
@@ -34,6 +34,8 @@ var kOnHeaders = HTTPParser.kOnHeaders | 0;
 var kOnHeadersComplete = HTTPParser.kOnHeadersComplete | 0;
 var kOnBody = HTTPParser.kOnBody | 0;
 var kOnMessageComplete = HTTPParser.kOnMessageComplete | 0;
+var kOnBodySpans = HTTPParser.kOnBodySpans | 0;
+var kOnBatch = HTTPParser.kOnBatch | 0;
 
 // The purpose of this test is not to check HTTP compliance but to test the
 // binding. Tests for pathological http messages should be submitted
@@ -283,6 +285,314 @@ function expectBody(expected) {
 })();
 
 
+//
+// Test that a large number of headers isn't flushed early
+//
+(function() {
+  var lots_of_headers = '';
+  for (var i = 0; i < 100; ++i) lots_of_headers += 'X-Filler-' + i + ': ' + i + CRLF;
+
+  var request = Buffer(
+      'GET /foo HTTP/1.1' + CRLF +
+      lots_of_headers +
+      CRLF);
+
+  var parser = newParser(REQUEST);
+
+  parser[kOnHeaders] = function(headers, url) {
+    assert.ok(false, 'Function should not be called.');
+  };
+
+  parser[kOnHeadersComplete] = mustCall(function(info) {
+    assert.equal(info.url, '/foo');
+    assert.equal(info.headers.length, 2 * 100);
+    for (var i = 0; i < 100; ++i) {
+      assert.equal(info.headers[2 * i], 'X-Filler-' + i);
+      assert.equal(info.headers[2 * i + 1], String(i));
+    }
+  });
+
+  parser.execute(request, 0, request.length);
+})();
+
+
+//
+// Test spellings of common header names
+//
+(function() {
+  var request = Buffer(
+      'GET / HTTP/1.1' + CRLF +
+      'Content-Length: 0' + CRLF +
+      'content-length: 0' + CRLF +
+      'CONTENT-LENGTH: 0' + CRLF +
+      'Content-length: 0' + CRLF +
+      'Host: example.com' + CRLF +
+      CRLF);
+
+  var parser = newParser(REQUEST);
+
+  parser[kOnHeadersComplete] = mustCall(function(info) {
+    assert.deepEqual(info.headers,
+        ['Content-Length', '0',
+         'content-length', '0',
+         'CONTENT-LENGTH', '0',
+         'Content-length', '0',
+         'Host', 'example.com']);
+  });
+
+  parser.execute(request, 0, request.length);
+})();
+
+
+//
+// Test raw headers, with more fields than the old 32 field flush limit
+//
+(function() {
+  var decodeRawHeaders = require('_http_common').decodeRawHeaders;
+
+  var fields = [];
+  var expected = [];
+  for (var i = 0; i < 40; i++) {
+    fields.push('X-Field-' + i + ': value ' + i + CRLF);
+    expected.push('X-Field-' + i, 'value ' + i);
+  }
+
+  var request = Buffer(
+      'POST /it HTTP/1.1' + CRLF +
+      fields.join('') +
+      'X-Empty:' + CRLF +
+      'Transfer-Encoding: chunked' + CRLF +
+      CRLF +
+      '4' + CRLF +
+      'ping' + CRLF +
+      '0' + CRLF +
+      'Vary: *' + CRLF +
+      'X-Trailer: yes' + CRLF +
+      CRLF);
+
+  var parser = newParser(REQUEST);
+  parser.setRawHeaders(true);
+
+  parser[kOnHeadersComplete] = mustCall(function(info) {
+    assert.equal(info.url, '/it');
+    assert.ok(Buffer.isBuffer(info.headers));
+    assert.deepEqual(decodeRawHeaders(info.headers),
+        expected.concat('X-Empty', '', 'Transfer-Encoding', 'chunked'));
+  });
+
+  parser[kOnHeaders] = mustCall(function(headers, url) {
+    assert.ok(Buffer.isBuffer(headers));
+    assert.deepEqual(decodeRawHeaders(headers),
+        ['Vary', '*', 'X-Trailer', 'yes']);
+  });
+
+  parser[kOnBody] = mustCall(function(buf, start, len) {
+    assert.equal(buf.toString('binary', start, start + len), 'ping');
+  });
+
+  parser.execute(request, 0, request.length);
+
+  // reinitialize() switches back to arrays.
+  parser.reinitialize(REQUEST);
+  parser[kOnHeadersComplete] = mustCall(function(info) {
+    assert.deepEqual(info.headers, ['Host', 'example.com']);
+  });
+  var request2 = Buffer('GET / HTTP/1.1' + CRLF +
+                        'Host: example.com' + CRLF +
+                        CRLF);
+  parser.execute(request2, 0, request2.length);
+})();
+
+
+//
+// Test that reinitialize() gives back the room grown for many headers and
+// the parser still grows it again for the next request
+//
+(function() {
+  var FIELDS = 100;
+  var lines = [];
+  var expected = [];
+  for (var i = 0; i < FIELDS; i++) {
+    lines.push('X-Field-' + i + ': ' + i);
+    expected.push('X-Field-' + i, '' + i);
+  }
+  var request = Buffer('GET / HTTP/1.1' + CRLF +
+                       lines.join(CRLF) + CRLF +
+                       CRLF);
+
+  var parser = newParser(REQUEST);
+  for (var round = 0; round < 2; round++) {
+    parser.reinitialize(REQUEST);
+    parser[kOnHeadersComplete] = mustCall(function(info) {
+      assert.deepEqual(info.headers, expected);
+    });
+    parser.execute(request, 0, request.length);
+  }
+})();
+
+
+//
+// Test that the binding stops collecting headers at parser.maxHeaderPairs
+//
+(function() {
+  var request = Buffer(
+      'POST /it HTTP/1.1' + CRLF +
+      'A: 1' + CRLF +
+      'B: 2' + CRLF +
+      'C: 3' + CRLF +
+      'D: 4' + CRLF +
+      'Transfer-Encoding: chunked' + CRLF +
+      CRLF +
+      '0' + CRLF +
+      'X: 1' + CRLF +
+      'Y: 2' + CRLF +
+      'Z: 3' + CRLF +
+      CRLF);
+
+  var parser = newParser(REQUEST);
+  parser.maxHeaderPairs = 4;
+
+  parser[kOnHeadersComplete] = mustCall(function(info) {
+    assert.deepEqual(info.headers, ['A', '1', 'B', '2']);
+  });
+
+  parser[kOnHeaders] = mustCall(function(headers, url) {
+    assert.deepEqual(headers, ['X', '1', 'Y', '2']);
+  });
+
+  parser.execute(request, 0, request.length);
+})();
+
+
+//
+// Test batched body spans
+//
+(function() {
+  var request = Buffer(
+      'POST /it HTTP/1.1' + CRLF +
+      'Transfer-Encoding: chunked' + CRLF +
+      CRLF +
+      '3' + CRLF +
+      '123' + CRLF +
+      '6' + CRLF +
+      '123456' + CRLF +
+      '0' + CRLF +
+      CRLF +
+      'POST /that HTTP/1.1' + CRLF +
+      'Content-Length: 4' + CRLF +
+      CRLF +
+      'pong');
+
+  var parser = newParser(REQUEST);
+  var bodies = [];
+  var completed = 0;
+
+  parser[kOnBodySpans] = mustCall(function(buf, spans) {
+    var body = '';
+    for (var i = 0; i < spans.length; i += 2)
+      body += buf.toString('binary', spans[i], spans[i] + spans[i + 1]);
+    bodies.push({ body: body, spans: spans.length / 2, completed: completed });
+  }, 2);
+
+  parser[kOnMessageComplete] = mustCall(function() {
+    completed++;
+  }, 2);
+
+  parser.execute(request, 0, request.length);
+
+  // The first message's body is flushed before its onMessageComplete, the
+  // second one's when execute() returns.
+  assert.deepEqual(bodies, [
+    { body: '123123456', spans: 2, completed: 0 },
+    { body: 'pong', spans: 1, completed: 1 }
+  ]);
+})();
+
+
+//
+// Test batched pipelined requests
+//
+(function() {
+  var request = Buffer(
+      'GET /1 HTTP/1.1' + CRLF +
+      'Host: example.com' + CRLF +
+      CRLF +
+      'POST /2 HTTP/1.1' + CRLF +
+      'Content-Length: 4' + CRLF +
+      CRLF +
+      'ping' +
+      'POST /3 HTTP/1.1' + CRLF +
+      'Transfer-Encoding: chunked' + CRLF +
+      CRLF +
+      '4' + CRLF +
+      'pong' + CRLF +
+      '0' + CRLF +
+      'Vary: *' + CRLF +
+      CRLF +
+      'GET /4 HTTP/1.1' + CRLF +
+      'Host: exam');
+
+  var parser = newParser(REQUEST);
+
+  parser[kOnHeadersComplete] = function(info) {
+    assert.ok(false, 'Function should not be called.');
+  };
+
+  parser[kOnMessageComplete] = function() {
+    assert.ok(false, 'Function should not be called.');
+  };
+
+  parser[kOnBatch] = mustCall(function(buf, events) {
+    var seen = [];
+    for (var i = 0; i < events.length;) {
+      switch (events[i]) {
+        case kOnHeadersComplete:
+          var info = events[i + 1];
+          seen.push(methods[info.method] + ' ' + info.url);
+          i += 2;
+          break;
+        case kOnBody:
+          seen.push('body ' + buf.toString('binary',
+                                           events[i + 1],
+                                           events[i + 1] + events[i + 2]));
+          i += 3;
+          break;
+        case kOnHeaders:
+          seen.push('trailers ' + events[i + 1].join(':'));
+          i += 3;
+          break;
+        case kOnMessageComplete:
+          seen.push('complete');
+          i += 1;
+          break;
+        default:
+          assert.ok(false, 'Unexpected event ' + events[i]);
+      }
+    }
+    assert.deepEqual(seen, [
+      'GET /1', 'complete',
+      'POST /2', 'body ping', 'complete',
+      'POST /3', 'body pong', 'trailers Vary:*', 'complete'
+    ]);
+  });
+
+  var ret = parser.execute(request, 0, request.length);
+  assert.equal(ret, request.length);
+
+  // Response parsers don't batch.
+  var response = Buffer(
+      'HTTP/1.1 200 OK' + CRLF +
+      'Content-Length: 0' + CRLF +
+      CRLF);
+  parser = newParser(RESPONSE);
+  parser[kOnBatch] = function() {
+    assert.ok(false, 'Function should not be called.');
+  };
+  parser[kOnHeadersComplete] = mustCall(function(info) {});
+  parser.execute(response, 0, response.length);
+})();
+
+
 //
 // Test request body
 //
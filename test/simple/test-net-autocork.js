@@ -0,0 +1,74 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+var common = require('../common');
+var assert = require('assert');
+var net = require('net');
+
+var CHUNKS = 10;
+var expected = '';
+var received = '';
+var stats;
+
+var server = net.createServer(function(socket) {
+  socket.setEncoding('utf8');
+  socket.on('data', function(data) {
+    received += data;
+  });
+  socket.on('end', function() {
+    server.close();
+  });
+});
+
+server.listen(common.PORT, function() {
+  var client = net.connect(common.PORT, function() {
+    client.setAutoCork(true);
+
+    // Strings and buffers written during one tick are batched. The first one
+    // counts towards writeQueueSize right away and holds back the others in
+    // the stream until it is out, those then go out together.
+    for (var i = 0; i < CHUNKS; i++) {
+      var chunk = 'chunk ' + i + '\n';
+      expected += chunk;
+      client.write(i % 2 ? chunk : new Buffer(chunk));
+    }
+
+    assert.equal(client._handle.writeQueueSize, Buffer.byteLength('chunk 0\n'));
+
+    process.nextTick(function() {
+      client.write('from nextTick\n');
+      expected += 'from nextTick\n';
+    });
+
+    setTimeout(function() {
+      stats = client._handle.getCorkStats();
+      client.setAutoCork(false);
+      client.end('done\n');
+      expected += 'done\n';
+    }, 50);
+  });
+});
+
+process.on('exit', function() {
+  assert.equal(received, expected);
+  assert.equal(stats.flushes, 2);
+  assert.equal(stats.chunks, CHUNKS + 1);
+});
@@ -0,0 +1,82 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// sendFile() has to wait for writes that are still corked, the file would
+// overtake them otherwise. The corked data is too big to go out in one go,
+// so that the transfer has to wait for libuv's write queue as well. It still
+// has to go through sendfile() rather than the copying fallback.
+
+var common = require('../common');
+var assert = require('assert');
+var fs = require('fs');
+var net = require('net');
+var path = require('path');
+
+var filename = path.join(common.tmpDir, 'sendfile-cork.txt');
+fs.writeFileSync(filename, 'FILEDATA');
+var fd = fs.openSync(filename, 'r');
+
+var header = new Array(4 * 1024 * 1024 + 1).join('h') + '|';
+var received = '';
+var sendFileCallbacks = 0;
+var sendFileResults = [];
+
+var server = net.createServer(function(socket) {
+  socket.setAutoCork(true);
+  var handle = socket._handle;
+  var sendFile = handle.sendFile;
+  handle.sendFile = function() {
+    var err = sendFile.apply(this, arguments);
+    sendFileResults.push(err);
+    return err;
+  };
+  socket.write(header);
+  socket.write('MORE|');
+  socket.sendFile(fd, 0, 8, function(err) {
+    assert.ifError(err);
+    sendFileCallbacks++;
+  });
+  socket.end('|TAIL');
+});
+
+server.listen(common.PORT, function() {
+  var client = net.connect(common.PORT);
+  client.setEncoding('utf8');
+  client.pause();
+  setTimeout(function() {
+    client.resume();
+  }, 100);
+  client.on('data', function(data) {
+    received += data;
+  });
+  client.on('end', function() {
+    server.close();
+  });
+});
+
+process.on('exit', function() {
+  fs.closeSync(fd);
+  fs.unlinkSync(filename);
+  assert.equal(sendFileCallbacks, 1);
+  assert.deepEqual(sendFileResults, [0]);
+  assert.equal(received.length, header.length + 18);
+  assert(received === header + 'MORE|FILEDATA|TAIL');
+});
@@ -0,0 +1,78 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// Destroying a socket in the middle of a sendFile() that waits for the socket
+// to become writable must let go of the connection right away. The transfer
+// works on a copy of the socket's fd, which used to stay open until the peer
+// read again, i.e. possibly forever.
+
+var common = require('../common');
+var assert = require('assert');
+var fs = require('fs');
+var net = require('net');
+var path = require('path');
+
+if (!fs.existsSync('/proc/self/fd')) {
+  console.log('1..0 # Skipped: needs /proc/self/fd');
+  return;
+}
+
+var SIZE = 8 * 1024 * 1024;
+
+var filename = path.join(common.tmpDir, 'sendfile-destroy.bin');
+fs.writeFileSync(filename, new Buffer(SIZE));
+var fd = fs.openSync(filename, 'r');
+
+function openFds() {
+  return fs.readdirSync('/proc/self/fd').length;
+}
+
+var checked = false;
+var client;
+
+var server = net.createServer(function(socket) {
+  socket.sendFile(fd, 0, SIZE, assert.fail);
+  server.close();
+  setTimeout(function() {
+    var before = openFds();
+    socket.destroy();
+    // Closing takes a loop iteration.
+    setTimeout(function() {
+      // The socket and the transfer's copy of it, readdir() doesn't count.
+      assert.equal(openFds(), before - 2);
+      checked = true;
+      client.destroy();
+    }, 50);
+  }, 100);
+});
+
+server.listen(common.PORT, function() {
+  client = net.connect(common.PORT);
+  // Never reads, so the transfer gets stuck on a full socket buffer.
+  client.pause();
+  client.on('error', function() {});
+});
+
+process.on('exit', function() {
+  fs.closeSync(fd);
+  fs.unlinkSync(filename);
+  assert(checked);
+});
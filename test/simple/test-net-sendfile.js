@@ -0,0 +1,77 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+var common = require('../common');
+var assert = require('assert');
+var fs = require('fs');
+var net = require('net');
+var path = require('path');
+
+// Big enough to fill the socket buffers while the client isn't reading, so
+// the transfer has to wait for the socket to become writable again.
+var SIZE = 8 * 1024 * 1024;
+var OFFSET = 100;
+
+var filename = path.join(common.tmpDir, 'sendfile.bin');
+var contents = new Buffer(SIZE);
+for (var i = 0; i < SIZE; i++)
+  contents[i] = i % 251;
+fs.writeFileSync(filename, contents);
+var fd = fs.openSync(filename, 'r');
+
+var sendFileCallbacks = 0;
+var received = [];
+
+var server = net.createServer(function(socket) {
+  socket.write('head:');
+  socket.sendFile(fd, OFFSET, SIZE - OFFSET, function(err) {
+    assert.ifError(err);
+    sendFileCallbacks++;
+  });
+  socket.end(':tail');
+});
+
+server.listen(common.PORT, function() {
+  var client = net.connect(common.PORT);
+  client.pause();
+  setTimeout(function() {
+    client.resume();
+  }, 100);
+  client.on('data', function(chunk) {
+    received.push(chunk);
+  });
+  client.on('end', function() {
+    server.close();
+  });
+});
+
+process.on('exit', function() {
+  fs.closeSync(fd);
+  fs.unlinkSync(filename);
+
+  var data = Buffer.concat(received);
+  assert.equal(sendFileCallbacks, 1);
+  assert.equal(data.length, 5 + SIZE - OFFSET + 5);
+  assert.equal(data.slice(0, 5).toString(), 'head:');
+  assert.equal(data.slice(data.length - 5).toString(), ':tail');
+  assert.equal(data.slice(5, data.length - 5).toString('hex'),
+               contents.slice(OFFSET).toString('hex'));
+});
@@ -0,0 +1,79 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+var common = require('../common');
+var assert = require('assert');
+var net = require('net');
+
+var binding = process.binding('stream_wrap');
+
+var before = binding.getSlabAllocatorStats();
+assert.equal(typeof before.hits, 'number');
+assert.equal(typeof before.misses, 'number');
+assert.equal(typeof before.retainedSlabs, 'number');
+assert.equal(typeof before.retainedBytes, 'number');
+
+// Send enough data to fill several slabs and check that the chunks that come
+// out on the other end are intact even though they share backing memory.
+var chunk = new Buffer(64 * 1024);
+for (var i = 0; i < chunk.length; i++)
+  chunk[i] = i % 251;
+
+var total = 64;
+var received = [];
+var receivedBytes = 0;
+
+var server = net.createServer(function(socket) {
+  socket.on('data', function(data) {
+    received.push(data);
+    receivedBytes += data.length;
+  });
+  socket.on('end', function() {
+    server.close();
+  });
+});
+
+server.listen(common.PORT, function() {
+  var client = net.connect(common.PORT, function() {
+    for (var i = 0; i < total; i++)
+      client.write(chunk);
+    client.end();
+  });
+});
+
+process.on('exit', function() {
+  assert.equal(receivedBytes, total * chunk.length);
+
+  var offset = 0;
+  received.forEach(function(data) {
+    for (var i = 0; i < data.length; i++, offset++)
+      assert.equal(data[i], offset % chunk.length % 251);
+  });
+
+  var after = binding.getSlabAllocatorStats();
+  assert.ok(after.hits + after.misses >= before.hits + before.misses +
+            received.length);
+  assert.ok(after.misses > before.misses);
+  // The received chunks are still alive so the slabs they point into are
+  // retained.
+  assert.ok(after.retainedSlabs > 0);
+  assert.ok(after.retainedBytes > 0);
+});
@@ -0,0 +1,75 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+var common = require('../common');
+var assert = require('assert');
+var net = require('net');
+
+var binding = process.binding('stream_wrap');
+
+var before = binding.getWritevStats();
+assert.equal(typeof before.immediate, 'number');
+assert.equal(typeof before.queued, 'number');
+assert.equal(typeof before.arena, 'number');
+assert.equal(typeof before.heap, 'number');
+
+var small = ['HTTP/1.1 200 OK\r\n', 'Content-Length: 5\r\n', '\r\n', 'hello'];
+var large = [new Array(6000).join('x'), new Array(6000).join('y')];
+var expected = small.join('') + new Buffer('buffer') + large.join('');
+var received = '';
+
+var server = net.createServer(function(socket) {
+  socket.setEncoding('utf8');
+  socket.on('data', function(data) {
+    received += data;
+  });
+  socket.on('end', function() {
+    server.close();
+  });
+});
+
+function writeCorked(socket, chunks) {
+  socket.cork();
+  chunks.forEach(function(chunk) {
+    socket.write(chunk);
+  });
+  socket.uncork();
+}
+
+server.listen(common.PORT, function() {
+  var client = net.connect(common.PORT, function() {
+    // Small strings fit in the stream's arena, large ones do not.
+    writeCorked(client, small);
+    writeCorked(client, [new Buffer('buf'), new Buffer('fer')]);
+    writeCorked(client, large);
+    client.end();
+  });
+});
+
+process.on('exit', function() {
+  assert.equal(received, expected);
+
+  var after = binding.getWritevStats();
+  assert.equal(after.arena - before.arena, 1);
+  assert.equal(after.heap - before.heap, 1);
+  assert.equal(after.immediate + after.queued -
+               before.immediate - before.queued, 3);
+});
@@ -0,0 +1,104 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+if (!process.versions.openssl) {
+  console.error('Skipping because node compiled without OpenSSL.');
+  process.exit(0);
+}
+
+var common = require('../common');
+var assert = require('assert');
+var crypto = require('crypto');
+var fs = require('fs');
+var net = require('net');
+var tls = require('tls');
+
+// While a handshake step is queued on the thread pool, the accessors must
+// leave the SSL object alone and end() must wait for the step's output.
+
+var context = tls.createSecureContext({
+  key: fs.readFileSync(common.fixturesDir + '/keys/agent1-key.pem'),
+  cert: fs.readFileSync(common.fixturesDir + '/keys/agent1-cert.pem')
+});
+
+var received = 0;
+var before = tls.getAsyncHandshakeStats();
+
+// Capture a ClientHello to replay over a plain socket.
+var capture = net.createServer(function(c) {
+  c.once('data', function(hello) {
+    c.destroy();
+    capture.close();
+    start(hello);
+  });
+}).listen(common.PORT + 1, function() {
+  tls.connect(common.PORT + 1).on('error', function() {});
+});
+
+var server = net.createServer(function(raw) {
+  var socket = new tls.TLSSocket(raw, {
+    isServer: true,
+    secureContext: context,
+    asyncHandshake: true
+  });
+  socket.on('error', function() {});
+
+  function queued() {
+    if (tls.getAsyncHandshakeStats().pending === before.pending)
+      return setImmediate(queued);
+
+    assert.equal(socket.getPeerCertificate(), null);
+    assert.equal(socket.getSession(), null);
+    assert.equal(socket.isSessionReused(), null);
+    assert.equal(socket.getCipher(), null);
+    assert.equal(socket.ssl.isInitFinished(), false);
+    assert.throws(function() {
+      socket.ssl.verifyError();
+    }, /TLS handshake in progress/);
+    socket.end();
+  }
+  queued();
+});
+
+function start(hello) {
+  // Keep the thread pool busy so that the handshake step stays queued.
+  for (var i = 0; i < 4; i++)
+    crypto.pbkdf2('password', 'salt', 200000, 20, function() {});
+
+  server.listen(common.PORT, function() {
+    var client = net.connect(common.PORT, function() {
+      client.write(hello);
+    });
+    client.on('data', function(data) {
+      received += data.length;
+    });
+    client.on('end', function() {
+      client.destroy();
+      server.close();
+    });
+  });
+}
+
+process.on('exit', function() {
+  // ServerHello, Certificate and ServerHelloDone went out before the FIN.
+  assert(received > 0);
+});
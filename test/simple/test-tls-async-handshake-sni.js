@@ -0,0 +1,99 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// Handshakes on the thread pool pick up the context that SNICallback chose.
+// The context is shared by all connections and set up on the loop thread.
+
+if (!process.features.tls_sni) {
+  console.error('Skipping because node compiled without OpenSSL or ' +
+                'with old OpenSSL version.');
+  process.exit(0);
+}
+
+var common = require('../common');
+var assert = require('assert');
+var fs = require('fs');
+var tls = require('tls');
+
+function loadPEM(n) {
+  return fs.readFileSync(common.fixturesDir + '/keys/' + n + '.pem');
+}
+
+var sniContext = tls.createSecureContext({
+  key: loadPEM('agent1-key'),
+  cert: loadPEM('agent1-cert')
+});
+
+var CLIENTS = 10;
+var lookups = 0;
+var names = [];
+var before = tls.getAsyncHandshakeStats();
+
+var server = tls.createServer({
+  key: loadPEM('agent2-key'),
+  cert: loadPEM('agent2-cert'),
+  asyncHandshake: true,
+  SNICallback: function(servername, callback) {
+    lookups++;
+    setImmediate(function() {
+      callback(null, servername === 'a.example.com' ? sniContext : null);
+    });
+  }
+}, function(c) {
+  c.end('ok');
+});
+
+server.listen(common.PORT, function() {
+  var left = CLIENTS;
+  for (var i = 0; i < CLIENTS; i++) {
+    connect(i % 2 ? 'a.example.com' : 'b.example.com', function() {
+      if (--left === 0)
+        server.close();
+    });
+  }
+});
+
+function connect(servername, cb) {
+  var c = tls.connect({
+    port: common.PORT,
+    servername: servername,
+    rejectUnauthorized: false
+  }, function() {
+    names.push(servername + ' ' + c.getPeerCertificate().subject.CN);
+  });
+  c.resume();
+  c.on('close', cb);
+}
+
+process.on('exit', function() {
+  assert.equal(lookups, CLIENTS);
+  assert.equal(names.length, CLIENTS);
+  names.forEach(function(name) {
+    if (/^a\./.test(name))
+      assert.equal(name, 'a.example.com agent1');
+    else
+      assert.equal(name, 'b.example.com agent2');
+  });
+
+  var stats = tls.getAsyncHandshakeStats();
+  assert(stats.queued - before.queued >= CLIENTS);
+  assert.equal(stats.pending, 0);
+});
@@ -0,0 +1,97 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+if (!process.versions.openssl) {
+  console.error('Skipping because node compiled without OpenSSL.');
+  process.exit(0);
+}
+
+var common = require('../common');
+var assert = require('assert');
+var fs = require('fs');
+var net = require('net');
+var tls = require('tls');
+
+var options = {
+  key: fs.readFileSync(common.fixturesDir + '/keys/agent1-key.pem'),
+  cert: fs.readFileSync(common.fixturesDir + '/keys/agent1-cert.pem'),
+  asyncHandshake: true
+};
+
+var CLIENTS = 10;
+var replies = 0;
+var clientErrors = 0;
+var before = tls.getAsyncHandshakeStats();
+
+var server = tls.createServer(options, function(c) {
+  c.on('data', function(data) {
+    c.end('echo:' + data);
+  });
+});
+
+server.on('clientError', function(err) {
+  assert(/SSL routines/.test(err.message));
+  clientErrors++;
+});
+
+server.listen(common.PORT, function() {
+  // A broken ClientHello fails on the thread pool, the error must still be
+  // reported on the loop thread.
+  var raw = net.connect(common.PORT, function() {
+    raw.end(new Buffer('16030100200100001c0303' +
+                       new Array(41).join('ff'), 'hex'));
+  });
+  raw.resume();
+  raw.on('close', startClients);
+});
+
+function startClients() {
+  var left = CLIENTS;
+  for (var i = 0; i < CLIENTS; i++) {
+    var c = tls.connect(common.PORT, { rejectUnauthorized: false });
+    // Written before the handshake is done.
+    c.end('' + i);
+    c.setEncoding('utf8');
+    c.on('data', function(i, data) {
+      assert.equal(data, 'echo:' + i);
+      replies++;
+    }.bind(null, i));
+    c.on('close', function() {
+      if (--left === 0)
+        server.close();
+    });
+  }
+}
+
+process.on('exit', function() {
+  assert.equal(replies, CLIENTS);
+  assert.equal(clientErrors, 1);
+
+  var stats = tls.getAsyncHandshakeStats();
+  // Every full handshake takes two steps on the server.
+  assert(stats.queued - before.queued >= CLIENTS * 2 + 1);
+  assert.equal(stats.queued, stats.completed);
+  assert.equal(stats.pending, 0);
+  assert(stats.maxPending >= 1);
+  assert(stats.runTime > 0);
+  assert(stats.maxLatency > 0);
+});
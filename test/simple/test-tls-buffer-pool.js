@@ -0,0 +1,79 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+if (!process.versions.openssl) {
+  console.error('Skipping because node compiled without OpenSSL.');
+  process.exit(0);
+}
+
+var common = require('../common');
+var assert = require('assert');
+var fs = require('fs');
+var tls = require('tls');
+
+var options = {
+  key: fs.readFileSync(common.fixturesDir + '/keys/agent1-key.pem'),
+  cert: fs.readFileSync(common.fixturesDir + '/keys/agent1-cert.pem')
+};
+
+var CLIENTS = 5;
+var payload = new Buffer(64 * 1024);
+payload.fill('x');
+
+var stats = tls.getBufferPoolStats();
+assert.equal(typeof stats.live, 'number');
+assert.equal(typeof stats.pooled, 'number');
+assert.equal(typeof stats.hits, 'number');
+assert.equal(typeof stats.misses, 'number');
+
+var server = tls.createServer(options, function(c) {
+  c.end(payload);
+});
+
+server.listen(common.PORT, function() {
+  var clients = [];
+  var done = 0;
+  for (var i = 0; i < CLIENTS; i++) {
+    var c = tls.connect(common.PORT, { rejectUnauthorized: false });
+    var received = 0;
+    c.on('data', function(data) {
+      received += data.length;
+    });
+    c.on('end', function() {
+      if (++done === CLIENTS)
+        checkIdle();
+    });
+    clients.push(c);
+  }
+
+  // All connections are still open but drained, so they shouldn't hold any
+  // buffers. Only the servers' half-closed sockets may have some in flight.
+  function checkIdle() {
+    setImmediate(function() {
+      var stats = tls.getBufferPoolStats();
+      assert(stats.pooled > 0);
+      assert(stats.hits > 0);
+      assert(stats.live < CLIENTS * 16384);
+      server.close();
+    });
+  }
+});
@@ -0,0 +1,90 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+if (!process.versions.openssl) {
+  console.error('Skipping because node compiled without OpenSSL.');
+  process.exit(0);
+}
+
+var common = require('../common');
+var assert = require('assert');
+var fs = require('fs');
+var tls = require('tls');
+
+var options = {
+  key: fs.readFileSync(common.fixturesDir + '/keys/agent1-key.pem'),
+  cert: fs.readFileSync(common.fixturesDir + '/keys/agent1-cert.pem')
+};
+
+var SMALL_WRITES = 100;
+var bulk = new Buffer(2 * 1024 * 1024);
+bulk.fill('x');
+var expected = SMALL_WRITES * 10 + bulk.length + 32 * 1024;
+
+var server = tls.createServer(options, function(c) {
+  // The first write goes out on its own, the ones that queue up behind it
+  // share a single record
+  for (var i = 1; i < SMALL_WRITES; i++)
+    c.write('0123456789');
+
+  c.write('0123456789', function() {
+    var stats = c.getRecordStats();
+    assert.equal(stats.records, 2);
+    assert.equal(stats.bytes, SMALL_WRITES * 10);
+    assert.equal(stats.chunks, SMALL_WRITES);
+    assert.equal(stats.sizes[0], 1);
+    assert.equal(stats.sizes[1], 1);
+
+    // Starts out with small records, switches to full ones after a while
+    c.write(bulk, function() {
+      stats = c.getRecordStats();
+      assert.equal(stats.bytes, SMALL_WRITES * 10 + bulk.length);
+      assert.equal(stats.recordSize, 16384);
+      assert(stats.sizes[2] >= 1024 * 1024 / 1400);
+      assert(stats.sizes[5] >= 1024 * 1024 / 16384);
+
+      // A fixed fragment size turns dynamic sizing off
+      assert(c.setMaxSendFragment(4096));
+      var sizes = stats.sizes.slice();
+      c.end(new Buffer(32 * 1024), function() {
+        stats = c.getRecordStats();
+        assert.equal(stats.recordSize, 4096);
+        assert.equal(stats.sizes[3], sizes[3] + 8);
+      });
+    });
+  });
+});
+
+var received = 0;
+server.listen(common.PORT, function() {
+  var c = tls.connect(common.PORT, { rejectUnauthorized: false });
+  c.on('data', function(data) {
+    received += data.length;
+  });
+  c.on('end', function() {
+    server.close();
+  });
+});
+
+process.on('exit', function() {
+  assert.equal(received, expected);
+});
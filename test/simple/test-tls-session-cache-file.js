@@ -0,0 +1,169 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+if (!process.versions.openssl) {
+  console.error('Skipping because node compiled without OpenSSL.');
+  process.exit(0);
+}
+if (process.platform === 'win32') {
+  console.error('Skipping because the shared session cache needs mmap().');
+  process.exit(0);
+}
+
+var common = require('../common');
+var assert = require('assert');
+var constants = require('constants');
+var fs = require('fs');
+var os = require('os');
+var path = require('path');
+var spawnSync = require('child_process').spawnSync;
+var tls = require('tls');
+
+var options = {
+  key: fs.readFileSync(common.fixturesDir + '/keys/agent1-key.pem'),
+  cert: fs.readFileSync(common.fixturesDir + '/keys/agent1-cert.pem'),
+  sessionCacheSize: 16
+};
+
+function createServer(cacheFile) {
+  options.sessionCacheFile = cacheFile;
+  return tls.createServer(options);
+}
+
+// The file starts with a header of 32 bits fields: magic, version, number of
+// slots and size of a slot. The slots follow at kHeaderSize, each starts with
+// its sequence number and the pid of its writer.
+var kHeaderSize = 64;
+
+function readField(buf, offset) {
+  return os.endianness() === 'LE' ? buf.readUInt32LE(offset) :
+                                    buf.readUInt32BE(offset);
+}
+
+function writeField(buf, value, offset) {
+  if (os.endianness() === 'LE')
+    buf.writeUInt32LE(value, offset);
+  else
+    buf.writeUInt32BE(value, offset);
+}
+
+var cacheFile = path.join(common.tmpDir, 'tls-session-cache');
+var target = path.join(common.tmpDir, 'tls-session-cache-target');
+try { fs.unlinkSync(cacheFile); } catch (e) {}
+try { fs.unlinkSync(target); } catch (e) {}
+
+// Don't follow a symlink, whoever planted it could read the sessions.
+fs.writeFileSync(target, '', { mode: 384 /* 0600 */ });
+fs.symlinkSync(target, cacheFile);
+assert.throws(function() {
+  createServer(cacheFile);
+}, /ELOOP/);
+assert.equal(fs.statSync(target).size, 0);
+fs.unlinkSync(cacheFile);
+fs.unlinkSync(target);
+
+// Nor use a file that others can get at.
+fs.writeFileSync(cacheFile, '', { mode: 420 /* 0644 */ });
+fs.chmodSync(cacheFile, 420);
+assert.throws(function() {
+  createServer(cacheFile);
+}, /EPERM/);
+fs.chmodSync(cacheFile, 384);
+createServer(cacheFile);
+
+// A cache without slots would have no set to hash session ids to.
+var cache = fs.readFileSync(cacheFile).slice(0, kHeaderSize);
+writeField(cache, 0, 8);
+fs.writeFileSync(cacheFile, cache);
+assert.throws(function() {
+  createServer(cacheFile);
+}, /EINVAL/);
+fs.unlinkSync(cacheFile);
+
+// The cache can't be swapped once the context is in use. The default cache
+// file goes away when the server is closed.
+var server = createServer(undefined);
+var tempFile = server._sessionCacheFile;
+assert(fs.existsSync(tempFile));
+server.on('secureConnection', common.mustCall(function(c) {
+  var err = server._sharedCreds.context.setSessionCache(cacheFile, 16);
+  assert.equal(err, process.binding('uv').UV_EBUSY);
+  assert(!fs.existsSync(cacheFile));
+  c.end();
+}));
+server.listen(common.PORT, function() {
+  var client = tls.connect(common.PORT, { rejectUnauthorized: false });
+  client.on('close', function() {
+    server.close(common.mustCall(function() {
+      assert(!fs.existsSync(tempFile));
+      testDeadWriter();
+    }));
+  });
+  client.resume();
+});
+
+// Slots that a writer left busy when it died are taken over by the next one.
+function testDeadWriter() {
+  var dead = spawnSync(process.execPath, ['-e', '0']).pid;
+  options.sessionCacheSize = 4;  // A single set, every session lands in it.
+  options.secureOptions = constants.SSL_OP_NO_TICKET;
+  createServer(cacheFile);
+  var cache = fs.readFileSync(cacheFile);
+  var slots = readField(cache, 8);
+  var slotSize = readField(cache, 12);
+  for (var i = 0; i < slots; i++) {
+    writeField(cache, 1, kHeaderSize + i * slotSize);
+    writeField(cache, dead, kHeaderSize + i * slotSize + 4);
+  }
+  fs.writeFileSync(cacheFile, cache);
+
+  var server = createServer(cacheFile);
+  server.on('secureConnection', endConnection);
+  server.listen(common.PORT, function() {
+    var first = tls.connect(common.PORT, { rejectUnauthorized: false });
+    first.resume();
+    first.on('close', function() {
+      assert.equal(server.getSessionCacheStats().stores, 1);
+      // A server of its own has to find the session in the file.
+      var other = createServer(cacheFile);
+      other.on('secureConnection', endConnection);
+      other.listen(common.PORT + 1, function() {
+        var second = tls.connect(common.PORT + 1, {
+          rejectUnauthorized: false,
+          session: first.getSession()
+        }, common.mustCall(function() {
+          assert(second.isSessionReused());
+        }));
+        second.resume();
+        second.on('close', function() {
+          assert.equal(other.getSessionCacheStats().hits, 1);
+          other.close();
+          server.close();
+          fs.unlinkSync(cacheFile);
+        });
+      });
+    });
+  });
+}
+
+function endConnection(c) {
+  c.end();
+}
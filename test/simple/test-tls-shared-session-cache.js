@@ -0,0 +1,121 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+if (!process.versions.openssl) {
+  console.error('Skipping because node compiled without OpenSSL.');
+  process.exit(0);
+}
+if (process.platform === 'win32') {
+  console.error('Skipping because the shared session cache needs mmap().');
+  process.exit(0);
+}
+
+var assert = require('assert');
+var constants = require('constants');
+var fs = require('fs');
+var net = require('net');
+var path = require('path');
+var tls = require('tls');
+
+var common = require('../common');
+
+var cacheFile = path.join(common.tmpDir, 'tls-session-cache');
+try { fs.unlinkSync(cacheFile); } catch (e) {}
+
+var serverLog = [];
+var reusedLog = [];
+
+var serverCount = 0;
+function createServer() {
+  var id = serverCount++;
+
+  var server = tls.createServer({
+    key: fs.readFileSync(common.fixturesDir + '/keys/agent1-key.pem'),
+    cert: fs.readFileSync(common.fixturesDir + '/keys/agent1-cert.pem'),
+    // Force session id based resumption.
+    secureOptions: constants.SSL_OP_NO_TICKET,
+    sessionCacheSize: 16,
+    sessionCacheFile: cacheFile
+  }, function(c) {
+    serverLog.push(id);
+    c.end();
+  });
+
+  return server;
+}
+
+var servers = [ createServer(), createServer(), createServer() ];
+var first = servers[0];
+
+// Only the servers share the cache, there is no JS side session store.
+assert.deepEqual(first.getSessionCacheStats(), {
+  entries: 16,
+  hits: 0,
+  misses: 0,
+  stores: 0,
+  evictions: 0
+});
+assert.equal(tls.createServer({}).getSessionCacheStats(), null);
+
+// Create one TCP server and balance sockets to multiple TLS server instances
+var shared = net.createServer(function(c) {
+  servers.shift().emit('connection', c);
+}).listen(common.PORT, function() {
+  start(function() {
+    shared.close();
+  });
+});
+
+function start(callback) {
+  var sess = null;
+  var left = servers.length;
+
+  function connect() {
+    var s = tls.connect(common.PORT, {
+      session: sess,
+      rejectUnauthorized: false
+    }, function() {
+      reusedLog.push(s.isSessionReused());
+      sess = s.getSession() || sess;
+    });
+    s.on('close', function() {
+      if (--left === 0)
+        callback();
+      else
+        connect();
+    });
+  }
+
+  connect();
+}
+
+process.on('exit', function() {
+  assert.deepEqual(serverLog, [0, 1, 2]);
+  assert.deepEqual(reusedLog, [false, true, true]);
+
+  var stats = first.getSessionCacheStats();
+  assert.equal(stats.stores, 1);
+  assert.equal(stats.hits, 2);
+  assert.equal(stats.evictions, 0);
+
+  fs.unlinkSync(cacheFile);
+});
@@ -0,0 +1,107 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+if (!process.versions.openssl) {
+  console.error('Skipping because node compiled without OpenSSL.');
+  process.exit(0);
+}
+
+var common = require('../common');
+var assert = require('assert');
+var crypto = require('crypto');
+var fs = require('fs');
+var tls = require('tls');
+
+var oldKey = crypto.randomBytes(48);
+var newKey = crypto.randomBytes(48);
+
+var server = tls.createServer({
+  key: fs.readFileSync(common.fixturesDir + '/keys/agent1-key.pem'),
+  cert: fs.readFileSync(common.fixturesDir + '/keys/agent1-cert.pem'),
+  ticketKeys: oldKey
+}, function(c) {
+  c.end();
+});
+
+assert.throws(function() {
+  server.setTicketKeys(new Buffer(47));
+}, TypeError);
+
+function connect(session, callback) {
+  var s = tls.connect(common.PORT, {
+    session: session,
+    rejectUnauthorized: false
+  }, function() {
+    var ticket = s.getTLSTicket();
+    callback(s.isSessionReused(), s.getSession(), ticket);
+    s.end();
+  });
+}
+
+function keyName(key) {
+  return key.slice(0, 16).toString('hex');
+}
+
+server.listen(common.PORT, function() {
+  assert.equal(server.getTicketKeyStats(), null);
+  assert.deepEqual(server.getTicketKeys(), oldKey);
+
+  connect(null, function(reused, oldSession, ticket) {
+    assert(!reused);
+    assert.equal(ticket.slice(0, 16).toString('hex'), keyName(oldKey));
+
+    // Rotate, tickets of the old key still resume and get renewed
+    server.setTicketKeys(Buffer.concat([newKey, oldKey]));
+    assert.deepEqual(server.getTicketKeys(), Buffer.concat([newKey, oldKey]));
+
+    connect(oldSession, function(reused, newSession, ticket) {
+      assert(reused);
+      assert.equal(ticket.slice(0, 16).toString('hex'), keyName(newKey));
+
+      var stats = server.getTicketKeyStats();
+      assert.equal(stats.keys.length, 2);
+      assert.equal(stats.keys[0].name.toString('hex'), keyName(newKey));
+      assert.equal(stats.keys[0].issued, 1);
+      assert.equal(stats.keys[0].hits, 0);
+      assert.equal(stats.keys[1].issued, 0);
+      assert.equal(stats.keys[1].hits, 1);
+      assert.equal(stats.misses, 0);
+
+      // Retire the old key
+      server.setTicketKeys(newKey);
+
+      connect(oldSession, function(reused) {
+        assert(!reused);
+
+        connect(newSession, function(reused) {
+          assert(reused);
+
+          stats = server.getTicketKeyStats();
+          assert.equal(stats.keys.length, 1);
+          assert.equal(stats.keys[0].hits, 1);
+          assert.equal(stats.misses, 1);
+          server.close();
+        });
+      });
+    });
+  });
+});
@@ -0,0 +1,116 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// The convenience methods compress the whole buffer in one native job.
+// Check that the output grows past its first guess and that errors make it
+// back with the same shape as the streams' errors.
+
+var common = require('../common.js');
+var assert = require('assert');
+var zlib = require('zlib');
+
+// Compresses very well, so inflating has to grow the output several times.
+var input = new Buffer(4 * 1024 * 1024);
+for (var i = 0; i < input.length; i++)
+  input[i] = 'abcdefgh'.charCodeAt(i % 8);
+
+[
+  ['gzip', 'gunzip'],
+  ['gzip', 'unzip'],
+  ['deflate', 'inflate'],
+  ['deflate', 'unzip'],
+  ['deflateRaw', 'inflateRaw'],
+].forEach(function(pair) {
+  var compressed = zlib[pair[0] + 'Sync'](input);
+  assert(compressed.length < input.length / 100);
+  assert.deepEqual(zlib[pair[1] + 'Sync'](compressed), input);
+
+  // Same bytes as the streaming version.
+  var stream = zlib['create' + pair[0][0].toUpperCase() + pair[0].slice(1)]();
+  var chunks = [];
+  stream.on('data', function(chunk) { chunks.push(chunk); });
+  stream.on('end', common.mustCall(function() {
+    assert.deepEqual(Buffer.concat(chunks), compressed);
+  }));
+  stream.end(input);
+
+  zlib[pair[0]](input, common.mustCall(function(err, result) {
+    assert.ifError(err);
+    assert.deepEqual(result, compressed);
+    zlib[pair[1]](result, common.mustCall(function(err, result) {
+      assert.ifError(err);
+      assert.deepEqual(result, input);
+    }));
+  }));
+});
+
+// Empty input.
+assert.equal(zlib.gunzipSync(zlib.gzipSync('')).length, 0);
+zlib.gzip(new Buffer(0), common.mustCall(function(err, result) {
+  assert.ifError(err);
+  assert(result.length > 0);
+}));
+
+// Errors, sync and async.
+var garbage = new Buffer('this is not valid compressed data.');
+assert.throws(function() {
+  zlib.gunzipSync(garbage);
+}, function(err) {
+  return err instanceof Error &&
+         /incorrect header check/.test(err.message) &&
+         err.errno === zlib.Z_DATA_ERROR &&
+         err.code === 'Z_DATA_ERROR';
+});
+zlib.inflate(garbage, common.mustCall(function(err, result) {
+  assert(err instanceof Error);
+  assert.equal(err.code, 'Z_DATA_ERROR');
+  assert.equal(result, undefined);
+}));
+
+assert.throws(function() {
+  zlib.gzipSync({});
+}, TypeError);
+
+assert.throws(function() {
+  zlib.gzip('x', { level: 42 }, assert.fail);
+}, /Invalid compression level/);
+
+// Dictionaries.
+var encoded = zlib.deflateSync('test', { dictionary: new Buffer('dict') });
+assert.equal(zlib.inflateSync(encoded, { dictionary: new Buffer('dict') }),
+             'test');
+assert.throws(function() {
+  zlib.inflateSync(encoded);
+}, /Missing dictionary/);
+zlib.inflate(encoded, { dictionary: new Buffer('fail') },
+             common.mustCall(function(err) {
+  assert(/Bad dictionary/.test(err.message));
+}));
+
+var dictionary = new Buffer('abcdefgh');
+var compressed = zlib.deflateSync(input, { dictionary: dictionary });
+assert.deepEqual(zlib.inflateSync(compressed, { dictionary: dictionary }),
+                 input);
+
+// A truncated stream yields what could be decoded, like the streams do.
+var gzipped = zlib.gzipSync(input);
+var partial = zlib.gunzipSync(gzipped.slice(0, gzipped.length - 8));
+assert.deepEqual(partial, input);
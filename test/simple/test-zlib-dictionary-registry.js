@@ -0,0 +1,106 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+var common = require('../common.js');
+var assert = require('assert');
+var util = require('util');
+var zlib = require('zlib');
+
+var dictionary = new Buffer('{"id":,"name":"","email":"","status":"active"}');
+var message = '{"id":42,"name":"bob","email":"bob@example.com",' +
+              '"status":"active"}';
+
+var id = zlib.registerDictionary(dictionary);
+assert.equal(typeof id, 'number');
+assert.equal(zlib.registerDictionary(new Buffer(dictionary)), id);
+assert.notEqual(zlib.registerDictionary(new Buffer('something else')), id);
+
+// Same bytes as with the Buffer, for every mode that takes a dictionary,
+// every time, so the copies really start out the same as the template.
+[
+  ['deflateSync', 'inflateSync'],
+  ['deflateRawSync', 'inflateRawSync'],
+].forEach(function(pair) {
+  [{}, { level: 1 }, { level: 9, memLevel: 9 }].forEach(function(opts) {
+    var withBuffer = util._extend({ dictionary: dictionary }, opts);
+    var withId = util._extend({ dictionary: id }, opts);
+    var expected = zlib[pair[0]](message, withBuffer);
+    for (var i = 0; i < 3; i++)
+      assert.deepEqual(zlib[pair[0]](message, withId), expected);
+    if (pair[0] === 'deflateSync') {
+      assert.equal(zlib[pair[1]](expected, withId), message);
+      assert.equal(zlib[pair[1]](expected, withBuffer), message);
+    }
+  });
+});
+
+// Streams and the async convenience methods.
+var deflate = zlib.createDeflate({ dictionary: id });
+var inflate = zlib.createInflate({ dictionary: id });
+var result = '';
+inflate.setEncoding('utf8');
+inflate.on('data', function(chunk) { result += chunk; });
+inflate.on('end', common.mustCall(function() {
+  assert.equal(result, message + message);
+}));
+deflate.pipe(inflate);
+deflate.write(message);
+deflate.end(message);
+
+zlib.deflate(message, { dictionary: id }, common.mustCall(function(err, out) {
+  assert.ifError(err);
+  zlib.inflate(out, { dictionary: id }, common.mustCall(function(err, out) {
+    assert.ifError(err);
+    assert.equal(out, message);
+  }));
+}));
+
+// reset() primes the stream again.
+var reset = zlib.createDeflateRaw({ dictionary: id });
+var chunks = [];
+reset.on('data', function(chunk) { chunks.push(chunk); });
+reset.on('end', common.mustCall(function() {
+  assert.deepEqual(Buffer.concat(chunks),
+                   zlib.deflateRawSync(message, { dictionary: dictionary }));
+}));
+reset.write('partial input', function() {
+  reset.reset();
+  reset.end(message);
+});
+
+// The dictionary still has to be the right one.
+var other = zlib.registerDictionary(new Buffer('not the same'));
+assert.throws(function() {
+  zlib.inflateSync(zlib.deflateSync(message, { dictionary: id }),
+                   { dictionary: other });
+}, /Bad dictionary/);
+
+assert.throws(function() {
+  zlib.deflateSync(message, { dictionary: 12345 });
+}, /Invalid dictionary/);
+
+assert.throws(function() {
+  zlib.createDeflate({ dictionary: 12345 });
+}, /Invalid dictionary/);
+
+assert.throws(function() {
+  zlib.registerDictionary('not a buffer');
+}, TypeError);
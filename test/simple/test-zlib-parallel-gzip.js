@@ -0,0 +1,85 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+var common = require('../common.js');
+var assert = require('assert');
+var zlib = require('zlib');
+
+var input = new Buffer(1024 * 1024 + 1234);
+for (var i = 0; i < input.length; i++)
+  input[i] = (i * 7 + (i >> 9)) % 97;
+
+function compress(opts, chunkSize, data, callback) {
+  var gzip = zlib.createParallelGzip(opts);
+  var chunks = [];
+  gzip.on('data', function(chunk) { chunks.push(chunk); });
+  gzip.on('end', function() { callback(Buffer.concat(chunks)); });
+  for (var i = 0; i < data.length; i += chunkSize)
+    gzip.write(data.slice(i, i + chunkSize));
+  gzip.end();
+}
+
+// gunzip checks the stitched together CRC-32 and length.
+compress({}, 65536, input, common.mustCall(function(output) {
+  assert.deepEqual(output.slice(0, 4), new Buffer([0x1f, 0x8b, 8, 0]));
+  assert.deepEqual(zlib.gunzipSync(output), input);
+
+  // Priming every block with the one before keeps it close to Gzip.
+  var serial = zlib.gzipSync(input);
+  assert(output.length < serial.length * 1.05);
+}));
+
+// Blocks much smaller than the dictionary, odd writes, one thread or many.
+[1, 3, 8].forEach(function(concurrency) {
+  var opts = { blockSize: 1000, concurrency: concurrency, level: 9 };
+  compress(opts, 777, input.slice(0, 100000), common.mustCall(function(out) {
+    assert.equal(out[8], 2);
+    assert.deepEqual(zlib.gunzipSync(out), input.slice(0, 100000));
+  }));
+});
+
+// Nothing at all is still a valid gzip member.
+compress({}, 1, new Buffer(0), common.mustCall(function(output) {
+  assert.equal(zlib.gunzipSync(output).length, 0);
+}));
+
+// Works with pipe() like the other streams.
+var gunzip = zlib.createGunzip();
+var result = [];
+gunzip.on('data', function(chunk) { result.push(chunk); });
+gunzip.on('end', common.mustCall(function() {
+  assert.equal(Buffer.concat(result).toString(), 'hello parallel world');
+}));
+var gzip = zlib.ParallelGzip({ blockSize: 64 });
+gzip.pipe(gunzip);
+gzip.end('hello parallel world');
+
+assert.throws(function() {
+  zlib.createParallelGzip({ blockSize: 1 });
+}, /Invalid block size/);
+
+assert.throws(function() {
+  zlib.createParallelGzip({ concurrency: 1.5 });
+}, /Invalid concurrency/);
+
+assert.throws(function() {
+  zlib.createParallelGzip({ level: 42 });
+}, /Invalid compression level/);
@@ -0,0 +1,93 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+var common = require('../common.js');
+var assert = require('assert');
+var zlib = require('zlib');
+
+var input = new Buffer(64 * 1024);
+for (var i = 0; i < input.length; i++)
+  input[i] = i % 251;
+
+var stats = zlib.getStreamPoolStats();
+assert.equal(stats.size, 16);
+assert.equal(stats.available, 0);
+
+// A reset stream has to produce the same output as a new one, whatever it
+// was used for before.
+var expected = zlib.gzipSync(input);
+stats = zlib.getStreamPoolStats();
+assert.equal(stats.misses, 1);
+assert.equal(stats.available, 1);
+
+assert.deepEqual(zlib.gzipSync(input), expected);
+assert.equal(zlib.getStreamPoolStats().hits, 1);
+
+// Other parameters, other stream.
+var fast = zlib.gzipSync(input, { level: 1 });
+assert.notDeepEqual(fast, expected);
+stats = zlib.getStreamPoolStats();
+assert.equal(stats.misses, 2);
+assert.equal(stats.available, 2);
+assert.deepEqual(zlib.gunzipSync(fast), input);
+
+// A stream that failed is reset before it's reused.
+assert.throws(function() {
+  zlib.gunzipSync(new Buffer('not gzip data'));
+}, /incorrect header check/);
+assert.deepEqual(zlib.gunzipSync(expected), input);
+
+// Streams go back to the pool when they're closed.
+var before = zlib.getStreamPoolStats();
+var gzip = zlib.createGzip();
+var chunks = [];
+gzip.on('data', function(chunk) { chunks.push(chunk); });
+gzip.on('end', common.mustCall(function() {
+  assert.deepEqual(Buffer.concat(chunks), expected);
+  process.nextTick(function() {
+    var after = zlib.getStreamPoolStats();
+    assert.equal(after.hits, before.hits + 1);
+    assert.equal(after.available, before.available);
+
+    // A stream whose parameters were changed gets pooled under the new ones.
+    var deflate = zlib.createDeflate({ level: 9 });
+    deflate.params(1, zlib.Z_DEFAULT_STRATEGY, function() {
+      deflate.close();
+      var hits = zlib.getStreamPoolStats().hits;
+      zlib.deflateSync(input, { level: 1 });
+      assert.equal(zlib.getStreamPoolStats().hits, hits + 1);
+
+      zlib.setStreamPoolSize(1);
+      stats = zlib.getStreamPoolStats();
+      assert.equal(stats.size, 1);
+      assert.equal(stats.available, 1);
+
+      zlib.setStreamPoolSize(0);
+      zlib.gzipSync(input);
+      assert.equal(zlib.getStreamPoolStats().available, 0);
+    });
+  });
+}));
+gzip.end(input);
+
+assert.throws(function() {
+  zlib.setStreamPoolSize(-1);
+}, TypeError);